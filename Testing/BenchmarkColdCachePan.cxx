@@ -0,0 +1,154 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    BenchmarkColdCachePan.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Measures frame times of vtkMultiThreadedOsmLayer while panning over
+// a cold tile cache, with tile images decoded in ResolveAsync() on the
+// rendering thread, as previously done, and on the request threads.
+// Tiles are 256x256 PNG images served by LocalTileServer. Each frame
+// polls the layer and draws the map, as the polling timer of vtkMap
+// does; the worst-case frame time is the one to watch. Renders
+// offscreen.
+//
+// Usage: BenchmarkColdCachePan [number of frames] [storage directory]
+
+#include "LocalTileServer.h"
+#include "MapTestUtilities.h"
+
+#include "vtkMap.h"
+#include "vtkMultiThreadedOsmLayer.h"
+
+#include <vtkGenericRenderWindowInteractor.h>
+#include <vtkNew.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtkTimerLog.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static const int Zoom = 14;
+
+//----------------------------------------------------------------------------
+// Pans for numFrames frames, then until all tiles are loaded.
+// Returns the frame times in seconds.
+static std::vector<double> Pan(LocalTileServer& server,
+                               const std::string& storageDir,
+                               bool decodeInBackground, int numFrames)
+{
+  vtkNew<vtkMap> map;
+  vtkNew<vtkRenderer> renderer;
+  map->SetRenderer(renderer.GetPointer());
+  map->SetStorageDirectory(storageDir.c_str());
+  map->SetCenter(40.0, -100.0);
+  map->SetZoom(Zoom);
+
+  vtkNew<vtkRenderWindow> renderWindow;
+  renderWindow->AddRenderer(renderer.GetPointer());
+  renderWindow->SetSize(1024, 768);
+  renderWindow->OffScreenRenderingOn();
+  vtkNew<vtkGenericRenderWindowInteractor> interactor;
+  interactor->SetRenderWindow(renderWindow.GetPointer());
+
+  // Cold cache: fresh cache directory, no prefetching
+  std::string cacheDir = decodeInBackground ? "background" : "foreground";
+  vtksys::SystemTools::RemoveADirectory(
+    (storageDir + "/" + cacheDir).c_str());
+  vtkNew<vtkMultiThreadedOsmLayer> layer;
+  map->AddLayer(layer.GetPointer());
+  layer->SetCacheSubDirectory(cacheDir.c_str());
+  layer->SetMapTileServer(server.GetHostAndPort().c_str(), "", "png");
+  layer->SetDecodeTilesInBackground(decodeInBackground);
+  layer->PrefetchOff();
+  map->Draw();
+
+  // Diagonal pan, a quarter tile per frame, at about 60 frames per second
+  double tileWidth = 360.0 / (1 << Zoom);
+  std::vector<double> frameTimes;
+  for (int frame = 0; frame < 10 * numFrames; ++frame)
+    {
+    double start = vtkTimerLog::GetUniversalTime();
+    if (frame < numFrames)
+      {
+      map->SetCenter(40.0 + 0.15 * frame * tileWidth,
+                     -100.0 + 0.25 * frame * tileWidth);
+      map->Draw();
+      }
+    map->PollingCallback();
+    frameTimes.push_back(vtkTimerLog::GetUniversalTime() - start);
+    if (frame >= numFrames && map->GetAsyncState() == vtkMap::AsyncIdle)
+      {
+      break;
+      }
+    vtksys::SystemTools::Delay(16);
+    }
+  return frameTimes;
+}
+
+//----------------------------------------------------------------------------
+static void Report(const char *name, std::vector<double> frameTimes)
+{
+  double total = 0.0;
+  for (std::size_t i = 0; i < frameTimes.size(); ++i)
+    {
+    total += frameTimes[i];
+    }
+  std::sort(frameTimes.begin(), frameTimes.end());
+  std::size_t p95 = frameTimes.size() * 95 / 100;
+  std::cout << std::setw(14) << name
+            << std::setw(8) << frameTimes.size()
+            << std::fixed << std::setprecision(2)
+            << std::setw(10) << 1.0e3 * total / frameTimes.size()
+            << std::setw(10) << 1.0e3 * frameTimes[p95]
+            << std::setw(10) << 1.0e3 * frameTimes.back()
+            << std::endl;
+}
+
+//----------------------------------------------------------------------------
+int BenchmarkColdCachePan(int argc, char *argv[])
+{
+  int numFrames = argc > 1 ? atoi(argv[1]) : 120;
+  std::string storageDir = argc > 2 ? argv[2] :
+    vtksys::SystemTools::CollapseFullPath(".vtkmap-benchmark", "~/");
+  vtksys::SystemTools::MakeDirectory(storageDir.c_str());
+
+  LocalTileServer server;
+  server.SetTileData(MakeTileData(256));
+  if (!server.Start())
+    {
+    std::cerr << "Could not start local tile server" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << std::setw(14) << "decode"
+            << std::setw(8) << "frames"
+            << std::setw(10) << "mean ms"
+            << std::setw(10) << "p95 ms"
+            << std::setw(10) << "max ms"
+            << std::endl;
+  Report("foreground", Pan(server, storageDir, false, numFrames));
+  Report("background", Pan(server, storageDir, true, numFrames));
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return BenchmarkColdCachePan(argc, argv);
+}
@@ -0,0 +1,305 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    BenchmarkInteraction.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Measures the tile path of vtkMultiThreadedOsmLayer during a scripted
+// interaction: the map is panned and zoomed through a fixed trajectory,
+// starting from a cold cache, while LocalTileServer serves 256x256 PNG
+// tiles with the given latency, bandwidth and error rate. Each frame
+// moves the view, if the step is not over, and polls the layer, as the
+// polling timer of vtkMap does; after each step, frames go on until all
+// tiles in view are loaded. A view is complete only when none of its
+// tiles is missing: tiles that failed to load, drawn as placeholders or
+// from other zoom levels, leave it incomplete. Renders offscreen.
+//
+// Reports, as one JSON object on the standard output:
+// - frame time percentiles, in milliseconds, over all frames;
+// - per step, the time to complete the view: from the last move of the
+//   view until no tiles are left to load, in milliseconds, and the
+//   number of tiles then missing from the view;
+// - bytes fetched, as sent by the server and counted by the layer;
+// - the metrics of the layer, see vtkMapTileMetrics.
+//
+// Usage: BenchmarkInteraction [latency ms] [bandwidth KB/s]
+//                             [error rate] [storage directory]
+//
+// A bandwidth of 0 is unlimited. The error rate is the fraction of the
+// tile requests answered with 503 (Service Unavailable). The storage
+// directory defaults to BenchmarkInteraction, in the working directory.
+
+#include "LocalTileServer.h"
+#include "MapTestUtilities.h"
+
+#include "vtkMap.h"
+#include "vtkMapTileMetrics.h"
+#include "vtkMultiThreadedOsmLayer.h"
+
+#include <vtkNew.h>
+#include <vtkRenderWindow.h>
+#include <vtkTimerLog.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+const double StartCenter[2] = { 40.0, -100.0 };
+const int StartZoom = 12;
+
+// Longest wait for a view to complete, in seconds
+const double CompleteViewTimeout = 30.0;
+
+// Step of the trajectory: moves the view, over a number of frames, to a
+// zoom level and a center offset from the start, in tiles at the start
+// zoom level (latitude, longitude)
+struct TrajectoryStep
+{
+  const char *Name;
+  int NumberOfFrames;
+  int Zoom;
+  double Offset[2];
+};
+
+const TrajectoryStep Trajectory[] =
+{
+  { "initial view", 0, 12, { 0.0, 0.0 } },
+  { "pan east", 60, 12, { 0.0, 15.0 } },
+  { "zoom in", 3, 15, { 0.0, 15.0 } },
+  { "pan north", 60, 15, { 2.0, 15.0 } },
+  { "zoom out", 3, 12, { 2.0, 15.0 } },
+  { "pan back", 60, 12, { 0.0, 0.0 } }
+};
+const int NumberOfSteps = sizeof(Trajectory) / sizeof(Trajectory[0]);
+
+struct StepResult
+{
+  int NumberOfFrames;
+  double TimeToCompleteView;  // seconds, negative if not completed
+  int NumberOfMissingTiles;   // in view, once no tiles are left to load
+  std::vector<double> FrameTimes;
+};
+
+//----------------------------------------------------------------------------
+// Nearest-rank percentile of sorted values
+double GetPercentile(const std::vector<double>& sorted, double fraction)
+{
+  if (sorted.empty())
+    {
+    return 0.0;
+    }
+  std::size_t rank = static_cast<std::size_t>(fraction * sorted.size());
+  return sorted[rank < sorted.size() ? rank : sorted.size() - 1];
+}
+
+//----------------------------------------------------------------------------
+// Frame time statistics, in milliseconds, as a JSON object
+void PrintFrameTimes(std::vector<double> frameTimes)
+{
+  double total = 0.0;
+  for (std::size_t i = 0; i < frameTimes.size(); ++i)
+    {
+    total += frameTimes[i];
+    }
+  std::sort(frameTimes.begin(), frameTimes.end());
+  double mean = frameTimes.empty() ? 0.0 : total / frameTimes.size();
+  std::cout << "{\"Count\": " << frameTimes.size()
+            << ", \"Mean\": " << 1.0e3 * mean
+            << ", \"P50\": " << 1.0e3 * GetPercentile(frameTimes, 0.5)
+            << ", \"P90\": " << 1.0e3 * GetPercentile(frameTimes, 0.9)
+            << ", \"P99\": " << 1.0e3 * GetPercentile(frameTimes, 0.99)
+            << ", \"Max\": "
+            << 1.0e3 * (frameTimes.empty() ? 0.0 : frameTimes.back())
+            << "}";
+}
+
+//----------------------------------------------------------------------------
+// Move the view by the frame-th of the frames of a step, from the end of
+// the previous step, or just poll the layer if frame is negative.
+// Returns the frame time in seconds.
+double Frame(vtkMap *map, const TrajectoryStep& from,
+             const TrajectoryStep& to, int frame)
+{
+  double start = vtkTimerLog::GetUniversalTime();
+  if (frame >= 0)
+    {
+    double t = static_cast<double>(frame + 1) / to.NumberOfFrames;
+    double tileWidth = 360.0 / (1 << StartZoom);
+    map->SetCenter(
+      StartCenter[0] + tileWidth *
+      (from.Offset[0] + t * (to.Offset[0] - from.Offset[0])),
+      StartCenter[1] + tileWidth *
+      (from.Offset[1] + t * (to.Offset[1] - from.Offset[1])));
+    map->SetZoom(
+      from.Zoom + static_cast<int>(t * (to.Zoom - from.Zoom) +
+                                   (to.Zoom > from.Zoom ? 0.5 : -0.5)));
+    map->Draw();
+    }
+  map->PollingCallback();
+  return vtkTimerLog::GetUniversalTime() - start;
+}
+
+//----------------------------------------------------------------------------
+// Move through the step, at about 60 frames per second, then wait for
+// the view to complete. A step without frames draws the view once.
+StepResult RunStep(vtkMap *map, vtkOsmLayer *layer,
+                   const TrajectoryStep& from, const TrajectoryStep& to)
+{
+  StepResult result;
+  double lastMove = vtkTimerLog::GetUniversalTime();
+  if (to.NumberOfFrames == 0)
+    {
+    map->Draw();
+    }
+  for (int frame = 0; frame < to.NumberOfFrames; ++frame)
+    {
+    lastMove = vtkTimerLog::GetUniversalTime();
+    result.FrameTimes.push_back(Frame(map, from, to, frame));
+    vtksys::SystemTools::Delay(16);
+    }
+  result.NumberOfFrames = static_cast<int>(result.FrameTimes.size());
+
+  // Once no tiles are left to load, the last view drawn has all the
+  // tiles it will get
+  result.TimeToCompleteView = -1.0;
+  for (;;)
+    {
+    result.FrameTimes.push_back(Frame(map, from, to, -1));
+    double now = vtkTimerLog::GetUniversalTime();
+    if (map->GetAsyncState() == vtkMap::AsyncIdle ||
+        now - lastMove > CompleteViewTimeout)
+      {
+      result.NumberOfMissingTiles = layer->GetNumberOfMissingTiles();
+      if (map->GetAsyncState() == vtkMap::AsyncIdle &&
+          result.NumberOfMissingTiles == 0)
+        {
+        result.TimeToCompleteView = now - lastMove;
+        }
+      break;
+      }
+    vtksys::SystemTools::Delay(16);
+    }
+  return result;
+}
+}
+
+//----------------------------------------------------------------------------
+int BenchmarkInteraction(int argc, char *argv[])
+{
+  double latency = argc > 1 ? atof(argv[1]) : 50.0;
+  double bandwidth = argc > 2 ? atof(argv[2]) : 0.0;
+  double errorRate = argc > 3 ? atof(argv[3]) : 0.0;
+  std::string storageDir = argc > 4 ? argv[4] : "BenchmarkInteraction";
+  vtksys::SystemTools::MakeDirectory(storageDir.c_str());
+
+  // As many server threads as the layer keeps connections open
+  LocalTileServer server;
+  server.SetTileData(MakeTileData(256));
+  server.SetKeepAlive(true);
+  server.SetNumberOfThreads(32);
+  server.SetLatency(1.0e-3 * latency, 0.0);
+  server.SetBandwidth(1024.0 * bandwidth);
+  server.SetErrorRate(errorRate);
+  if (!server.Start())
+    {
+    std::cerr << "Could not start local tile server" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Cold cache: fresh cache directory
+  std::string cacheDir = "interaction";
+  vtksys::SystemTools::RemoveADirectory(
+    (storageDir + "/" + cacheDir).c_str());
+  vtkNew<vtkMultiThreadedOsmLayer> layer;
+  TestMapView view(storageDir);
+  vtkMap *map = view.Map.GetPointer();
+  map->SetCenter(StartCenter[0], StartCenter[1]);
+  map->SetZoom(StartZoom);
+  view.RenderWindow->SetSize(1024, 768);
+  map->AddLayer(layer.GetPointer());
+  layer->SetCacheSubDirectory(cacheDir.c_str());
+  layer->SetMapTileServer(server.GetHostAndPort().c_str(), "", "png");
+
+  std::vector<StepResult> results;
+  std::vector<double> frameTimes;
+  for (int i = 0; i < NumberOfSteps; ++i)
+    {
+    results.push_back(RunStep(map, layer.GetPointer(),
+                              Trajectory[i > 0 ? i - 1 : 0], Trajectory[i]));
+    frameTimes.insert(frameTimes.end(), results.back().FrameTimes.begin(),
+                      results.back().FrameTimes.end());
+    }
+
+  vtkMapTileMetricsSnapshot snapshot;
+  layer->GetMetricsSnapshot(snapshot);
+
+  double maxTimeToComplete = 0.0;
+  double totalTimeToComplete = 0.0;
+  bool completed = true;
+  std::cout << "{\"Benchmark\": \"BenchmarkInteraction\""
+            << ", \"Server\": {\"Latency\": " << latency
+            << ", \"Bandwidth\": " << bandwidth
+            << ", \"ErrorRate\": " << errorRate
+            << ", \"Requests\": " << server.GetNumberOfRequests()
+            << ", \"Errors\": " << server.GetNumberOfErrors()
+            << ", \"Connections\": " << server.GetNumberOfConnections()
+            << "}, \"Steps\": [";
+  for (int i = 0; i < NumberOfSteps; ++i)
+    {
+    const StepResult& result = results[i];
+    double timeToComplete = result.TimeToCompleteView;
+    if (timeToComplete < 0.0)
+      {
+      completed = false;
+      timeToComplete = CompleteViewTimeout;
+      }
+    if (timeToComplete > maxTimeToComplete)
+      {
+      maxTimeToComplete = timeToComplete;
+      }
+    totalTimeToComplete += timeToComplete;
+    std::cout << (i > 0 ? ", " : "")
+              << "{\"Name\": \"" << Trajectory[i].Name << "\""
+              << ", \"MoveFrames\": " << result.NumberOfFrames
+              << ", \"Completed\": "
+              << (result.TimeToCompleteView >= 0.0 ? "true" : "false")
+              << ", \"TimeToCompleteView\": " << 1.0e3 * timeToComplete
+              << ", \"MissingTiles\": " << result.NumberOfMissingTiles
+              << ", \"FrameTime\": ";
+    PrintFrameTimes(result.FrameTimes);
+    std::cout << "}";
+    }
+  std::cout << "], \"FrameTime\": ";
+  PrintFrameTimes(frameTimes);
+  std::cout << ", \"TimeToCompleteView\": {\"Mean\": "
+            << 1.0e3 * totalTimeToComplete / NumberOfSteps
+            << ", \"Max\": " << 1.0e3 * maxTimeToComplete
+            << ", \"Completed\": " << (completed ? "true" : "false")
+            << "}, \"BytesSent\": " << server.GetNumberOfBytesSent()
+            << ", \"BytesFetched\": "
+            << snapshot.Counters[vtkMapTileMetrics::DownloadedBytes]
+            << ", \"Metrics\": ";
+  snapshot.PrintJson(std::cout);
+  std::cout << "}" << std::endl;
+
+  return completed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return BenchmarkInteraction(argc, argv);
+}
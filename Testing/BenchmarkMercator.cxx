@@ -0,0 +1,136 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    BenchmarkMercator.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Measures the projection of points with the scalar vtkMercator
+// functions against the array versions: plain arrays of doubles and
+// floats, and the latitude component of vtkPoints, converted point by
+// point through the vtkPoints accessors as vtkGeoJSONMapFeature did,
+// or at once through the points' data array.
+//
+// Usage: BenchmarkMercator [number of points]
+
+#include "vtkMercator.h"
+
+#include <vtkDataArray.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkTimerLog.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+//----------------------------------------------------------------------------
+static void Report(const char *name, vtkIdType numPoints, double seconds)
+{
+  std::cout << std::setw(28) << name
+            << std::fixed << std::setprecision(2)
+            << std::setw(12) << 1.0e9 * seconds / numPoints
+            << std::setw(12) << 1.0e-6 * numPoints / seconds << std::endl;
+}
+
+//----------------------------------------------------------------------------
+int BenchmarkMercator(int argc, char *argv[])
+{
+  vtkIdType numPoints = argc > 1 ? atoi(argv[1]) : 4000000;
+
+  std::vector<double> lat(numPoints), y(numPoints);
+  std::vector<int> tiles(numPoints);
+  for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+    lat[i] = -85.0 + 170.0 * (i % 100003) / 100003.0;
+    }
+  std::vector<float> latFloat(lat.begin(), lat.end());
+  std::vector<float> yFloat(numPoints);
+
+  std::cout << numPoints << " points" << std::endl
+            << std::setw(28) << "" << std::setw(12) << "ns/point"
+            << std::setw(12) << "Mpoints/s" << std::endl;
+
+  double start = vtkTimerLog::GetUniversalTime();
+  for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+    y[i] = vtkMercator::lat2y(lat[i]);
+    }
+  Report("lat2y scalar", numPoints, vtkTimerLog::GetUniversalTime() - start);
+
+  start = vtkTimerLog::GetUniversalTime();
+  vtkMercator::lat2y(&lat[0], &y[0], numPoints);
+  Report("lat2y double array", numPoints,
+         vtkTimerLog::GetUniversalTime() - start);
+
+  start = vtkTimerLog::GetUniversalTime();
+  vtkMercator::lat2y(&latFloat[0], &yFloat[0], numPoints);
+  Report("lat2y float array", numPoints,
+         vtkTimerLog::GetUniversalTime() - start);
+
+  start = vtkTimerLog::GetUniversalTime();
+  for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+    lat[i] = vtkMercator::y2lat(y[i]);
+    }
+  Report("y2lat scalar", numPoints, vtkTimerLog::GetUniversalTime() - start);
+
+  start = vtkTimerLog::GetUniversalTime();
+  vtkMercator::y2lat(&y[0], &lat[0], numPoints);
+  Report("y2lat double array", numPoints,
+         vtkTimerLog::GetUniversalTime() - start);
+
+  start = vtkTimerLog::GetUniversalTime();
+  for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+    tiles[i] = vtkMercator::lat2tiley(lat[i], 16);
+    }
+  Report("lat2tiley scalar", numPoints,
+         vtkTimerLog::GetUniversalTime() - start);
+
+  start = vtkTimerLog::GetUniversalTime();
+  vtkMercator::lat2tiley(&lat[0], &tiles[0], numPoints, 16);
+  Report("lat2tiley array", numPoints,
+         vtkTimerLog::GetUniversalTime() - start);
+
+  // <longitude, latitude, 0> points
+  vtkNew<vtkPoints> points;
+  points->SetDataTypeToDouble();
+  points->SetNumberOfPoints(numPoints);
+  for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+    points->SetPoint(i, 0.0, lat[i], 0.0);
+    }
+
+  start = vtkTimerLog::GetUniversalTime();
+  for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+    double *coords = points->GetPoint(i);
+    coords[1] = vtkMercator::lat2y(coords[1]);
+    points->SetPoint(i, coords);
+    }
+  Report("vtkPoints point by point", numPoints,
+         vtkTimerLog::GetUniversalTime() - start);
+
+  vtkMercator::y2lat(points->GetData(), 1);
+  start = vtkTimerLog::GetUniversalTime();
+  vtkMercator::lat2y(points->GetData(), 1);
+  Report("vtkPoints data array", numPoints,
+         vtkTimerLog::GetUniversalTime() - start);
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return BenchmarkMercator(argc, argv);
+}
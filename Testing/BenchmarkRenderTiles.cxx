@@ -0,0 +1,207 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    BenchmarkRenderTiles.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Measures the cost of vtkOsmLayer::RenderTiles() per frame while
+// panning, for growing tile caches. Compares the previous approach,
+// which removed the actors of all cached tiles from the renderer and
+// added the visible ones on every update, against the incremental
+// update of the attached actors. The incremental cost should stay flat
+// as the cache grows.
+//
+// Usage: BenchmarkRenderTiles [number of frames]
+
+#include "vtkMap.h"
+#include "vtkMapTile.h"
+#include "vtkOsmLayer.h"
+
+#include <vtkActor.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPNGWriter.h>
+#include <vtkRenderer.h>
+#include <vtkTimerLog.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Visible window of WindowSize x WindowSize tiles, panning across a
+// cache laid out as a strip WindowSize tiles high
+static const int WindowSize = 8;
+static const int Zoom = 14;
+
+//----------------------------------------------------------------------------
+// Gives access to the layer's tile cache and RenderTiles()
+class BenchmarkLayer : public vtkOsmLayer
+{
+public:
+  static BenchmarkLayer *New();
+  vtkTypeMacro(BenchmarkLayer, vtkOsmLayer)
+
+  void AddTile(int x, int y, vtkMapTile *tile)
+  {
+    this->AddTileToCache(Zoom, x, y, tile);
+  }
+
+  vtkMapTile *GetTile(int x, int y)
+  {
+    return this->GetCachedTile(Zoom, x, y);
+  }
+
+  std::vector<vtkMapTile*>& GetTiles()
+  {
+    return this->CachedTiles;
+  }
+
+  void Render(std::vector<vtkMapTile*>& tiles)
+  {
+    this->RenderTiles(tiles);
+  }
+};
+vtkStandardNewMacro(BenchmarkLayer)
+
+//----------------------------------------------------------------------------
+// Small tile with a decoded texture, for other tiles to share
+static vtkMapTile *MakeRootTile(double width)
+{
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(16, 16, 1);
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
+  unsigned char *pixel =
+    static_cast<unsigned char*>(image->GetScalarPointer());
+  for (int i = 0; i < 16 * 16 * 3; ++i)
+    {
+    pixel[i] = static_cast<unsigned char>(i);
+    }
+  vtkNew<vtkPNGWriter> writer;
+  writer->SetInputData(image.GetPointer());
+  writer->WriteToMemoryOn();
+  writer->Write();
+  vtkUnsignedCharArray *result = writer->GetResult();
+  std::vector<unsigned char> data(
+    result->GetPointer(0), result->GetPointer(0) + result->GetNumberOfTuples());
+
+  vtkMapTile *tile = vtkMapTile::New();
+  double corners[4] = { 0.0, 0.0, width, WindowSize };
+  tile->SetCorners(corners);
+  tile->SetImageBuffer(data);
+  tile->Init();
+  return tile;
+}
+
+//----------------------------------------------------------------------------
+static void GetWindowTiles(BenchmarkLayer *layer, int frame, int columns,
+                           std::vector<vtkMapTile*>& tiles)
+{
+  int x0 = frame % (columns - WindowSize);
+  for (int x = x0; x < x0 + WindowSize; ++x)
+    {
+    for (int y = 0; y < WindowSize; ++y)
+      {
+      tiles.push_back(layer->GetTile(x, y));
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// RenderTiles() as previously done: remove all cached tiles, then add
+// the visible ones
+static void PreviousRenderTiles(vtkRenderer *renderer,
+                                std::vector<vtkMapTile*>& cachedTiles,
+                                std::vector<vtkMapTile*>& tiles)
+{
+  for (std::size_t i = 0; i < cachedTiles.size(); ++i)
+    {
+    renderer->RemoveActor(cachedTiles[i]->GetActor());
+    }
+  for (std::size_t i = 0; i < tiles.size(); ++i)
+    {
+    renderer->AddActor(tiles[i]->GetActor());
+    }
+  tiles.clear();
+}
+
+//----------------------------------------------------------------------------
+int BenchmarkRenderTiles(int argc, char *argv[])
+{
+  int numFrames = argc > 1 ? atoi(argv[1]) : 200;
+  const int cacheSizes[] = { 256, 1024, 4096, 16384 };
+
+  std::cout << std::setw(10) << "tiles"
+            << std::setw(20) << "previous us/frame"
+            << std::setw(22) << "incremental us/frame"
+            << std::endl;
+
+  for (std::size_t n = 0; n < sizeof(cacheSizes) / sizeof(int); ++n)
+    {
+    vtkNew<vtkMap> map;
+    vtkNew<vtkRenderer> renderer;
+    map->SetRenderer(renderer.GetPointer());
+    vtkNew<BenchmarkLayer> layer;
+    map->AddLayer(layer.GetPointer());
+
+    // Fill the cache with tiles sharing one texture
+    int columns = cacheSizes[n] / WindowSize;
+    vtkMapTile *root = MakeRootTile(columns);
+    for (int x = 0; x < columns; ++x)
+      {
+      for (int y = 0; y < WindowSize; ++y)
+        {
+        vtkMapTile *tile = vtkMapTile::New();
+        double corners[4] = { double(x), double(y), x + 1.0, y + 1.0 };
+        tile->SetActorPool(layer->GetActorPool());
+        tile->SetCorners(corners);
+        tile->InitFromAncestor(root);
+        layer->AddTile(x, y, tile);
+        }
+      }
+
+    std::vector<vtkMapTile*> tiles;
+    double start = vtkTimerLog::GetUniversalTime();
+    for (int frame = 0; frame < numFrames; ++frame)
+      {
+      GetWindowTiles(layer.GetPointer(), frame, columns, tiles);
+      PreviousRenderTiles(renderer.GetPointer(), layer->GetTiles(), tiles);
+      }
+    double previousTime = vtkTimerLog::GetUniversalTime() - start;
+    renderer->RemoveAllViewProps();
+
+    start = vtkTimerLog::GetUniversalTime();
+    for (int frame = 0; frame < numFrames; ++frame)
+      {
+      GetWindowTiles(layer.GetPointer(), frame, columns, tiles);
+      layer->Render(tiles);
+      }
+    double incrementalTime = vtkTimerLog::GetUniversalTime() - start;
+
+    std::cout << std::setw(10) << cacheSizes[n]
+              << std::fixed << std::setprecision(1)
+              << std::setw(20) << 1.0e6 * previousTime / numFrames
+              << std::setw(22) << 1.0e6 * incrementalTime / numFrames
+              << std::endl;
+
+    root->Delete();
+    }
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return BenchmarkRenderTiles(argc, argv);
+}
@@ -0,0 +1,261 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    BenchmarkTileCreation.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Measures map tiles created per second while panning: tiles are built
+// from in-memory png images and the oldest tiles are deleted, keeping a
+// view-sized set alive. Compares the previous per-tile plane pipeline
+// against vtkMapTile with a shared vtkMapTileActorPool. Image decoding
+// alone is timed as the lower bound.
+//
+// Usage: BenchmarkTileCreation [number of tiles]
+
+#include "vtkMapTile.h"
+#include "vtkMapTileActorPool.h"
+
+#include <vtkActor.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPlaneSource.h>
+#include <vtkPNGReader.h>
+#include <vtkPNGWriter.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkProperty.h>
+#include <vtkTexture.h>
+#include <vtkTextureMapToPlane.h>
+#include <vtkTimerLog.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Tiles alive at once, about what an 8x8 tile view keeps around
+static const std::size_t ViewTiles = 64;
+
+//----------------------------------------------------------------------------
+// 256x256 RGB tile image encoded as png
+static void MakeTileData(std::vector<unsigned char>& data)
+{
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(256, 256, 1);
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
+  unsigned char *pixel =
+    static_cast<unsigned char*>(image->GetScalarPointer());
+  for (int j = 0; j < 256; ++j)
+    {
+    for (int i = 0; i < 256; ++i, pixel += 3)
+      {
+      pixel[0] = static_cast<unsigned char>(i);
+      pixel[1] = static_cast<unsigned char>(j);
+      pixel[2] = static_cast<unsigned char>((i / 16 + j / 16) % 2 * 255);
+      }
+    }
+
+  vtkNew<vtkPNGWriter> writer;
+  writer->SetInputData(image.GetPointer());
+  writer->WriteToMemoryOn();
+  writer->Write();
+  vtkUnsignedCharArray *result = writer->GetResult();
+  unsigned char *bytes = result->GetPointer(0);
+  data.assign(bytes, bytes + result->GetNumberOfTuples());
+}
+
+//----------------------------------------------------------------------------
+static vtkImageData *DecodeTile(std::vector<unsigned char>& data)
+{
+  vtkNew<vtkPNGReader> reader;
+  reader->SetMemoryBuffer(&data[0]);
+  reader->SetMemoryBufferLength(static_cast<vtkIdType>(data.size()));
+  reader->Update();
+  vtkImageData *image = vtkImageData::New();
+  image->ShallowCopy(reader->GetOutput());
+  return image;
+}
+
+//----------------------------------------------------------------------------
+static void TileCorners(int i, double corners[4])
+{
+  corners[0] = (i % 16) * 10.0;
+  corners[1] = (i / 16 % 16) * 10.0;
+  corners[2] = corners[0] + 10.0;
+  corners[3] = corners[1] + 10.0;
+}
+
+//----------------------------------------------------------------------------
+// Tile as previously built by vtkMapTile::Build(): its own plane source,
+// texture-coordinate filter, mapper, actor and texture
+struct PipelineTile
+{
+  vtkPlaneSource *Plane;
+  vtkTextureMapToPlane *TexturePlane;
+  vtkPolyDataMapper *Mapper;
+  vtkActor *Actor;
+
+  PipelineTile(std::vector<unsigned char>& data, const double corners[4])
+  {
+    vtkImageData *image = DecodeTile(data);
+    vtkNew<vtkTexture> texture;
+    texture->SetInputData(image);
+    texture->SetQualityTo32Bit();
+    texture->SetInterpolate(1);
+    image->Delete();
+
+    this->Plane = vtkPlaneSource::New();
+    this->Plane->SetPoint1(corners[2], corners[1], 0.0);
+    this->Plane->SetPoint2(corners[0], corners[3], 0.0);
+    this->Plane->SetOrigin(corners[0], corners[1], 0.0);
+    this->Plane->SetNormal(0, 0, 1);
+    this->TexturePlane = vtkTextureMapToPlane::New();
+    this->TexturePlane->SetInputConnection(this->Plane->GetOutputPort());
+    this->Mapper = vtkPolyDataMapper::New();
+    this->Mapper->SetInputConnection(this->TexturePlane->GetOutputPort());
+    this->Actor = vtkActor::New();
+    this->Actor->SetMapper(this->Mapper);
+    this->Actor->PickableOff();
+    this->Actor->GetProperty()->SetLighting(false);
+    this->Actor->SetTexture(texture.GetPointer());
+
+    // Executed by the first render
+    this->Mapper->Update();
+  }
+
+  ~PipelineTile()
+  {
+    this->Plane->Delete();
+    this->TexturePlane->Delete();
+    this->Mapper->Delete();
+    this->Actor->Delete();
+  }
+};
+
+//----------------------------------------------------------------------------
+static double TimeDecode(std::vector<unsigned char>& data, int numTiles)
+{
+  double start = vtkTimerLog::GetUniversalTime();
+  for (int i = 0; i < numTiles; ++i)
+    {
+    DecodeTile(data)->Delete();
+    }
+  return vtkTimerLog::GetUniversalTime() - start;
+}
+
+//----------------------------------------------------------------------------
+static double TimePipelineTiles(std::vector<unsigned char>& data,
+                                int numTiles)
+{
+  std::deque<PipelineTile*> alive;
+  double corners[4];
+  double start = vtkTimerLog::GetUniversalTime();
+  for (int i = 0; i < numTiles; ++i)
+    {
+    TileCorners(i, corners);
+    alive.push_back(new PipelineTile(data, corners));
+    if (alive.size() > ViewTiles)
+      {
+      delete alive.front();
+      alive.pop_front();
+      }
+    }
+  double elapsed = vtkTimerLog::GetUniversalTime() - start;
+  for (std::size_t i = 0; i < alive.size(); ++i)
+    {
+    delete alive[i];
+    }
+  return elapsed;
+}
+
+//----------------------------------------------------------------------------
+static double TimePooledTiles(std::vector<unsigned char>& data,
+                              int numTiles, vtkMapTileActorPool *pool)
+{
+  std::deque<vtkMapTile*> alive;
+  double corners[4];
+  double start = vtkTimerLog::GetUniversalTime();
+  for (int i = 0; i < numTiles; ++i)
+    {
+    TileCorners(i, corners);
+    std::vector<unsigned char> buffer(data);
+    vtkMapTile *tile = vtkMapTile::New();
+    tile->SetActorPool(pool);
+    tile->SetCorners(corners);
+    tile->SetImageBuffer(buffer);
+    tile->Init();
+    tile->GetMapper()->Update();
+    alive.push_back(tile);
+    if (alive.size() > ViewTiles)
+      {
+      alive.front()->Delete();
+      alive.pop_front();
+      }
+    }
+  double elapsed = vtkTimerLog::GetUniversalTime() - start;
+  for (std::size_t i = 0; i < alive.size(); ++i)
+    {
+    alive[i]->Delete();
+    }
+  return elapsed;
+}
+
+//----------------------------------------------------------------------------
+int BenchmarkTileCreation(int argc, char *argv[])
+{
+  int numTiles = argc > 1 ? atoi(argv[1]) : 2000;
+  if (numTiles <= static_cast<int>(ViewTiles))
+    {
+    std::cerr << "Number of tiles must exceed " << ViewTiles << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::vector<unsigned char> data;
+  MakeTileData(data);
+
+  vtkNew<vtkMapTileActorPool> pool;
+  double decodeTime = TimeDecode(data, numTiles);
+  double pipelineTime = TimePipelineTiles(data, numTiles);
+  double pooledTime = TimePooledTiles(data, numTiles, pool.GetPointer());
+
+  // All but the first view's worth of actors are reused
+  if (pool->GetNumberOfCreatedActors() != static_cast<int>(ViewTiles) + 1)
+    {
+    std::cerr << "Expected " << ViewTiles + 1 << " actors to be created, got "
+              << pool->GetNumberOfCreatedActors() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << std::setw(22) << "" << std::setw(14) << "tiles/s"
+            << std::setw(14) << "us/tile" << std::endl;
+  std::cout << std::fixed << std::setprecision(1)
+            << std::setw(22) << "decode only"
+            << std::setw(14) << numTiles / decodeTime
+            << std::setw(14) << 1.0e6 * decodeTime / numTiles << std::endl
+            << std::setw(22) << "per-tile pipeline"
+            << std::setw(14) << numTiles / pipelineTime
+            << std::setw(14) << 1.0e6 * pipelineTime / numTiles << std::endl
+            << std::setw(22) << "pooled actors"
+            << std::setw(14) << numTiles / pooledTime
+            << std::setw(14) << 1.0e6 * pooledTime / numTiles << std::endl
+            << "Pooled actors: " << pool->GetNumberOfCreatedActors()
+            << " created, " << pool->GetNumberOfReusedActors() << " reused"
+            << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return BenchmarkTileCreation(argc, argv);
+}
@@ -0,0 +1,179 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    BenchmarkTileDownload.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Measures tile download throughput from LocalTileServer, with
+// artificial latency per response and per new connection, using as
+// many threads as vtkMultiThreadedOsmLayer. Compares a new curl handle
+// per tile, as the layers previously did, against vtkMapTileFetcher,
+// which keeps connections alive and shares them between threads.
+//
+// Usage: BenchmarkTileDownload [number of tiles] [latency ms]
+//                              [connection latency ms]
+
+#include "LocalTileServer.h"
+
+#include "vtkMapTileFetcher.h"
+
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtkTimerLog.h>
+
+#include <curl/curl.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const int NumberOfThreads = 6;
+
+namespace
+{
+  struct DownloadJob
+  {
+    vtkMapTileFetcher *Fetcher;  // NULL for a new handle per tile
+    std::string Server;
+    int NumberOfTiles;
+    vtkAtomic<vtkTypeInt32> NextTile;
+    vtkAtomic<vtkTypeInt32> Failures;
+  };
+
+  //--------------------------------------------------------------------------
+  size_t AppendToBuffer(void *contents, size_t size, size_t nmemb,
+                        void *userData)
+  {
+    std::vector<unsigned char> *buffer =
+      static_cast<std::vector<unsigned char>*>(userData);
+    unsigned char *bytes = static_cast<unsigned char*>(contents);
+    buffer->insert(buffer->end(), bytes, bytes + size * nmemb);
+    return size * nmemb;
+  }
+}
+
+//----------------------------------------------------------------------------
+// Download as previously done: a new handle, so a new connection,
+// for every tile
+static bool DownloadWithNewHandle(const std::string& url,
+                                  std::vector<unsigned char>& data)
+{
+  data.clear();
+  CURL *curl = curl_easy_init();
+  if (!curl)
+    {
+    return false;
+    }
+  long httpStatus = 0;
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, AppendToBuffer);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &data);
+  CURLcode res = curl_easy_perform(curl);
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpStatus);
+  curl_easy_cleanup(curl);
+  return res == CURLE_OK && httpStatus == 200;
+}
+
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE DownloadTiles(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  DownloadJob *job = static_cast<DownloadJob*>(info->UserData);
+  std::vector<unsigned char> data;
+  int tile;
+  while ((tile = job->NextTile++) < job->NumberOfTiles)
+    {
+    std::stringstream url;
+    url << "http://" << job->Server << "/16/" << tile % 1024 << "/"
+        << tile / 1024 << ".png";
+    bool success = job->Fetcher ?
+      job->Fetcher->Fetch(url.str(), data) :
+      DownloadWithNewHandle(url.str(), data);
+    if (!success)
+      {
+      job->Failures++;
+      }
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+static void Run(const char *name, LocalTileServer& server,
+                vtkMapTileFetcher *fetcher, int numTiles)
+{
+  DownloadJob job;
+  job.Fetcher = fetcher;
+  job.Server = server.GetHostAndPort();
+  job.NumberOfTiles = numTiles;
+  job.NextTile = 0;
+  job.Failures = 0;
+  int connections = server.GetNumberOfConnections();
+
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(NumberOfThreads);
+  threader->SetSingleMethod(DownloadTiles, &job);
+  double start = vtkTimerLog::GetUniversalTime();
+  threader->SingleMethodExecute();
+  double seconds = vtkTimerLog::GetUniversalTime() - start;
+
+  std::cout << std::setw(14) << name
+            << std::fixed << std::setprecision(1)
+            << std::setw(12) << numTiles / seconds
+            << std::setw(14) << server.GetNumberOfConnections() - connections
+            << std::setw(10) << job.Failures
+            << std::endl;
+}
+
+//----------------------------------------------------------------------------
+int BenchmarkTileDownload(int argc, char *argv[])
+{
+  int numTiles = argc > 1 ? atoi(argv[1]) : 600;
+  double latency = (argc > 2 ? atof(argv[2]) : 5.0) / 1000.0;
+  double connectionLatency = (argc > 3 ? atof(argv[3]) : 30.0) / 1000.0;
+
+  // Enough threads for the fetcher's idle connections too
+  LocalTileServer server;
+  server.SetKeepAlive(true);
+  server.SetNumberOfThreads(2 * NumberOfThreads);
+  server.SetLatency(latency, connectionLatency);
+  if (!server.Start())
+    {
+    std::cerr << "Could not start local tile server" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::cout << numTiles << " tiles, " << NumberOfThreads << " threads, "
+            << 1000.0 * latency << " ms latency, "
+            << 1000.0 * connectionLatency << " ms per new connection"
+            << std::endl
+            << std::setw(14) << "" << std::setw(12) << "tiles/s"
+            << std::setw(14) << "connections" << std::setw(10) << "failed"
+            << std::endl;
+
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+  Run("new handle", server, NULL, numTiles);
+  vtkNew<vtkMapTileFetcher> fetcher;
+  Run("fetcher", server, fetcher.GetPointer(), numTiles);
+  curl_global_cleanup();
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return BenchmarkTileDownload(argc, argv);
+}
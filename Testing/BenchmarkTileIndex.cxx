@@ -0,0 +1,151 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    BenchmarkTileIndex.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Compares the tile lookup pattern of vtkOsmLayer::SelectTiles() using
+// the previous nested std::map cache index against the flat
+// vtkMapTileIndexInternal, for increasing cache sizes.
+
+#include "vtkMapTileIndexInternal.h"
+
+#include <vtkTimerLog.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <vector>
+
+typedef std::map< int, std::map< int, std::map <int, void*> > > NestedMap;
+
+//----------------------------------------------------------------------------
+// Lookup as previously done by vtkOsmLayer::GetCachedTile()
+static void *NestedFind(NestedMap& map, int zoom, int x, int y)
+{
+  if (map.find(zoom) == map.end() &&
+      map[zoom].find(x) == map[zoom].end() &&
+      map[zoom][x].find(y) == map[zoom][x].end())
+    {
+    return NULL;
+    }
+  return map[zoom][x][y];
+}
+
+//----------------------------------------------------------------------------
+// Visit a view-sized window of tiles, like SelectTiles() does per update
+template <typename FindFunction>
+static double TimeLookups(FindFunction find, int zoom, int passes,
+                          std::size_t& hits)
+{
+  const int windowSize = 8;  // 8x8 tiles, a large display at one zoom
+  const int extent = 1 << zoom;
+  double start = vtkTimerLog::GetUniversalTime();
+  for (int pass = 0; pass < passes; ++pass)
+    {
+    // Pan the window across the zoom level
+    int x0 = (pass * 3) % (extent - windowSize);
+    int y0 = (pass * 5) % (extent - windowSize);
+    for (int i = x0; i < x0 + windowSize; ++i)
+      {
+      for (int j = y0; j < y0 + windowSize; ++j)
+        {
+        hits += find(zoom, i, j) ? 1 : 0;
+        }
+      }
+    }
+  return vtkTimerLog::GetUniversalTime() - start;
+}
+
+struct NestedFinder
+{
+  NestedMap *Map;
+  void *operator()(int z, int x, int y) { return NestedFind(*Map, z, x, y); }
+};
+
+struct FlatFinder
+{
+  vtkMapTileIndexInternal<void*> *Index;
+  void *operator()(int z, int x, int y)
+  {
+    void **value =
+      Index->Find(vtkMapTileIndexInternal<void*>::MakeKey(z, x, y));
+    return value ? *value : NULL;
+  }
+};
+
+//----------------------------------------------------------------------------
+int BenchmarkTileIndex(int argc, char *argv[])
+{
+  int passes = argc > 1 ? atoi(argv[1]) : 20000;
+  const int lookupZoom = 12;
+  const int cacheSizes[] = { 256, 1024, 4096, 16384, 65536, 262144 };
+
+  std::cout << std::setw(10) << "tiles"
+            << std::setw(16) << "map ns/lookup"
+            << std::setw(16) << "flat ns/lookup"
+            << std::setw(10) << "speedup"
+            << std::setw(16) << "map x-entries"
+            << std::endl;
+
+  for (std::size_t n = 0; n < sizeof(cacheSizes) / sizeof(int); ++n)
+    {
+    NestedMap nested;
+    vtkMapTileIndexInternal<void*> flat;
+
+    // Fill caches with tiles spread over zoom levels, as left
+    // behind by a long session of panning and zooming
+    srand(1);
+    for (int i = 0; i < cacheSizes[n]; ++i)
+      {
+      int zoom = 4 + (rand() % 14);
+      int x = rand() % (1 << zoom);
+      int y = rand() % (1 << zoom);
+      void *tile = reinterpret_cast<void*>(static_cast<std::size_t>(i + 1));
+      nested[zoom][x][y] = tile;
+      flat.Insert(vtkMapTileIndexInternal<void*>::MakeKey(zoom, x, y), tile);
+      }
+
+    std::size_t nestedHits = 0;
+    std::size_t flatHits = 0;
+    NestedFinder nestedFinder = { &nested };
+    FlatFinder flatFinder = { &flat };
+    double nestedTime =
+      TimeLookups(nestedFinder, lookupZoom, passes, nestedHits);
+    double flatTime = TimeLookups(flatFinder, lookupZoom, passes, flatHits);
+
+    if (nestedHits != flatHits)
+      {
+      std::cerr << "Lookup mismatch: " << nestedHits
+                << " vs " << flatHits << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    double lookups = 64.0 * passes;
+    std::cout << std::setw(10) << cacheSizes[n]
+              << std::setw(16) << std::fixed << std::setprecision(1)
+              << 1.0e9 * nestedTime / lookups
+              << std::setw(16) << 1.0e9 * flatTime / lookups
+              << std::setw(10) << std::setprecision(2)
+              << nestedTime / flatTime
+              << std::setw(16) << nested[lookupZoom].size()
+              << std::endl;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return BenchmarkTileIndex(argc, argv);
+}
@@ -0,0 +1,194 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    BenchmarkTileRendering.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Compares frame times of drawing map tiles with one actor per tile,
+// as vtkOsmLayer does by default, against one vtkMapTileAtlas actor,
+// for growing numbers of tiles, looking straight down and in a tilted
+// perspective view. Renders offscreen.
+//
+// Meant to be run with software rendering, so that per-draw-call
+// overhead is not hidden by the GPU, e.g. Mesa llvmpipe:
+//   LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe BenchmarkTileRendering
+// or with VTK built against OSMesa.
+//
+// Usage: BenchmarkTileRendering [number of frames]
+
+#include "vtkMapTile.h"
+#include "vtkMapTileActorPool.h"
+#include "vtkMapTileAtlas.h"
+
+#include <vtkActor.h>
+#include <vtkCamera.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPNGWriter.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtkTimerLog.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// 256x256 RGB tile image encoded as png, distinct per seed
+static void MakeTileData(int seed, std::vector<unsigned char>& data)
+{
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(256, 256, 1);
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
+  unsigned char *pixel =
+    static_cast<unsigned char*>(image->GetScalarPointer());
+  for (int j = 0; j < 256; ++j)
+    {
+    for (int i = 0; i < 256; ++i, pixel += 3)
+      {
+      pixel[0] = static_cast<unsigned char>(i + seed * 37);
+      pixel[1] = static_cast<unsigned char>(j + seed * 91);
+      pixel[2] = static_cast<unsigned char>((i / 16 + j / 16) % 2 * 255);
+      }
+    }
+
+  vtkNew<vtkPNGWriter> writer;
+  writer->SetInputData(image.GetPointer());
+  writer->WriteToMemoryOn();
+  writer->Write();
+  vtkUnsignedCharArray *result = writer->GetResult();
+  unsigned char *bytes = result->GetPointer(0);
+  data.assign(bytes, bytes + result->GetNumberOfTuples());
+}
+
+//----------------------------------------------------------------------------
+// Place the camera over the side x side tile grid, straight down or
+// tilted towards the horizon
+static void SetView(vtkRenderer *renderer, int side, bool tilted)
+{
+  vtkCamera *camera = renderer->GetActiveCamera();
+  double center = 0.5 * side;
+  camera->SetFocalPoint(center, center, 0.0);
+  camera->SetPosition(center, center, 1.0);
+  camera->SetViewUp(0.0, 1.0, 0.0);
+  renderer->ResetCamera();
+  if (tilted)
+    {
+    camera->Elevation(-60.0);
+    camera->OrthogonalizeViewUp();
+    renderer->ResetCameraClippingRange();
+    }
+}
+
+//----------------------------------------------------------------------------
+// Seconds per frame, after a warm-up frame that uploads the textures
+static double TimeFrames(vtkRenderWindow *window, vtkRenderer *renderer,
+                         int numFrames)
+{
+  window->Render();
+  double start = vtkTimerLog::GetUniversalTime();
+  for (int frame = 0; frame < numFrames; ++frame)
+    {
+    // Small pan, as while dragging the map
+    renderer->GetActiveCamera()->Azimuth(frame % 2 ? 0.1 : -0.1);
+    window->Render();
+    }
+  return (vtkTimerLog::GetUniversalTime() - start) / numFrames;
+}
+
+//----------------------------------------------------------------------------
+int BenchmarkTileRendering(int argc, char *argv[])
+{
+  int numFrames = argc > 1 ? atoi(argv[1]) : 50;
+  const int sides[] = { 4, 8, 12 };
+
+  vtkNew<vtkRenderer> renderer;
+  vtkNew<vtkRenderWindow> window;
+  window->SetOffScreenRendering(1);
+  window->SetSize(1024, 768);
+  window->AddRenderer(renderer.GetPointer());
+
+  std::cout << std::setw(8) << "tiles" << std::setw(12) << "view"
+            << std::setw(16) << "actors ms/frame"
+            << std::setw(16) << "atlas ms/frame"
+            << std::setw(10) << "speedup" << std::endl;
+
+  vtkNew<vtkMapTileActorPool> pool;
+  for (std::size_t n = 0; n < sizeof(sides) / sizeof(int); ++n)
+    {
+    // side x side unit tiles, each with its own image
+    int side = sides[n];
+    std::vector<vtkMapTile*> tiles;
+    for (int i = 0; i < side * side; ++i)
+      {
+      std::vector<unsigned char> data;
+      MakeTileData(i, data);
+      vtkMapTile *tile = vtkMapTile::New();
+      double corners[4] =
+        { double(i % side), double(i / side),
+          double(i % side + 1), double(i / side + 1) };
+      tile->SetActorPool(pool.GetPointer());
+      tile->SetCorners(corners);
+      tile->SetImageBuffer(data);
+      tile->Init();
+      tiles.push_back(tile);
+      }
+
+    vtkNew<vtkMapTileAtlas> atlas;
+    if (!atlas->Update(tiles))
+      {
+      std::cerr << "Tiles do not fit into the atlas" << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    for (int tilted = 0; tilted < 2; ++tilted)
+      {
+      SetView(renderer.GetPointer(), side, tilted != 0);
+
+      for (std::size_t i = 0; i < tiles.size(); ++i)
+        {
+        renderer->AddActor(tiles[i]->GetActor());
+        }
+      double actorTime =
+        TimeFrames(window.GetPointer(), renderer.GetPointer(), numFrames);
+      renderer->RemoveAllViewProps();
+
+      renderer->AddActor(atlas->GetActor());
+      double atlasTime =
+        TimeFrames(window.GetPointer(), renderer.GetPointer(), numFrames);
+      renderer->RemoveAllViewProps();
+
+      std::cout << std::setw(8) << tiles.size()
+                << std::setw(12) << (tilted ? "tilted" : "top-down")
+                << std::fixed << std::setprecision(2)
+                << std::setw(16) << 1000.0 * actorTime
+                << std::setw(16) << 1000.0 * atlasTime
+                << std::setw(10) << actorTime / atlasTime << std::endl;
+      }
+
+    atlas->GetActor()->ReleaseGraphicsResources(window.GetPointer());
+    for (std::size_t i = 0; i < tiles.size(); ++i)
+      {
+      tiles[i]->GetActor()->ReleaseGraphicsResources(window.GetPointer());
+      tiles[i]->Delete();
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return BenchmarkTileRendering(argc, argv);
+}
@@ -0,0 +1,211 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    BenchmarkTileStore.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Compares the per-file tile cache layout ("<z>-<x>-<y>.png" files, as
+// written by vtkOsmLayer) against vtkPackedTileStore, for startup and
+// cache-hit latency. Also verifies import/export round trips.
+//
+// Usage: BenchmarkTileStore [directory] [number of tiles]
+
+#include "vtkPackedTileStore.h"
+
+#include <vtkNew.h>
+#include <vtkTimerLog.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Fake png bytes: valid magic and trailer around a pseudo-random payload
+static void MakeTileData(int seed, std::vector<unsigned char>& data)
+{
+  static const unsigned char pngMagic[8] =
+    { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+  static const unsigned char pngEnd[12] =
+    { 0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xae, 0x42, 0x60, 0x82 };
+  data.resize(8000 + (seed * 7919) % 16000);
+  std::copy(pngMagic, pngMagic + 8, data.begin());
+  unsigned int state = seed + 1;
+  for (std::size_t i = 8; i < data.size() - 12; ++i)
+    {
+    state = state * 1103515245 + 12345;
+    data[i] = static_cast<unsigned char>(state >> 16);
+    }
+  // Complete PNG trailer, as imported tiles are checked for one
+  std::copy(pngEnd, pngEnd + 12, data.end() - 12);
+}
+
+//----------------------------------------------------------------------------
+static std::string TilePath(const std::string& dir, int z, int x, int y)
+{
+  std::stringstream ss;
+  ss << dir << "/" << z << "-" << x << "-" << y << ".png";
+  return ss.str();
+}
+
+//----------------------------------------------------------------------------
+// Cache hit as done by vtkMultiThreadedOsmLayer + vtkMapTile::Build():
+// existence check, then open and read the whole file
+static bool ReadTileFile(const std::string& path,
+                         std::vector<unsigned char>& data)
+{
+  if (!vtksys::SystemTools::FileExists(path.c_str(), true))
+    {
+    return false;
+    }
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp)
+    {
+    return false;
+    }
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  data.resize(static_cast<std::size_t>(size));
+  bool ok = fread(&data[0], 1, data.size(), fp) == data.size();
+  fclose(fp);
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+int BenchmarkTileStore(int argc, char *argv[])
+{
+  std::string baseDir = argc > 1 ? argv[1] : "BenchmarkTileStore";
+  int numTiles = argc > 2 ? atoi(argv[2]) : 20000;
+  const int numLookups = 20000;
+  const int zoom = 14;
+
+  std::string fileDir = baseDir + "/files";
+  std::string exportDir = baseDir + "/export";
+  std::string packPath = baseDir + "/tiles.pack";
+  vtksys::SystemTools::RemoveADirectory(baseDir);
+  vtksys::SystemTools::MakeDirectory(fileDir);
+
+  // Populate per-file cache
+  std::vector<unsigned char> data;
+  std::vector<int> xs(numTiles), ys(numTiles);
+  for (int i = 0; i < numTiles; ++i)
+    {
+    xs[i] = 8000 + i % 300;
+    ys[i] = 5000 + i / 300;
+    MakeTileData(i, data);
+    FILE *fp = fopen(TilePath(fileDir, zoom, xs[i], ys[i]).c_str(), "wb");
+    if (!fp)
+      {
+      std::cerr << "Cannot write to " << fileDir << std::endl;
+      return EXIT_FAILURE;
+      }
+    fwrite(&data[0], 1, data.size(), fp);
+    fclose(fp);
+    }
+
+  // Import into packed store
+  vtkNew<vtkPackedTileStore> store;
+  double start = vtkTimerLog::GetUniversalTime();
+  store->Open(packPath.c_str());
+  int imported = store->ImportDirectory(fileDir.c_str(), "png");
+  double importTime = vtkTimerLog::GetUniversalTime() - start;
+  store->Close();
+  if (imported != numTiles)
+    {
+    std::cerr << "Imported " << imported << " of " << numTiles << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Startup: per-file cache needs a directory scan to know its contents;
+  // the store loads its index
+  start = vtkTimerLog::GetUniversalTime();
+  vtksys::Directory dir;
+  dir.Load(fileDir);
+  double fileStartup = vtkTimerLog::GetUniversalTime() - start;
+
+  start = vtkTimerLog::GetUniversalTime();
+  store->Open(packPath.c_str());
+  double storeStartup = vtkTimerLog::GetUniversalTime() - start;
+
+  // Cache hits in pseudo-random order, plus the same number of misses
+  std::vector<unsigned char> fileData, storeData;
+  double fileHit = 0.0, storeHit = 0.0, fileMiss = 0.0, storeMiss = 0.0;
+  for (int n = 0; n < numLookups; ++n)
+    {
+    int i = static_cast<int>((n * 2654435761u) % numTiles);
+    std::string path = TilePath(fileDir, zoom, xs[i], ys[i]);
+
+    start = vtkTimerLog::GetUniversalTime();
+    bool fileOk = ReadTileFile(path, fileData);
+    fileHit += vtkTimerLog::GetUniversalTime() - start;
+
+    start = vtkTimerLog::GetUniversalTime();
+    bool storeOk = store->Contains(zoom, xs[i], ys[i]) &&
+      store->Get(zoom, xs[i], ys[i], storeData);
+    storeHit += vtkTimerLog::GetUniversalTime() - start;
+
+    if (!fileOk || !storeOk || fileData != storeData)
+      {
+      std::cerr << "Tile mismatch at " << path << std::endl;
+      return EXIT_FAILURE;
+      }
+
+    path = TilePath(fileDir, zoom + 1, xs[i], ys[i]);
+    start = vtkTimerLog::GetUniversalTime();
+    ReadTileFile(path, fileData);
+    fileMiss += vtkTimerLog::GetUniversalTime() - start;
+
+    start = vtkTimerLog::GetUniversalTime();
+    store->Contains(zoom + 1, xs[i], ys[i]);
+    storeMiss += vtkTimerLog::GetUniversalTime() - start;
+    }
+
+  // Round trip back to per-file layout
+  int exported = store->ExportDirectory(exportDir.c_str(), "png");
+  ReadTileFile(TilePath(exportDir, zoom, xs[0], ys[0]), fileData);
+  MakeTileData(0, data);
+  if (exported != numTiles || fileData != data)
+    {
+    std::cerr << "Export failed: " << exported << " tiles" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  double usPerLookup = 1.0e6 / numLookups;
+  std::cout << std::fixed << std::setprecision(2)
+            << "tiles: " << numTiles
+            << ", pack size: " << store->GetPackSize() / (1024 * 1024)
+            << " MB, import: " << importTime << " s\n"
+            << std::setw(12) << "" << std::setw(14) << "startup ms"
+            << std::setw(14) << "hit us" << std::setw(14) << "miss us\n"
+            << std::setw(12) << "per-file" << std::setw(14)
+            << 1000.0 * fileStartup
+            << std::setw(14) << fileHit * usPerLookup
+            << std::setw(14) << fileMiss * usPerLookup << "\n"
+            << std::setw(12) << "packed" << std::setw(14)
+            << 1000.0 * storeStartup
+            << std::setw(14) << storeHit * usPerLookup
+            << std::setw(14) << storeMiss * usPerLookup << std::endl;
+
+  store->Close();
+  vtksys::SystemTools::RemoveADirectory(baseDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return BenchmarkTileStore(argc, argv);
+}
@@ -0,0 +1,525 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    LocalTileServer.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME LocalTileServer - stand-in map tile server for tests
+// .SECTION Description
+// Minimal HTTP server on 127.0.0.1, serving a small PNG-signed body
+// for every "GET /<zoom>/<x>/<y>.<ext>" request, so that tile
+// downloads can be tested without network access. By default, requests
+// are handled one at a time by a background thread, and each connection
+// is closed after the response. Paths added with FailPath() get a 404
+// response. SetTileData() replaces the PNG-signed body with real image
+// data, for tests that decode the tiles.
+//
+// Tile responses carry an ETag naming the tile version set with
+// SetTileVersion(), and optionally a Cache-Control max-age. Conditional
+// requests for the current version get a 304 response without body.
+//
+// To measure downloads under more realistic conditions, the server can
+// keep connections alive, serve several connections at once from a
+// number of threads, and delay responses: every response by a latency
+// standing in for the round trip to a remote server, and the first
+// response of each connection by a further latency standing in for the
+// TCP and TLS handshakes. Responses can also be sent at a limited
+// bandwidth per connection, and a fraction of the tile requests answered
+// with 503 (Service Unavailable), as overloaded servers do.
+//
+// Usage:
+//   LocalTileServer server;
+//   server.Start();
+//   layer->SetMapTileServer(server.GetHostAndPort().c_str(), "", "png");
+
+#ifndef __LocalTileServer_h
+#define __LocalTileServer_h
+
+#include <vtkAtomic.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+
+#include <cstring>
+#include <set>
+#include <vector>
+#include <sstream>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>  // Sleep()
+typedef SOCKET LocalTileServerSocket;
+#define LOCAL_TILE_SERVER_INVALID_SOCKET INVALID_SOCKET
+#define LOCAL_TILE_SERVER_CLOSE closesocket
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int LocalTileServerSocket;
+#define LOCAL_TILE_SERVER_INVALID_SOCKET -1
+#define LOCAL_TILE_SERVER_CLOSE close
+#endif
+
+class LocalTileServer
+{
+public:
+  LocalTileServer()
+  {
+    this->Socket = LOCAL_TILE_SERVER_INVALID_SOCKET;
+    this->Port = 0;
+    this->Running = 0;
+    this->NumberOfRequests = 0;
+    this->NumberOfConnections = 0;
+    this->NumberOfNotModified = 0;
+    this->TileVersion = 1;
+    this->MaxAge = -1;
+    this->TileSize = 1024;
+    this->NumberOfThreads = 1;
+    this->KeepAlive = false;
+    this->Latency = 0.0;
+    this->ConnectionLatency = 0.0;
+    this->Bandwidth = 0.0;
+    this->ErrorRate = 0.0;
+    this->ErrorSeed = 1;
+    this->NumberOfErrors = 0;
+    this->NumberOfBytesSent = 0;
+    this->Threader = vtkMultiThreader::New();
+    this->Lock = vtkMutexLock::New();
+    this->AcceptLock = vtkMutexLock::New();
+  }
+
+  ~LocalTileServer()
+  {
+    this->Stop();
+    this->Threader->Delete();
+    this->Lock->Delete();
+    this->AcceptLock->Delete();
+  }
+
+  // Number of connections served at once. Call before Start().
+  void SetNumberOfThreads(int count)
+  {
+    this->NumberOfThreads = count > 0 ? count : 1;
+  }
+
+  // Keep connections open for further requests, unless the client asks
+  // to close them. Keep-alive connections each hold a thread while
+  // open, so use as many threads as the client opens connections.
+  void SetKeepAlive(bool keepAlive)
+  {
+    this->KeepAlive = keepAlive;
+  }
+
+  // Delay, in seconds, of every response, and further delay of the
+  // first response of each connection
+  void SetLatency(double seconds, double connectionSeconds)
+  {
+    this->Latency = seconds;
+    this->ConnectionLatency = connectionSeconds;
+  }
+
+  // Bytes per second at which each connection sends its responses.
+  // 0, the default, sends them at once.
+  void SetBandwidth(double bytesPerSecond)
+  {
+    this->Bandwidth = bytesPerSecond;
+  }
+
+  // Fraction, from 0 to 1, of the tile requests answered with 503.
+  // The requests failing are drawn from a fixed pseudo-random sequence,
+  // so that runs are comparable, and requests tried again may succeed.
+  void SetErrorRate(double fraction)
+  {
+    this->ErrorRate = fraction;
+  }
+
+  // Listen on an ephemeral port and start serving.
+  // Returns false if the socket could not be set up.
+  bool Start()
+  {
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+    this->Socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (this->Socket == LOCAL_TILE_SERVER_INVALID_SOCKET)
+      {
+      return false;
+      }
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if (bind(this->Socket, reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) != 0 ||
+        listen(this->Socket, 64) != 0 ||
+        getsockname(this->Socket, reinterpret_cast<sockaddr*>(&address),
+                    &length) != 0)
+      {
+      LOCAL_TILE_SERVER_CLOSE(this->Socket);
+      this->Socket = LOCAL_TILE_SERVER_INVALID_SOCKET;
+      return false;
+      }
+    this->Port = ntohs(address.sin_port);
+    this->Running = 1;
+    for (int i = 0; i < this->NumberOfThreads; ++i)
+      {
+      this->ThreadIds.push_back(
+        this->Threader->SpawnThread(StaticServe, this));
+      }
+    return true;
+  }
+
+  void Stop()
+  {
+    if (!this->Running)
+      {
+      return;
+      }
+    this->Running = 0;
+    for (std::size_t i = 0; i < this->ThreadIds.size(); ++i)
+      {
+      this->Threader->TerminateThread(this->ThreadIds[i]);
+      }
+    this->ThreadIds.clear();
+    LOCAL_TILE_SERVER_CLOSE(this->Socket);
+    this->Socket = LOCAL_TILE_SERVER_INVALID_SOCKET;
+#ifdef _WIN32
+    WSACleanup();
+#endif
+  }
+
+  // Server name for vtkOsmLayer::SetMapTileServer()
+  std::string GetHostAndPort() const
+  {
+    std::stringstream ss;
+    ss << "127.0.0.1:" << this->Port;
+    return ss.str();
+  }
+
+  // Respond with 404 to requests for the path, e.g. "/3/1/2.png"
+  void FailPath(const std::string& path)
+  {
+    this->Lock->Lock();
+    this->FailedPaths.insert(path);
+    this->Lock->Unlock();
+  }
+
+  void ClearFailedPaths()
+  {
+    this->Lock->Lock();
+    this->FailedPaths.clear();
+    this->Lock->Unlock();
+  }
+
+  // Serve data, e.g. an encoded image, as the body of every tile
+  // response. Call before Start().
+  void SetTileData(const std::string& data)
+  {
+    this->TileData = data;
+    this->TileSize = static_cast<int>(data.size());
+  }
+
+  // Version of the tiles, sent as ETag "v<version>". Changing it makes
+  // conditional requests for earlier versions get the tile again.
+  void SetTileVersion(int version)
+  {
+    this->TileVersion = version;
+  }
+
+  // Send "Cache-Control: max-age=<seconds>" with tile responses.
+  // A negative value, the default, sends no Cache-Control header.
+  void SetMaxAge(int seconds)
+  {
+    this->MaxAge = seconds;
+  }
+
+  // Number of requests received
+  int GetNumberOfRequests()
+  {
+    return this->NumberOfRequests;
+  }
+
+  // Paths of the requests received, in order
+  std::vector<std::string> GetRequestedPaths()
+  {
+    this->Lock->Lock();
+    std::vector<std::string> paths = this->RequestedPaths;
+    this->Lock->Unlock();
+    return paths;
+  }
+
+  // Number of conditional requests answered with 304 (Not Modified)
+  int GetNumberOfNotModified()
+  {
+    return this->NumberOfNotModified;
+  }
+
+  // Number of connections accepted
+  int GetNumberOfConnections()
+  {
+    return this->NumberOfConnections;
+  }
+
+  // Number of requests answered with 503 because of the error rate
+  int GetNumberOfErrors()
+  {
+    return this->NumberOfErrors;
+  }
+
+  // Bytes of the responses sent, headers included
+  vtkTypeInt64 GetNumberOfBytesSent()
+  {
+    return this->NumberOfBytesSent;
+  }
+
+  // Body size of tile responses, in bytes
+  int GetTileSize() const
+  {
+    return this->TileSize;
+  }
+
+protected:
+  static VTK_THREAD_RETURN_TYPE StaticServe(void *arg)
+  {
+    vtkMultiThreader::ThreadInfo *info =
+      static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+    static_cast<LocalTileServer*>(info->UserData)->Serve();
+    return VTK_THREAD_RETURN_VALUE;
+  }
+
+  void Serve()
+  {
+    while (this->Running)
+      {
+      // Poll, so that Stop() does not have to interrupt accept(). One
+      // thread at a time waits for a connection.
+      this->AcceptLock->Lock();
+      LocalTileServerSocket client = LOCAL_TILE_SERVER_INVALID_SOCKET;
+      if (WaitForData(this->Socket))
+        {
+        client = accept(this->Socket, NULL, NULL);
+        }
+      this->AcceptLock->Unlock();
+      if (client == LOCAL_TILE_SERVER_INVALID_SOCKET)
+        {
+        continue;
+        }
+      ++this->NumberOfConnections;
+      this->HandleConnection(client);
+      LOCAL_TILE_SERVER_CLOSE(client);
+      }
+  }
+
+  // Wait up to 50 ms for data, or a connection, on the socket
+  static bool WaitForData(LocalTileServerSocket socket)
+  {
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(socket, &readSet);
+    timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 50000;
+    return select(static_cast<int>(socket) + 1, &readSet, NULL, NULL,
+                  &timeout) > 0;
+  }
+
+  static void Wait(double seconds)
+  {
+    if (seconds <= 0.0)
+      {
+      return;
+      }
+#ifdef _WIN32
+    Sleep(static_cast<DWORD>(seconds * 1000.0));
+#else
+    usleep(static_cast<useconds_t>(seconds * 1.0e6));
+#endif
+  }
+
+  void HandleConnection(LocalTileServerSocket client)
+  {
+    std::string received;
+    bool firstRequest = true;
+    while (this->Running)
+      {
+      // Read the request header, leaving any further requests for later
+      std::size_t end;
+      while ((end = received.find("\r\n\r\n")) == std::string::npos)
+        {
+        if (!this->Running)
+          {
+          return;
+          }
+        if (!WaitForData(client))
+          {
+          continue;
+          }
+        char buffer[1024];
+        int count = static_cast<int>(recv(client, buffer, sizeof(buffer), 0));
+        if (count <= 0)
+          {
+          return;
+          }
+        received.append(buffer, count);
+        }
+      std::string request = received.substr(0, end + 4);
+      received.erase(0, end + 4);
+      ++this->NumberOfRequests;
+
+      Wait(firstRequest ? this->Latency + this->ConnectionLatency :
+           this->Latency);
+      firstRequest = false;
+
+      bool keepAlive = this->KeepAlive &&
+        request.find("Connection: close") == std::string::npos;
+      if (!this->SendResponse(client, request, keepAlive) || !keepAlive)
+        {
+        return;
+        }
+      }
+  }
+
+  bool SendResponse(LocalTileServerSocket client, const std::string& request,
+                    bool keepAlive)
+  {
+    // "GET <path> HTTP/1.1"
+    std::string method, path;
+    std::istringstream line(request);
+    line >> method >> path;
+
+    this->Lock->Lock();
+    bool fail = method != "GET" || this->FailedPaths.count(path) > 0;
+    this->RequestedPaths.push_back(path);
+    bool error = false;
+    if (!fail && this->ErrorRate > 0.0)
+      {
+      this->ErrorSeed = this->ErrorSeed * 1103515245u + 12345u;
+      error = (this->ErrorSeed >> 8) / 16777216.0 < this->ErrorRate;
+      }
+    this->Lock->Unlock();
+
+    std::stringstream etag;
+    etag << "\"v" << this->TileVersion << "\"";
+    bool notModified = !fail && !error &&
+      request.find("If-None-Match: " + etag.str() + "\r\n") !=
+      std::string::npos;
+
+    std::string body;
+    std::stringstream response;
+    if (fail)
+      {
+      body = "Not Found";
+      response << "HTTP/1.1 404 Not Found\r\n";
+      }
+    else if (error)
+      {
+      ++this->NumberOfErrors;
+      body = "Service Unavailable";
+      response << "HTTP/1.1 503 Service Unavailable\r\n";
+      }
+    else if (notModified)
+      {
+      ++this->NumberOfNotModified;
+      response << "HTTP/1.1 304 Not Modified\r\n";
+      }
+    else if (!this->TileData.empty())
+      {
+      body = this->TileData;
+      response << "HTTP/1.1 200 OK\r\n"
+               << "Content-Type: image/png\r\n";
+      }
+    else
+      {
+      static const char pngMagic[8] =
+        { '\x89', 'P', 'N', 'G', '\x0d', '\x0a', '\x1a', '\x0a' };
+      body.assign(this->TileSize, '\0');
+      static const char pngEnd[12] =
+        { '\0', '\0', '\0', '\0', 'I', 'E', 'N', 'D',
+          '\xae', '\x42', '\x60', '\x82' };
+      body.replace(0, 8, pngMagic, 8);
+      // Make each tile distinct
+      body.replace(8, path.size(), path);
+      // End with the IEND chunk, as complete PNG files do
+      body.replace(body.size() - 12, 12, pngEnd, 12);
+      response << "HTTP/1.1 200 OK\r\n"
+               << "Content-Type: image/png\r\n";
+      }
+    if (!fail && !error)
+      {
+      response << "ETag: " << etag.str() << "\r\n";
+      if (this->MaxAge >= 0)
+        {
+        response << "Cache-Control: max-age=" << this->MaxAge << "\r\n";
+        }
+      }
+    response << "Content-Length: " << body.size() << "\r\n"
+             << "Connection: " << (keepAlive ? "keep-alive" : "close")
+             << "\r\n\r\n"
+             << body;
+    std::string data = response.str();
+    // At a limited bandwidth, send 4 KB at a time, each after the time
+    // it takes
+    std::size_t chunkSize = this->Bandwidth > 0.0 ? 4096 : data.size();
+    std::size_t sent = 0;
+    while (sent < data.size())
+      {
+      std::size_t size = data.size() - sent;
+      size = size < chunkSize ? size : chunkSize;
+      if (this->Bandwidth > 0.0)
+        {
+        Wait(static_cast<double>(size) / this->Bandwidth);
+        }
+      int count = static_cast<int>(send(client, data.data() + sent,
+        static_cast<int>(size), 0));
+      if (count <= 0)
+        {
+        return false;
+        }
+      sent += count;
+      this->NumberOfBytesSent += count;
+      }
+    return true;
+  }
+
+  LocalTileServerSocket Socket;
+  int Port;
+  std::vector<int> ThreadIds;
+  int TileSize;
+  std::string TileData;
+  int NumberOfThreads;
+  bool KeepAlive;
+  double Latency;
+  double ConnectionLatency;
+  double Bandwidth;
+  double ErrorRate;
+  unsigned int ErrorSeed;
+  vtkAtomic<vtkTypeInt32> Running;
+  vtkAtomic<vtkTypeInt32> NumberOfRequests;
+  vtkAtomic<vtkTypeInt32> NumberOfConnections;
+  vtkAtomic<vtkTypeInt32> NumberOfNotModified;
+  vtkAtomic<vtkTypeInt32> NumberOfErrors;
+  vtkAtomic<vtkTypeInt64> NumberOfBytesSent;
+  vtkAtomic<vtkTypeInt32> TileVersion;
+  vtkAtomic<vtkTypeInt32> MaxAge;
+  std::set<std::string> FailedPaths;
+  std::vector<std::string> RequestedPaths;
+  vtkMultiThreader *Threader;
+  vtkMutexLock *Lock;
+  vtkMutexLock *AcceptLock;
+};
+
+#endif // __LocalTileServer_h
@@ -0,0 +1,218 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    MapTestUtilities.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME MapTestUtilities - helpers shared by the vtkMap tests
+// .SECTION Description
+// CHECK(condition) makes the calling test function return EXIT_FAILURE,
+// after printing the line and condition, if the condition is false.
+//
+// MakeStorageDirectory() empties the storage directory of a test,
+// CountFiles() counts the files in a directory by suffix, MakeTileData()
+// encodes a PNG image to serve or store as a tile, PutTiles() stores one
+// as every tile of a zoom level in a vtkPackedTileStore, WaitForTiles()
+// waits for the requests of a vtkMultiThreadedOsmLayer, and TestMapView
+// is an offscreen map drawing tile layers, e.g. from a LocalTileServer
+// or a vtkProceduralTileSource.
+
+#ifndef __MapTestUtilities_h
+#define __MapTestUtilities_h
+
+#include "vtkMap.h"
+#include "vtkMultiThreadedOsmLayer.h"
+#include "vtkOsmLayer.h"
+#include "vtkPackedTileStore.h"
+
+#include <vtkGenericRenderWindowInteractor.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPNGWriter.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtksys/Directory.hxx>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#define CHECK(condition) \
+  if (!(condition)) \
+    { \
+    std::cerr << "Failed at line " << __LINE__ << ": " #condition \
+              << std::endl; \
+    return EXIT_FAILURE; \
+    }
+
+//----------------------------------------------------------------------------
+// Storage directory of a test, given as first argument or named after
+// the test, created empty
+inline std::string MakeStorageDirectory(int argc, char *argv[],
+                                        const std::string& testName)
+{
+  std::string storageDir = argc > 1 ? argv[1] : testName;
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  vtksys::SystemTools::MakeDirectory(storageDir);
+  return storageDir;
+}
+
+//----------------------------------------------------------------------------
+// Number of files in the directory whose names end with the suffix
+inline int CountFiles(const std::string& dirName, const std::string& suffix)
+{
+  vtksys::Directory dir;
+  dir.Load(dirName);
+  int count = 0;
+  for (unsigned long i = 0; i < dir.GetNumberOfFiles(); ++i)
+    {
+    std::string name = dir.GetFile(i);
+    if (name.size() > suffix.size() &&
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+      {
+      ++count;
+      }
+    }
+  return count;
+}
+
+//----------------------------------------------------------------------------
+// RGB PNG image of size x size pixels. Noisy enough that a 256x256
+// image takes about as long to decode as a map tile.
+inline std::string MakeTileData(int size = 16)
+{
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(size, size, 1);
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
+  unsigned char *pixel =
+    static_cast<unsigned char*>(image->GetScalarPointer());
+  unsigned int seed = 1;
+  for (int i = 0; i < size * size * 3; ++i)
+    {
+    seed = seed * 1103515245 + 12345;
+    pixel[i] = static_cast<unsigned char>((i / 3 % 256) ^ (seed >> 28));
+    }
+  vtkNew<vtkPNGWriter> writer;
+  writer->SetInputData(image.GetPointer());
+  writer->WriteToMemoryOn();
+  writer->Write();
+  vtkUnsignedCharArray *result = writer->GetResult();
+  return std::string(reinterpret_cast<char*>(result->GetPointer(0)),
+                     result->GetNumberOfTuples());
+}
+
+//----------------------------------------------------------------------------
+// Put the same image in the store as every tile of the zoom level
+inline bool PutTiles(vtkPackedTileStore *store, int zoom)
+{
+  std::string data = MakeTileData();
+  for (int x = 0; x < (1 << zoom); ++x)
+    {
+    for (int y = 0; y < (1 << zoom); ++y)
+      {
+      if (!store->Put(zoom, x, y,
+                      reinterpret_cast<const unsigned char*>(data.data()),
+                      data.size()))
+        {
+        return false;
+        }
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Wait up to 30 seconds until the layer has loaded all tiles in view.
+// Returns false on timeout.
+inline bool WaitForTiles(vtkMultiThreadedOsmLayer *layer)
+{
+  for (int i = 0; i < 600; ++i)
+    {
+    if (layer->GetNumberOfScheduledTiles() == 0)
+      {
+      return true;
+      }
+    vtksys::SystemTools::Delay(50);
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+// Offscreen map, 512x512 pixels, centered on (40, -100) at zoom level 4
+class TestMapView
+{
+public:
+  explicit TestMapView(const std::string& storageDir)
+  {
+    this->Initialize(storageDir);
+  }
+
+  // Map showing the layer, with tiles from the tile server, given as
+  // "host:port", or from the tile source, drawn once. The tiles of a
+  // vtkMultiThreadedOsmLayer are waited for and added to the layer.
+  TestMapView(const std::string& storageDir, vtkOsmLayer *layer,
+              const std::string& server)
+  {
+    this->Initialize(storageDir);
+    this->Map->AddLayer(layer);
+    layer->SetMapTileServer(server.c_str(), "", "png");
+    this->DrawTiles(layer);
+  }
+
+  TestMapView(const std::string& storageDir, vtkOsmLayer *layer,
+              vtkTileSource *source)
+  {
+    this->Initialize(storageDir);
+    this->Map->AddLayer(layer);
+    layer->SetMapTileServer("procedural", "", "png");
+    layer->SetTileSource(source);
+    this->DrawTiles(layer);
+  }
+
+  // Draw the map, then wait for the tiles of the layer, if threaded
+  void DrawTiles(vtkOsmLayer *layer)
+  {
+    this->Map->Draw();
+    vtkMultiThreadedOsmLayer *threaded =
+      vtkMultiThreadedOsmLayer::SafeDownCast(layer);
+    if (threaded && WaitForTiles(threaded))
+      {
+      while (threaded->ResolveAsync() == vtkMap::AsyncPartialUpdate)
+        {
+        }
+      }
+  }
+
+  vtkNew<vtkMap> Map;
+  vtkNew<vtkRenderer> Renderer;
+  vtkNew<vtkRenderWindow> RenderWindow;
+  vtkNew<vtkGenericRenderWindowInteractor> Interactor;
+
+private:
+  void Initialize(const std::string& storageDir)
+  {
+    this->Map->SetRenderer(this->Renderer.GetPointer());
+    this->Map->SetStorageDirectory(storageDir.c_str());
+    this->Map->SetCenter(40.0, -100.0);
+    this->Map->SetZoom(4);
+    this->RenderWindow->AddRenderer(this->Renderer.GetPointer());
+    this->RenderWindow->SetSize(512, 512);
+    this->RenderWindow->OffScreenRenderingOn();
+    this->Interactor->SetRenderWindow(this->RenderWindow.GetPointer());
+  }
+
+  TestMapView(const TestMapView&);  // Not implemented
+  void operator=(const TestMapView&); // Not implemented
+};
+
+#endif // __MapTestUtilities_h
@@ -0,0 +1,185 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileAtlas.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks that vtkMapTileAtlas copies each tile image once, keeps slots
+// of images still in view, shares slots between tiles showing the same
+// image, points texture coordinates at the right texels, and refuses
+// tiles that do not fit.
+
+#include "MapTestUtilities.h"
+
+#include "vtkMapTile.h"
+#include "vtkMapTileAtlas.h"
+
+#include <vtkActor.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPNGWriter.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkTexture.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+  const int ImageSize = 64;
+}
+
+//----------------------------------------------------------------------------
+// Tile with a png image whose red channel is the seed, and whose
+// green and blue channels are the pixel indices
+static vtkMapTile *MakeTile(int seed, double x, double y)
+{
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(ImageSize, ImageSize, 1);
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
+  unsigned char *pixel =
+    static_cast<unsigned char*>(image->GetScalarPointer());
+  for (int j = 0; j < ImageSize; ++j)
+    {
+    for (int i = 0; i < ImageSize; ++i, pixel += 3)
+      {
+      pixel[0] = static_cast<unsigned char>(seed);
+      pixel[1] = static_cast<unsigned char>(i);
+      pixel[2] = static_cast<unsigned char>(j);
+      }
+    }
+  vtkNew<vtkPNGWriter> writer;
+  writer->SetInputData(image.GetPointer());
+  writer->WriteToMemoryOn();
+  writer->Write();
+  vtkUnsignedCharArray *result = writer->GetResult();
+  std::vector<unsigned char> data(
+    result->GetPointer(0), result->GetPointer(0) + result->GetNumberOfTuples());
+
+  vtkMapTile *tile = vtkMapTile::New();
+  double corners[4] = { x, y, x + 1.0, y + 1.0 };
+  tile->SetCorners(corners);
+  tile->SetImageBuffer(data);
+  tile->Init();
+  return tile;
+}
+
+//----------------------------------------------------------------------------
+// Atlas texel under texture coordinate (s, t)
+static unsigned char *AtlasTexel(vtkMapTileAtlas *atlas, double s, double t)
+{
+  vtkImageData *image = atlas->GetActor()->GetTexture()->GetInput();
+  int *dims = image->GetDimensions();
+  return static_cast<unsigned char*>(image->GetScalarPointer(
+    static_cast<int>(s * dims[0]), static_cast<int>(t * dims[1]), 0));
+}
+
+//----------------------------------------------------------------------------
+static vtkPolyData *AtlasPolyData(vtkMapTileAtlas *atlas)
+{
+  return vtkPolyDataMapper::SafeDownCast(
+    atlas->GetActor()->GetMapper())->GetInput();
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileAtlas(int, char *[])
+{
+  std::vector<vtkMapTile*> tiles;
+  for (int i = 0; i < 6; ++i)
+    {
+    tiles.push_back(MakeTile(i + 1, i, 0.0));
+    }
+
+  // Fallback tile showing the upper right quarter of the first tile
+  vtkMapTile *fallback = vtkMapTile::New();
+  double corners[4] = { 0.5, 0.5, 1.0, 1.0 };
+  fallback->SetCorners(corners);
+  fallback->InitFromAncestor(tiles[0]);
+  tiles.push_back(fallback);
+
+  vtkNew<vtkMapTileAtlas> atlas;
+  CHECK(atlas->Update(tiles));
+  CHECK(atlas->GetNumberOfUsedSlots() == 6);
+  CHECK(atlas->GetNumberOfSlots() >= 6);
+  CHECK(atlas->GetNumberOfCopiedImages() == 6);
+  CHECK(AtlasPolyData(atlas.GetPointer())->GetNumberOfCells() == 7);
+
+  // Each quad samples its own image, from the lower left texel inward
+  vtkDataArray *tcoords =
+    AtlasPolyData(atlas.GetPointer())->GetPointData()->GetTCoords();
+  for (int i = 0; i < 6; ++i)
+    {
+    double *st = tcoords->GetTuple(4 * i);
+    unsigned char *texel = AtlasTexel(atlas.GetPointer(), st[0], st[1]);
+    CHECK(texel[0] == i + 1);
+    CHECK(texel[1] == 0 && texel[2] == 0);
+    CHECK(texel[3] == 255);
+    }
+  // The fallback quad starts in the middle of the first image
+  double *st = tcoords->GetTuple(4 * 6);
+  unsigned char *texel = AtlasTexel(atlas.GetPointer(), st[0], st[1]);
+  CHECK(texel[0] == 1);
+  CHECK(texel[1] == ImageSize / 2 && texel[2] == ImageSize / 2);
+
+  // Unchanged tiles are not copied again
+  CHECK(atlas->Update(tiles));
+  CHECK(atlas->GetNumberOfCopiedImages() == 6);
+
+  // Panning: two tiles leave the view and two new ones take their slots
+  tiles[4]->Delete();
+  tiles[5]->Delete();
+  tiles[4] = MakeTile(7, 4.0, 1.0);
+  tiles[5] = MakeTile(8, 5.0, 1.0);
+  int numSlots = atlas->GetNumberOfSlots();
+  CHECK(atlas->Update(tiles));
+  CHECK(atlas->GetNumberOfCopiedImages() == 8);
+  CHECK(atlas->GetNumberOfUsedSlots() == 6);
+  CHECK(atlas->GetNumberOfSlots() == numSlots);
+  tcoords = AtlasPolyData(atlas.GetPointer())->GetPointData()->GetTCoords();
+  st = tcoords->GetTuple(4 * 5);
+  CHECK(AtlasTexel(atlas.GetPointer(), st[0], st[1])[0] == 8);
+
+  // 256 x 256 atlas: 16 slots of 64 x 64
+  vtkNew<vtkMapTileAtlas> smallAtlas;
+  smallAtlas->SetMaxSize(ImageSize);
+  CHECK(smallAtlas->GetMaxSize() == 256);  // clamped
+  std::vector<vtkMapTile*> manyTiles;
+  for (int i = 0; i < 17; ++i)
+    {
+    manyTiles.push_back(MakeTile(i, i, 2.0));
+    }
+  CHECK(!smallAtlas->Update(manyTiles));
+  manyTiles.back()->Delete();
+  manyTiles.pop_back();
+  CHECK(smallAtlas->Update(manyTiles));
+  CHECK(smallAtlas->GetNumberOfSlots() == 16);
+
+  for (std::size_t i = 0; i < tiles.size(); ++i)
+    {
+    tiles[i]->Delete();
+    }
+  for (std::size_t i = 0; i < manyTiles.size(); ++i)
+    {
+    manyTiles[i]->Delete();
+    }
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestMapTileAtlas(argc, argv);
+}
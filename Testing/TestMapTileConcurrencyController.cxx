@@ -0,0 +1,151 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileConcurrencyController.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks vtkMapTileConcurrencyController: the limit of a host grows
+// while its requests succeed and use it fully, halves on 429 and 503
+// responses, failures and slow responses, at most once per response
+// time, and stays between the floor and ceiling. Hosts are independent.
+
+#include "MapTestUtilities.h"
+
+#include "vtkMapTileConcurrencyController.h"
+
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+//----------------------------------------------------------------------------
+// Begin as many requests as allowed, and return their number
+static int BeginRequests(vtkMapTileConcurrencyController *controller,
+                         const std::string& host)
+{
+  int count = 0;
+  while (controller->TryBeginRequest(host))
+    {
+    ++count;
+    }
+  return count;
+}
+
+//----------------------------------------------------------------------------
+// Complete count requests, with new ones using the limit fully
+static void CompleteRequests(vtkMapTileConcurrencyController *controller,
+                             const std::string& host, int count,
+                             double seconds, long httpStatus)
+{
+  for (int i = 0; i < count; ++i)
+    {
+    controller->RecordResponse(host, seconds, httpStatus);
+    controller->EndRequest(host);
+    BeginRequests(controller, host);
+    }
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileConcurrencyController(int, char *[])
+{
+  CHECK(vtkMapTileConcurrencyController::GetHost(
+          "http://tile.example.org:8080/4/3/5.png") ==
+        "tile.example.org:8080");
+  CHECK(vtkMapTileConcurrencyController::GetHost("localhost/tiles") ==
+        "localhost");
+
+  vtkNew<vtkMapTileConcurrencyController> controller;
+  controller->SetMinConcurrency(2);
+  controller->SetMaxConcurrency(10);
+  const std::string host = "a.example.org";
+  const std::string other = "b.example.org";
+
+  // New hosts start at the initial limit
+  CHECK(controller->GetConcurrency(host) == 6);
+  CHECK(BeginRequests(controller.GetPointer(), host) == 6);
+  CHECK(controller->GetNumberOfActiveRequests(host) == 6);
+  CHECK(controller->TryBeginRequest(other));
+  controller->EndRequest(other);
+
+  // Fast responses with the limit in use grow it by one per round
+  CompleteRequests(controller.GetPointer(), host, 6, 0.02, 200);
+  CHECK(controller->GetConcurrency(host) == 7);
+  CHECK(controller->GetNumberOfActiveRequests(host) == 7);
+  CompleteRequests(controller.GetPointer(), host, 200, 0.02, 200);
+  CHECK(controller->GetConcurrency(host) == 10);
+  CHECK(controller->GetNumberOfDecreases(host) == 0);
+
+  // 429 halves it, once per response time
+  CompleteRequests(controller.GetPointer(), host, 1, 0.02, 429);
+  CHECK(controller->GetConcurrency(host) == 5);
+  CompleteRequests(controller.GetPointer(), host, 1, 0.02, 503);
+  CHECK(controller->GetConcurrency(host) == 5);
+  vtksys::SystemTools::Delay(30);
+  CompleteRequests(controller.GetPointer(), host, 1, 0.02, 503);
+  CHECK(controller->GetConcurrency(host) == 2);
+  vtksys::SystemTools::Delay(30);
+  CompleteRequests(controller.GetPointer(), host, 1, 0.02, 429);
+  CHECK(controller->GetConcurrency(host) == 2);
+  CHECK(controller->GetNumberOfDecreases(host) == 3);
+  CHECK(controller->GetConcurrency(other) == 6);
+
+  // Once the requests in flight have ended, the limit applies
+  for (int i = 0; i < 10; ++i)
+    {
+    controller->EndRequest(host);
+    }
+  CHECK(controller->GetNumberOfActiveRequests(host) == 0);
+  CHECK(BeginRequests(controller.GetPointer(), host) == 2);
+
+  // Responses taking much longer than the fastest ones decrease it
+  controller->Reset();
+  controller->SetLatencyTolerance(4.0);
+  BeginRequests(controller.GetPointer(), host);
+  CompleteRequests(controller.GetPointer(), host, 8, 0.02, 200);
+  vtkTypeInt64 decreases = controller->GetNumberOfDecreases(host);
+  CHECK(decreases == 0);
+  int concurrency = controller->GetConcurrency(host);
+  CompleteRequests(controller.GetPointer(), host, 10, 0.5, 200);
+  CHECK(controller->GetNumberOfDecreases(host) == 1);
+  CHECK(controller->GetConcurrency(host) < concurrency);
+
+  // So do failures without responses, once they are frequent
+  controller->Reset();
+  controller->SetMaxErrorRate(0.25);
+  CompleteRequests(controller.GetPointer(), host, 2, 1.0, 0);
+  CHECK(controller->GetNumberOfDecreases(host) == 0);
+  CompleteRequests(controller.GetPointer(), host, 1, 1.0, 0);
+  CHECK(controller->GetNumberOfDecreases(host) == 1);
+  CHECK(controller->GetConcurrency(host) == 3);
+
+  // 404 responses do not
+  controller->Reset();
+  CompleteRequests(controller.GetPointer(), host, 20, 0.02, 404);
+  CHECK(controller->GetNumberOfDecreases(host) == 0);
+
+  // Changing the ceiling clamps the limits
+  controller->SetMaxConcurrency(4);
+  CHECK(controller->GetConcurrency(host) == 4);
+  CHECK(controller->GetInitialConcurrency() == 4);
+  controller->SetMinConcurrency(8);
+  CHECK(controller->GetMaxConcurrency() == 8);
+  CHECK(controller->GetConcurrency(other) == 8);
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestMapTileConcurrencyController(argc, argv);
+}
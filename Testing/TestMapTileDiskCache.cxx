@@ -0,0 +1,207 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileDiskCache.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks that vtkMapTileDiskCache evicts least recently used tiles,
+// that access order persists across sessions through the journal, kept
+// only while a quota is set, and
+// that eviction works with a vtkPackedTileStore.
+//
+// Usage: TestMapTileDiskCache [directory]
+
+#include "MapTestUtilities.h"
+
+#include "vtkMapTileDiskCache.h"
+#include "vtkPackedTileStore.h"
+
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+  const int NumberOfTiles = 100;
+  const int TileSize = 1000;
+  const int Zoom = 10;
+}
+
+//----------------------------------------------------------------------------
+static std::string TilePath(const std::string& dir, int i)
+{
+  std::stringstream ss;
+  ss << dir << "/" << Zoom << "-" << i << "-" << i << ".png";
+  return ss.str();
+}
+
+//----------------------------------------------------------------------------
+static void MakeTileData(std::vector<unsigned char>& data)
+{
+  static const unsigned char pngMagic[8] =
+    { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+  data.assign(TileSize, 0);
+  std::copy(pngMagic, pngMagic + 8, data.begin());
+}
+
+//----------------------------------------------------------------------------
+static int TestFileCache(const std::string& dir)
+{
+  std::vector<unsigned char> data;
+  MakeTileData(data);
+  for (int i = 0; i < NumberOfTiles; ++i)
+    {
+    FILE *fp = fopen(TilePath(dir, i).c_str(), "wb");
+    CHECK(fp != NULL);
+    fwrite(&data[0], 1, data.size(), fp);
+    fclose(fp);
+    }
+
+  // First session: use tiles 0-49, 0 first
+  {
+  vtkNew<vtkMapTileDiskCache> cache;
+  cache->Open(dir.c_str(), "png", NULL);
+  cache->Flush();
+  CHECK(cache->GetNumberOfTiles() == NumberOfTiles);
+  CHECK(cache->GetDiskUsage() >= NumberOfTiles * TileSize);
+
+  for (int i = 0; i < 50; ++i)
+    {
+    cache->RecordAccess(Zoom, i, i);
+    }
+
+  // Accesses are only journaled while a quota is set
+  cache->Flush();
+  CHECK(!vtksys::SystemTools::FileExists((dir + "/tiles.journal").c_str()));
+
+  // Over quota: unused tiles 50-99 go first, down to 90% of 60
+  cache->SetMaxNumberOfTiles(60);
+  cache->Flush();
+  CHECK(cache->GetNumberOfTiles() == 54);
+  CHECK(cache->GetNumberOfEvictedTiles() == 46);
+  for (int i = 0; i < 50; ++i)
+    {
+    CHECK(vtksys::SystemTools::FileExists(TilePath(dir, i).c_str()));
+    }
+  cache->Close();
+  }
+
+  // Second session: access order is restored from the journal
+  {
+  vtkNew<vtkMapTileDiskCache> cache;
+  cache->Open(dir.c_str(), "png", NULL);
+  cache->Flush();
+  CHECK(cache->GetNumberOfTiles() == 54);
+
+  // New download, then a byte quota that keeps about 40 tiles
+  FILE *fp = fopen(TilePath(dir, 200).c_str(), "wb");
+  CHECK(fp != NULL);
+  fwrite(&data[0], 1, data.size(), fp);
+  fclose(fp);
+  cache->RecordInsert(Zoom, 200, 200, TileSize);
+  cache->SetMaxSize(45 * TileSize);
+  cache->Flush();
+  CHECK(cache->GetDiskUsage() <= 45 * TileSize);
+  CHECK(vtksys::SystemTools::FileExists(TilePath(dir, 200).c_str()));
+  CHECK(vtksys::SystemTools::FileExists(TilePath(dir, 49).c_str()));
+  CHECK(!vtksys::SystemTools::FileExists(TilePath(dir, 0).c_str()));
+  CHECK(!vtksys::SystemTools::FileExists(TilePath(dir, 55).c_str()));
+  }
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+static int TestPackedCache(const std::string& dir)
+{
+  std::string packPath = dir + "/tiles.pack";
+  std::vector<unsigned char> data;
+  MakeTileData(data);
+
+  vtkNew<vtkPackedTileStore> store;
+  CHECK(store->Open(packPath.c_str()));
+  for (int i = 0; i < NumberOfTiles; ++i)
+    {
+    CHECK(store->Put(Zoom, i, i, &data[0], data.size()));
+    }
+  CHECK(store->Contains(Zoom, NumberOfTiles - 1, NumberOfTiles - 1));
+  vtkTypeInt64 fullSize = store->GetPackSize();
+
+  vtkNew<vtkMapTileDiskCache> cache;
+  cache->Open(dir.c_str(), "png", store.GetPointer());
+  cache->Flush();
+  CHECK(cache->GetNumberOfTiles() == NumberOfTiles);
+  for (int i = 50; i < NumberOfTiles; ++i)
+    {
+    cache->RecordAccess(Zoom, i, i);
+    }
+  cache->SetMaxNumberOfTiles(50);
+  cache->Flush();
+  CHECK(cache->GetNumberOfTiles() == 45);
+  CHECK(store->GetNumberOfTiles() == 45);
+  CHECK(store->GetPackSize() < fullSize / 2);
+  CHECK(!store->Contains(Zoom, 49, 49));
+  CHECK(store->Get(Zoom, 99, 99, data) && data.size() == TileSize);
+
+  // Evicting a few tiles leaves the pack uncompacted
+  vtkTypeInt64 compactedSize = store->GetPackSize();
+  cache->SetMaxNumberOfTiles(40);
+  cache->Flush();
+  CHECK(store->GetNumberOfTiles() == 36);
+  CHECK(store->GetPackSize() > compactedSize);
+  CHECK(!store->Contains(Zoom, 58, 58));
+  cache->Close();
+
+  // Removals and compaction survive reopening
+  store->Close();
+  CHECK(store->Open(packPath.c_str()));
+  CHECK(store->GetNumberOfTiles() == 36);
+  CHECK(!store->Contains(Zoom, 0, 0));
+  CHECK(store->Remove(Zoom, 99, 99));
+  store->Close();
+  CHECK(store->Open(packPath.c_str()));
+  CHECK(store->GetNumberOfTiles() == 35);
+  CHECK(!store->Contains(Zoom, 99, 99));
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileDiskCache(int argc, char *argv[])
+{
+  std::string baseDir = argc > 1 ? argv[1] : "TestMapTileDiskCache";
+  std::string fileDir = baseDir + "/files";
+  std::string packDir = baseDir + "/packed";
+  vtksys::SystemTools::RemoveADirectory(baseDir);
+  vtksys::SystemTools::MakeDirectory(fileDir);
+  vtksys::SystemTools::MakeDirectory(packDir);
+
+  int result = TestFileCache(fileDir);
+  if (result == EXIT_SUCCESS)
+    {
+    result = TestPackedCache(packDir);
+    }
+
+  vtksys::SystemTools::RemoveADirectory(baseDir);
+  return result;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestMapTileDiskCache(argc, argv);
+}
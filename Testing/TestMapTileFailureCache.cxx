@@ -0,0 +1,171 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileFailureCache.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks vtkMapTileFailureCache: failed tiles are retried after
+// exponentially growing delays, server failures open the circuit, which
+// a single probe closes again, and invalid tile data does not. Then checks that a vtkOsmLayer drawing a
+// tile the server does not have neither hangs nor requests the tile
+// again on every draw, and draws a placeholder in its place.
+
+#include "LocalTileServer.h"
+#include "MapTestUtilities.h"
+
+#include "vtkMap.h"
+#include "vtkMapTileFailureCache.h"
+#include "vtkMercator.h"
+#include "vtkOsmLayer.h"
+
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+//----------------------------------------------------------------------------
+static int TestBackoff()
+{
+  vtkNew<vtkMapTileFailureCache> cache;
+  cache->SetInitialDelay(0.2);
+  cache->SetMaxDelay(0.4);
+  cache->SetCircuitBreakerThreshold(3);
+  cache->SetCircuitBreakerDelay(0.2);
+
+  // A missing tile waits 0.2, then 0.4 s, and the delay stops growing
+  CHECK(cache->ShouldRequest(1, 0, 0));
+  cache->RecordFailure(1, 0, 0, 404);
+  CHECK(cache->HasFailed(1, 0, 0));
+  CHECK(cache->IsBackingOff(1, 0, 0));
+  CHECK(!cache->ShouldRequest(1, 0, 0));
+  CHECK(cache->ShouldRequest(1, 1, 0));  // other tiles are unaffected
+  cache->RecordSuccess(1, 1, 0);
+  vtksys::SystemTools::Delay(250);
+  CHECK(!cache->IsBackingOff(1, 0, 0));
+  CHECK(cache->ShouldRequest(1, 0, 0));
+  cache->RecordFailure(1, 0, 0, 404);
+  vtksys::SystemTools::Delay(250);
+  CHECK(cache->IsBackingOff(1, 0, 0));
+  vtksys::SystemTools::Delay(200);
+  CHECK(!cache->IsBackingOff(1, 0, 0));
+  CHECK(cache->GetNumberOfFailedTiles() == 1);
+  CHECK(!cache->IsCircuitOpen());
+
+  // Success clears the tile
+  CHECK(cache->ShouldRequest(1, 0, 0));
+  cache->RecordSuccess(1, 0, 0);
+  CHECK(!cache->HasFailed(1, 0, 0));
+  CHECK(cache->GetNumberOfFailedTiles() == 0);
+
+  // Server failures in a row open the circuit for all tiles
+  for (int i = 0; i < 3; ++i)
+    {
+    CHECK(cache->ShouldRequest(2, i, 0));
+    cache->RecordFailure(2, i, 0, i == 0 ? 0 : 503);
+    }
+  CHECK(cache->IsCircuitOpen());
+  CHECK(!cache->ShouldRequest(2, 3, 3));
+
+  // After the delay, one probe goes out. A failed probe keeps the
+  // circuit open, a successful one closes it.
+  vtksys::SystemTools::Delay(250);
+  CHECK(cache->ShouldRequest(2, 3, 3));
+  CHECK(!cache->ShouldRequest(2, 3, 2));
+  cache->RecordFailure(2, 3, 3, 0);
+  CHECK(cache->IsCircuitOpen());
+  CHECK(!cache->ShouldRequest(2, 3, 2));
+  vtksys::SystemTools::Delay(450);
+  CHECK(cache->ShouldRequest(2, 3, 2));
+  cache->RecordSuccess(2, 3, 2);
+  CHECK(!cache->IsCircuitOpen());
+  CHECK(cache->ShouldRequest(2, 3, 1));
+  CHECK(cache->GetNumberOfSkippedRequests() == 4);
+
+  // Invalid tile data backs the tile off, but leaves the circuit open
+  for (int i = 0; i < 3; ++i)
+    {
+    CHECK(cache->ShouldRequest(3, i, 0));
+    cache->RecordFailure(3, i, 0, 503);
+    }
+  CHECK(cache->IsCircuitOpen());
+  cache->RecordInvalidTile(3, 3, 0);
+  CHECK(cache->IsBackingOff(3, 3, 0));
+  CHECK(cache->IsCircuitOpen());
+
+  cache->Reset();
+  CHECK(cache->GetNumberOfFailedTiles() == 0);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileFailureCache(int argc, char *argv[])
+{
+  if (TestBackoff() != EXIT_SUCCESS)
+    {
+    return EXIT_FAILURE;
+    }
+
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestMapTileFailureCache");
+
+  const int zoom = 4;
+  const double latitude = 40.0;
+  const double longitude = -100.0;
+  std::stringstream failedPath;
+  failedPath << "/" << zoom
+             << "/" << vtkMercator::long2tilex(longitude, zoom)
+             << "/" << vtkMercator::lat2tiley(latitude, zoom) << ".png";
+
+  LocalTileServer server;
+  server.SetTileData(MakeTileData());
+  server.FailPath(failedPath.str());
+  CHECK(server.Start());
+
+  // The missing tile fails once, the others load
+  vtkNew<vtkOsmLayer> layer;
+  layer->RevalidateTilesOff();
+  layer->SetFallbackZoomLevels(0);
+  TestMapView view(storageDir, layer.GetPointer(), server.GetHostAndPort());
+  vtkMap *map = view.Map.GetPointer();
+  vtkMapTileFailureCache *failures = layer->GetFailureCache();
+  CHECK(failures->GetNumberOfFailedTiles() == 1);
+  CHECK(!failures->IsCircuitOpen());
+  int numTiles = layer->GetNumberOfCachedTiles();
+  CHECK(numTiles > 0);
+  CHECK(server.GetNumberOfRequests() == numTiles + 1);
+
+  // Drawing again does not request it before its retry time
+  map->Draw();
+  map->Draw();
+  CHECK(server.GetNumberOfRequests() == numTiles + 1);
+  CHECK(failures->GetNumberOfSkippedRequests() == 2);
+
+  // Once the server has it, and the failure is forgotten, the tile loads
+  server.ClearFailedPaths();
+  failures->Reset();
+  map->Draw();
+  CHECK(server.GetNumberOfRequests() == numTiles + 2);
+  CHECK(layer->GetNumberOfCachedTiles() == numTiles + 1);
+  CHECK(failures->GetNumberOfFailedTiles() == 0);
+
+  server.Stop();
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestMapTileFailureCache(argc, argv);
+}
@@ -0,0 +1,146 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileFetcher.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks that vtkMapTileFetcher downloads tiles from LocalTileServer,
+// reports failures, and reuses connections across requests and threads
+// when the server keeps them alive.
+
+#include "LocalTileServer.h"
+#include "MapTestUtilities.h"
+
+#include "vtkMapTileFetcher.h"
+
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+  const int NumberOfThreads = 4;
+  const int TilesPerThread = 10;
+
+  struct FetchJob
+  {
+    vtkMapTileFetcher *Fetcher;
+    std::string Server;
+    vtkAtomic<vtkTypeInt32> Failures;
+  };
+}
+
+//----------------------------------------------------------------------------
+static std::string TileUrl(const std::string& server, int x, int y)
+{
+  std::stringstream ss;
+  ss << "http://" << server << "/10/" << x << "/" << y << ".png";
+  return ss.str();
+}
+
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE FetchTiles(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  FetchJob *job = static_cast<FetchJob*>(info->UserData);
+  std::vector<unsigned char> data;
+  for (int i = 0; i < TilesPerThread; ++i)
+    {
+    if (!job->Fetcher->Fetch(TileUrl(job->Server, info->ThreadID, i), data))
+      {
+      job->Failures++;
+      }
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileFetcher(int, char *[])
+{
+  LocalTileServer server;
+  server.SetKeepAlive(true);
+  server.SetNumberOfThreads(NumberOfThreads);
+  CHECK(server.Start());
+  std::string host = server.GetHostAndPort();
+
+  vtkNew<vtkMapTileFetcher> fetcher;
+  CHECK(fetcher->GetUseHttp2());
+
+  // Sequential requests share one connection
+  std::vector<unsigned char> data;
+  long status = 0;
+  std::string message;
+  for (int i = 0; i < 10; ++i)
+    {
+    CHECK(fetcher->Fetch(TileUrl(host, 1, i), data, &status, &message));
+    CHECK(status == 200);
+    CHECK(static_cast<int>(data.size()) == server.GetTileSize());
+    CHECK(data[0] == 0x89);
+    }
+  CHECK(fetcher->GetNumberOfRequests() == 10);
+  CHECK(fetcher->GetNumberOfConnections() == 1);
+  CHECK(server.GetNumberOfConnections() == 1);
+
+  // Failures
+  server.FailPath("/10/1/100.png");
+  CHECK(!fetcher->Fetch(TileUrl(host, 1, 100), data, &status, &message));
+  CHECK(status == 404);
+  CHECK(data.empty());
+  CHECK(message == "status 404");
+  CHECK(fetcher->Fetch(TileUrl(host, 1, 101), data));
+
+  // Concurrent requests open at most one connection per thread
+  FetchJob job;
+  job.Fetcher = fetcher.GetPointer();
+  job.Server = host;
+  job.Failures = 0;
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(NumberOfThreads);
+  threader->SetSingleMethod(FetchTiles, &job);
+  threader->SingleMethodExecute();
+  CHECK(job.Failures == 0);
+  CHECK(fetcher->GetNumberOfRequests() ==
+        12 + NumberOfThreads * TilesPerThread);
+  CHECK(server.GetNumberOfConnections() <= NumberOfThreads);
+  std::cout << server.GetNumberOfConnections() << " connections for "
+            << server.GetNumberOfRequests() << " requests" << std::endl;
+
+  // Connections closed by the server are not reused
+  server.Stop();
+  LocalTileServer closingServer;
+  CHECK(closingServer.Start());
+  host = closingServer.GetHostAndPort();
+  for (int i = 0; i < 3; ++i)
+    {
+    CHECK(fetcher->Fetch(TileUrl(host, 2, i), data));
+    }
+  CHECK(closingServer.GetNumberOfConnections() == 3);
+
+  // No server
+  closingServer.Stop();
+  CHECK(!fetcher->Fetch(TileUrl(host, 2, 0), data, &status, &message));
+  CHECK(status == 0);
+  CHECK(!message.empty());
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestMapTileFetcher(argc, argv);
+}
@@ -0,0 +1,214 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileIndex.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks vtkMapTileIndexInternal: keys sharing a home bucket, and probe
+// runs wrapping around the end of the table, are found after entries
+// are erased from the start, middle and end of the runs. Then checks
+// random inserts and erases, across growth, against std::map.
+
+#include "MapTestUtilities.h"
+
+#include "vtkMapTileIndexInternal.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace
+{
+typedef vtkMapTileIndexInternal<int> TileIndex;
+
+// Slots of the table before it first grows, and the most entries it
+// then holds
+const int Capacity = 64;
+const int MaxCount = Capacity / 2;
+
+//----------------------------------------------------------------------------
+// Home bucket of the key while the table has Capacity slots. Same
+// finalizer as vtkMapTileIndexInternal::Bucket().
+int Home(vtkTypeUInt64 key)
+{
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31;
+  return static_cast<int>(key & (Capacity - 1));
+}
+
+//----------------------------------------------------------------------------
+// The first count tile keys at the zoom level with the home bucket
+std::vector<vtkTypeUInt64> FindKeys(int home, int count)
+{
+  std::vector<vtkTypeUInt64> keys;
+  for (int x = 0; static_cast<int>(keys.size()) < count; ++x)
+    {
+    vtkTypeUInt64 key = TileIndex::MakeKey(12, x, 7);
+    if (Home(key) == home)
+      {
+      keys.push_back(key);
+      }
+    }
+  return keys;
+}
+
+//----------------------------------------------------------------------------
+// True if the index holds exactly the entries of the map
+bool Matches(TileIndex& index, const std::map<vtkTypeUInt64, int>& entries)
+{
+  if (index.Size() != entries.size())
+    {
+    return false;
+    }
+  std::map<vtkTypeUInt64, int>::const_iterator iter = entries.begin();
+  for (; iter != entries.end(); iter++)
+    {
+    int *value = index.Find(iter->first);
+    if (!value || *value != iter->second)
+      {
+      return false;
+      }
+    }
+  std::vector<vtkTypeUInt64> keys;
+  index.GetKeys(keys);
+  return keys.size() == entries.size();
+}
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileIndex(int, char *[])
+{
+  // Keys round trip, up to the largest tile indices at zoom 29
+  int zoom, x, y;
+  int maxIndex = (1 << 29) - 1;
+  TileIndex::SplitKey(TileIndex::MakeKey(29, maxIndex, 5), zoom, x, y);
+  CHECK(zoom == 29 && x == maxIndex && y == 5);
+  TileIndex::SplitKey(TileIndex::MakeKey(0, 0, 0), zoom, x, y);
+  CHECK(zoom == 0 && x == 0 && y == 0);
+  CHECK(TileIndex::MakeKey(3, 1, 2) != TileIndex::MakeKey(3, 2, 1));
+  CHECK(TileIndex::MakeKey(3, 1, 2) != TileIndex::MakeKey(4, 1, 2));
+
+  // Keys homed in the last two buckets and the first one, so that their
+  // probe run wraps around the end of the table, interleaved so that
+  // keys homed in bucket 0 are displaced past others
+  std::vector<vtkTypeUInt64> last = FindKeys(Capacity - 1, 3);
+  std::vector<vtkTypeUInt64> nextToLast = FindKeys(Capacity - 2, 3);
+  std::vector<vtkTypeUInt64> first = FindKeys(0, 3);
+  std::vector<vtkTypeUInt64> keys;
+  for (int i = 0; i < 3; ++i)
+    {
+    keys.push_back(nextToLast[i]);
+    keys.push_back(last[i]);
+    keys.push_back(first[i]);
+    }
+
+  // Erase every key in turn from the full run, in the middle of the run,
+  // at its start and at its end
+  for (std::size_t erased = 0; erased < keys.size(); ++erased)
+    {
+    TileIndex index;
+    std::map<vtkTypeUInt64, int> entries;
+    CHECK(!index.Find(keys[0]));
+    CHECK(!index.Erase(keys[0]));
+    for (std::size_t i = 0; i < keys.size(); ++i)
+      {
+      index.Insert(keys[i], static_cast<int>(i));
+      entries[keys[i]] = static_cast<int>(i);
+      }
+    CHECK(Matches(index, entries));
+
+    CHECK(index.Erase(keys[erased]));
+    entries.erase(keys[erased]);
+    CHECK(!index.Find(keys[erased]));
+    CHECK(!index.Erase(keys[erased]));
+    CHECK(Matches(index, entries));
+
+    // Then every other key, leaving holes across the run
+    for (std::size_t i = 0; i < keys.size(); i += 2)
+      {
+      if (entries.count(keys[i]))
+        {
+        CHECK(index.Erase(keys[i]));
+        entries.erase(keys[i]);
+        CHECK(Matches(index, entries));
+        }
+      }
+
+    // Inserting again fills the holes, replacing does not add
+    for (std::size_t i = 0; i < keys.size(); ++i)
+      {
+      index.Insert(keys[i], static_cast<int>(100 + i));
+      entries[keys[i]] = static_cast<int>(100 + i);
+      }
+    CHECK(Matches(index, entries));
+    }
+
+  // A full table, before it grows, with runs wrapping around its end
+  TileIndex index;
+  std::map<vtkTypeUInt64, int> entries;
+  std::vector<vtkTypeUInt64> crowded = FindKeys(Capacity - 1, 8);
+  std::vector<vtkTypeUInt64> others = FindKeys(Capacity - 3, 8);
+  crowded.insert(crowded.end(), others.begin(), others.end());
+  for (int i = 0; static_cast<int>(crowded.size()) < MaxCount; ++i)
+    {
+    crowded.push_back(TileIndex::MakeKey(12, i, 11));
+    }
+  for (std::size_t i = 0; i < crowded.size(); ++i)
+    {
+    index.Insert(crowded[i], static_cast<int>(i));
+    entries[crowded[i]] = static_cast<int>(i);
+    }
+  CHECK(Matches(index, entries));
+  for (std::size_t i = 3; i < crowded.size(); i += 4)
+    {
+    CHECK(index.Erase(crowded[i]));
+    entries.erase(crowded[i]);
+    CHECK(Matches(index, entries));
+    }
+
+  // Random inserts and erases, growing the table several times
+  index.Clear();
+  entries.clear();
+  CHECK(index.Size() == 0 && !index.Find(crowded[0]));
+  unsigned int seed = 1;
+  for (int i = 0; i < 20000; ++i)
+    {
+    seed = seed * 1103515245 + 12345;
+    vtkTypeUInt64 key = TileIndex::MakeKey(14, (seed >> 8) % 64,
+                                           (seed >> 16) % 64);
+    if ((seed >> 28) % 3 == 0)
+      {
+      CHECK(index.Erase(key) == (entries.erase(key) > 0));
+      }
+    else
+      {
+      index.Insert(key, i);
+      entries[key] = i;
+      }
+    if (i % 500 == 0)
+      {
+      CHECK(Matches(index, entries));
+      }
+    }
+  CHECK(Matches(index, entries));
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestMapTileIndex(argc, argv);
+}
@@ -0,0 +1,173 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileMetrics.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks vtkMapTileMetrics: histogram buckets and percentiles, counts
+// recorded by concurrent threads, and snapshots printed as JSON. Then
+// checks the metrics recorded by vtkOsmLayer and vtkMultiThreadedOsmLayer
+// drawing generated tiles, and the periodic metrics log.
+
+#include "MapTestUtilities.h"
+
+#include "vtkMap.h"
+#include "vtkMapTileMetrics.h"
+#include "vtkMultiThreadedOsmLayer.h"
+#include "vtkOsmLayer.h"
+#include "vtkProceduralTileSource.h"
+
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+const int NumberOfRecords = 10000;
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE RecordMetrics(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  vtkMapTileMetrics *metrics = static_cast<vtkMapTileMetrics*>(info->UserData);
+  for (int i = 0; i < NumberOfRecords; ++i)
+    {
+    metrics->Increment(vtkMapTileMetrics::Downloads);
+    metrics->Record(vtkMapTileMetrics::DownloadTime, 3.0);
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileMetrics(int argc, char *argv[])
+{
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestMapTileMetrics");
+
+  // Power-of-two buckets
+  CHECK(vtkMapTileMetrics::GetBucket(0.5) == 0);
+  CHECK(vtkMapTileMetrics::GetBucket(1.0) == 1);
+  CHECK(vtkMapTileMetrics::GetBucket(3.0) == 2);
+  CHECK(vtkMapTileMetrics::GetBucket(4.0) == 3);
+  CHECK(vtkMapTileMetrics::GetBucket(1e30) ==
+        vtkMapTileMetrics::NumberOfBuckets - 1);
+
+  vtkNew<vtkMapTileMetrics> metrics;
+  for (int i = 0; i < 90; ++i)
+    {
+    metrics->Record(vtkMapTileMetrics::DecodeTime, 5.0);
+    }
+  for (int i = 0; i < 10; ++i)
+    {
+    metrics->Record(vtkMapTileMetrics::DecodeTime, 100.0);
+    }
+  vtkMapTileMetricsSnapshot snapshot;
+  metrics->GetSnapshot(snapshot);
+  const vtkMapTileMetricsSnapshot::Histogram& decode =
+    snapshot.Histograms[vtkMapTileMetrics::DecodeTime];
+  CHECK(decode.Count == 100);
+  CHECK(decode.GetMean() == 14.5);
+  CHECK(decode.GetPercentile(0.5) == 8.0);
+  CHECK(decode.GetPercentile(0.9) == 8.0);
+  CHECK(decode.GetPercentile(0.99) == 128.0);
+
+  // Updates from concurrent threads are all counted
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(4);
+  threader->SetSingleMethod(RecordMetrics, metrics.GetPointer());
+  threader->SingleMethodExecute();
+  metrics->GetSnapshot(snapshot);
+  CHECK(snapshot.Counters[vtkMapTileMetrics::Downloads] ==
+        4 * NumberOfRecords);
+  CHECK(snapshot.Histograms[vtkMapTileMetrics::DownloadTime].Count ==
+        4 * NumberOfRecords);
+  CHECK(snapshot.GetDownloadRate() == 1.0);
+
+  // JSON, one line
+  std::ostringstream json;
+  snapshot.PrintJson(json);
+  std::cout << json.str() << std::endl;
+  CHECK(json.str().find("\"Downloads\": 40000") != std::string::npos);
+  CHECK(json.str().find("\"DecodeTime\": {\"Count\": 100") !=
+        std::string::npos);
+  CHECK(json.str().find('\n') == std::string::npos);
+  metrics->Reset();
+  CHECK(metrics->GetCounter(vtkMapTileMetrics::Downloads) == 0);
+
+  // Tiles drawn by a layer are generated, decoded, then found in the
+  // layer's cache
+  std::string logFile = storageDir + "/metrics.json";
+    {
+    vtkNew<vtkProceduralTileSource> source;
+    vtkNew<vtkOsmLayer> layer;
+    layer->SetMetricsLogInterval(0.001);
+    layer->SetMetricsLogFileName(logFile.c_str());
+    TestMapView view(storageDir, layer.GetPointer(), source.GetPointer());
+    view.Map->Draw();
+    layer->GetMetricsSnapshot(snapshot);
+    vtkTypeInt64 *counters = snapshot.Counters;
+    int numTiles = layer->GetNumberOfCachedTiles();
+    CHECK(numTiles > 0);
+    CHECK(snapshot.NumberOfCachedTiles == numTiles);
+    CHECK(counters[vtkMapTileMetrics::LayerCacheMisses] == numTiles);
+    CHECK(counters[vtkMapTileMetrics::LayerCacheHits] == numTiles);
+    CHECK(counters[vtkMapTileMetrics::Downloads] == numTiles);
+    CHECK(counters[vtkMapTileMetrics::DownloadedBytes] > 0);
+    CHECK(counters[vtkMapTileMetrics::DecodedTiles] == numTiles);
+    CHECK(snapshot.Histograms[vtkMapTileMetrics::DecodeTime].Count ==
+          numTiles);
+    CHECK(snapshot.GetMemoryHitRate() == 0.5);
+    }
+  std::ifstream log(logFile.c_str());
+  std::string line;
+  CHECK(std::getline(log, line));
+  CHECK(line[0] == '{' && line[line.size() - 1] == '}');
+
+  // Request threads record downloads, and ResolveAsync() the tiles it
+  // adds
+    {
+    vtkNew<vtkProceduralTileSource> source;
+    vtkNew<vtkMultiThreadedOsmLayer> layer;
+    layer->PrefetchOff();
+    TestMapView view(storageDir, layer.GetPointer(), source.GetPointer());
+    layer->GetMetricsSnapshot(snapshot);
+    vtkTypeInt64 *counters = snapshot.Counters;
+    int numTiles = layer->GetNumberOfCachedTiles();
+    CHECK(numTiles > 0);
+    CHECK(counters[vtkMapTileMetrics::LayerCacheMisses] == numTiles);
+    CHECK(counters[vtkMapTileMetrics::Downloads] == numTiles);
+    CHECK(counters[vtkMapTileMetrics::DecodedTiles] == numTiles);
+    CHECK(snapshot.Histograms[vtkMapTileMetrics::QueueDepth].Count == 1);
+    const vtkMapTileMetricsSnapshot::Histogram& resolves =
+      snapshot.Histograms[vtkMapTileMetrics::TilesPerResolve];
+    CHECK(resolves.Count > 0);
+    CHECK(resolves.Sum == numTiles);
+    CHECK(snapshot.NumberOfScheduledTiles == 0);
+    CHECK(snapshot.NumberOfPendingTiles == 0);
+    }
+
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestMapTileMetrics(argc, argv);
+}
@@ -0,0 +1,142 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileRevalidator.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks the revalidation of cached tiles: downloaded tiles get their
+// ETag recorded, expired tiles loaded from the disk cache are checked
+// with conditional requests, which cost a 304 response while the tiles
+// do not change, tiles changed on the server are reloaded, the metadata
+// persists across sessions, and revalidation requests are rate limited.
+// Tiles come from LocalTileServer, which sends max-age=0 so that tiles
+// expire right away.
+
+#include "LocalTileServer.h"
+#include "MapTestUtilities.h"
+
+#include "vtkMap.h"
+#include "vtkMapTileCacheInfo.h"
+#include "vtkMapTileRevalidator.h"
+#include "vtkMercator.h"
+#include "vtkOsmLayer.h"
+
+#include <vtkNew.h>
+#include <vtkTimerLog.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+//----------------------------------------------------------------------------
+int TestMapTileRevalidator(int argc, char *argv[])
+{
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestMapTileRevalidator");
+
+  LocalTileServer server;
+  server.SetTileData(MakeTileData());
+  server.SetMaxAge(0);
+  CHECK(server.Start());
+
+  const int zoom = 4;
+  const int col = vtkMercator::long2tilex(-100.0, zoom);
+  const int row = vtkMercator::lat2tiley(40.0, zoom);
+  int numTiles = 0;
+  std::string sidecarPath;
+
+  // Downloaded tiles get their metadata recorded
+    {
+    vtkNew<vtkOsmLayer> layer;
+    TestMapView view(storageDir, layer.GetPointer(),
+                     server.GetHostAndPort());
+    numTiles = layer->GetNumberOfCachedTiles();
+    sidecarPath = layer->GetCacheDirectory() + std::string("/tiles.http");
+    CHECK(numTiles > 0);
+    CHECK(server.GetNumberOfRequests() == numTiles);
+    vtkMapTileRevalidator *revalidator = layer->GetRevalidator();
+    CHECK(revalidator != NULL);
+    vtkMapTileCacheInfo info;
+    CHECK(revalidator->GetCacheInfo(zoom, col, row, info));
+    CHECK(info.ETag == "\"v1\"");
+    CHECK(info.Expires <= vtkTimerLog::GetUniversalTime());
+    CHECK(revalidator->IsExpired(zoom, col, row));
+    // Tiles already in memory are not checked again
+    CHECK(revalidator->GetNumberOfQueuedTiles() == 0);
+    }
+  CHECK(vtksys::SystemTools::FileExists(sidecarPath.c_str(), true));
+
+  // Expired tiles loaded from the disk cache are revalidated, and found
+  // unchanged
+  vtkNew<vtkOsmLayer> layer;
+  TestMapView view(storageDir, layer.GetPointer(), server.GetHostAndPort());
+  vtkMapTileRevalidator *revalidator = layer->GetRevalidator();
+  revalidator->SetMaxRequestsPerSecond(0.0);
+  CHECK(layer->GetNumberOfCachedTiles() == numTiles);
+  revalidator->Flush();
+  std::cout << numTiles << " tiles, " << server.GetNumberOfRequests()
+            << " requests, " << server.GetNumberOfNotModified()
+            << " not modified" << std::endl;
+  CHECK(revalidator->GetNumberOfRevalidations() == numTiles);
+  CHECK(revalidator->GetNumberOfNotModified() == numTiles);
+  CHECK(server.GetNumberOfNotModified() == numTiles);
+  CHECK(!revalidator->HasUpdatedTiles(layer.GetPointer()));
+
+  // A tile changed on the server is stored, and reloaded by the next draw
+  server.SetTileVersion(2);
+  CHECK(revalidator->CheckTile(zoom, col, row));
+  revalidator->Flush();
+  CHECK(revalidator->GetNumberOfUpdatedTiles() == 1);
+  CHECK(revalidator->HasUpdatedTiles(layer.GetPointer()));
+  vtkMapTileCacheInfo info;
+  CHECK(revalidator->GetCacheInfo(zoom, col, row, info));
+  CHECK(info.ETag == "\"v2\"");
+  view.Map->Draw();
+  CHECK(!revalidator->HasUpdatedTiles(layer.GetPointer()));
+  CHECK(layer->GetNumberOfCachedTiles() == numTiles);
+
+  // The metadata persists across sessions
+    {
+    vtkNew<vtkMapTileRevalidator> other;
+    other->Open(layer.GetPointer(), layer->GetCacheDirectory());
+    CHECK(other->GetCacheInfo(zoom, col, row, info));
+    CHECK(info.ETag == "\"v2\"");
+    CHECK(other->GetCacheInfo(zoom, col + 1, row, info));
+    CHECK(info.ETag == "\"v1\"");
+    CHECK(!other->GetCacheInfo(zoom + 1, col, row, info));
+    other->Close();
+    }
+
+  // Revalidation requests are spaced by the rate limit
+  revalidator->SetMaxRequestsPerSecond(10.0);
+  double start = vtkTimerLog::GetUniversalTime();
+  for (int i = 0; i < 6; ++i)
+    {
+    CHECK(revalidator->CheckTile(zoom, i, row));
+    }
+  CHECK(revalidator->GetNumberOfQueuedTiles() > 0);
+  revalidator->Flush();
+  double elapsed = vtkTimerLog::GetUniversalTime() - start;
+  std::cout << "6 revalidations in " << elapsed << " s" << std::endl;
+  CHECK(elapsed >= 0.45);
+  CHECK(revalidator->GetNumberOfQueuedTiles() == 0);
+
+  server.Stop();
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestMapTileRevalidator(argc, argv);
+}
@@ -0,0 +1,191 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileSeeder.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Seeds tile caches from a LocalTileServer, and checks that present
+// tiles are skipped, that an interrupted run resumes, that requests are
+// rate limited, that failed tiles are reported, and that tiles can be
+// seeded into a vtkPackedTileStore.
+//
+// Usage: TestMapTileSeeder [storage directory]
+
+#include "LocalTileServer.h"
+#include "MapTestUtilities.h"
+#include "vtkMap.h"
+#include "vtkMapTileSeeder.h"
+#include "vtkOsmLayer.h"
+#include "vtkPackedTileStore.h"
+
+#include <vtkCommand.h>
+#include <vtkNew.h>
+#include <vtkRenderer.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+//----------------------------------------------------------------------------
+// Aborts the seeder on its first progress event
+class AbortCallback : public vtkCommand
+{
+public:
+  static AbortCallback *New()
+    { return new AbortCallback; }
+  virtual void Execute(vtkObject *caller, unsigned long, void*)
+    {
+      vtkMapTileSeeder::SafeDownCast(caller)->Abort();
+    }
+};
+
+//----------------------------------------------------------------------------
+// Counts tiles of the seeder's area in the layer's cache
+static vtkTypeInt64 CountCachedTiles(vtkMapTileSeeder *seeder)
+{
+  vtkOsmLayer *layer = seeder->GetLayer();
+  vtkTypeInt64 count = 0;
+  for (int zoom = seeder->GetMinZoom(); zoom <= seeder->GetMaxZoom(); ++zoom)
+    {
+    int n = 1 << zoom;
+    for (int x = 0; x < n; ++x)
+      {
+      for (int y = 0; y < n; ++y)
+        {
+        if (layer->GetTileStore() ?
+            layer->GetTileStore()->Contains(zoom, x, y) :
+            vtksys::SystemTools::FileExists(
+              layer->GetTileFileSystemPath(zoom, x, y).c_str(), true))
+          {
+          ++count;
+          }
+        }
+      }
+    }
+  return count;
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileSeeder(int argc, char *argv[])
+{
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestMapTileSeeder");
+
+  LocalTileServer server;
+  CHECK(server.Start());
+
+  vtkNew<vtkMap> map;
+  vtkNew<vtkRenderer> renderer;
+  map->SetRenderer(renderer.GetPointer());
+  map->SetStorageDirectory(storageDir.c_str());
+  vtkNew<vtkOsmLayer> layer;
+  map->AddLayer(layer.GetPointer());
+  layer->SetMapTileServer(server.GetHostAndPort().c_str(), "", "png");
+  CHECK(layer->GetCacheDirectory() != NULL);
+  std::string resumePath =
+    std::string(layer->GetCacheDirectory()) + "/seed.resume";
+
+  // Seed everything
+  double bounds[4] = { 40.0, -76.0, 44.0, -72.0 };
+  vtkNew<vtkMapTileSeeder> seeder;
+  seeder->SetLayer(layer.GetPointer());
+  seeder->SetBounds(bounds);
+  seeder->SetMinZoom(0);
+  seeder->SetMaxZoom(6);
+  seeder->SetMaxRequestsPerSecond(0.0);
+  vtkTypeInt64 numTiles = seeder->GetNumberOfTiles();
+  CHECK(numTiles == 13);
+  CHECK(seeder->Seed());
+  CHECK(seeder->GetNumberOfDownloadedTiles() == numTiles);
+  CHECK(seeder->GetNumberOfDownloadedBytes() == numTiles * server.GetTileSize());
+  CHECK(seeder->GetNumberOfFailedTiles() == 0);
+  CHECK(server.GetNumberOfRequests() == numTiles);
+  CHECK(CountCachedTiles(seeder.GetPointer()) == numTiles);
+  CHECK(!vtksys::SystemTools::FileExists(resumePath.c_str()));
+
+  // Seeding again only skips present tiles
+  CHECK(seeder->Seed());
+  CHECK(seeder->GetNumberOfDownloadedTiles() == 0);
+  CHECK(seeder->GetNumberOfSkippedTiles() == numTiles);
+  CHECK(server.GetNumberOfRequests() == numTiles);
+
+  // Rate limit: 25 tiles at 25 requests per second take about a second
+  seeder->SetMinZoom(7);
+  seeder->SetMaxZoom(8);
+  vtkTypeInt64 rateTiles = seeder->GetNumberOfTiles();
+  CHECK(rateTiles == 25);
+  seeder->SetMaxRequestsPerSecond(25.0);
+  CHECK(seeder->Seed());
+  CHECK(seeder->GetNumberOfDownloadedTiles() == rateTiles);
+  CHECK(seeder->GetElapsedTime() >= 0.9);
+
+  // Interrupt a run at the first progress event, then resume it
+  int requests = server.GetNumberOfRequests();
+  seeder->SetMinZoom(9);
+  seeder->SetMaxZoom(9);
+  vtkTypeInt64 resumeTiles = seeder->GetNumberOfTiles();
+  CHECK(resumeTiles == 56);
+  vtkNew<AbortCallback> abortCallback;
+  unsigned long observer = seeder->AddObserver(vtkCommand::ProgressEvent,
+                                               abortCallback.GetPointer());
+  CHECK(!seeder->Seed());
+  vtkTypeInt64 firstRun = seeder->GetNumberOfDownloadedTiles();
+  CHECK(firstRun > 0 && firstRun < resumeTiles);
+  CHECK(vtksys::SystemTools::FileExists(resumePath.c_str()));
+  seeder->RemoveObserver(observer);
+
+  seeder->SetMaxRequestsPerSecond(0.0);
+  CHECK(seeder->Seed());
+  // Resumed at the checkpoint, so at most the tiles in flight are seen again
+  CHECK(seeder->GetNumberOfSkippedTiles() <= seeder->GetNumberOfThreads());
+  CHECK(firstRun + seeder->GetNumberOfDownloadedTiles() == resumeTiles);
+  CHECK(server.GetNumberOfRequests() - requests == resumeTiles);
+  CHECK(!vtksys::SystemTools::FileExists(resumePath.c_str()));
+
+  // A failed tile fails the run, keeps the resume file, and is
+  // downloaded by the next run
+  std::string failedPath = layer->GetTileFileSystemPath(8, 74, 94);
+  vtksys::SystemTools::RemoveFile(failedPath);
+  seeder->SetMinZoom(8);
+  seeder->SetMaxZoom(8);
+  server.FailPath("/8/74/94.png");
+  CHECK(!seeder->Seed());
+  CHECK(seeder->GetNumberOfFailedTiles() == 1);
+  CHECK(seeder->GetNumberOfDownloadedTiles() == 0);
+  CHECK(vtksys::SystemTools::FileExists(resumePath.c_str()));
+  CHECK(!vtksys::SystemTools::FileExists(failedPath.c_str()));
+  server.ClearFailedPaths();
+  CHECK(seeder->Seed());
+  CHECK(seeder->GetNumberOfDownloadedTiles() == 1);
+  CHECK(vtksys::SystemTools::FileExists(failedPath.c_str()));
+  CHECK(!vtksys::SystemTools::FileExists(resumePath.c_str()));
+
+  // Packed tile store
+  layer->SetUsePackedTileStore(true);
+  CHECK(layer->GetTileStore() != NULL);
+  seeder->SetMinZoom(0);
+  seeder->SetMaxZoom(6);
+  CHECK(seeder->Seed());
+  CHECK(seeder->GetNumberOfDownloadedTiles() == numTiles);
+  CHECK(layer->GetTileStore()->GetNumberOfTiles() == numTiles);
+  CHECK(CountCachedTiles(seeder.GetPointer()) == numTiles);
+
+  server.Stop();
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestMapTileSeeder(argc, argv);
+}
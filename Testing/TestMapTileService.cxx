@@ -0,0 +1,307 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileService.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks vtkMapTileService: the global instance lives as long as it is
+// referenced, a load in progress is shared with the callers asking for
+// the same tile, with its image or its failure, and decoded images are
+// kept up to the cache size, least recently used evicted first, down to
+// their encoded bytes. Then checks that layers of two maps showing the
+// same view load each tile once, with one pool of request threads, and
+// that tiles evicted by a layer are drawn again without loading them.
+
+#include "MapTestUtilities.h"
+
+#include "vtkMap.h"
+#include "vtkMapTileService.h"
+#include "vtkMultiThreadedOsmLayer.h"
+#include "vtkOsmLayer.h"
+#include "vtkProceduralTileSource.h"
+
+#include <vtkImageData.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Load of a tile by another thread
+struct LoadJob
+{
+  vtkMapTileService *Service;
+  std::string Url;
+  int Result;
+  vtkImageData *Image;
+};
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE BeginLoad(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  LoadJob *job = static_cast<LoadJob*>(info->UserData);
+  job->Result = job->Service->BeginLoad(job->Url, job->Url, job->Image);
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *MakeImage()
+{
+  vtkImageData *image = vtkImageData::New();
+  image->SetDimensions(64, 64, 1);
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, 4);
+  return image;
+}
+
+//----------------------------------------------------------------------------
+// Start a load of url by another thread, which waits for the same load
+// by this thread, and return its thread id
+int StartWaitingLoad(vtkMultiThreader *threader, LoadJob& job,
+                     const std::string& url)
+{
+  job.Url = url;
+  job.Result = -1;
+  job.Image = NULL;
+  vtkTypeInt64 coalesced = job.Service->GetNumberOfCoalescedLoads();
+  int threadId = threader->SpawnThread(BeginLoad, &job);
+  for (int i = 0; i < 100; ++i)
+    {
+    if (job.Service->GetNumberOfCoalescedLoads() > coalesced)
+      {
+      break;
+      }
+    vtksys::SystemTools::Delay(10);
+    }
+  return threadId;
+}
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileService(int argc, char *argv[])
+{
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestMapTileService");
+
+  // One global instance while referenced
+  vtkMapTileService *global = vtkMapTileService::GetGlobalInstance();
+  vtkMapTileService *other = vtkMapTileService::GetGlobalInstance();
+  CHECK(other == global);
+  CHECK(global->GetReferenceCount() == 2);
+  other->Delete();
+  global->Delete();
+
+  vtkNew<vtkMapTileService> service;
+  vtkNew<vtkMultiThreader> threader;
+  LoadJob job;
+  job.Service = service.GetPointer();
+  vtkImageData *image = MakeImage();
+  vtkImageData *shared = NULL;
+
+  // Loads of the same tile wait for the first one, and share its image,
+  // which is kept for later loads
+  CHECK(service->BeginLoad("a", "a", shared) == vtkMapTileService::LoadTile);
+  CHECK(shared == NULL);
+  int threadId = StartWaitingLoad(threader.GetPointer(), job, "a");
+  CHECK(service->GetNumberOfCoalescedLoads() == 1);
+  CHECK(job.Result == -1);
+  service->EndLoad("a", "a", image, true);
+  threader->TerminateThread(threadId);
+  CHECK(job.Result == vtkMapTileService::LoadShared);
+  CHECK(job.Image == image);
+  job.Image->Delete();
+  CHECK(service->GetNumberOfCachedImages() == 1);
+  CHECK(service->BeginLoad("a", "lookup a", shared) ==
+        vtkMapTileService::LoadShared);
+  CHECK(shared == image);
+  shared->Delete();
+  CHECK(service->GetNumberOfSharedImages() == 2);
+  image->Delete();
+
+  // Failures are shared with the loads waiting, not later ones
+  CHECK(service->BeginLoad("b", "b", shared) == vtkMapTileService::LoadTile);
+  threadId = StartWaitingLoad(threader.GetPointer(), job, "b");
+  service->EndLoad("b", "b", NULL, false);
+  threader->TerminateThread(threadId);
+  CHECK(job.Result == vtkMapTileService::LoadFailed);
+  CHECK(job.Image == NULL);
+  CHECK(service->BeginLoad("b", "b", shared) == vtkMapTileService::LoadTile);
+
+  // Loads not waiting are told the load is in progress
+  CHECK(service->BeginLoad("b", "b", shared, NULL, false) ==
+        vtkMapTileService::LoadInProgress);
+  CHECK(shared == NULL);
+  CHECK(service->GetNumberOfCoalescedLoads() == 2);
+
+  // Loaded without an image, so the waiting load loads it again
+  threadId = StartWaitingLoad(threader.GetPointer(), job, "b");
+  service->EndLoad("b", "b", NULL, true);
+  threader->TerminateThread(threadId);
+  CHECK(job.Result == vtkMapTileService::LoadTile);
+  service->EndLoad("b", "b", NULL, false);
+  CHECK(service->GetNumberOfCoalescedLoads() == 3);
+
+  // Least recently used images are evicted beyond the cache size
+  service->RemoveImage("a");
+  CHECK(service->GetNumberOfCachedImages() == 0);
+  CHECK(service->GetImageCacheSize() == 0);
+  vtkImageData *images[4];
+  for (int i = 0; i < 4; ++i)
+    {
+    images[i] = MakeImage();
+    }
+  vtkTypeInt64 imageSize =
+    static_cast<vtkTypeInt64>(images[0]->GetActualMemorySize()) * 1024;
+  service->SetMaxImageCacheSize(3 * imageSize);
+  service->AddImage("0", images[0]);
+  service->AddImage("1", images[1]);
+  service->AddImage("2", images[2]);
+  CHECK(service->GetImageCacheSize() == 3 * imageSize);
+  shared = service->FindImage("0");
+  CHECK(shared == images[0]);
+  shared->Delete();
+  service->AddImage("3", images[3]);
+  CHECK(service->GetNumberOfCachedImages() == 3);
+  shared = service->FindImage("1");
+  CHECK(shared == NULL);
+  for (int i = 0; i < 4; ++i)
+    {
+    images[i]->Delete();
+    }
+  service->SetMaxImageCacheSize(0);
+  CHECK(service->GetNumberOfCachedImages() == 0);
+
+  // Encoded bytes are kept within a budget of their own, and decoded
+  // again by the callers
+  std::vector<unsigned char> encoded(1000, 0x89);
+  std::vector<unsigned char> data;
+  service->SetMaxEncodedCacheSize(2500);
+  service->AddEncodedTile("0", encoded);
+  service->AddEncodedTile("1", encoded);
+  CHECK(service->GetEncodedCacheSize() == 2000);
+  CHECK(service->BeginLoad("0", "0", shared, &data) ==
+        vtkMapTileService::LoadEncoded);
+  CHECK(data == encoded);
+  CHECK(service->GetNumberOfSharedEncodedTiles() == 1);
+  service->AddEncodedTile("2", encoded);
+  CHECK(service->GetNumberOfEncodedTiles() == 2);
+  CHECK(service->BeginLoad("1", "1", shared, &data) ==
+        vtkMapTileService::LoadTile);
+  service->EndLoad("1", "1", NULL, false);
+
+  // Evicted images leave their encoded bytes, removed tiles do not
+  service->SetMaxImageCacheSize(imageSize);
+  image = MakeImage();
+  service->EndLoad("0", "0", image, true);
+  CHECK(service->GetNumberOfCachedImages() == 1);
+  vtkImageData *otherImage = MakeImage();
+  service->AddImage("3", otherImage);
+  CHECK(service->GetNumberOfCachedImages() == 1);
+  CHECK(service->BeginLoad("0", "0", shared, &data) ==
+        vtkMapTileService::LoadEncoded);
+  service->EndLoad("0", "0", NULL, false);
+  service->RemoveImage("0");
+  CHECK(service->GetNumberOfEncodedTiles() == 1);
+  CHECK(service->BeginLoad("0", "0", shared, &data) ==
+        vtkMapTileService::LoadTile);
+  service->EndLoad("0", "0", NULL, false);
+  image->Delete();
+  otherImage->Delete();
+  service->RemoveAllImages();
+  CHECK(service->GetImageCacheSize() == 0);
+  CHECK(service->GetEncodedCacheSize() == 0);
+
+  // Layers of two maps showing the same tiles load them once, with the
+  // request threads of the global service
+  vtkNew<vtkProceduralTileSource> source;
+    {
+    vtkNew<vtkMultiThreadedOsmLayer> layer1;
+    vtkNew<vtkMultiThreadedOsmLayer> layer2;
+    layer1->PrefetchOff();
+    layer2->PrefetchOff();
+    CHECK(layer1->GetTileService() == layer2->GetTileService());
+    CHECK(layer1->GetConcurrencyController() ==
+          layer2->GetConcurrencyController());
+    vtkMapTileService *layerService = layer1->GetTileService();
+    CHECK(layerService->GetNumberOfLayers() == 2);
+
+    TestMapView view1(storageDir, layer1.GetPointer(), source.GetPointer());
+    int numTiles = layer1->GetNumberOfCachedTiles();
+    std::cout << numTiles << " tiles drawn" << std::endl;
+    CHECK(numTiles > 0);
+    CHECK(source->GetNumberOfGeneratedTiles() == numTiles);
+
+    TestMapView view2(storageDir, layer2.GetPointer(), source.GetPointer());
+    CHECK(layer2->GetNumberOfCachedTiles() == numTiles);
+    CHECK(source->GetNumberOfGeneratedTiles() == numTiles);
+    CHECK(layerService->GetNumberOfSharedImages() >= numTiles);
+
+    // Also with layers drawing synchronously
+    vtkNew<vtkOsmLayer> layer3;
+    TestMapView view3(storageDir, layer3.GetPointer(), source.GetPointer());
+    CHECK(layer3->GetNumberOfCachedTiles() == numTiles);
+    CHECK(source->GetNumberOfGeneratedTiles() == numTiles);
+
+    // A service of its own isolates a layer
+    layer2->SetTileService(service.GetPointer());
+    CHECK(layerService->GetNumberOfLayers() == 1);
+    CHECK(service->GetNumberOfLayers() == 1);
+    CHECK(layer2->GetConcurrencyController() ==
+          service->GetConcurrencyController());
+    layer2->SetTileService(NULL);
+    CHECK(layer2->GetTileService() == layerService);
+    CHECK(service->GetNumberOfLayers() == 0);
+    }
+
+  // Tiles evicted by a layer keep their images, then their encoded
+  // bytes, so that moving back to them loads none again
+    {
+    vtkNew<vtkProceduralTileSource> tiles;
+    vtkNew<vtkOsmLayer> layer;
+    layer->SetTileService(service.GetPointer());
+    service->SetMaxImageCacheSize(64 * 1024 * 1024);
+    service->SetMaxEncodedCacheSize(32 * 1024 * 1024);
+    TestMapView view(storageDir, layer.GetPointer(), tiles.GetPointer());
+    layer->SetMaxCacheSize(1);
+    view.Map->SetCenter(-40.0, 100.0);
+    view.Map->Draw();
+    vtkTypeInt64 generated = tiles->GetNumberOfGeneratedTiles();
+    int numTiles = layer->GetNumberOfCachedTiles();
+    CHECK(generated > numTiles);
+
+    view.Map->SetCenter(40.0, -100.0);
+    view.Map->Draw();
+    CHECK(tiles->GetNumberOfGeneratedTiles() == generated);
+    CHECK(service->GetNumberOfSharedImages() >=
+          layer->GetNumberOfCachedTiles());
+
+    service->SetMaxImageCacheSize(0);
+    view.Map->SetCenter(-40.0, 100.0);
+    view.Map->Draw();
+    CHECK(tiles->GetNumberOfGeneratedTiles() == generated);
+    CHECK(service->GetNumberOfSharedEncodedTiles() >= 2 + numTiles);
+    }
+
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestMapTileService(argc, argv);
+}
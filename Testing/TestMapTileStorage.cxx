@@ -0,0 +1,134 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileStorage.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Runs two layers, with tile services of their own, on the same
+// LocalTileServer and storage directory, and checks that they share the
+// packed tile store, disk cache and revalidator of the cache directory,
+// that the disk cache is only created for a quota, and that the tiles
+// they wrote read back intact.
+//
+// Usage: TestMapTileStorage [storage directory]
+
+#include "LocalTileServer.h"
+#include "MapTestUtilities.h"
+#include "vtkMapTileDiskCache.h"
+#include "vtkMapTileRevalidator.h"
+#include "vtkMapTileService.h"
+#include "vtkMapTileStorage.h"
+#include "vtkMultiThreadedOsmLayer.h"
+#include "vtkPackedTileStore.h"
+
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+int TestMapTileStorage(int argc, char *argv[])
+{
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestMapTileStorage");
+
+  LocalTileServer server;
+  std::string tileData = MakeTileData();
+  server.SetTileData(tileData);
+  CHECK(server.Start());
+
+  std::string cacheDir;
+  int numTiles = 0;
+    {
+    // Separate services, so that the layers only share tiles on disk
+    vtkNew<vtkMapTileService> service1;
+    vtkNew<vtkMapTileService> service2;
+    vtkNew<vtkMultiThreadedOsmLayer> layer1;
+    vtkNew<vtkMultiThreadedOsmLayer> layer2;
+    layer1->SetTileService(service1.GetPointer());
+    layer2->SetTileService(service2.GetPointer());
+    layer1->UsePackedTileStoreOn();
+    layer2->UsePackedTileStoreOn();
+
+    std::string host = server.GetHostAndPort();
+    TestMapView view1(storageDir, layer1.GetPointer(), host);
+    TestMapView view2(storageDir, layer2.GetPointer(), host);
+    numTiles = layer1->GetNumberOfCachedTiles();
+    std::cout << numTiles << " tiles drawn" << std::endl;
+    CHECK(numTiles > 0);
+    CHECK(layer2->GetNumberOfCachedTiles() == numTiles);
+
+    CHECK(layer1->GetTileStore() != NULL);
+    CHECK(layer1->GetTileStore() == layer2->GetTileStore());
+    CHECK(layer1->GetRevalidator() != NULL);
+    CHECK(layer1->GetRevalidator() == layer2->GetRevalidator());
+    CHECK(layer1->GetRevalidator()->GetNumberOfLayers() == 2);
+    CHECK(layer1->GetTileStore()->GetNumberOfTiles() == numTiles);
+    cacheDir = layer1->GetCacheDirectory();
+
+    // The disk cache is only created for a quota or statistics
+    CHECK(layer1->GetDiskCache() == NULL);
+    layer2->SetMaxDiskCacheTiles(1000);
+    CHECK(layer1->GetDiskCache() != NULL);
+    CHECK(layer1->GetDiskCache() == layer2->GetDiskCache());
+    layer1->GetDiskCache()->Flush();
+    CHECK(layer1->GetNumberOfDiskCacheTiles() == numTiles);
+
+    // The storage is acquired by the layers' cache directory
+    vtkMapTileStorage *storage =
+      vtkMapTileStorage::Acquire(cacheDir.c_str(), true, "png");
+    CHECK(storage->GetTileStore() == layer1->GetTileStore());
+    storage->Delete();
+
+    // A layer leaving the directory keeps the storage of the other
+    layer2->SetMapTileServer("localhost:1", "", "png");
+    CHECK(layer2->GetTileStore() != layer1->GetTileStore());
+    CHECK(layer2->GetRevalidator() != layer1->GetRevalidator());
+    CHECK(layer1->GetRevalidator()->GetNumberOfLayers() == 1);
+    CHECK(layer1->GetTileStore()->GetNumberOfTiles() == numTiles);
+    }
+
+  // With the last layer, the storage is released and its files closed
+  vtkNew<vtkPackedTileStore> store;
+  std::string packPath = cacheDir + "/tiles.pack";
+  CHECK(store->Open(packPath.c_str()));
+  CHECK(store->GetNumberOfTiles() == numTiles);
+  int numRead = 0;
+  std::vector<unsigned char> data;
+  for (int x = 0; x < 16; ++x)
+    {
+    for (int y = 0; y < 16; ++y)
+      {
+      if (store->Get(4, x, y, data))
+        {
+        CHECK(data.size() == tileData.size());
+        CHECK(std::memcmp(&data[0], tileData.data(), data.size()) == 0);
+        ++numRead;
+        }
+      }
+    }
+  CHECK(numRead == numTiles);
+  store->Close();
+
+  server.Stop();
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestMapTileStorage(argc, argv);
+}
@@ -0,0 +1,170 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMercator.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks the array conversions of vtkMercator against the scalar ones:
+// error bounds of lat2y() and y2lat(), float and in-place conversion,
+// conversion of one component of a vtkDataArray, and tile indices.
+
+#include "MapTestUtilities.h"
+
+#include "vtkMercator.h"
+
+#include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
+#include <vtkNew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+  const int NumberOfValues = 100001;
+  const double MaxError = 1.0e-10;
+}
+
+//----------------------------------------------------------------------------
+// Evenly spaced values from first to last
+static void Fill(std::vector<double>& values, double first, double last)
+{
+  for (std::size_t i = 0; i < values.size(); ++i)
+    {
+    values[i] = first + (last - first) * i / (values.size() - 1);
+    }
+}
+
+//----------------------------------------------------------------------------
+int TestMercator(int, char *[])
+{
+  std::vector<double> lat(NumberOfValues), y(NumberOfValues);
+  std::vector<double> back(NumberOfValues);
+
+  // lat2y() against the scalar version, near the poles too
+  Fill(lat, -89.9, 89.9);
+  vtkMercator::lat2y(&lat[0], &y[0], NumberOfValues);
+  double maxError = 0.0;
+  for (int i = 0; i < NumberOfValues; ++i)
+    {
+    // The scalar version itself loses digits near the poles
+    double tolerance = MaxError + 1.0e-13 * std::fabs(y[i]);
+    double error = std::fabs(y[i] - vtkMercator::lat2y(lat[i]));
+    CHECK(error < tolerance);
+    maxError = std::max(maxError, error);
+    }
+  std::cout << "lat2y max error " << maxError << std::endl;
+  CHECK(std::fabs(y[NumberOfValues / 2]) < MaxError);
+
+  // y2lat() over the map, and back
+  Fill(y, -180.0, 180.0);
+  vtkMercator::y2lat(&y[0], &lat[0], NumberOfValues);
+  vtkMercator::lat2y(&lat[0], &back[0], NumberOfValues);
+  maxError = 0.0;
+  for (int i = 0; i < NumberOfValues; ++i)
+    {
+    double error = std::fabs(lat[i] - vtkMercator::y2lat(y[i]));
+    CHECK(error < MaxError);
+    CHECK(std::fabs(back[i] - y[i]) < MaxError);
+    maxError = std::max(maxError, error);
+    }
+  std::cout << "y2lat max error " << maxError << std::endl;
+  CHECK(std::fabs(lat[0] + 85.0511287798) < 1.0e-9);
+
+  // In place, and a count that is not a multiple of any vector width
+  std::vector<double> inPlace(lat.begin(), lat.begin() + 1001);
+  vtkMercator::lat2y(&inPlace[0], &inPlace[0], 1001);
+  for (int i = 0; i < 1001; ++i)
+    {
+    CHECK(std::fabs(inPlace[i] - y[i]) < MaxError);
+    }
+
+  // Floats are converted in double precision, then rounded
+  std::vector<float> latFloat(lat.begin(), lat.end());
+  std::vector<float> yFloat(NumberOfValues);
+  vtkMercator::lat2y(&latFloat[0], &yFloat[0], NumberOfValues);
+  for (int i = 0; i < NumberOfValues; ++i)
+    {
+    float expected = static_cast<float>(vtkMercator::lat2y(latFloat[i]));
+    CHECK(std::fabs(yFloat[i] - expected) <=
+          2.0f * std::max(std::fabs(expected), 1.0f) * 1.2e-7f);
+    }
+
+  // Component 1 of <longitude, latitude, z> points, other components
+  // unchanged
+  const int numPoints = 3000;
+  vtkNew<vtkDoubleArray> points;
+  points->SetNumberOfComponents(3);
+  points->SetNumberOfTuples(numPoints);
+  vtkNew<vtkFloatArray> floatPoints;
+  floatPoints->SetNumberOfComponents(3);
+  floatPoints->SetNumberOfTuples(numPoints);
+  for (int i = 0; i < numPoints; ++i)
+    {
+    double latitude = -80.0 + 160.0 * i / numPoints;
+    points->SetComponent(i, 0, i);
+    points->SetComponent(i, 1, latitude);
+    points->SetComponent(i, 2, -i);
+    floatPoints->SetComponent(i, 0, i);
+    floatPoints->SetComponent(i, 1, latitude);
+    floatPoints->SetComponent(i, 2, -i);
+    }
+  vtkMercator::lat2y(points.GetPointer(), 1);
+  vtkMercator::lat2y(floatPoints.GetPointer(), 1);
+  for (int i = 0; i < numPoints; ++i)
+    {
+    double expected = vtkMercator::lat2y(-80.0 + 160.0 * i / numPoints);
+    CHECK(points->GetComponent(i, 0) == i);
+    CHECK(std::fabs(points->GetComponent(i, 1) - expected) < MaxError);
+    CHECK(points->GetComponent(i, 2) == -i);
+    CHECK(floatPoints->GetComponent(i, 0) == i);
+    CHECK(std::fabs(floatPoints->GetComponent(i, 1) - expected) < 1.0e-4);
+    CHECK(floatPoints->GetComponent(i, 2) == -i);
+    }
+  vtkMercator::y2lat(points.GetPointer(), 1);
+  for (int i = 0; i < numPoints; ++i)
+    {
+    double expected = -80.0 + 160.0 * i / numPoints;
+    CHECK(std::fabs(points->GetComponent(i, 1) - expected) < MaxError);
+    }
+
+  // Tile indices, away from tile boundaries
+  std::vector<double> lon(NumberOfValues);
+  Fill(lon, -179.99, 179.99);
+  Fill(lat, -85.0, 85.0);
+  std::vector<int> tileX(NumberOfValues), tileY(NumberOfValues);
+  for (int zoom = 0; zoom <= 18; zoom += 6)
+    {
+    vtkMercator::long2tilex(&lon[0], &tileX[0], NumberOfValues, zoom);
+    vtkMercator::lat2tiley(&lat[0], &tileY[0], NumberOfValues, zoom);
+    for (int i = 0; i < NumberOfValues; ++i)
+      {
+      CHECK(tileX[i] == vtkMercator::long2tilex(lon[i], zoom));
+      double tileYValue = (1.0 - vtkMercator::lat2y(lat[i]) / 180.0) / 2.0 *
+        (1 << zoom);
+      if (std::fabs(tileYValue - std::floor(tileYValue + 0.5)) > 1.0e-6)
+        {
+        CHECK(tileY[i] == vtkMercator::lat2tiley(lat[i], zoom));
+        }
+      }
+    }
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestMercator(argc, argv);
+}
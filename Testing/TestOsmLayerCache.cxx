@@ -0,0 +1,206 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestOsmLayerCache.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks the memory budget of the vtkOsmLayer tile cache: the cache size
+// accounts for every cached tile, the least recently viewed tiles are
+// evicted first, just enough to get below the budget, and tiles in view
+// are kept even over budget. Every tile of zoom level 4 is in the
+// layer's cache directory beforehand, so that none is downloaded.
+
+#include "MapTestUtilities.h"
+
+#include "vtkMap.h"
+#include "vtkMapTile.h"
+#include "vtkOsmLayer.h"
+
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Gives access to the layer's tile cache
+class CacheLayer : public vtkOsmLayer
+{
+public:
+  static CacheLayer *New();
+  vtkTypeMacro(CacheLayer, vtkOsmLayer)
+
+  // (zoom, x, y) of the cached tiles, in that order
+  std::set<std::vector<int> > GetCachedTileIds()
+  {
+    std::set<std::vector<int> > ids;
+    for (std::size_t i = 0; i < this->CachedTiles.size(); ++i)
+      {
+      int *zoomXY = this->CachedTiles[i]->GetZoomXY();
+      ids.insert(std::vector<int>(zoomXY, zoomXY + 3));
+      }
+    return ids;
+  }
+
+  // Sum of the memory sizes of the cached tiles
+  vtkTypeInt64 SumTileSizes()
+  {
+    vtkTypeInt64 size = 0;
+    for (std::size_t i = 0; i < this->CachedTiles.size(); ++i)
+      {
+      size += this->CachedTiles[i]->GetMemorySize();
+      }
+    return size;
+  }
+};
+vtkStandardNewMacro(CacheLayer)
+
+namespace
+{
+typedef std::set<std::vector<int> > TileIds;
+
+//----------------------------------------------------------------------------
+// Write the same image as the cache file of every tile of the zoom
+// level, named as vtkOsmLayer names them
+void WriteTileFiles(const std::string& dirName, int zoom)
+{
+  std::string data = MakeTileData();
+  for (int x = 0; x < (1 << zoom); ++x)
+    {
+    for (int y = 0; y < (1 << zoom); ++y)
+      {
+      std::stringstream path;
+      path << dirName << "/" << zoom << "-" << x << "-" << y << ".png";
+      std::ofstream file(path.str().c_str(), std::ios::binary);
+      file.write(data.data(), data.size());
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Tiles of a that are not in b
+TileIds Difference(const TileIds& a, const TileIds& b)
+{
+  TileIds difference;
+  for (TileIds::const_iterator iter = a.begin(); iter != a.end(); iter++)
+    {
+    if (!b.count(*iter))
+      {
+      difference.insert(*iter);
+      }
+    }
+  return difference;
+}
+
+//----------------------------------------------------------------------------
+// True if every tile of a is in b
+bool Includes(const TileIds& b, const TileIds& a)
+{
+  return Difference(a, b).empty();
+}
+}
+
+//----------------------------------------------------------------------------
+int TestOsmLayerCache(int argc, char *argv[])
+{
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestOsmLayerCache");
+
+  vtkNew<CacheLayer> layer;
+  layer->SetMaxCacheSize(0);
+  TestMapView view(storageDir);
+  vtkMap *map = view.Map.GetPointer();
+  map->AddLayer(layer.GetPointer());
+  layer->SetMapTileServer("127.0.0.1", "", "png");
+  layer->SetCacheSubDirectory("tiles");
+  WriteTileFiles(storageDir + "/tiles", 4);
+  map->Draw();
+
+  // View tiles in three places, without limit. Tiles are the same size.
+  TileIds first = layer->GetCachedTileIds();
+  CHECK(!first.empty());
+  vtkTypeInt64 tileSize = layer->GetCacheSize() /
+    static_cast<vtkTypeInt64>(first.size());
+  CHECK(tileSize > 0);
+  CHECK(layer->GetCacheSize() ==
+        static_cast<vtkTypeInt64>(first.size()) * tileSize);
+
+  map->SetCenter(-40.0, 100.0);
+  map->Draw();
+  TileIds second = Difference(layer->GetCachedTileIds(), first);
+  CHECK(!second.empty());
+
+  map->SetCenter(40.0, 100.0);
+  map->Draw();
+  TileIds third = Difference(layer->GetCachedTileIds(), first);
+  third = Difference(third, second);
+  CHECK(!third.empty());
+
+  std::size_t numTiles = first.size() + second.size() + third.size();
+  CHECK(layer->GetNumberOfCachedTiles() == static_cast<int>(numTiles));
+  CHECK(layer->GetCacheSize() == layer->SumTileSizes());
+  CHECK(layer->GetCacheSize() ==
+        static_cast<vtkTypeInt64>(numTiles) * tileSize);
+  CHECK(layer->GetNumberOfEvictedTiles() == 0);
+
+  // Back to the first place, the second is now the least recently viewed
+  map->SetCenter(40.0, -100.0);
+  map->Draw();
+  CHECK(layer->GetCachedTileIds().size() == numTiles);
+
+  // A budget whose low-water mark, 90% of it, leaves just enough room for
+  // the first and third places: the second place is evicted, nothing else
+  vtkTypeInt64 target = layer->GetCacheSize() -
+    static_cast<vtkTypeInt64>(second.size()) * tileSize;
+  vtkTypeInt64 budget = target;
+  while (budget - budget / 10 < target)
+    {
+    ++budget;
+    }
+  layer->SetMaxCacheSize(budget);
+  map->Draw();
+  TileIds cached = layer->GetCachedTileIds();
+  CHECK(Difference(second, cached) == second);
+  CHECK(Includes(cached, first));
+  CHECK(Includes(cached, third));
+  CHECK(layer->GetNumberOfEvictedTiles() ==
+        static_cast<vtkTypeInt64>(second.size()));
+  CHECK(layer->GetCacheSize() == target);
+  CHECK(layer->GetCacheSize() == layer->SumTileSizes());
+
+  // Within budget, nothing more is evicted
+  map->Draw();
+  CHECK(layer->GetCachedTileIds() == cached);
+
+  // Over any budget, tiles in view are kept, and only they
+  layer->SetMaxCacheSize(1);
+  map->Draw();
+  CHECK(layer->GetCachedTileIds() == first);
+  CHECK(layer->GetCacheSize() ==
+        static_cast<vtkTypeInt64>(first.size()) * tileSize);
+  CHECK(layer->GetNumberOfEvictedTiles() ==
+        static_cast<vtkTypeInt64>(numTiles - first.size()));
+
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestOsmLayerCache(argc, argv);
+}
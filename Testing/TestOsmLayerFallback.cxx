@@ -0,0 +1,186 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestOsmLayerFallback.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks the tiles vtkOsmLayer draws in place of tiles it could not
+// load: zooming in, the cached parent tile, reused across views; zooming
+// out, the cached child tiles; and without either, a placeholder shared
+// by all such tiles. Tiles of zoom levels 2 and 4 are in the layer's
+// packed tile store beforehand, the others fail to download.
+
+#include "MapTestUtilities.h"
+
+#include "vtkMap.h"
+#include "vtkMapTile.h"
+#include "vtkMapTileFailureCache.h"
+#include "vtkOsmLayer.h"
+#include "vtkPackedTileStore.h"
+
+#include <vtkActor.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkTexture.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Gives access to the layer's cached and fallback tiles
+class FallbackLayer : public vtkOsmLayer
+{
+public:
+  static FallbackLayer *New();
+  vtkTypeMacro(FallbackLayer, vtkOsmLayer)
+
+  const std::vector<vtkMapTile*>& GetFallbackTiles()
+  {
+    return this->FallbackTiles;
+  }
+
+  const std::vector<vtkMapTile*>& GetCachedTiles()
+  {
+    return this->CachedTiles;
+  }
+
+  vtkMapTile *GetCachedTileAt(int zoom, int x, int y)
+  {
+    return this->GetCachedTile(zoom, x, y);
+  }
+
+  vtkTexture *GetPlaceholderTexture()
+  {
+    return this->PlaceholderTexture;
+  }
+
+  // True if the tile is drawn in the current view
+  bool IsInView(vtkMapTile *tile)
+  {
+    return tile->GetLastAccess() == this->TileAccessCounter;
+  }
+};
+vtkStandardNewMacro(FallbackLayer)
+
+namespace
+{
+//----------------------------------------------------------------------------
+vtkTexture *GetTexture(vtkMapTile *tile)
+{
+  return tile && tile->GetActor() ? tile->GetActor()->GetTexture() : NULL;
+}
+}
+
+//----------------------------------------------------------------------------
+int TestOsmLayerFallback(int argc, char *argv[])
+{
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestOsmLayerFallback");
+
+  std::string cacheDir = storageDir + "/tiles";
+  vtksys::SystemTools::MakeDirectory(cacheDir);
+  vtkNew<vtkPackedTileStore> store;
+  CHECK(store->Open((cacheDir + "/tiles.pack").c_str()));
+  CHECK(PutTiles(store.GetPointer(), 2));
+  CHECK(PutTiles(store.GetPointer(), 4));
+  store->Close();
+
+  vtkNew<FallbackLayer> layer;
+  TestMapView view(storageDir);
+  vtkMap *map = view.Map.GetPointer();
+  map->AddLayer(layer.GetPointer());
+  layer->SetMapTileServer("127.0.0.1", "", "png");
+  layer->SetCacheSubDirectory("tiles");
+  layer->SetUsePackedTileStore(true);
+  // Every tile that fails is recorded, none is skipped
+  layer->GetFailureCache()->SetCircuitBreakerThreshold(0);
+  map->Draw();
+  std::vector<vtkMapTile*> zoom4Tiles = layer->GetCachedTiles();
+  CHECK(!zoom4Tiles.empty());
+  CHECK(layer->GetFallbackTiles().empty());
+
+  // Zooming in to missing tiles, their cached parents stand in for them
+  map->SetZoom(5);
+  map->Draw();
+  CHECK(layer->GetCachedTiles().size() == zoom4Tiles.size());
+  std::vector<vtkMapTile*> fallbackTiles = layer->GetFallbackTiles();
+  CHECK(!fallbackTiles.empty());
+  for (std::size_t i = 0; i < fallbackTiles.size(); ++i)
+    {
+    int *zoomXY = fallbackTiles[i]->GetZoomXY();
+    CHECK(zoomXY[0] == 5);
+    vtkMapTile *parent =
+      layer->GetCachedTileAt(4, zoomXY[1] >> 1, zoomXY[2] >> 1);
+    CHECK(parent && !layer->IsInView(parent));
+    CHECK(GetTexture(fallbackTiles[i]) == GetTexture(parent));
+    CHECK(layer->IsInView(fallbackTiles[i]));
+    }
+
+  // and keep standing in for them in later views
+  map->Draw();
+  CHECK(layer->GetFallbackTiles() == fallbackTiles);
+
+  // Without fallback zoom levels, missing tiles are placeholders, all
+  // sharing a texture, and fallback tiles out of view are released
+  layer->SetFallbackZoomLevels(0);
+  map->SetZoom(6);
+  map->Draw();
+  fallbackTiles = layer->GetFallbackTiles();
+  CHECK(!fallbackTiles.empty());
+  CHECK(layer->GetPlaceholderTexture() != NULL);
+  for (std::size_t i = 0; i < fallbackTiles.size(); ++i)
+    {
+    CHECK(fallbackTiles[i]->GetZoomXY()[0] == 6);
+    CHECK(GetTexture(fallbackTiles[i]) == layer->GetPlaceholderTexture());
+    CHECK(layer->IsInView(fallbackTiles[i]));
+    }
+  CHECK(layer->GetCachedTiles().size() == zoom4Tiles.size());
+
+  // Zooming out to missing tiles, their cached children stand in for
+  // them, and placeholders only for those without any
+  layer->SetFallbackZoomLevels(4);
+  map->SetZoom(3);
+  map->Draw();
+  CHECK(layer->GetCachedTiles().size() == zoom4Tiles.size());
+  for (std::size_t i = 0; i < zoom4Tiles.size(); ++i)
+    {
+    CHECK(layer->IsInView(zoom4Tiles[i]));
+    }
+  fallbackTiles = layer->GetFallbackTiles();
+  for (std::size_t i = 0; i < fallbackTiles.size(); ++i)
+    {
+    int *zoomXY = fallbackTiles[i]->GetZoomXY();
+    CHECK(zoomXY[0] == 3);
+    CHECK(GetTexture(fallbackTiles[i]) == layer->GetPlaceholderTexture());
+    for (int j = 0; j < 4; ++j)
+      {
+      CHECK(!layer->GetCachedTileAt(4, 2 * zoomXY[1] + (j & 1),
+                                    2 * zoomXY[2] + (j >> 1)));
+      }
+    }
+
+  // Once tiles load, nothing stands in for them
+  map->SetZoom(2);
+  map->Draw();
+  CHECK(layer->GetFallbackTiles().empty());
+
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestOsmLayerFallback(argc, argv);
+}
@@ -0,0 +1,235 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestOsmLayerRenderTiles.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks that vtkOsmLayer keeps the actors in the renderer in sync with
+// the tiles in view, as it adds and removes only the actors of tiles
+// entering and leaving the view: after panning part way and back,
+// zooming, evicting tiles, drawing fallback tiles, switching the tile
+// atlas on and off, and removing all tiles. Tiles of zoom levels 4 and
+// 5 are in the layer's packed tile store beforehand, the others fail to
+// download.
+
+#include "MapTestUtilities.h"
+
+#include "vtkMap.h"
+#include "vtkMapTile.h"
+#include "vtkMapTileAtlas.h"
+#include "vtkOsmLayer.h"
+#include "vtkPackedTileStore.h"
+
+#include <vtkActor.h>
+#include <vtkActorCollection.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkRenderer.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Gives access to the layer's tiles
+class RenderTilesLayer : public vtkOsmLayer
+{
+public:
+  static RenderTilesLayer *New();
+  vtkTypeMacro(RenderTilesLayer, vtkOsmLayer)
+
+  const std::vector<vtkMapTile*>& GetAttachedTiles()
+  {
+    return this->AttachedTiles;
+  }
+
+  // Cached and fallback tiles
+  std::vector<vtkMapTile*> GetAllTiles()
+  {
+    std::vector<vtkMapTile*> tiles = this->CachedTiles;
+    tiles.insert(tiles.end(), this->FallbackTiles.begin(),
+                 this->FallbackTiles.end());
+    return tiles;
+  }
+
+  // True if the tile is drawn in the current view
+  bool IsInView(vtkMapTile *tile)
+  {
+    return tile->GetLastAccess() == this->TileAccessCounter;
+  }
+
+  void RemoveAllTiles()
+  {
+    this->RemoveTiles();
+  }
+};
+vtkStandardNewMacro(RenderTilesLayer)
+
+namespace
+{
+//----------------------------------------------------------------------------
+// True if the renderer has the actors of the tiles in view, and only
+// them, and the layer tracks them as attached. With the tile atlas,
+// no tile has its actor in the renderer.
+bool IsInSync(RenderTilesLayer *layer, vtkRenderer *renderer)
+{
+  const std::vector<vtkMapTile*>& attached = layer->GetAttachedTiles();
+  for (std::size_t i = 1; i < attached.size(); ++i)
+    {
+    if (!(attached[i - 1] < attached[i]))
+      {
+      std::cerr << "Attached tiles not sorted or not unique" << std::endl;
+      return false;
+      }
+    }
+
+  bool atlas = layer->GetUseTileAtlas() && layer->GetTileAtlas() &&
+    renderer->GetActors()->IsItemPresent(layer->GetTileAtlas()->GetActor());
+  std::vector<vtkMapTile*> tiles = layer->GetAllTiles();
+  int numInView = 0;
+  for (std::size_t i = 0; i < tiles.size(); ++i)
+    {
+    vtkMapTile *tile = tiles[i];
+    bool inView = layer->IsInView(tile);
+    bool isAttached =
+      std::binary_search(attached.begin(), attached.end(), tile);
+    bool inRenderer = tile->GetActor() &&
+      renderer->GetActors()->IsItemPresent(tile->GetActor());
+    numInView += inView ? 1 : 0;
+    if (isAttached != (inView && !atlas) || inRenderer != isAttached)
+      {
+      int *zoomXY = tile->GetZoomXY();
+      std::cerr << "Tile " << zoomXY[0] << "/" << zoomXY[1] << "/"
+                << zoomXY[2] << " in view: " << inView << ", attached: "
+                << isAttached << ", in renderer: " << inRenderer
+                << std::endl;
+      return false;
+      }
+    }
+  return atlas ? attached.empty() :
+    static_cast<int>(attached.size()) == numInView;
+}
+}
+
+//----------------------------------------------------------------------------
+int TestOsmLayerRenderTiles(int argc, char *argv[])
+{
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestOsmLayerRenderTiles");
+
+  std::string cacheDir = storageDir + "/tiles";
+  vtksys::SystemTools::MakeDirectory(cacheDir);
+  vtkNew<vtkPackedTileStore> store;
+  CHECK(store->Open((cacheDir + "/tiles.pack").c_str()));
+  CHECK(PutTiles(store.GetPointer(), 4));
+  CHECK(PutTiles(store.GetPointer(), 5));
+  store->Close();
+
+  vtkNew<RenderTilesLayer> layer;
+  layer->SetMaxCacheSize(0);
+  TestMapView view(storageDir);
+  vtkMap *map = view.Map.GetPointer();
+  map->AddLayer(layer.GetPointer());
+  layer->SetMapTileServer("127.0.0.1", "", "png");
+  layer->SetCacheSubDirectory("tiles");
+  layer->SetUsePackedTileStore(true);
+  map->Draw();
+  vtkRenderer *renderer = view.Renderer.GetPointer();
+  CHECK(!layer->GetAttachedTiles().empty());
+  CHECK(IsInSync(layer.GetPointer(), renderer));
+  std::vector<vtkMapTile*> firstView = layer->GetAttachedTiles();
+
+  // The same view attaches the same tiles
+  map->Draw();
+  CHECK(layer->GetAttachedTiles() == firstView);
+  CHECK(IsInSync(layer.GetPointer(), renderer));
+
+  // Panning part way keeps some tiles attached, and brings others in
+  map->SetCenter(40.0, -80.0);
+  map->Draw();
+  CHECK(IsInSync(layer.GetPointer(), renderer));
+  std::vector<vtkMapTile*> kept;
+  std::set_intersection(firstView.begin(), firstView.end(),
+                        layer->GetAttachedTiles().begin(),
+                        layer->GetAttachedTiles().end(),
+                        std::back_inserter(kept));
+  CHECK(!kept.empty() && kept.size() < firstView.size());
+  CHECK(layer->GetAttachedTiles().size() > kept.size());
+
+  // and back again
+  map->SetCenter(40.0, -100.0);
+  map->Draw();
+  CHECK(layer->GetAttachedTiles() == firstView);
+  CHECK(IsInSync(layer.GetPointer(), renderer));
+
+  // Zooming replaces all tiles
+  map->SetZoom(5);
+  map->Draw();
+  CHECK(IsInSync(layer.GetPointer(), renderer));
+  kept.clear();
+  std::set_intersection(firstView.begin(), firstView.end(),
+                        layer->GetAttachedTiles().begin(),
+                        layer->GetAttachedTiles().end(),
+                        std::back_inserter(kept));
+  CHECK(kept.empty());
+
+  // Evicted tiles, out of view, leave nothing behind
+  layer->SetMaxCacheSize(1);
+  map->Draw();
+  CHECK(layer->GetNumberOfEvictedTiles() > 0);
+  CHECK(IsInSync(layer.GetPointer(), renderer));
+  layer->SetMaxCacheSize(0);
+
+  // Fallback tiles are attached like the others, and detached when
+  // pruned
+  map->SetZoom(6);
+  map->Draw();
+  CHECK(IsInSync(layer.GetPointer(), renderer));
+  map->SetZoom(5);
+  map->Draw();
+  CHECK(IsInSync(layer.GetPointer(), renderer));
+
+  // The tile atlas draws all tiles with its own actor
+  layer->UseTileAtlasOn();
+  map->Draw();
+  CHECK(layer->GetAttachedTiles().empty());
+  CHECK(IsInSync(layer.GetPointer(), renderer));
+  layer->UseTileAtlasOff();
+  map->Draw();
+  CHECK(!layer->GetAttachedTiles().empty());
+  CHECK(IsInSync(layer.GetPointer(), renderer));
+
+  // Removing all tiles removes their actors
+  std::vector<vtkActor*> actors;
+  for (std::size_t i = 0; i < layer->GetAttachedTiles().size(); ++i)
+    {
+    actors.push_back(layer->GetAttachedTiles()[i]->GetActor());
+    }
+  layer->RemoveAllTiles();
+  CHECK(layer->GetAttachedTiles().empty());
+  for (std::size_t i = 0; i < actors.size(); ++i)
+    {
+    CHECK(!renderer->GetActors()->IsItemPresent(actors[i]));
+    }
+
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestOsmLayerRenderTiles(argc, argv);
+}
@@ -0,0 +1,170 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestPackedTileStore.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks vtkPackedTileStore: tiles put are found by the same session,
+// superseded and removed tiles are not, and tiles persist across
+// sessions. Then checks recovery after a crash: pack records missing
+// from the index are indexed again, a partial record at the end of the
+// pack is dropped, and tiles put by the recovered session are found
+// right away. Last, a lost index is rebuilt from the pack.
+//
+// Usage: TestPackedTileStore [directory]
+
+#include "MapTestUtilities.h"
+
+#include "vtkPackedTileStore.h"
+
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+const int Zoom = 10;
+
+//----------------------------------------------------------------------------
+std::vector<unsigned char> MakeTile(int size)
+{
+  std::string data = MakeTileData(size);
+  return std::vector<unsigned char>(data.begin(), data.end());
+}
+
+//----------------------------------------------------------------------------
+bool Put(vtkPackedTileStore *store, int x,
+         const std::vector<unsigned char>& data)
+{
+  return store->Put(Zoom, x, x, &data[0], data.size());
+}
+
+//----------------------------------------------------------------------------
+bool HasTile(vtkPackedTileStore *store, int x,
+             const std::vector<unsigned char>& data)
+{
+  std::vector<unsigned char> stored;
+  return store->Contains(Zoom, x, x) && store->Get(Zoom, x, x, stored) &&
+    stored == data;
+}
+
+//----------------------------------------------------------------------------
+std::string ReadFile(const std::string& path)
+{
+  std::ifstream file(path.c_str(), std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+//----------------------------------------------------------------------------
+void WriteFile(const std::string& path, const std::string& data)
+{
+  std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+  file.write(data.data(), data.size());
+}
+}
+
+//----------------------------------------------------------------------------
+int TestPackedTileStore(int argc, char *argv[])
+{
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestPackedTileStore");
+  std::string packPath = storageDir + "/tiles.pack";
+  std::string indexPath = packPath + ".idx";
+
+  std::vector<unsigned char> tile0 = MakeTile(8);
+  std::vector<unsigned char> tile1 = MakeTile(16);
+  std::vector<unsigned char> tile2 = MakeTile(24);
+  std::vector<unsigned char> data;
+
+  // Tiles put are found by the same session, without reopening
+  vtkNew<vtkPackedTileStore> store;
+  CHECK(store->Open(packPath.c_str()));
+  CHECK(!store->Contains(Zoom, 0, 0));
+  CHECK(!store->Get(Zoom, 0, 0, data));
+  CHECK(Put(store.GetPointer(), 0, tile0));
+  CHECK(HasTile(store.GetPointer(), 0, tile0));
+  CHECK(store->GetNumberOfTiles() == 1);
+
+  // A tile put again is superseded, not added
+  vtkTypeInt64 packSize = store->GetPackSize();
+  CHECK(Put(store.GetPointer(), 0, tile1));
+  CHECK(HasTile(store.GetPointer(), 0, tile1));
+  CHECK(store->GetNumberOfTiles() == 1);
+  CHECK(store->GetPackSize() ==
+        packSize + static_cast<vtkTypeInt64>(tile1.size()) + 12);
+
+  // Removed tiles are gone right away
+  CHECK(Put(store.GetPointer(), 1, tile1));
+  CHECK(store->Remove(Zoom, 0, 0));
+  CHECK(!store->Contains(Zoom, 0, 0));
+  CHECK(!store->Get(Zoom, 0, 0, data));
+  CHECK(!store->Remove(Zoom, 0, 0));
+  CHECK(store->GetNumberOfTiles() == 1);
+  CHECK(Put(store.GetPointer(), 0, tile0));
+  CHECK(HasTile(store.GetPointer(), 0, tile0));
+  store->Close();
+
+  // Tiles persist across sessions
+  CHECK(store->Open(packPath.c_str()));
+  CHECK(store->GetNumberOfTiles() == 2);
+  CHECK(HasTile(store.GetPointer(), 0, tile0));
+  CHECK(HasTile(store.GetPointer(), 1, tile1));
+  CHECK(Put(store.GetPointer(), 2, tile2));
+  store->Close();
+
+  // Crash after the pack record of tile 2 was written, but not its
+  // index record, in the middle of writing another pack record
+  std::string index = ReadFile(indexPath);
+  WriteFile(indexPath, index.substr(0, index.size() - 20));
+  std::string pack = ReadFile(packPath);
+  std::string partial(pack.end() - tile2.size() - 12,
+                      pack.end() - tile2.size() / 2);
+  WriteFile(packPath, pack + partial);
+
+  // Recovery indexes tile 2 again, and drops the partial record, so
+  // that tiles put next are appended after tile 2 and found
+  CHECK(store->Open(packPath.c_str()));
+  CHECK(store->GetPackSize() == static_cast<vtkTypeInt64>(pack.size()));
+  CHECK(store->GetNumberOfTiles() == 3);
+  CHECK(HasTile(store.GetPointer(), 2, tile2));
+  CHECK(Put(store.GetPointer(), 3, tile0));
+  CHECK(HasTile(store.GetPointer(), 3, tile0));
+  CHECK(HasTile(store.GetPointer(), 2, tile2));
+  CHECK(store->Remove(Zoom, 1, 1));
+  CHECK(!store->Contains(Zoom, 1, 1));
+  store->Close();
+
+  // A lost index is rebuilt from the pack, removals included
+  vtksys::SystemTools::RemoveFile(indexPath);
+  CHECK(store->Open(packPath.c_str()));
+  CHECK(store->GetNumberOfTiles() == 3);
+  CHECK(HasTile(store.GetPointer(), 0, tile0));
+  CHECK(!store->Contains(Zoom, 1, 1));
+  CHECK(HasTile(store.GetPointer(), 2, tile2));
+  CHECK(HasTile(store.GetPointer(), 3, tile0));
+  store->Close();
+
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestPackedTileStore(argc, argv);
+}
@@ -0,0 +1,176 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestPerspectiveTileSelection.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks the quadtree tile selection of vtkOsmLayer in perspective
+// views: one zoom level looking straight down, coarser tiles towards
+// the horizon in a tilted view, no overlapping tiles, and at most
+// MaxPerspectiveTiles tiles.
+
+#include "MapTestUtilities.h"
+
+#include "vtkMap.h"
+#include "vtkOsmLayer.h"
+
+#include <vtkCamera.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Gives access to the perspective tile selection
+class SelectionLayer : public vtkOsmLayer
+{
+public:
+  static SelectionLayer *New();
+  vtkTypeMacro(SelectionLayer, vtkOsmLayer)
+
+  void Select(std::vector<vtkMapTileSpecInternal>& specs)
+  {
+    std::vector<vtkMapTile*> tiles;
+    specs.clear();
+    this->SelectTilesPerspective(tiles, specs);
+  }
+};
+vtkStandardNewMacro(SelectionLayer)
+
+//----------------------------------------------------------------------------
+static bool Overlap(const vtkMapTileSpecInternal& a,
+                    const vtkMapTileSpecInternal& b)
+{
+  return a.Corners[0] < b.Corners[2] && b.Corners[0] < a.Corners[2] &&
+         a.Corners[1] < b.Corners[3] && b.Corners[1] < a.Corners[3];
+}
+
+//----------------------------------------------------------------------------
+// Zoom level of the selected tile containing world point (x, y),
+// or -1 if there is none
+static int ZoomAt(const std::vector<vtkMapTileSpecInternal>& specs,
+                  double x, double y)
+{
+  for (std::size_t i = 0; i < specs.size(); ++i)
+    {
+    const double *corners = specs[i].Corners;
+    if (corners[0] <= x && x < corners[2] && corners[1] <= y && y < corners[3])
+      {
+      return specs[i].ZoomXY[0];
+      }
+    }
+  return -1;
+}
+
+//----------------------------------------------------------------------------
+static bool AnyOverlap(const std::vector<vtkMapTileSpecInternal>& specs)
+{
+  for (std::size_t i = 0; i < specs.size(); ++i)
+    {
+    for (std::size_t j = i + 1; j < specs.size(); ++j)
+      {
+      if (Overlap(specs[i], specs[j]))
+        {
+        return true;
+        }
+      }
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+int TestPerspectiveTileSelection(int, char *[])
+{
+  vtkNew<vtkMap> map;
+  vtkNew<vtkRenderer> renderer;
+  map->SetRenderer(renderer.GetPointer());
+  map->PerspectiveProjectionOn();
+  vtkNew<vtkRenderWindow> window;
+  window->AddRenderer(renderer.GetPointer());
+  window->SetSize(500, 500);
+
+  vtkNew<SelectionLayer> layer;
+  map->AddLayer(layer.GetPointer());
+  CHECK(layer->GetPerspectiveTileScreenSize() == 256.0);
+  CHECK(layer->GetMaxPerspectiveTiles() == 128);
+
+  vtkCamera *camera = renderer->GetActiveCamera();
+  camera->SetViewAngle(30.0);
+  camera->SetFocalPoint(0.0, 0.0, 0.0);
+  camera->SetClippingRange(0.1, 1000.0);
+
+  // Straight down: all tiles about the same size on screen
+  camera->SetPosition(0.0, 0.0, 10.0);
+  camera->SetViewUp(0.0, 1.0, 0.0);
+  std::vector<vtkMapTileSpecInternal> specs;
+  layer->Select(specs);
+  CHECK(!specs.empty());
+  CHECK(specs.size() <= 128);
+  CHECK(!AnyOverlap(specs));
+  int minZoom = 20, maxZoom = -1;
+  for (std::size_t i = 0; i < specs.size(); ++i)
+    {
+    minZoom = std::min(minZoom, specs[i].ZoomXY[0]);
+    maxZoom = std::max(maxZoom, specs[i].ZoomXY[0]);
+    }
+  CHECK(maxZoom - minZoom <= 1);
+  CHECK(ZoomAt(specs, 0.0, 0.0) >= 7);
+
+  // Tilted towards the horizon: coarser tiles further away
+  camera->SetPosition(0.0, -30.0, 10.0);
+  camera->OrthogonalizeViewUp();
+  layer->Select(specs);
+  CHECK(specs.size() <= 128);
+  CHECK(!AnyOverlap(specs));
+  int nearZoom = ZoomAt(specs, 0.0, -5.0);
+  int focalZoom = ZoomAt(specs, 0.0, 0.0);
+  int farZoom = ZoomAt(specs, 0.0, 50.0);
+  CHECK(farZoom >= 0);
+  CHECK(nearZoom >= focalZoom && focalZoom > farZoom);
+
+  // Row and column agree with the tile's corners
+  for (std::size_t i = 0; i < specs.size(); ++i)
+    {
+    int zoom = specs[i].ZoomXY[0];
+    CHECK(specs[i].ZoomRowCol[0] == zoom);
+    CHECK(specs[i].ZoomRowCol[1] == specs[i].ZoomXY[1]);
+    CHECK(specs[i].ZoomRowCol[2] == (1 << zoom) - 1 - specs[i].ZoomXY[2]);
+    CHECK(specs[i].Corners[0] == -180.0 + specs[i].ZoomXY[1] * 360.0 / (1 << zoom));
+    }
+
+  // Tile budget: still covers the view, with less detail
+  layer->SetMaxPerspectiveTiles(16);
+  layer->Select(specs);
+  CHECK(specs.size() <= 16);
+  CHECK(!AnyOverlap(specs));
+  CHECK(ZoomAt(specs, 0.0, 0.0) >= 0);
+  CHECK(ZoomAt(specs, 0.0, 0.0) <= focalZoom);
+
+  // Looking away from the map
+  camera->SetPosition(0.0, 0.0, -10.0);
+  camera->SetViewUp(0.0, 1.0, 0.0);
+  camera->SetFocalPoint(0.0, 0.0, -20.0);
+  layer->Select(specs);
+  CHECK(specs.empty());
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestPerspectiveTileSelection(argc, argv);
+}
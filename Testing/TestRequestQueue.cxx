@@ -0,0 +1,123 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestRequestQueue.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks the request queue of vtkMultiThreadedOsmLayer: tiles nearest
+// to the view center are downloaded first, requests for tiles that
+// left the view are cancelled, and the number of request threads can
+// be changed while tiles are loading. Tiles come from LocalTileServer,
+// which delays each response.
+
+#include "LocalTileServer.h"
+#include "MapTestUtilities.h"
+
+#include "vtkMap.h"
+#include "vtkMercator.h"
+#include "vtkMultiThreadedOsmLayer.h"
+
+#include <vtkNew.h>
+#include <vtkRenderWindow.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+int TestRequestQueue(int argc, char *argv[])
+{
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestRequestQueue");
+
+  const int zoom = 6;
+  const double latitude = 40.0;
+  const double longitude = -100.0;
+
+  LocalTileServer server;
+  server.SetTileData(MakeTileData());
+  server.SetNumberOfThreads(4);
+  server.SetLatency(0.1, 0.0);
+  CHECK(server.Start());
+
+  TestMapView view(storageDir);
+  vtkMap *map = view.Map.GetPointer();
+  map->SetCenter(latitude, longitude);
+  map->SetZoom(zoom);
+  view.RenderWindow->SetSize(1024, 768);
+
+  vtkNew<vtkMultiThreadedOsmLayer> layer;
+  CHECK(layer->GetNumberOfThreads() == 16);
+  layer->SetNumberOfThreads(1);
+  CHECK(layer->GetNumberOfThreads() == 1);
+  map->AddLayer(layer.GetPointer());
+  layer->SetMapTileServer(server.GetHostAndPort().c_str(), "", "png");
+  layer->PrefetchOff();
+  map->Draw();
+  int numScheduled = layer->GetNumberOfScheduledTiles();
+  CHECK(numScheduled > 1);
+
+  // Move to the other side of the world before the single request
+  // thread gets far, which cancels the requests for the first view
+  map->SetCenter(-latitude, -longitude);
+  map->Draw();
+  CHECK(layer->GetNumberOfCancelledRequests() > 0);
+
+  // More threads to load the second view
+  layer->SetNumberOfThreads(4);
+  CHECK(layer->GetNumberOfThreads() == 4);
+  CHECK(WaitForTiles(layer.GetPointer()));
+  std::cout << numScheduled << " tiles scheduled, "
+            << layer->GetNumberOfCancelledRequests() << " cancelled, "
+            << server.GetNumberOfRequests() << " requested" << std::endl;
+
+  // The first download is the tile at the view center, and only
+  // downloads in progress were left of the first view
+  std::vector<std::string> paths = server.GetRequestedPaths();
+  CHECK(!paths.empty());
+  std::stringstream centerPath;
+  centerPath << "/" << zoom
+             << "/" << vtkMercator::long2tilex(longitude, zoom)
+             << "/" << vtkMercator::lat2tiley(latitude, zoom) << ".png";
+  CHECK(paths[0] == centerPath.str());
+  int numFirstView = 0;
+  int halfWidth = 1 << (zoom - 1);
+  for (std::size_t i = 0; i < paths.size(); ++i)
+    {
+    int col = atoi(paths[i].c_str() + paths[i].find('/', 1) + 1);
+    numFirstView += col < halfWidth ? 1 : 0;
+    }
+  CHECK(numFirstView <= 2);
+  CHECK(numFirstView + layer->GetNumberOfCancelledRequests() >=
+        numScheduled);
+
+  // All tiles of the second view arrive
+  while (layer->ResolveAsync() != vtkMap::AsyncFullUpdate)
+    {
+    CHECK(layer->GetNumberOfPendingTiles() > 0);
+    }
+  CHECK(layer->GetNumberOfPendingTiles() == 0);
+  CHECK(layer->GetNumberOfCachedTiles() >=
+        static_cast<int>(paths.size()) - numFirstView);
+
+  server.Stop();
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestRequestQueue(argc, argv);
+}
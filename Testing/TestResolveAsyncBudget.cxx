@@ -0,0 +1,142 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestResolveAsyncBudget.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks that vtkMultiThreadedOsmLayer::ResolveAsync() adds new tiles
+// within its per-call tile budget, nearest to the view center first,
+// and reports a partial update until all tiles are added. Tiles come
+// from LocalTileServer.
+
+#include "LocalTileServer.h"
+#include "MapTestUtilities.h"
+
+#include "vtkMap.h"
+#include "vtkMapTile.h"
+#include "vtkMultiThreadedOsmLayer.h"
+
+#include <vtkCamera.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+//----------------------------------------------------------------------------
+// Gives access to the layer's tile cache
+class BudgetLayer : public vtkMultiThreadedOsmLayer
+{
+public:
+  static BudgetLayer *New();
+  vtkTypeMacro(BudgetLayer, vtkMultiThreadedOsmLayer)
+
+  vtkMapTile *GetCachedTileAt(int i)
+  {
+    return this->CachedTiles[i];
+  }
+};
+vtkStandardNewMacro(BudgetLayer)
+
+//----------------------------------------------------------------------------
+static double Distance2(vtkMapTile *tile, const double center[3])
+{
+  double *corners = tile->GetCorners();
+  double dx = 0.5 * (corners[0] + corners[2]) - center[0];
+  double dy = 0.5 * (corners[1] + corners[3]) - center[1];
+  return dx * dx + dy * dy;
+}
+
+//----------------------------------------------------------------------------
+int TestResolveAsyncBudget(int argc, char *argv[])
+{
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestResolveAsyncBudget");
+
+  LocalTileServer server;
+  server.SetTileData(MakeTileData());
+  CHECK(server.Start());
+
+  TestMapView view(storageDir);
+  vtkMap *map = view.Map.GetPointer();
+  map->SetZoom(6);
+  view.RenderWindow->SetSize(1024, 768);
+
+  vtkNew<BudgetLayer> layer;
+  map->AddLayer(layer.GetPointer());
+  layer->SetMapTileServer(server.GetHostAndPort().c_str(), "", "png");
+  layer->PrefetchOff();
+  CHECK(layer->GetMaxResolveTime() == 0.008);
+  CHECK(layer->GetMaxTilesPerResolve() == 0);
+  layer->SetMaxResolveTime(0.0);
+  layer->SetMaxTilesPerResolve(2);
+  map->Draw();
+
+  // Wait for the request threads to load all tiles in view
+  int pending = 0;
+  int stableCount = 0;
+  for (int i = 0; i < 600 && stableCount < 20; ++i)
+    {
+    vtksys::SystemTools::Delay(50);
+    int count = layer->GetNumberOfPendingTiles();
+    stableCount = count > 0 && count == pending ? stableCount + 1 : 0;
+    pending = count;
+    }
+  CHECK(pending > 2);
+  std::cout << pending << " tiles loaded" << std::endl;
+
+  double center[3];
+  view.Renderer->GetActiveCamera()->GetFocalPoint(center);
+  double lastDistance = 0.0;
+  int numCalls = 0;
+  for (;;)
+    {
+    int numCached = layer->GetNumberOfCachedTiles();
+    vtkMap::AsyncState state = layer->ResolveAsync();
+    ++numCalls;
+    int numAdded = layer->GetNumberOfCachedTiles() - numCached;
+    CHECK(numAdded >= 1 && numAdded <= 2);
+
+    // Nearest first, across calls too
+    for (int i = numCached; i < numCached + numAdded; ++i)
+      {
+      double distance = Distance2(layer->GetCachedTileAt(i), center);
+      CHECK(distance >= lastDistance - 1.0e-12);
+      lastDistance = distance;
+      }
+
+    if (layer->GetNumberOfPendingTiles() > 0)
+      {
+      CHECK(state == vtkMap::AsyncPartialUpdate);
+      }
+    else
+      {
+      CHECK(state == vtkMap::AsyncFullUpdate);
+      break;
+      }
+    }
+  CHECK(numCalls == (pending + 1) / 2);
+  CHECK(layer->ResolveAsync() == vtkMap::AsyncIdle);
+
+  server.Stop();
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestResolveAsyncBudget(argc, argv);
+}
@@ -0,0 +1,107 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestTileFileIntegrity.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks that truncated tiles do not end up in, or stay in, the disk
+// cache: images cut short are told apart from complete ones, tile files
+// are replaced without leaving temporary files behind, and a truncated
+// file in the cache is downloaded again rather than drawn.
+
+#include "LocalTileServer.h"
+#include "MapTestUtilities.h"
+
+#include "vtkMap.h"
+#include "vtkMercator.h"
+#include "vtkOsmLayer.h"
+#include "vtkPackedTileStore.h"
+
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+int TestTileFileIntegrity(int argc, char *argv[])
+{
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestTileFileIntegrity");
+
+  // Images cut short are not complete
+  std::string tileData = MakeTileData();
+  std::vector<unsigned char> data(tileData.begin(), tileData.end());
+  CHECK(vtkPackedTileStore::IsCompleteImage(&data[0], data.size()));
+  CHECK(!vtkPackedTileStore::IsCompleteImage(&data[0], data.size() - 1));
+  CHECK(!vtkPackedTileStore::IsCompleteImage(&data[0], data.size() / 2));
+  CHECK(vtkPackedTileStore::IsImageData(&data[0], data.size() / 2));
+
+  // Tile files are replaced whole, through temporary files
+  std::string path = storageDir + "/tile.png";
+  std::vector<unsigned char> half(data.begin(),
+                                  data.begin() + data.size() / 2);
+  CHECK(vtkOsmLayer::WriteTileFile(path, half));
+  CHECK(vtkOsmLayer::WriteTileFile(path, data));
+  CHECK(vtksys::SystemTools::FileLength(path) == data.size());
+  CHECK(CountFiles(storageDir, ".part") == 0);
+  vtksys::SystemTools::RemoveFile(path);
+
+  LocalTileServer server;
+  server.SetTileData(tileData);
+  CHECK(server.Start());
+
+  const int zoom = 4;
+  const int col = vtkMercator::long2tilex(-100.0, zoom);
+  const int row = vtkMercator::lat2tiley(40.0, zoom);
+
+  int numRequests = 0;
+  std::string tilePath;
+    {
+    vtkNew<vtkOsmLayer> layer;
+    layer->RevalidateTilesOff();
+    TestMapView view(storageDir, layer.GetPointer(), server.GetHostAndPort());
+    numRequests = server.GetNumberOfRequests();
+    CHECK(numRequests > 0);
+    CHECK(CountFiles(layer->GetCacheDirectory(), ".part") == 0);
+    tilePath = layer->GetTileFileSystemPath(zoom, col, row);
+    }
+  CHECK(vtksys::SystemTools::FileLength(tilePath) == data.size());
+
+  // Truncate a cached tile, as a crash in the middle of a write by an
+  // earlier version could have
+  FILE *fp = fopen(tilePath.c_str(), "wb");
+  CHECK(fp != NULL);
+  fwrite(&half[0], 1, half.size(), fp);
+  fclose(fp);
+
+  // The next session downloads it again, and only it
+    {
+    vtkNew<vtkOsmLayer> layer;
+    layer->RevalidateTilesOff();
+    TestMapView view(storageDir, layer.GetPointer(), server.GetHostAndPort());
+    CHECK(server.GetNumberOfRequests() == numRequests + 1);
+    }
+  CHECK(vtksys::SystemTools::FileLength(tilePath) == data.size());
+
+  server.Stop();
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestTileFileIntegrity(argc, argv);
+}
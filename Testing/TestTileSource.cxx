@@ -0,0 +1,157 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestTileSource.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks the tile sources: URLs made from templates with subdomains,
+// tiles read from a directory tree and from a pack file, and generated
+// tiles, which are the same every time. Then checks that vtkOsmLayer
+// and vtkMultiThreadedOsmLayer draw tiles of a local source without a
+// tile server, and without copying them to their disk cache.
+
+#include "MapTestUtilities.h"
+
+#include "vtkDirectoryTileSource.h"
+#include "vtkHttpTileSource.h"
+#include "vtkMap.h"
+#include "vtkMultiThreadedOsmLayer.h"
+#include "vtkOsmLayer.h"
+#include "vtkPackedTileSource.h"
+#include "vtkPackedTileStore.h"
+#include "vtkProceduralTileSource.h"
+
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+int TestTileSource(int argc, char *argv[])
+{
+  std::string storageDir =
+    MakeStorageDirectory(argc, argv, "TestTileSource");
+
+  // URL templates, with neighboring tiles on different subdomains
+  vtkNew<vtkHttpTileSource> http;
+  CHECK(http->GetTileUrl(3, 1, 2) ==
+        "http://tile.openstreetmap.org/3/1/2.png");
+  CHECK(!http->IsLocal());
+  http->SetUrlTemplate("http://{s}.tiles.example.org:8080/{z}/{x}/{y}.jpg");
+  http->SetSubdomains("a,b,c");
+  CHECK(http->GetSubdomains() == "a,b,c");
+  CHECK(http->GetTileUrl(3, 1, 2) ==
+        "http://a.tiles.example.org:8080/3/1/2.jpg");
+  CHECK(http->GetTileUrl(3, 2, 2) ==
+        "http://b.tiles.example.org:8080/3/2/2.jpg");
+  std::vector<std::string> hosts;
+  http->GetHosts(hosts);
+  CHECK(hosts.size() == 3);
+  CHECK(hosts[2] == "c.tiles.example.org:8080");
+
+  // Generated tiles are complete images, the same every time
+  vtkNew<vtkProceduralTileSource> procedural;
+  procedural->SetTileSize(64);
+  std::vector<unsigned char> data;
+  std::vector<unsigned char> other;
+  long status = 0;
+  CHECK(procedural->FetchTile(3, 1, 2, data, &status));
+  CHECK(status == 200);
+  CHECK(vtkPackedTileStore::IsCompleteImage(&data[0], data.size()));
+  CHECK(procedural->FetchTile(3, 1, 2, other));
+  CHECK(other == data);
+  CHECK(procedural->FetchTile(3, 2, 1, other));
+  CHECK(other != data);
+  CHECK(!procedural->FetchTile(3, 8, 0, other, &status));
+  CHECK(status == 404);
+  procedural->SetMaxZoom(2);
+  CHECK(!procedural->FetchTile(3, 1, 2, other, &status));
+  CHECK(status == 404);
+  CHECK(procedural->GetNumberOfGeneratedTiles() == 3);
+
+  // Directory trees
+  std::string treeDir = storageDir + "/tree";
+  vtksys::SystemTools::MakeDirectory(treeDir + "/3/1");
+  CHECK(vtkOsmLayer::WriteTileFile(treeDir + "/3/1/2.png", data));
+  vtkNew<vtkDirectoryTileSource> directory;
+  directory->SetDirectory(treeDir.c_str());
+  CHECK(directory->IsLocal());
+  CHECK(directory->GetTileUrl(3, 1, 2) ==
+        "file://" + treeDir + "/3/1/2.png");
+  CHECK(directory->FetchTile(3, 1, 2, other, &status));
+  CHECK(status == 200);
+  CHECK(other == data);
+  CHECK(!directory->FetchTile(3, 1, 3, other, &status));
+  CHECK(status == 404);
+  CHECK(other.empty());
+
+  // Pack files
+  std::string packPath = storageDir + "/tiles.pack";
+    {
+    vtkNew<vtkPackedTileStore> store;
+    CHECK(store->Open(packPath.c_str()));
+    CHECK(store->Put(3, 1, 2, &data[0], data.size()));
+    store->Close();
+    }
+  vtkNew<vtkPackedTileSource> packed;
+  packed->SetFileName(packPath.c_str());
+  CHECK(packed->IsLocal());
+  CHECK(packed->FetchTile(3, 1, 2, other, &status));
+  CHECK(status == 200);
+  CHECK(other == data);
+  CHECK(!packed->FetchTile(3, 2, 1, other, &status));
+  CHECK(status == 404);
+
+  // Layers draw local tiles without copying them to their cache
+    {
+    vtkNew<vtkProceduralTileSource> source;
+    vtkNew<vtkOsmLayer> layer;
+    TestMapView view(storageDir, layer.GetPointer(), source.GetPointer());
+    int numTiles = layer->GetNumberOfCachedTiles();
+    std::cout << numTiles << " tiles drawn" << std::endl;
+    CHECK(numTiles > 0);
+    CHECK(source->GetNumberOfGeneratedTiles() == numTiles);
+    CHECK(layer->GetTileSource() == source.GetPointer());
+    CHECK(layer->GetTileUrl(4, 3, 5) == "procedural://4/3/5.png");
+    CHECK(layer->GetRevalidator() == NULL);
+    CHECK(CountFiles(layer->GetCacheDirectory(), ".png") == 0);
+
+    // Back to the tile server
+    layer->SetTileSource(NULL);
+    CHECK(layer->GetTileUrl(4, 3, 5) == "http://procedural/4/3/5.png");
+    CHECK(layer->GetNumberOfCachedTiles() == 0);
+    }
+
+    {
+    vtkNew<vtkProceduralTileSource> source;
+    vtkNew<vtkMultiThreadedOsmLayer> layer;
+    layer->PrefetchOff();
+    TestMapView view(storageDir, layer.GetPointer(), source.GetPointer());
+    int numTiles = layer->GetNumberOfCachedTiles();
+    std::cout << numTiles << " tiles drawn by request threads" << std::endl;
+    CHECK(numTiles > 0);
+    CHECK(source->GetNumberOfGeneratedTiles() == numTiles);
+    CHECK(layer->GetConcurrency() == 0);
+    CHECK(CountFiles(layer->GetCacheDirectory(), ".png") == 0);
+    }
+
+  vtksys::SystemTools::RemoveADirectory(storageDir);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  return TestTileSource(argc, argv);
+}
@@ -0,0 +1,173 @@
+// Fills the map-tile cache for an area and zoom range, for offline use.
+// The tile server must be given, and must allow bulk downloads: the
+// OpenStreetMap tile servers forbid them, so they are refused.
+//
+// Example: seed the Albany, NY area, zoom levels 0 to 14
+//   seed -b 42.5 -74.0 42.9 -73.5 -z 0 14 -m tiles.example.com
+
+#include "vtkMap.h"
+#include "vtkMapTileSeeder.h"
+#include "vtkOsmLayer.h"
+
+#include <vtkCommand.h>
+#include <vtkNew.h>
+#include <vtkRenderer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static vtkMapTileSeeder *ActiveSeeder = NULL;
+
+// ------------------------------------------------------------
+// Stop cleanly on Ctrl-C, so that the next run resumes
+extern "C" void InterruptHandler(int)
+{
+  if (ActiveSeeder)
+    {
+    ActiveSeeder->Abort();
+    }
+}
+
+// ------------------------------------------------------------
+class ProgressCallback : public vtkCommand
+{
+public:
+  static ProgressCallback *New()
+    { return new ProgressCallback; }
+  virtual void Execute(vtkObject *caller, unsigned long, void* data)
+    {
+      vtkMapTileSeeder *seeder = vtkMapTileSeeder::SafeDownCast(caller);
+      double progress = *static_cast<double*>(data);
+      char line[256];
+      snprintf(line, sizeof(line),
+               "\r%5.1f%%  %lld/%lld tiles, %lld downloaded, %lld present,"
+               " %lld failed, %.1f tiles/s, %.1f KB/s   ",
+               100.0 * progress,
+               static_cast<long long>(seeder->GetNumberOfProcessedTiles()),
+               static_cast<long long>(seeder->GetNumberOfTiles()),
+               static_cast<long long>(seeder->GetNumberOfDownloadedTiles()),
+               static_cast<long long>(seeder->GetNumberOfSkippedTiles()),
+               static_cast<long long>(seeder->GetNumberOfFailedTiles()),
+               seeder->GetTilesPerSecond(),
+               seeder->GetBytesPerSecond() / 1024.0);
+      std::cout << line << std::flush;
+    }
+};
+
+int main(int argc, char *argv[])
+{
+  bool showHelp = false;
+  bool packed = false;
+  bool noResume = false;
+  int numberOfThreads = 4;
+  double rate = 10.0;
+  std::vector<double> bounds;
+  std::vector<int> zoomRange;
+  std::string storageDirectory;
+  std::string tileExtension = "png";
+  std::string tileServer;
+
+  vtksys::CommandLineArguments arg;
+  arg.Initialize(argc, argv);
+  arg.StoreUnusedArguments(true);
+  arg.AddArgument("-h", vtksys::CommandLineArguments::NO_ARGUMENT,
+                  &showHelp, "show help message");
+  arg.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT,
+                  &showHelp, "show help message");
+  arg.AddArgument("-b", vtksys::CommandLineArguments::MULTI_ARGUMENT,
+                  &bounds, "area (latitude1 longitude1 latitude2 longitude2)");
+  arg.AddArgument("-d", vtksys::CommandLineArguments::SPACE_ARGUMENT,
+                  &storageDirectory, "map storage directory (~/.vtkmap/tiles)");
+  arg.AddArgument("-e", vtksys::CommandLineArguments::SPACE_ARGUMENT,
+                  &tileExtension, "map-tile file extension (jpg, png, etc.)");
+  arg.AddArgument("-j", vtksys::CommandLineArguments::SPACE_ARGUMENT,
+                  &numberOfThreads, "number of concurrent requests (4)");
+  arg.AddArgument("-k", vtksys::CommandLineArguments::NO_ARGUMENT,
+                  &packed, "store tiles in a packed tile store");
+  arg.AddArgument("-m", vtksys::CommandLineArguments::SPACE_ARGUMENT,
+                  &tileServer, "map-tile server allowing bulk downloads");
+  arg.AddArgument("-n", vtksys::CommandLineArguments::NO_ARGUMENT,
+                  &noResume, "start over instead of resuming");
+  arg.AddArgument("-r", vtksys::CommandLineArguments::SPACE_ARGUMENT,
+                  &rate, "maximum requests per second, 0 for no limit (10)");
+  arg.AddArgument("-z", vtksys::CommandLineArguments::MULTI_ARGUMENT,
+                  &zoomRange, "zoom levels (minimum maximum)");
+
+  bool parsed = arg.Parse();
+  if (tileServer.find("tile.openstreetmap.org") != std::string::npos)
+    {
+    std::cout << "The OpenStreetMap tile servers do not allow bulk"
+              << " downloads, see\n"
+              << "https://operations.osmfoundation.org/policies/tiles/"
+              << std::endl;
+    tileServer = "";
+    }
+  if (!parsed || showHelp || bounds.size() != 4 || zoomRange.size() != 2 ||
+      tileServer == "")
+    {
+    std::cout << "\n"
+              << "Usage: seed -b lat1 lon1 lat2 lon2 -z min max -m server"
+              << " [options]\n"
+              << arg.GetHelp()
+              << std::endl;
+    return -1;
+    }
+
+  // The layer provides the tile server, cache paths and tile store
+  vtkNew<vtkMap> map;
+  vtkNew<vtkRenderer> rend;
+  map->SetRenderer(rend.GetPointer());
+  if (storageDirectory != "")
+    {
+    map->SetStorageDirectory(storageDirectory.c_str());
+    }
+
+  vtkNew<vtkOsmLayer> osmLayer;
+  map->AddLayer(osmLayer.GetPointer());
+  osmLayer->SetMapTileServer(tileServer.c_str(), "", tileExtension.c_str());
+  osmLayer->SetUsePackedTileStore(packed);
+  if (!osmLayer->GetCacheDirectory())
+    {
+    return 1;
+    }
+
+  vtkNew<vtkMapTileSeeder> seeder;
+  seeder->SetLayer(osmLayer.GetPointer());
+  seeder->SetBounds(&bounds[0]);
+  seeder->SetMinZoom(zoomRange[0]);
+  seeder->SetMaxZoom(zoomRange[1]);
+  seeder->SetNumberOfThreads(numberOfThreads);
+  seeder->SetMaxRequestsPerSecond(rate);
+  seeder->SetResume(!noResume);
+
+  vtkNew<ProgressCallback> progressCallback;
+  seeder->AddObserver(vtkCommand::ProgressEvent,
+                      progressCallback.GetPointer());
+
+  std::cout << "Seeding " << seeder->GetNumberOfTiles() << " tiles from "
+            << tileServer << " into " << osmLayer->GetCacheDirectory()
+            << std::endl;
+
+  ActiveSeeder = seeder.GetPointer();
+  signal(SIGINT, InterruptHandler);
+  bool complete = seeder->Seed();
+  signal(SIGINT, SIG_DFL);
+  ActiveSeeder = NULL;
+
+  std::cout << "\n"
+            << seeder->GetNumberOfDownloadedTiles() << " tiles ("
+            << seeder->GetNumberOfDownloadedBytes() / 1024 << " KB) downloaded"
+            << " in " << seeder->GetElapsedTime() << " s, "
+            << seeder->GetNumberOfSkippedTiles() << " already present, "
+            << seeder->GetNumberOfFailedTiles() << " failed" << std::endl;
+  if (!complete)
+    {
+    std::cout << "Incomplete; run again to resume" << std::endl;
+    return 1;
+    }
+  return 0;
+}
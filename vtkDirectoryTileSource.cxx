@@ -0,0 +1,104 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkDirectoryTileSource.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkDirectoryTileSource.h"
+
+#include <vtkObjectFactory.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdio>
+
+vtkStandardNewMacro(vtkDirectoryTileSource)
+
+//----------------------------------------------------------------------------
+vtkDirectoryTileSource::vtkDirectoryTileSource()
+{
+  this->Directory = NULL;
+  this->PathTemplate = NULL;
+  this->SetPathTemplate("{z}/{x}/{y}.png");
+}
+
+//----------------------------------------------------------------------------
+vtkDirectoryTileSource::~vtkDirectoryTileSource()
+{
+  this->SetDirectory(NULL);
+  this->SetPathTemplate(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkDirectoryTileSource::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Directory: "
+     << (this->Directory ? this->Directory : "(none)") << "\n"
+     << indent << "PathTemplate: "
+     << (this->PathTemplate ? this->PathTemplate : "(none)") << std::endl;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkDirectoryTileSource::GetTilePath(int zoom, int x, int y)
+{
+  std::string path = this->Directory ? this->Directory : ".";
+  return path + "/" + ExpandTemplate(
+    this->PathTemplate ? this->PathTemplate : "", zoom, x, y);
+}
+
+//----------------------------------------------------------------------------
+bool vtkDirectoryTileSource::FetchTile(int zoom, int x, int y,
+                                       std::vector<unsigned char>& data,
+                                       long *httpStatus,
+                                       std::string *errorMessage,
+                                       vtkMapTileCacheInfo *vtkNotUsed(info))
+{
+  std::string path = this->GetTilePath(zoom, x, y);
+  data.clear();
+  FILE *fp = fopen(path.c_str(), "rb");
+  bool valid = fp != NULL;
+  if (fp)
+    {
+    data.resize(static_cast<std::size_t>(
+      vtksys::SystemTools::FileLength(path)));
+    valid = !data.empty() &&
+      fread(&data[0], 1, data.size(), fp) == data.size();
+    fclose(fp);
+    }
+  if (!valid)
+    {
+    data.clear();
+    }
+
+  // Reported like the responses of tile servers
+  if (httpStatus)
+    {
+    *httpStatus = valid ? 200 : 404;
+    }
+  if (errorMessage && !valid)
+    {
+    *errorMessage = fp ? "cannot read " + path : "no file " + path;
+    }
+  return valid;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkDirectoryTileSource::GetTileUrl(int zoom, int x, int y)
+{
+  return "file://" + this->GetTilePath(zoom, x, y);
+}
+
+//----------------------------------------------------------------------------
+bool vtkDirectoryTileSource::IsLocal()
+{
+  return true;
+}
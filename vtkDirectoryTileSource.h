@@ -0,0 +1,72 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkDirectoryTileSource.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkDirectoryTileSource - map tiles from a local directory tree
+// .SECTION Description
+// Reads map tiles from files under a directory, such as a tree exported
+// by a tile renderer, or a vtkOsmLayer cache directory. The path of
+// each tile relative to the directory is made from a template, where
+// {z}, {x} and {y} are replaced by the tile indices.
+
+#ifndef __vtkDirectoryTileSource_h
+#define __vtkDirectoryTileSource_h
+
+#include "vtkTileSource.h"
+
+class VTKMAP_EXPORT vtkDirectoryTileSource : public vtkTileSource
+{
+public:
+  static vtkDirectoryTileSource *New();
+  vtkTypeMacro(vtkDirectoryTileSource, vtkTileSource)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Get/Set the directory the tiles are in.
+  // Must not be changed while tiles are being read.
+  vtkSetStringMacro(Directory);
+  vtkGetStringMacro(Directory);
+
+  // Description:
+  // Get/Set the path template of tile files, relative to the directory.
+  // Default is "{z}/{x}/{y}.png". Use "{z}-{x}-{y}.png" to read a
+  // vtkOsmLayer cache directory. Must not be changed while tiles are
+  // being read.
+  vtkSetStringMacro(PathTemplate);
+  vtkGetStringMacro(PathTemplate);
+
+  // Description:
+  // Path of the tile file
+  std::string GetTilePath(int zoom, int x, int y);
+
+  virtual bool FetchTile(int zoom, int x, int y,
+                         std::vector<unsigned char>& data,
+                         long *httpStatus = NULL,
+                         std::string *errorMessage = NULL,
+                         vtkMapTileCacheInfo *cacheInfo = NULL);
+  virtual std::string GetTileUrl(int zoom, int x, int y);
+  virtual bool IsLocal();
+
+protected:
+  vtkDirectoryTileSource();
+  ~vtkDirectoryTileSource();
+
+  char *Directory;
+  char *PathTemplate;
+
+private:
+  vtkDirectoryTileSource(const vtkDirectoryTileSource&);  // Not implemented
+  void operator=(const vtkDirectoryTileSource&); // Not implemented
+};
+
+#endif // __vtkDirectoryTileSource_h
@@ -62,12 +62,8 @@ void vtkGeoJSONMapFeature::Init()
 
   // Convert poly data points from <lon, lat> to <x, y>
   vtkPoints *points = this->PolyData->GetPoints();
-  for (vtkIdType i=0; i<points->GetNumberOfPoints(); i++)
-    {
-    double *coords = points->GetPoint(i);
-    coords[1] = vtkMercator::lat2y(coords[1]);
-    points->SetPoint(i, coords);
-    }
+  vtkMercator::lat2y(points->GetData(), 1);
+  points->Modified();
 
   std::cout << "Points:   " << this->PolyData->GetNumberOfPoints() << "\n"
             << "Vertices: " << this->PolyData->GetNumberOfVerts() << "\n"
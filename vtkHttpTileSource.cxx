@@ -0,0 +1,197 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkHttpTileSource.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkHttpTileSource.h"
+#include "vtkMapTileConcurrencyController.h"
+#include "vtkMapTileFetcher.h"
+
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+
+#include <cstdlib>  // std::abs
+#include <sstream>
+
+vtkStandardNewMacro(vtkHttpTileSource)
+
+//----------------------------------------------------------------------------
+vtkHttpTileSource::vtkHttpTileSource()
+{
+  this->TileFetcher = vtkMapTileFetcher::New();
+  this->UrlTemplate = "http://tile.openstreetmap.org/{z}/{x}/{y}.png";
+  this->Lock = vtkMutexLock::New();
+}
+
+//----------------------------------------------------------------------------
+vtkHttpTileSource::~vtkHttpTileSource()
+{
+  if (this->TileFetcher)
+    {
+    this->TileFetcher->Delete();
+    }
+  this->Lock->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkHttpTileSource::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "UrlTemplate: " << this->GetUrlTemplate() << "\n"
+     << indent << "Subdomains: " << this->GetSubdomains() << "\n"
+     << indent << "TileFetcher: " << this->TileFetcher << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkHttpTileSource::SetUrlTemplate(const std::string& urlTemplate)
+{
+  this->Lock->Lock();
+  bool changed = urlTemplate != this->UrlTemplate;
+  this->UrlTemplate = urlTemplate;
+  this->Lock->Unlock();
+  if (changed)
+    {
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+std::string vtkHttpTileSource::GetUrlTemplate()
+{
+  this->Lock->Lock();
+  std::string urlTemplate = this->UrlTemplate;
+  this->Lock->Unlock();
+  return urlTemplate;
+}
+
+//----------------------------------------------------------------------------
+void vtkHttpTileSource::SetSubdomains(const std::string& subdomains)
+{
+  std::vector<std::string> list;
+  std::stringstream ss(subdomains);
+  std::string subdomain;
+  while (std::getline(ss, subdomain, ','))
+    {
+    if (!subdomain.empty())
+      {
+      list.push_back(subdomain);
+      }
+    }
+
+  this->Lock->Lock();
+  this->Subdomains.swap(list);
+  this->Lock->Unlock();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkHttpTileSource::GetSubdomains()
+{
+  std::string subdomains;
+  this->Lock->Lock();
+  for (std::size_t i = 0; i < this->Subdomains.size(); ++i)
+    {
+    subdomains += (i ? "," : "") + this->Subdomains[i];
+    }
+  this->Lock->Unlock();
+  return subdomains;
+}
+
+//----------------------------------------------------------------------------
+void vtkHttpTileSource::SetTileFetcher(vtkMapTileFetcher *fetcher)
+{
+  if (fetcher == this->TileFetcher)
+    {
+    return;
+    }
+  if (fetcher)
+    {
+    fetcher->Register(this);
+    }
+  if (this->TileFetcher)
+    {
+    this->TileFetcher->UnRegister(this);
+    }
+  this->TileFetcher = fetcher;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkHttpTileSource::FetchTile(int zoom, int x, int y,
+                                  std::vector<unsigned char>& data,
+                                  long *httpStatus, std::string *errorMessage,
+                                  vtkMapTileCacheInfo *cacheInfo)
+{
+  if (!this->TileFetcher)
+    {
+    if (httpStatus)
+      {
+      *httpStatus = 0;
+      }
+    if (errorMessage)
+      {
+      *errorMessage = "no tile fetcher";
+      }
+    return false;
+    }
+  return this->TileFetcher->Fetch(this->GetTileUrl(zoom, x, y), data,
+                                  httpStatus, errorMessage, cacheInfo);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkHttpTileSource::GetTileUrl(int zoom, int x, int y)
+{
+  this->Lock->Lock();
+  std::string url = ExpandTemplate(this->UrlTemplate, zoom, x, y);
+  std::string::size_type pos = url.find("{s}");
+  if (pos != std::string::npos)
+    {
+    // Neighboring tiles, which are requested together, go to
+    // different hosts
+    std::string subdomain;
+    if (!this->Subdomains.empty())
+      {
+      std::size_t count = this->Subdomains.size();
+      subdomain = this->Subdomains[(std::abs(x) + std::abs(y)) % count];
+      }
+    url.replace(pos, 3, subdomain);
+    }
+  this->Lock->Unlock();
+  return url;
+}
+
+//----------------------------------------------------------------------------
+void vtkHttpTileSource::GetHosts(std::vector<std::string>& hosts)
+{
+  this->Lock->Lock();
+  std::string host =
+    vtkMapTileConcurrencyController::GetHost(this->UrlTemplate);
+  std::string::size_type pos = host.find("{s}");
+  if (pos == std::string::npos)
+    {
+    hosts.push_back(host);
+    }
+  else if (this->Subdomains.empty())
+    {
+    hosts.push_back(host.replace(pos, 3, ""));
+    }
+  else
+    {
+    for (std::size_t i = 0; i < this->Subdomains.size(); ++i)
+      {
+      hosts.push_back(std::string(host).replace(pos, 3,
+                                                this->Subdomains[i]));
+      }
+    }
+  this->Lock->Unlock();
+}
@@ -0,0 +1,78 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkHttpTileSource.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkHttpTileSource - map tiles from a tile server
+// .SECTION Description
+// Downloads map tiles through a vtkMapTileFetcher, from URLs made from
+// a template such as "http://{s}.tile.example.org/{z}/{x}/{y}.png".
+// {z}, {x} and {y} are replaced by the tile indices, and {s} by one of
+// the subdomains, chosen from the tile indices, so that requests are
+// spread over several hosts.
+
+#ifndef __vtkHttpTileSource_h
+#define __vtkHttpTileSource_h
+
+#include "vtkTileSource.h"
+
+class vtkMapTileFetcher;
+class vtkMutexLock;
+
+class VTKMAP_EXPORT vtkHttpTileSource : public vtkTileSource
+{
+public:
+  static vtkHttpTileSource *New();
+  vtkTypeMacro(vtkHttpTileSource, vtkTileSource)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Get/Set the URL template. Default is
+  // "http://tile.openstreetmap.org/{z}/{x}/{y}.png".
+  void SetUrlTemplate(const std::string& urlTemplate);
+  std::string GetUrlTemplate();
+
+  // Description:
+  // Get/Set the comma-separated subdomains replacing {s} in the URL
+  // template, such as "a,b,c". Default is none.
+  void SetSubdomains(const std::string& subdomains);
+  std::string GetSubdomains();
+
+  // Description:
+  // Get/Set the fetcher downloading the tiles. A fetcher is created by
+  // default. Must not be changed while tiles are being downloaded.
+  vtkGetObjectMacro(TileFetcher, vtkMapTileFetcher);
+  void SetTileFetcher(vtkMapTileFetcher *fetcher);
+
+  virtual bool FetchTile(int zoom, int x, int y,
+                         std::vector<unsigned char>& data,
+                         long *httpStatus = NULL,
+                         std::string *errorMessage = NULL,
+                         vtkMapTileCacheInfo *cacheInfo = NULL);
+  virtual std::string GetTileUrl(int zoom, int x, int y);
+  virtual void GetHosts(std::vector<std::string>& hosts);
+
+protected:
+  vtkHttpTileSource();
+  ~vtkHttpTileSource();
+
+  vtkMapTileFetcher *TileFetcher;
+  std::string UrlTemplate;
+  std::vector<std::string> Subdomains;
+  vtkMutexLock *Lock;
+
+private:
+  vtkHttpTileSource(const vtkHttpTileSource&);  // Not implemented
+  void operator=(const vtkHttpTileSource&); // Not implemented
+};
+
+#endif // __vtkHttpTileSource_h
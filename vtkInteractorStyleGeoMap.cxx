@@ -35,6 +35,7 @@
 #include <vtkRenderer.h>
 #include <vtkRenderWindow.h>
 #include <vtkRenderWindowInteractor.h>
+#include <vtkTimerLog.h>
 
 #include <algorithm>  // std::copy, std::max, std::min
 
@@ -53,6 +54,7 @@ vtkInteractorStyleGeoMap::vtkInteractorStyleGeoMap() :
   this->RubberBandSelectionWithCtrlKey = 0;
   this->RubberBandActor = 0;
   this->RubberBandPoints = 0;
+  this->LastPanTime = 0.0;
 
   // Default rubber band colors (RGBA)
   double violet[] = {1.0, 0.6, 1.0, 0.2};
@@ -88,6 +90,13 @@ void vtkInteractorStyleGeoMap::OnLeftButtonDown()
     vtkDebugMacro("StartPan()");
     this->Interaction = PANNING;
     this->StartPan();
+
+    // Camera is at rest until the first mouse move
+    this->LastPanTime = 0.0;
+    if (this->Map)
+      {
+      this->Map->SetCameraVelocity(0.0, 0.0);
+      }
     }
 
   // fall back to built-in rubberband drawing if no renderer was given
@@ -183,6 +192,13 @@ void vtkInteractorStyleGeoMap::OnLeftButtonUp()
   this->EndPan();
   this->Interaction = NONE;
 
+  // If the mouse was held still before release, the camera is at rest
+  if (this->Map && this->LastPanTime > 0.0 &&
+      vtkTimerLog::GetUniversalTime() - this->LastPanTime > 0.1)
+    {
+    this->Map->SetCameraVelocity(0.0, 0.0);
+    }
+
   if (this->RubberBandMode == vtkInteractorStyleGeoMap::DisabledMode)
     {
     this->Interactor->GetRenderWindow()->SetCurrentCursor(VTK_CURSOR_DEFAULT);
@@ -427,6 +443,10 @@ void vtkInteractorStyleGeoMap::OnMouseWheelForward()
       nextCameraCoords[2] = 0.0;
       camera->SetFocalPoint(nextCameraCoords);
 
+      // Hint for tile prefetching
+      this->Map->SetCameraVelocity(0.0, 0.0);
+      this->Map->SetZoomDirection(1);
+
       // Redraw the map
       this->Map->Draw();
       }
@@ -498,6 +518,10 @@ void vtkInteractorStyleGeoMap::OnMouseWheelBackward()
       nextCameraCoords[2] = 0.0;
       camera->SetFocalPoint(nextCameraCoords);
 
+      // Hint for tile prefetching
+      this->Map->SetCameraVelocity(0.0, 0.0);
+      this->Map->SetZoomDirection(-1);
+
       // Redraw the map
       this->Map->Draw();
       }
@@ -569,6 +593,20 @@ void vtkInteractorStyleGeoMap::Pan()
                       motionVector[1] + viewPoint[1],
                       motionVector[2] + viewPoint[2]);
 
+  // Track camera velocity, smoothed over mouse events, so that
+  // tile layers can prefetch in the direction of motion
+  double now = vtkTimerLog::GetUniversalTime();
+  if (this->LastPanTime > 0.0 && now - this->LastPanTime < 0.5)
+    {
+    double dt = std::max(now - this->LastPanTime, 0.01);
+    double *velocity = this->Map->GetCameraVelocity();
+    this->Map->SetCameraVelocity(
+      0.5 * velocity[0] + 0.5 * motionVector[0] / dt,
+      0.5 * velocity[1] + 0.5 * motionVector[1] / dt);
+    }
+  this->LastPanTime = now;
+  this->Map->SetZoomDirection(0);
+
   this->Map->Draw();
 }
 
@@ -128,6 +128,9 @@ private:
 
   vtkActor2D* RubberBandActor;
   vtkPoints*  RubberBandPoints;
+
+  // Time of the last pan step, for computing camera velocity
+  double LastPanTime;
 };
 
 #endif // __vtkInteractorStyleGeoMap_h
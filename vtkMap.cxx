@@ -91,6 +91,8 @@ vtkMap::vtkMap()
   interactorGeoMap->SetMap(this);
   this->PerspectiveProjection = false;
   this->Zoom = 1;
+  this->CameraVelocity[0] = this->CameraVelocity[1] = 0.0;
+  this->ZoomDirection = 0;
   this->Center[0] = this->Center[1] = 0.0;
   this->Initialized = false;
   this->BaseLayer = NULL;
@@ -85,6 +85,16 @@ public:
   vtkGetMacro(Zoom, int)
   vtkSetMacro(Zoom, int)
 
+  // Description:
+  // Get/Set the camera motion hints used by tile layers to prefetch
+  // tiles: the pan velocity, in world units per second, and the
+  // direction of the last zoom change (+1 in, -1 out, 0 none).
+  // Set by vtkInteractorStyleGeoMap while the user navigates.
+  vtkGetVector2Macro(CameraVelocity, double)
+  vtkSetVector2Macro(CameraVelocity, double)
+  vtkGetMacro(ZoomDirection, int)
+  vtkSetClampMacro(ZoomDirection, int, -1, 1)
+
   // Description:
   // Get/Set center of the map.
   void GetCenter(double (&latlngPoint)[2]);
@@ -186,6 +196,11 @@ protected:
   // Set Zoom level, which determines the level of detailing
   int Zoom;
 
+  // Description:
+  // Camera motion hints for tile prefetching
+  double CameraVelocity[2];
+  int ZoomDirection;
+
   // Description:
   // Center of the map
   double Center[2];
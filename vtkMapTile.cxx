@@ -13,23 +13,21 @@
 =========================================================================*/
 
 #include "vtkMapTile.h"
+#include "vtkMapTileFetcher.h"
 #include "vtkOsmLayer.h"
+#include "vtkPackedTileStore.h"
 
 // VTK Includes
 #include <vtkActor.h>
+#include <vtkImageData.h>
 #include <vtkJPEGReader.h>
 #include <vtkObjectFactory.h>
-#include <vtkPlaneSource.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkPNGReader.h>
-#include <vtkProperty.h>
 #include <vtkTexture.h>
-#include <vtkTextureMapToPlane.h>
 #include <vtkNew.h>
 #include <vtksys/SystemTools.hxx>
 
-#include <curl/curl.h>
-
 #include <cstdio>  // for remove()
 #include <sstream>
 #include <fstream>
@@ -39,92 +37,221 @@ vtkStandardNewMacro(vtkMapTile)
 //----------------------------------------------------------------------------
 vtkMapTile::vtkMapTile()
 {
-  Plane = 0;
-  TexturePlane = 0;
-  Actor = 0;
-  Mapper = 0;
+  this->ActorPool = NULL;
+  this->Actor = NULL;
+  this->Mapper = NULL;
   this->Bin = Hidden;
   this->VisibleFlag = false;
   this->Corners[0] = this->Corners[1] =
   this->Corners[2] = this->Corners[3] = 0.0;
+  this->TextureRange[0] = this->TextureRange[2] = 0.0;
+  this->TextureRange[1] = this->TextureRange[3] = 1.0;
+  this->ZoomXY[0] = this->ZoomXY[1] = this->ZoomXY[2] = 0;
+  this->LastAccess = 0;
+  this->MemorySize = 0;
+  this->Prefetched = false;
+  this->Image = NULL;
 }
 
 //----------------------------------------------------------------------------
 vtkMapTile::~vtkMapTile()
 {
-  if (Plane)
+  if (this->Actor)
     {
-    Plane->Delete();
+    this->ActorPool->ReleaseActor(this->Actor);
     }
+  this->SetActorPool(NULL);
+  this->SetImage(NULL);
+}
 
-  if (TexturePlane)
+//----------------------------------------------------------------------------
+bool vtkMapTile::Decode()
+{
+  if (this->Image)
     {
-    TexturePlane->Delete();
+    return true;
     }
 
-  if (Actor)
+  // Read the image which will be the texture
+  vtkImageReader2 *imageReader = NULL;
+  if (!this->ImageBuffer.empty())
     {
-    Actor->Delete();
+    // Decode from memory, picking the reader from the magic bytes
+    if (this->ImageBuffer[0] == 0x89)
+      {
+      imageReader = vtkPNGReader::New();
+      }
+    else
+      {
+      imageReader = vtkJPEGReader::New();
+      }
+    imageReader->SetMemoryBuffer(&this->ImageBuffer[0]);
+    imageReader->SetMemoryBufferLength(
+      static_cast<vtkIdType>(this->ImageBuffer.size()));
+    }
+  else
+    {
+    if (!this->InitializeDownload())
+      {
+      return false;
+      }
+
+    std::string fileExtension =
+      vtksys::SystemTools::GetFilenameLastExtension(this->ImageFile);
+    if (fileExtension == ".png")
+      {
+      vtkPNGReader *pngReader = vtkPNGReader::New();
+      imageReader = pngReader;
+      }
+    else if (fileExtension == ".jpg")
+      {
+      vtkJPEGReader *jpgReader = vtkJPEGReader::New();
+      imageReader = jpgReader;
+      }
+    else
+      {
+      vtkErrorMacro("Unsupported map-tile extension " << fileExtension);
+      return false;
+      }
+    imageReader->SetFileName (this->ImageFile.c_str());
     }
+  imageReader->Update();
 
-  if (Mapper)
+  // Detach the decoded image from the reader, so the texture never
+  // re-executes it (the memory buffer is released below)
+  vtkImageData *image = vtkImageData::New();
+  image->ShallowCopy(imageReader->GetOutput());
+  imageReader->Delete();
+  int *dims = image->GetDimensions();
+  bool decoded = dims[0] > 0 && dims[1] > 0;
+  if (decoded)
     {
-    Mapper->Delete();
+    this->SetImage(image);
+    std::vector<unsigned char>().swap(this->ImageBuffer);
     }
+  image->Delete();
+  return decoded;
 }
 
 //----------------------------------------------------------------------------
-void vtkMapTile::Build()
+void vtkMapTile::SetImage(vtkImageData *image)
 {
-  this->Plane = vtkPlaneSource::New();
-  this->Plane->SetPoint1(this->Corners[2], this->Corners[1], 0.0);
-  this->Plane->SetPoint2(this->Corners[0], this->Corners[3], 0.0);
-  this->Plane->SetOrigin(this->Corners[0], this->Corners[1], 0.0);
-  this->Plane->SetNormal(0, 0, 1);
-
-  this->TexturePlane = vtkTextureMapToPlane::New();
-  this->InitializeDownload();
-
-  // Read the image which will be the texture
-  vtkImageReader2 *imageReader = NULL;
-  std::string fileExtension =
-    vtksys::SystemTools::GetFilenameLastExtension(this->ImageFile);
-  if (fileExtension == ".png")
+  if (image == this->Image)
     {
-    vtkPNGReader *pngReader = vtkPNGReader::New();
-    imageReader = pngReader;
+    return;
     }
-  else if (fileExtension == ".jpg")
+  if (image)
     {
-    vtkJPEGReader *jpgReader = vtkJPEGReader::New();
-    imageReader = jpgReader;
+    image->Register(this);
     }
-  else
+  if (this->Image)
+    {
+    this->Image->UnRegister(this);
+    }
+  this->Image = image;
+  this->MemorySize = 0;
+  if (image)
+    {
+    // Estimate memory held by the tile: the decoded image (reported in
+    // KiB) plus the 32-bit texture created from it
+    int *dims = image->GetDimensions();
+    this->MemorySize =
+      static_cast<vtkTypeInt64>(image->GetActualMemorySize()) * 1024 +
+      static_cast<vtkTypeInt64>(dims[0]) * dims[1] * 4;
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTile::Build()
+{
+  // Decode unless already done, possibly in a background thread
+  this->Decode();
+  if (!this->Image)
     {
-    vtkErrorMacro("Unsupported map-tile extension " << fileExtension);
     return;
     }
-  imageReader->SetFileName (this->ImageFile.c_str());
-  imageReader->Update();
 
-  // Apply the texture
+  // Apply the texture, which uses the decoded image as is. The tile
+  // keeps the image, at no cost, for the layer to keep it in memory
+  // once the texture is released.
   vtkNew<vtkTexture> texture;
-  texture->SetInputConnection(imageReader->GetOutputPort());
+  texture->SetInputData(this->Image);
   texture->SetQualityTo32Bit();
   texture->SetInterpolate(1);
-  this->TexturePlane->SetInputConnection(Plane->GetOutputPort());
-
-  this->Mapper = vtkPolyDataMapper::New();
-  this->Mapper->SetInputConnection(this->TexturePlane->GetOutputPort());
 
-  this->Actor = vtkActor::New();
-  this->Actor->SetMapper(Mapper);
+  this->BuildGeometry();
   this->Actor->SetTexture(texture.GetPointer());
-  this->Actor->PickableOff();
-  this->Actor->GetProperty()->SetLighting(false);
 
   this->BuildTime.Modified();
-  imageReader->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTile::BuildGeometry()
+{
+  if (!this->ActorPool)
+    {
+    vtkMapTileActorPool *pool = vtkMapTileActorPool::New();
+    this->SetActorPool(pool);
+    pool->Delete();
+    }
+
+  // Rebuilding gives the actor back first, it is picked up again below
+  if (this->Actor)
+    {
+    this->ActorPool->ReleaseActor(this->Actor);
+    }
+  this->Actor = this->ActorPool->AcquireActor(this->Corners);
+  this->Mapper = vtkPolyDataMapper::SafeDownCast(this->Actor->GetMapper());
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTile::InitFromAncestor(vtkMapTile *ancestor)
+{
+  // Texture coordinates of this tile's corners within the ancestor.
+  // Tile corners are linear in the projected coordinates, so the
+  // cropped texture lines up with the ancestor's.
+  double *outer = ancestor->GetCorners();
+  double width = outer[2] - outer[0];
+  double height = outer[3] - outer[1];
+
+  double sRange[2] =
+    {
+    (this->Corners[0] - outer[0]) / width,
+    (this->Corners[2] - outer[0]) / width
+    };
+  double tRange[2] =
+    {
+    (this->Corners[1] - outer[1]) / height,
+    (this->Corners[3] - outer[1]) / height
+    };
+
+  this->TextureRange[0] = sRange[0];
+  this->TextureRange[1] = sRange[1];
+  this->TextureRange[2] = tRange[0];
+  this->TextureRange[3] = tRange[1];
+
+  this->BuildGeometry();
+  this->ActorPool->SetTextureRange(this->Actor, sRange, tRange);
+  this->Actor->SetTexture(ancestor->GetActor()->GetTexture());
+
+  // The texture is shared with the ancestor
+  this->MemorySize = 0;
+  this->BuildTime.Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTile::InitPlaceholder(vtkTexture *texture)
+{
+  this->TextureRange[0] = this->TextureRange[2] = 0.0;
+  this->TextureRange[1] = this->TextureRange[3] = 1.0;
+
+  this->BuildGeometry();
+  this->Actor->SetTexture(texture);
+
+  // The texture is shared with the other placeholders
+  this->MemorySize = 0;
+  this->BuildTime.Modified();
 }
 
 //----------------------------------------------------------------------------
@@ -152,17 +279,19 @@ bool vtkMapTile::IsVisible()
 }
 
 //----------------------------------------------------------------------------
-void vtkMapTile::InitializeDownload()
+bool vtkMapTile::InitializeDownload()
 {
   // Check if image file already exists.
-  // If not, download
-  while(!this->IsImageDownloaded(this->ImageFile.c_str()))
+  // If not, download it once. Retrying failed downloads is up to the
+  // layer, which backs off from failing tiles and servers.
+  if (!this->IsImageDownloaded(this->ImageFile.c_str()))
     {
     std::cerr << "Downloading " << this->ImageSource.c_str()
               << " to " << this->ImageFile
               << std::endl;
     this->DownloadImage(this->ImageSource.c_str(), this->ImageFile.c_str());
     }
+  return this->IsImageDownloaded(this->ImageFile.c_str());
 }
 
 //----------------------------------------------------------------------------
@@ -187,38 +316,35 @@ bool vtkMapTile::IsImageDownloaded(const char *outfile)
 //----------------------------------------------------------------------------
 void vtkMapTile::DownloadImage(const char *url, const char *outfilename)
 {
-  // Download file from url and store in outfilename
-  // Uses libcurl
-  CURL* curl;
-  FILE* fp;
-  CURLcode res;
-  char errorBuffer[CURL_ERROR_SIZE];
-  curl = curl_easy_init();
-
-  if(curl)
+  // Download file from url and store in outfilename, through the
+  // layer's fetcher, which reuses connections
+  vtkOsmLayer *osmLayer = vtkOsmLayer::SafeDownCast(this->Layer);
+  vtkMapTileFetcher *fetcher =
+    osmLayer ? osmLayer->GetTileFetcher() : vtkMapTileFetcher::New();
+
+  std::vector<unsigned char> data;
+  std::string message;
+  if (fetcher->Fetch(url, data, NULL, &message))
     {
-    fp = fopen(outfilename, "wb");
-    if(!fp)
+    if (data.empty() ||
+        !vtkPackedTileStore::IsCompleteImage(&data[0], data.size()))
       {
-      vtkErrorMacro( << "Not Open")
-      return;
+      vtkWarningMacro(<< "Download " << url << " is not a complete image");
       }
-
-    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errorBuffer);
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
-    res = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
-    fclose(fp);
-
-    //if curl failed remove the file
-    if (res != CURLE_OK)
+    else if (!vtkOsmLayer::WriteTileFile(outfilename, data))
       {
-      remove(outfilename);
-      vtkWarningMacro(<<errorBuffer);
+      vtkWarningMacro(<< "Cannot write " << outfilename);
       }
     }
+  else
+    {
+    vtkWarningMacro(<< "Download " << url << " failed: " << message);
+    }
+
+  if (!osmLayer)
+    {
+    fetcher->Delete();
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -248,6 +374,10 @@ void vtkMapTile::CleanUp()
 //----------------------------------------------------------------------------
 void vtkMapTile::Update()
 {
-  this->Actor->SetVisibility(this->IsVisible());
+  // Tiles get their actor from the pool when built
+  if (this->Actor)
+    {
+    this->Actor->SetVisibility(this->IsVisible());
+    }
   this->UpdateTime.Modified();
 }
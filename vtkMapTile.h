@@ -19,13 +19,17 @@
 #define __vtkMapTile_h
 
 #include "vtkFeature.h"
+#include "vtkMapTileActorPool.h"
 #include "vtkmap_export.h"
 
+#include <string>
+#include <vector>
+
 class vtkStdString;
-class vtkPlaneSource;
 class vtkActor;
+class vtkImageData;
 class vtkPolyDataMapper;
-class vtkTextureMapToPlane;
+class vtkTexture;
 
 class VTKMAP_EXPORT vtkMapTile : public vtkFeature
 {
@@ -41,6 +45,15 @@ public:
     this->ImageFile = path;
     }
 
+  // Description:
+  // Set encoded (png/jpg) image bytes to decode from memory instead of
+  // reading the file system path. The buffer contents are swapped into
+  // the tile and released once the tile is built.
+  void SetImageBuffer(std::vector<unsigned char>& buffer)
+    {
+    this->ImageBuffer.swap(buffer);
+    }
+
   void  SetImageSource(const std::string& imgSrc) {this->ImageSource= imgSrc;}
   std::string GetImageSource() {return this->ImageSource;}
 
@@ -49,13 +62,47 @@ public:
   vtkGetVector4Macro(Corners, double);
   vtkSetVector4Macro(Corners, double);
 
+  // Description:
+  // Part of the texture image drawn on the tile:
+  // [sMin, sMax, tMin, tMax]. The whole image unless the tile was
+  // initialized from an ancestor.
+  vtkGetVector4Macro(TextureRange, double);
+
   // Description:
   // Get/Set bin of the tile
   vtkGetMacro(Bin, int);
   vtkSetMacro(Bin, int);
 
   // Description:
-  vtkGetMacro(Plane, vtkPlaneSource*)
+  // Get/Set the (zoom, x, y) key under which the layer caches the tile
+  vtkGetVector3Macro(ZoomXY, int);
+  vtkSetVector3Macro(ZoomXY, int);
+
+  // Description:
+  // Get/Set the layer's access stamp from the last time the tile
+  // was part of the view. Used for least-recently-used eviction.
+  vtkGetMacro(LastAccess, unsigned long);
+  vtkSetMacro(LastAccess, unsigned long);
+
+  // Description:
+  // Estimated memory, in bytes, held by the tile once built
+  // (decoded image plus 32-bit texture)
+  vtkGetMacro(MemorySize, vtkTypeInt64);
+
+  // Description:
+  // Get/Set whether the tile was prefetched and has not been
+  // in view since. Used for prefetch hit-rate statistics.
+  vtkGetMacro(Prefetched, bool);
+  vtkSetMacro(Prefetched, bool);
+
+  // Description:
+  // Get/Set the pool that provides the tile's geometry and actor.
+  // Tiles of a layer share the layer's pool. If not set, the tile
+  // creates a pool of its own when built.
+  vtkSetObjectMacro(ActorPool, vtkMapTileActorPool);
+  vtkGetObjectMacro(ActorPool, vtkMapTileActorPool);
+
+  // Description:
   vtkGetMacro(Actor, vtkActor*)
   vtkGetMacro(Mapper, vtkPolyDataMapper*)
 
@@ -72,6 +119,34 @@ public:
   // the image if necessary
   virtual void Init();
 
+  // Description:
+  // Read and decode the image, from the image buffer or from the file
+  // system path (downloading it if necessary), without touching any
+  // rendering objects. Safe to call from a background thread before the
+  // tile is handed to the layer; Init() then only creates the texture
+  // and the geometry. Returns false, leaving no image, if the image
+  // could not be decoded.
+  bool Decode();
+
+  // Description:
+  // Get/Set the decoded image, e.g. one shared with the tiles of other
+  // layers, which is then not decoded again. The tile holds the image
+  // from Decode() or SetImage(), and its texture uses the image as is.
+  void SetImage(vtkImageData *image);
+  vtkGetObjectMacro(Image, vtkImageData);
+
+  // Description:
+  // Create the geometry, textured with the part of an already built,
+  // lower-zoom tile that covers this tile's corners. Used to stand in
+  // for the tile while its image loads.
+  void InitFromAncestor(vtkMapTile *ancestor);
+
+  // Description:
+  // Create the geometry, textured with the given placeholder texture,
+  // which the tile shares. Used to stand in for a tile that failed to
+  // load.
+  void InitPlaceholder(vtkTexture *texture);
+
   // Description:
   // Remove drawables from the renderer and
   // perform any other clean up operations
@@ -90,6 +165,10 @@ protected:
   // Construct the textured geometry for the tile
   void Build();
 
+  // Description:
+  // Get the untextured actor, placed at the tile's corners, from the pool
+  void BuildGeometry();
+
   // Description:
   // Check if the corresponding image is downloaded
   bool IsImageDownloaded(const char* outfile);
@@ -100,21 +179,31 @@ protected:
 
   // Description:
   // Download the texture (image) if not already downloaded.
-  void InitializeDownload();
+  // Returns false if the image file is still missing.
+  bool InitializeDownload();
 
   // Description:
   // Storing the remote and local paths
   std::string ImageSource;
   std::string ImageFile;
+  std::vector<unsigned char> ImageBuffer;
+
+  // Description:
+  // Decoded image, from Decode() or SetImage(), shared with the texture
+  vtkImageData* Image;
 
-  vtkPlaneSource* Plane;
-  vtkTextureMapToPlane* TexturePlane;
+  vtkMapTileActorPool* ActorPool;
   vtkActor* Actor;
   vtkPolyDataMapper* Mapper;
 
   int Bin;
   bool VisibleFlag;
   double Corners[4];
+  double TextureRange[4];
+  int ZoomXY[3];
+  unsigned long LastAccess;
+  vtkTypeInt64 MemorySize;
+  bool Prefetched;
 
 private:
   vtkMapTile(const vtkMapTile&);  // Not implemented
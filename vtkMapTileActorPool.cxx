@@ -0,0 +1,172 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileActorPool.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileActorPool.h"
+
+#include <vtkActor.h>
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkProperty.h>
+
+vtkStandardNewMacro(vtkMapTileActorPool)
+
+//----------------------------------------------------------------------------
+vtkMapTileActorPool::vtkMapTileActorPool()
+{
+  this->MaxNumberOfPooledActors = 256;
+  this->NumberOfCreatedActors = 0;
+  this->NumberOfReusedActors = 0;
+
+  // Counterclockwise from the origin; texture coordinates equal the
+  // point coordinates, as vtkTextureMapToPlane generated them
+  vtkNew<vtkPoints> points;
+  points->SetNumberOfPoints(4);
+  points->SetPoint(0, 0.0, 0.0, 0.0);
+  points->SetPoint(1, 1.0, 0.0, 0.0);
+  points->SetPoint(2, 1.0, 1.0, 0.0);
+  points->SetPoint(3, 0.0, 1.0, 0.0);
+
+  vtkNew<vtkFloatArray> tcoords;
+  tcoords->SetName("TextureCoordinates");
+  tcoords->SetNumberOfComponents(2);
+  tcoords->SetNumberOfTuples(4);
+  tcoords->SetTuple2(0, 0.0, 0.0);
+  tcoords->SetTuple2(1, 1.0, 0.0);
+  tcoords->SetTuple2(2, 1.0, 1.0);
+  tcoords->SetTuple2(3, 0.0, 1.0);
+
+  vtkIdType ids[4] = { 0, 1, 2, 3 };
+  vtkNew<vtkCellArray> polys;
+  polys->InsertNextCell(4, ids);
+
+  this->UnitQuad = vtkPolyData::New();
+  this->UnitQuad->SetPoints(points.GetPointer());
+  this->UnitQuad->SetPolys(polys.GetPointer());
+  this->UnitQuad->GetPointData()->SetTCoords(tcoords.GetPointer());
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileActorPool::~vtkMapTileActorPool()
+{
+  std::vector<vtkActor*>::iterator iter = this->PooledActors.begin();
+  for (; iter != this->PooledActors.end(); iter++)
+    {
+    (*iter)->Delete();
+    }
+  this->UnitQuad->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileActorPool::PrintSelf(ostream &os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "MaxNumberOfPooledActors: "
+     << this->MaxNumberOfPooledActors << "\n"
+     << indent << "NumberOfPooledActors: "
+     << this->PooledActors.size() << "\n"
+     << indent << "NumberOfCreatedActors: "
+     << this->NumberOfCreatedActors << "\n"
+     << indent << "NumberOfReusedActors: "
+     << this->NumberOfReusedActors << std::endl;
+}
+
+//----------------------------------------------------------------------------
+vtkActor *vtkMapTileActorPool::AcquireActor(const double corners[4])
+{
+  vtkActor *actor = NULL;
+  if (!this->PooledActors.empty())
+    {
+    actor = this->PooledActors.back();
+    this->PooledActors.pop_back();
+    ++this->NumberOfReusedActors;
+    }
+  else
+    {
+    vtkPolyDataMapper *mapper = vtkPolyDataMapper::New();
+    mapper->SetInputData(this->UnitQuad);
+    actor = vtkActor::New();
+    actor->SetMapper(mapper);
+    actor->PickableOff();
+    actor->GetProperty()->SetLighting(false);
+    mapper->Delete();
+    ++this->NumberOfCreatedActors;
+    }
+
+  actor->SetPosition(corners[0], corners[1], 0.0);
+  actor->SetScale(corners[2] - corners[0], corners[3] - corners[1], 1.0);
+  return actor;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileActorPool::SetTextureRange(vtkActor *actor,
+                                          const double sRange[2],
+                                          const double tRange[2])
+{
+  // Share the points and cell with the unit square, only the
+  // texture coordinates differ
+  vtkNew<vtkFloatArray> tcoords;
+  tcoords->SetName("TextureCoordinates");
+  tcoords->SetNumberOfComponents(2);
+  tcoords->SetNumberOfTuples(4);
+  tcoords->SetTuple2(0, sRange[0], tRange[0]);
+  tcoords->SetTuple2(1, sRange[1], tRange[0]);
+  tcoords->SetTuple2(2, sRange[1], tRange[1]);
+  tcoords->SetTuple2(3, sRange[0], tRange[1]);
+
+  vtkNew<vtkPolyData> quad;
+  quad->SetPoints(this->UnitQuad->GetPoints());
+  quad->SetPolys(this->UnitQuad->GetPolys());
+  quad->GetPointData()->SetTCoords(tcoords.GetPointer());
+
+  vtkPolyDataMapper::SafeDownCast(actor->GetMapper())->SetInputData(
+    quad.GetPointer());
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileActorPool::ReleaseActor(vtkActor *actor)
+{
+  if (!actor)
+    {
+    return;
+    }
+  if (static_cast<int>(this->PooledActors.size()) >=
+      this->MaxNumberOfPooledActors)
+    {
+    actor->Delete();
+    return;
+    }
+
+  actor->SetTexture(NULL);
+  actor->SetVisibility(1);
+  vtkPolyDataMapper *mapper =
+    vtkPolyDataMapper::SafeDownCast(actor->GetMapper());
+  if (mapper->GetInput() != this->UnitQuad)
+    {
+    mapper->SetInputData(this->UnitQuad);
+    }
+  this->PooledActors.push_back(actor);
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileActorPool::GetNumberOfPooledActors()
+{
+  return static_cast<int>(this->PooledActors.size());
+}
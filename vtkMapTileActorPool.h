@@ -0,0 +1,100 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileActorPool.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileActorPool - shared geometry and reusable actors for tiles
+// .SECTION Description
+// Holds one unit-square polydata, with texture coordinates, that all
+// map tiles of a layer draw. Each tile's actor places the square at the
+// tile's corners with its position and scale, so no per-tile geometry
+// or pipeline update is needed.
+//
+// Actors, each with its own vtkPolyDataMapper, are handed out by
+// AcquireActor() and returned by ReleaseActor() when a tile is deleted,
+// to be reused by the next tile. Returned actors keep their mapper's
+// graphics resources; textures are not kept.
+//
+// Only use from the thread that renders.
+
+#ifndef __vtkMapTileActorPool_h
+#define __vtkMapTileActorPool_h
+
+#include "vtkmap_export.h"
+#include <vtkObject.h>
+
+#include <vector>
+
+class vtkActor;
+class vtkPolyData;
+
+class VTKMAP_EXPORT vtkMapTileActorPool : public vtkObject
+{
+public:
+  static vtkMapTileActorPool *New();
+  vtkTypeMacro(vtkMapTileActorPool, vtkObject)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Get/Set the maximum number of unused actors kept for reuse.
+  // Default is 256.
+  vtkSetClampMacro(MaxNumberOfPooledActors, int, 0, VTK_INT_MAX);
+  vtkGetMacro(MaxNumberOfPooledActors, int);
+
+  // Description:
+  // Get an untextured, non-pickable, unlit actor drawing the unit
+  // square, placed at the given corners (lower left, upper right).
+  // The caller owns the returned reference, and gives it back with
+  // ReleaseActor().
+  vtkActor *AcquireActor(const double corners[4]);
+
+  // Description:
+  // Set the actor to draw the part [s0, s1] x [t0, t1] of its texture,
+  // instead of the whole texture
+  void SetTextureRange(vtkActor *actor, const double sRange[2],
+                       const double tRange[2]);
+
+  // Description:
+  // Return an actor obtained from AcquireActor(). Its texture is
+  // removed, and it is kept for reuse or deleted.
+  void ReleaseActor(vtkActor *actor);
+
+  // Description:
+  // Unit square in the xy plane, with texture coordinates
+  vtkGetObjectMacro(UnitQuad, vtkPolyData);
+
+  // Description:
+  // Number of actors currently kept for reuse
+  int GetNumberOfPooledActors();
+
+  // Description:
+  // Number of actors created, and number of actors reused,
+  // by AcquireActor()
+  vtkGetMacro(NumberOfCreatedActors, vtkTypeInt64);
+  vtkGetMacro(NumberOfReusedActors, vtkTypeInt64);
+
+protected:
+  vtkMapTileActorPool();
+  ~vtkMapTileActorPool();
+
+  vtkPolyData *UnitQuad;
+  std::vector<vtkActor*> PooledActors;
+  int MaxNumberOfPooledActors;
+  vtkTypeInt64 NumberOfCreatedActors;
+  vtkTypeInt64 NumberOfReusedActors;
+
+private:
+  vtkMapTileActorPool(const vtkMapTileActorPool&);  // Not implemented
+  void operator=(const vtkMapTileActorPool&); // Not implemented
+};
+
+#endif // __vtkMapTileActorPool_h
@@ -0,0 +1,371 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileAtlas.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileAtlas.h"
+#include "vtkMapTile.h"
+
+#include <vtkActor.h>
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkProperty.h>
+#include <vtkSmartPointer.h>
+#include <vtkTexture.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+vtkStandardNewMacro(vtkMapTileAtlas)
+
+//----------------------------------------------------------------------------
+class vtkMapTileAtlas::vtkMapTileAtlasInternals
+{
+public:
+  vtkImageData *Image;
+  vtkTexture *Texture;
+  vtkPolyData *PolyData;
+  vtkPolyDataMapper *Mapper;
+
+  int SlotSize[2];
+  int Columns;
+  int Rows;
+
+  // Image held by each slot, NULL if the slot is free.
+  // Holding a reference keeps the image's address from being reused.
+  std::vector<vtkSmartPointer<vtkImageData> > Slots;
+  std::map<vtkImageData*, int> SlotIndex;
+};
+
+namespace
+{
+  //--------------------------------------------------------------------------
+  // The texture image drawn by a tile, or NULL if it has none
+  vtkImageData *GetTileImage(vtkMapTile *tile)
+  {
+    if (!tile->GetActor() || !tile->GetActor()->GetTexture())
+      {
+      return NULL;
+      }
+    return tile->GetActor()->GetTexture()->GetInput();
+  }
+
+  //--------------------------------------------------------------------------
+  int NextPowerOfTwo(int n)
+  {
+    int power = 1;
+    while (power < n)
+      {
+      power *= 2;
+      }
+    return power;
+  }
+
+  //--------------------------------------------------------------------------
+  // Copy an 8-bit gray, gray-alpha, RGB or RGBA image into the RGBA
+  // atlas, with its lower left corner at (x0, y0)
+  void CopyImage(vtkImageData *image, vtkImageData *atlas, int x0, int y0)
+  {
+    int *dims = image->GetDimensions();
+    int components = image->GetNumberOfScalarComponents();
+    int atlasWidth = atlas->GetDimensions()[0];
+    const unsigned char *source =
+      static_cast<const unsigned char*>(image->GetScalarPointer());
+    unsigned char *atlasPixels =
+      static_cast<unsigned char*>(atlas->GetScalarPointer());
+
+    for (int j = 0; j < dims[1]; ++j)
+      {
+      unsigned char *target =
+        atlasPixels + (static_cast<std::size_t>(y0 + j) * atlasWidth + x0) * 4;
+      if (components == 4)
+        {
+        memcpy(target, source, static_cast<std::size_t>(dims[0]) * 4);
+        source += dims[0] * 4;
+        continue;
+        }
+      for (int i = 0; i < dims[0]; ++i, source += components, target += 4)
+        {
+        switch (components)
+          {
+          case 1:
+            target[0] = target[1] = target[2] = source[0];
+            target[3] = 255;
+            break;
+          case 2:
+            target[0] = target[1] = target[2] = source[0];
+            target[3] = source[1];
+            break;
+          default:
+            target[0] = source[0];
+            target[1] = source[1];
+            target[2] = source[2];
+            target[3] = 255;
+            break;
+          }
+        }
+      }
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileAtlas::vtkMapTileAtlas()
+{
+  this->MaxSize = 4096;
+  this->NumberOfCopiedImages = 0;
+
+  this->Internals = new vtkMapTileAtlasInternals;
+  this->Internals->SlotSize[0] = this->Internals->SlotSize[1] = 0;
+  this->Internals->Columns = this->Internals->Rows = 0;
+
+  this->Internals->Image = vtkImageData::New();
+  this->Internals->Texture = vtkTexture::New();
+  this->Internals->Texture->SetInputData(this->Internals->Image);
+  this->Internals->Texture->SetQualityTo32Bit();
+  this->Internals->Texture->SetInterpolate(1);
+
+  this->Internals->PolyData = vtkPolyData::New();
+  this->Internals->Mapper = vtkPolyDataMapper::New();
+  this->Internals->Mapper->SetInputData(this->Internals->PolyData);
+
+  this->Actor = vtkActor::New();
+  this->Actor->SetMapper(this->Internals->Mapper);
+  this->Actor->SetTexture(this->Internals->Texture);
+  this->Actor->PickableOff();
+  this->Actor->GetProperty()->SetLighting(false);
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileAtlas::~vtkMapTileAtlas()
+{
+  this->Actor->Delete();
+  this->Internals->Mapper->Delete();
+  this->Internals->PolyData->Delete();
+  this->Internals->Texture->Delete();
+  this->Internals->Image->Delete();
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileAtlas::PrintSelf(ostream &os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "MaxSize: " << this->MaxSize << "\n"
+     << indent << "SlotSize: " << this->Internals->SlotSize[0] << " x "
+     << this->Internals->SlotSize[1] << "\n"
+     << indent << "NumberOfSlots: " << this->GetNumberOfSlots() << "\n"
+     << indent << "NumberOfUsedSlots: " << this->GetNumberOfUsedSlots() << "\n"
+     << indent << "NumberOfCopiedImages: " << this->NumberOfCopiedImages
+     << std::endl;
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileAtlas::GetNumberOfSlots()
+{
+  return static_cast<int>(this->Internals->Slots.size());
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileAtlas::GetNumberOfUsedSlots()
+{
+  return static_cast<int>(this->Internals->SlotIndex.size());
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileAtlas::Allocate(int slotWidth, int slotHeight,
+                               int numberOfSlots)
+{
+  // Square-ish power-of-two grid, limited by the maximum size
+  int maxColumns = this->MaxSize / slotWidth;
+  int maxRows = this->MaxSize / slotHeight;
+  int side = static_cast<int>(
+    std::ceil(std::sqrt(static_cast<double>(numberOfSlots))));
+  int columns = std::min(NextPowerOfTwo(side), maxColumns);
+  if (columns < 1)
+    {
+    return false;
+    }
+  int rows = NextPowerOfTwo((numberOfSlots + columns - 1) / columns);
+  if (rows > maxRows)
+    {
+    rows = (numberOfSlots + columns - 1) / columns;
+    if (rows > maxRows)
+      {
+      return false;
+      }
+    }
+
+  vtkMapTileAtlasInternals *internals = this->Internals;
+  internals->SlotSize[0] = slotWidth;
+  internals->SlotSize[1] = slotHeight;
+  internals->Columns = columns;
+  internals->Rows = rows;
+  internals->Slots.clear();
+  internals->Slots.resize(static_cast<std::size_t>(columns) * rows);
+  internals->SlotIndex.clear();
+
+  internals->Image->SetDimensions(columns * slotWidth, rows * slotHeight, 1);
+  internals->Image->AllocateScalars(VTK_UNSIGNED_CHAR, 4);
+  memset(internals->Image->GetScalarPointer(), 0,
+         static_cast<std::size_t>(columns) * slotWidth *
+         rows * slotHeight * 4);
+  vtkDebugMacro("Allocated " << columns << " x " << rows << " slot atlas");
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileAtlas::Update(const std::vector<vtkMapTile*>& tiles)
+{
+  vtkMapTileAtlasInternals *internals = this->Internals;
+
+  // Distinct images, and the slot size they need
+  std::map<vtkImageData*, int> images;
+  int slotSize[2] = { internals->SlotSize[0], internals->SlotSize[1] };
+  std::vector<vtkMapTile*>::const_iterator iter = tiles.begin();
+  for (; iter != tiles.end(); iter++)
+    {
+    vtkImageData *image = GetTileImage(*iter);
+    if (!image || images.count(image))
+      {
+      continue;
+      }
+    int components = image->GetNumberOfScalarComponents();
+    if (image->GetScalarType() != VTK_UNSIGNED_CHAR ||
+        components < 1 || components > 4)
+      {
+      return false;
+      }
+    int *dims = image->GetDimensions();
+    slotSize[0] = std::max(slotSize[0], dims[0]);
+    slotSize[1] = std::max(slotSize[1], dims[1]);
+    images[image] = -1;
+    }
+  int numImages = static_cast<int>(images.size());
+
+  if (slotSize[0] > internals->SlotSize[0] ||
+      slotSize[1] > internals->SlotSize[1] ||
+      numImages > this->GetNumberOfSlots())
+    {
+    if (!this->Allocate(slotSize[0], slotSize[1],
+                        std::max(numImages, this->GetNumberOfSlots())))
+      {
+      return false;
+      }
+    }
+
+  // Free the slots of images no longer drawn
+  std::map<vtkImageData*, int>::iterator slotIter =
+    internals->SlotIndex.begin();
+  while (slotIter != internals->SlotIndex.end())
+    {
+    if (images.count(slotIter->first))
+      {
+      images[slotIter->first] = slotIter->second;
+      ++slotIter;
+      }
+    else
+      {
+      internals->Slots[slotIter->second] = NULL;
+      internals->SlotIndex.erase(slotIter++);
+      }
+    }
+
+  // Copy new images into free slots
+  std::size_t freeSlot = 0;
+  bool copied = false;
+  std::map<vtkImageData*, int>::iterator imageIter = images.begin();
+  for (; imageIter != images.end(); imageIter++)
+    {
+    if (imageIter->second >= 0)
+      {
+      continue;
+      }
+    while (internals->Slots[freeSlot])
+      {
+      ++freeSlot;
+      }
+    int slot = static_cast<int>(freeSlot);
+    CopyImage(imageIter->first, internals->Image,
+              (slot % internals->Columns) * internals->SlotSize[0],
+              (slot / internals->Columns) * internals->SlotSize[1]);
+    internals->Slots[slot] = imageIter->first;
+    internals->SlotIndex[imageIter->first] = slot;
+    imageIter->second = slot;
+    ++this->NumberOfCopiedImages;
+    copied = true;
+    }
+  if (copied)
+    {
+    internals->Image->Modified();
+    }
+
+  // One quad per tile, textured from its image's slot. Texture
+  // coordinates stay half a texel inside the image, so interpolation
+  // does not blend in the neighboring slots.
+  int *atlasDims = internals->Image->GetDimensions();
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  vtkSmartPointer<vtkFloatArray> tcoords =
+    vtkSmartPointer<vtkFloatArray>::New();
+  tcoords->SetName("TextureCoordinates");
+  tcoords->SetNumberOfComponents(2);
+  vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+  for (iter = tiles.begin(); iter != tiles.end(); iter++)
+    {
+    vtkImageData *image = GetTileImage(*iter);
+    if (!image)
+      {
+      continue;
+      }
+    int slot = images[image];
+    int *dims = image->GetDimensions();
+    double *corners = (*iter)->GetCorners();
+    double *range = (*iter)->GetTextureRange();
+    double x0 = (slot % internals->Columns) * internals->SlotSize[0];
+    double y0 = (slot / internals->Columns) * internals->SlotSize[1];
+    double s[2] =
+      {
+      (x0 + std::max(range[0] * dims[0], 0.5)) / atlasDims[0],
+      (x0 + std::min(range[1] * dims[0], dims[0] - 0.5)) / atlasDims[0]
+      };
+    double t[2] =
+      {
+      (y0 + std::max(range[2] * dims[1], 0.5)) / atlasDims[1],
+      (y0 + std::min(range[3] * dims[1], dims[1] - 0.5)) / atlasDims[1]
+      };
+
+    vtkIdType ids[4];
+    ids[0] = points->InsertNextPoint(corners[0], corners[1], 0.0);
+    ids[1] = points->InsertNextPoint(corners[2], corners[1], 0.0);
+    ids[2] = points->InsertNextPoint(corners[2], corners[3], 0.0);
+    ids[3] = points->InsertNextPoint(corners[0], corners[3], 0.0);
+    tcoords->InsertNextTuple2(s[0], t[0]);
+    tcoords->InsertNextTuple2(s[1], t[0]);
+    tcoords->InsertNextTuple2(s[1], t[1]);
+    tcoords->InsertNextTuple2(s[0], t[1]);
+    polys->InsertNextCell(4, ids);
+    }
+
+  internals->PolyData->SetPoints(points);
+  internals->PolyData->SetPolys(polys);
+  internals->PolyData->GetPointData()->SetTCoords(tcoords);
+  internals->PolyData->Modified();
+  return true;
+}
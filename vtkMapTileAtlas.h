@@ -0,0 +1,96 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileAtlas.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileAtlas - draw a set of map tiles with one actor
+// .SECTION Description
+// Packs the images of map tiles into the slots of one texture atlas,
+// and draws all tiles as a single polydata with one texture, i.e. one
+// draw call and one set of state changes, instead of one actor per
+// tile. Each tile is a quad at its corners, with texture coordinates
+// pointing into its image's slot.
+//
+// Slots are kept across calls to Update(), for as long as the image is
+// drawn, so only the images of tiles new to the view are copied into
+// the atlas. Tiles that share an image (fallback tiles showing parts of
+// one ancestor) share its slot. The atlas grows as needed, up to
+// MaxSize texels on each side.
+//
+// Only use from the thread that renders.
+
+#ifndef __vtkMapTileAtlas_h
+#define __vtkMapTileAtlas_h
+
+#include "vtkmap_export.h"
+#include <vtkObject.h>
+
+#include <vector>
+
+class vtkActor;
+class vtkMapTile;
+
+class VTKMAP_EXPORT vtkMapTileAtlas : public vtkObject
+{
+public:
+  static vtkMapTileAtlas *New();
+  vtkTypeMacro(vtkMapTileAtlas, vtkObject)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Get/Set the maximum width and height of the atlas, in texels.
+  // Should not exceed the largest texture size of the graphics
+  // hardware. Default is 4096.
+  vtkSetClampMacro(MaxSize, int, 256, 16384);
+  vtkGetMacro(MaxSize, int);
+
+  // Description:
+  // Draw the given (built) tiles, in order. Returns false, leaving the
+  // actor unchanged, if the tiles do not fit into the atlas or have
+  // images it cannot hold (not 8-bit, 1 to 4 components).
+  bool Update(const std::vector<vtkMapTile*>& tiles);
+
+  // Description:
+  // The actor drawing the tiles of the last successful Update()
+  vtkGetObjectMacro(Actor, vtkActor);
+
+  // Description:
+  // Number of slots in the atlas, and number of them in use
+  int GetNumberOfSlots();
+  int GetNumberOfUsedSlots();
+
+  // Description:
+  // Total number of tile images copied into the atlas
+  vtkGetMacro(NumberOfCopiedImages, vtkTypeInt64);
+
+protected:
+  vtkMapTileAtlas();
+  ~vtkMapTileAtlas();
+
+  // Description:
+  // Reallocate the atlas for the given slot size and number of slots.
+  // Clears all slots.
+  bool Allocate(int slotWidth, int slotHeight, int numberOfSlots);
+
+  vtkActor *Actor;
+  int MaxSize;
+  vtkTypeInt64 NumberOfCopiedImages;
+
+  class vtkMapTileAtlasInternals;
+  vtkMapTileAtlasInternals *Internals;
+
+private:
+  vtkMapTileAtlas(const vtkMapTileAtlas&);  // Not implemented
+  void operator=(const vtkMapTileAtlas&); // Not implemented
+};
+
+#endif // __vtkMapTileAtlas_h
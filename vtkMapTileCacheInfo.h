@@ -0,0 +1,49 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileCacheInfo.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileCacheInfo - HTTP caching metadata of a map tile
+// .SECTION Description
+// The validators of a downloaded tile (ETag and Last-Modified response
+// headers), sent with conditional requests to check whether the tile
+// changed, and the time until which the tile is fresh.
+// Used by vtkMapTileFetcher and vtkMapTileRevalidator.
+
+#ifndef __vtkMapTileCacheInfo_h
+#define __vtkMapTileCacheInfo_h
+
+#include <string>
+
+class vtkMapTileCacheInfo
+{
+public:
+  std::string ETag;
+  std::string LastModified;
+  double Expires;  // as vtkTimerLog::GetUniversalTime(), 0 if unknown
+
+  vtkMapTileCacheInfo();
+
+  bool HasValidators() const;
+};
+
+inline vtkMapTileCacheInfo::vtkMapTileCacheInfo()
+{
+  this->Expires = 0.0;
+}
+
+inline bool vtkMapTileCacheInfo::HasValidators() const
+{
+  return !this->ETag.empty() || !this->LastModified.empty();
+}
+
+#endif // __vtkMapTileCacheInfo_h
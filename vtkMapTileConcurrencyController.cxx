@@ -0,0 +1,369 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileConcurrencyController.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileConcurrencyController.h"
+
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+#include <map>
+
+namespace
+{
+  // Weights of the latest response in the running averages
+  const double LatencyWeight = 0.2;
+  const double ErrorWeight = 0.1;
+
+  // Responses needed before response times are trusted, and the
+  // fastest response time considered, below which times are noise
+  const int MinLatencySamples = 8;
+  const double MinLatency = 0.01;
+
+  struct HostState
+  {
+    int Limit;
+    int FullResponses;     // with the limit in use, since it last changed
+    int ActiveRequests;
+    double Latency;        // running average of response times
+    double MinLatency;     // fastest response time
+    int LatencySamples;
+    double ErrorRate;      // running average of failures
+    double DecreaseTime;   // as vtkTimerLog::GetUniversalTime()
+    vtkTypeInt64 Decreases;
+
+    explicit HostState(int limit = 1)
+      : Limit(limit), FullResponses(0), ActiveRequests(0), Latency(0.0),
+        MinLatency(0.0), LatencySamples(0), ErrorRate(0.0),
+        DecreaseTime(0.0), Decreases(0)
+    {
+    }
+  };
+}
+
+vtkStandardNewMacro(vtkMapTileConcurrencyController)
+
+//----------------------------------------------------------------------------
+class vtkMapTileConcurrencyController::
+vtkMapTileConcurrencyControllerInternals
+{
+public:
+  std::map<std::string, HostState> Hosts;
+  int MinConcurrency;
+  int MaxConcurrency;
+  int InitialConcurrency;
+  double LatencyTolerance;
+  double MaxErrorRate;
+
+  HostState& GetHostState(const std::string& host)
+  {
+    std::map<std::string, HostState>::iterator iter = this->Hosts.find(host);
+    if (iter == this->Hosts.end())
+      {
+      iter = this->Hosts.insert(std::make_pair(
+        host, HostState(this->InitialConcurrency))).first;
+      }
+    return iter->second;
+  }
+
+  void ClampLimits()
+  {
+    std::map<std::string, HostState>::iterator iter = this->Hosts.begin();
+    for (; iter != this->Hosts.end(); iter++)
+      {
+      iter->second.Limit = std::max(this->MinConcurrency,
+        std::min(iter->second.Limit, this->MaxConcurrency));
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+vtkMapTileConcurrencyController::vtkMapTileConcurrencyController()
+{
+  this->Internals = new vtkMapTileConcurrencyControllerInternals;
+  this->Internals->MinConcurrency = 1;
+  this->Internals->MaxConcurrency = 16;
+  this->Internals->InitialConcurrency = 6;
+  this->Internals->LatencyTolerance = 4.0;
+  this->Internals->MaxErrorRate = 0.25;
+  this->Lock = vtkMutexLock::New();
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileConcurrencyController::~vtkMapTileConcurrencyController()
+{
+  this->Lock->Delete();
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileConcurrencyController::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "MinConcurrency: " << this->GetMinConcurrency() << "\n"
+     << indent << "MaxConcurrency: " << this->GetMaxConcurrency() << "\n"
+     << indent << "InitialConcurrency: "
+     << this->GetInitialConcurrency() << "\n"
+     << indent << "LatencyTolerance: " << this->GetLatencyTolerance() << "\n"
+     << indent << "MaxErrorRate: " << this->GetMaxErrorRate() << "\n";
+
+  this->Lock->Lock();
+  std::map<std::string, HostState>::const_iterator iter =
+    this->Internals->Hosts.begin();
+  for (; iter != this->Internals->Hosts.end(); iter++)
+    {
+    const HostState& state = iter->second;
+    os << indent << iter->first << ": Concurrency " << state.Limit
+       << ", ActiveRequests " << state.ActiveRequests
+       << ", Latency " << state.Latency
+       << ", ErrorRate " << state.ErrorRate
+       << ", Decreases " << state.Decreases << "\n";
+    }
+  this->Lock->Unlock();
+  os << std::flush;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileConcurrencyController::TryBeginRequest(const std::string& host)
+{
+  this->Lock->Lock();
+  HostState& state = this->Internals->GetHostState(host);
+  bool result = state.ActiveRequests < state.Limit;
+  if (result)
+    {
+    ++state.ActiveRequests;
+    }
+  this->Lock->Unlock();
+  return result;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileConcurrencyController::EndRequest(const std::string& host)
+{
+  this->Lock->Lock();
+  HostState& state = this->Internals->GetHostState(host);
+  state.ActiveRequests = std::max(0, state.ActiveRequests - 1);
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileConcurrencyController::RecordResponse(const std::string& host,
+                                                     double seconds,
+                                                     long httpStatus)
+{
+  vtkMapTileConcurrencyControllerInternals *internals = this->Internals;
+  double now = vtkTimerLog::GetUniversalTime();
+  bool overloaded = httpStatus == 429 || httpStatus == 503;
+  bool failed = httpStatus == 0 || httpStatus == 429 || httpStatus >= 500;
+
+  this->Lock->Lock();
+  HostState& state = internals->GetHostState(host);
+  state.ErrorRate += ErrorWeight * ((failed ? 1.0 : 0.0) - state.ErrorRate);
+  if (!failed)
+    {
+    if (state.LatencySamples++ == 0)
+      {
+      state.Latency = state.MinLatency = seconds;
+      }
+    else
+      {
+      state.Latency += LatencyWeight * (seconds - state.Latency);
+      state.MinLatency = std::min(state.MinLatency, seconds);
+      }
+    }
+
+  bool congested = overloaded || state.ErrorRate > internals->MaxErrorRate ||
+    (internals->LatencyTolerance > 0.0 &&
+     state.LatencySamples >= MinLatencySamples &&
+     state.Latency > internals->LatencyTolerance *
+       std::max(state.MinLatency, MinLatency));
+  if (congested)
+    {
+    // Responses to requests made before the last decrease do not
+    // reflect it yet, so wait for them
+    if (now - state.DecreaseTime >= std::max(state.Latency, MinLatency))
+      {
+      state.Limit = std::max(internals->MinConcurrency, state.Limit / 2);
+      state.FullResponses = 0;
+      state.DecreaseTime = now;
+      ++state.Decreases;
+      vtkDebugMacro("Decreased concurrency for " << host << " to "
+                    << state.Limit);
+      }
+    }
+  else if (!failed && state.ActiveRequests >= state.Limit &&
+           ++state.FullResponses >= state.Limit)
+    {
+    // Only grow a limit in use: one more request per round of responses
+    // that used it fully
+    state.Limit = std::min(internals->MaxConcurrency, state.Limit + 1);
+    state.FullResponses = 0;
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileConcurrencyController::GetConcurrency(const std::string& host)
+{
+  this->Lock->Lock();
+  int count = this->Internals->GetHostState(host).Limit;
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileConcurrencyController::
+GetNumberOfActiveRequests(const std::string& host)
+{
+  this->Lock->Lock();
+  int count = this->Internals->GetHostState(host).ActiveRequests;
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileConcurrencyController::
+GetNumberOfDecreases(const std::string& host)
+{
+  this->Lock->Lock();
+  vtkTypeInt64 count = this->Internals->GetHostState(host).Decreases;
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileConcurrencyController::Reset()
+{
+  this->Lock->Lock();
+  // Requests in flight are still ended
+  std::map<std::string, HostState>::iterator iter =
+    this->Internals->Hosts.begin();
+  for (; iter != this->Internals->Hosts.end(); iter++)
+    {
+    int active = iter->second.ActiveRequests;
+    iter->second = HostState(this->Internals->InitialConcurrency);
+    iter->second.ActiveRequests = active;
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileConcurrencyController::SetMinConcurrency(int count)
+{
+  vtkMapTileConcurrencyControllerInternals *internals = this->Internals;
+  this->Lock->Lock();
+  internals->MinConcurrency = std::max(1, count);
+  internals->MaxConcurrency =
+    std::max(internals->MaxConcurrency, internals->MinConcurrency);
+  internals->InitialConcurrency =
+    std::max(internals->InitialConcurrency, internals->MinConcurrency);
+  internals->ClampLimits();
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileConcurrencyController::GetMinConcurrency()
+{
+  this->Lock->Lock();
+  int count = this->Internals->MinConcurrency;
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileConcurrencyController::SetMaxConcurrency(int count)
+{
+  vtkMapTileConcurrencyControllerInternals *internals = this->Internals;
+  this->Lock->Lock();
+  internals->MaxConcurrency = std::max(1, count);
+  internals->MinConcurrency =
+    std::min(internals->MinConcurrency, internals->MaxConcurrency);
+  internals->InitialConcurrency =
+    std::min(internals->InitialConcurrency, internals->MaxConcurrency);
+  internals->ClampLimits();
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileConcurrencyController::GetMaxConcurrency()
+{
+  this->Lock->Lock();
+  int count = this->Internals->MaxConcurrency;
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileConcurrencyController::SetInitialConcurrency(int count)
+{
+  vtkMapTileConcurrencyControllerInternals *internals = this->Internals;
+  this->Lock->Lock();
+  internals->InitialConcurrency = std::max(internals->MinConcurrency,
+    std::min(count, internals->MaxConcurrency));
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileConcurrencyController::GetInitialConcurrency()
+{
+  this->Lock->Lock();
+  int count = this->Internals->InitialConcurrency;
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileConcurrencyController::SetLatencyTolerance(double ratio)
+{
+  this->Lock->Lock();
+  this->Internals->LatencyTolerance = std::max(0.0, ratio);
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileConcurrencyController::GetLatencyTolerance()
+{
+  this->Lock->Lock();
+  double ratio = this->Internals->LatencyTolerance;
+  this->Lock->Unlock();
+  return ratio;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileConcurrencyController::SetMaxErrorRate(double rate)
+{
+  this->Lock->Lock();
+  this->Internals->MaxErrorRate = std::max(0.0, std::min(rate, 1.0));
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileConcurrencyController::GetMaxErrorRate()
+{
+  this->Lock->Lock();
+  double rate = this->Internals->MaxErrorRate;
+  this->Lock->Unlock();
+  return rate;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkMapTileConcurrencyController::GetHost(const std::string& url)
+{
+  std::string::size_type start = url.find("://");
+  start = start == std::string::npos ? 0 : start + 3;
+  std::string::size_type end = url.find('/', start);
+  return url.substr(start, end == std::string::npos ? end : end - start);
+}
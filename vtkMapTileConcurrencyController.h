@@ -0,0 +1,118 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileConcurrencyController.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileConcurrencyController - adaptive limit on tile requests
+// .SECTION Description
+// Limits the number of tile requests in flight to each tile server host,
+// and adjusts the limit from the responses, in the manner of TCP
+// congestion control (additive increase, multiplicative decrease).
+//
+// Each host starts at InitialConcurrency. While the host keeps up, the
+// limit grows by about one request per round of responses that used it
+// fully. It is halved, at most once per typical response time, when the
+// host answers 429 (Too Many Requests) or 503 (Service Unavailable),
+// when the recent rate of failed requests exceeds MaxErrorRate, or when
+// the typical response time exceeds LatencyTolerance times the fastest
+// seen, i.e. requests are waiting in a queue at the server. The limit
+// stays between MinConcurrency and MaxConcurrency.
+//
+// Hosts are names such as "tile.openstreetmap.org", or with a port.
+// All methods are thread safe.
+
+#ifndef __vtkMapTileConcurrencyController_h
+#define __vtkMapTileConcurrencyController_h
+
+#include "vtkmap_export.h"
+#include <vtkObject.h>
+#include <string>
+
+class vtkMutexLock;
+
+class VTKMAP_EXPORT vtkMapTileConcurrencyController : public vtkObject
+{
+public:
+  static vtkMapTileConcurrencyController *New();
+  vtkTypeMacro(vtkMapTileConcurrencyController, vtkObject)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Start a request to host if its limit allows, and return true then.
+  // Each request started must be ended by EndRequest().
+  bool TryBeginRequest(const std::string& host);
+  void EndRequest(const std::string& host);
+
+  // Description:
+  // Record the response to a request to host, and adjust its limit.
+  // seconds is the time the request took, and httpStatus the response
+  // status, or 0 if there was no response.
+  void RecordResponse(const std::string& host, double seconds,
+                      long httpStatus);
+
+  // Description:
+  // Current limit on requests in flight to host
+  int GetConcurrency(const std::string& host);
+
+  // Description:
+  // Number of requests in flight to host
+  int GetNumberOfActiveRequests(const std::string& host);
+
+  // Description:
+  // Number of times the limit of host was decreased
+  vtkTypeInt64 GetNumberOfDecreases(const std::string& host);
+
+  // Description:
+  // Forget the state of all hosts
+  void Reset();
+
+  // Description:
+  // Get/Set the lowest and highest limits, and the limit of hosts not
+  // seen before. Defaults are 1, 16 and 6.
+  void SetMinConcurrency(int count);
+  int GetMinConcurrency();
+  void SetMaxConcurrency(int count);
+  int GetMaxConcurrency();
+  void SetInitialConcurrency(int count);
+  int GetInitialConcurrency();
+
+  // Description:
+  // Get/Set the ratio of the typical response time to the fastest one
+  // above which the limit decreases. 0 ignores response times.
+  // Default is 4.
+  void SetLatencyTolerance(double ratio);
+  double GetLatencyTolerance();
+
+  // Description:
+  // Get/Set the recent rate of failed requests above which the limit
+  // decreases. Default is 0.25.
+  void SetMaxErrorRate(double rate);
+  double GetMaxErrorRate();
+
+  // Description:
+  // Host part of a URL such as "http://host:port/path"
+  static std::string GetHost(const std::string& url);
+
+protected:
+  vtkMapTileConcurrencyController();
+  ~vtkMapTileConcurrencyController();
+
+  class vtkMapTileConcurrencyControllerInternals;
+  vtkMapTileConcurrencyControllerInternals *Internals;
+  vtkMutexLock *Lock;
+
+private:
+  vtkMapTileConcurrencyController(const vtkMapTileConcurrencyController&);  // Not implemented
+  void operator=(const vtkMapTileConcurrencyController&); // Not implemented
+};
+
+#endif // __vtkMapTileConcurrencyController_h
@@ -0,0 +1,838 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileDiskCache.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileDiskCache.h"
+#include "vtkMapTileIndexInternal.h"
+#include "vtkPackedTileStore.h"
+
+#include <vtkConditionVariable.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtksys/Directory.hxx>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  const char JournalMagic[8] = { 'V', 'T', 'K', 'M', 'A', 'P', 'J', 'L' };
+  const vtkTypeUInt32 JournalVersion = 1;
+  const vtkTypeInt64 JournalHeaderSize = 12;  // magic + version
+  const vtkTypeInt64 JournalRecordSize = 8;   // key
+
+  // Number of recorded accesses that wakes up the background thread
+  const std::size_t PendingBatchSize = 256;
+
+  // Number of tiles deleted between pauses of the background thread
+  const std::size_t EvictionBatchSize = 64;
+
+  // Fraction of a packed tile store that removed tiles must take up
+  // before the store is compacted, so that the whole pack is not
+  // rewritten after every eviction
+  const double CompactionThreshold = 0.5;
+
+  struct TileEntry
+  {
+    vtkTypeUInt64 Stamp;  // 0 if never accessed
+    vtkTypeInt64 Size;
+    TileEntry() : Stamp(0), Size(0) {}
+  };
+
+  typedef vtkMapTileIndexInternal<TileEntry> TileIndex;
+
+  struct PendingRecord
+  {
+    vtkTypeUInt64 Key;
+    vtkTypeInt64 Size;  // negative for an access to an existing tile
+  };
+
+  struct EvictionCandidate
+  {
+    vtkTypeUInt64 Stamp;
+    vtkTypeUInt64 Key;
+    vtkTypeInt64 Size;
+  };
+
+  struct sortCandidatesByStamp
+  {
+    inline bool operator() (const EvictionCandidate& a,
+                            const EvictionCandidate& b)
+    {
+      return a.Stamp < b.Stamp;
+    }
+  };
+
+  //--------------------------------------------------------------------------
+  // Keep cache maintenance from competing with rendering and tile loading
+  void LowerThreadPriority()
+  {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__linux__)
+    // Linux applies nice values to individual threads
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+#endif
+  }
+}
+
+vtkStandardNewMacro(vtkMapTileDiskCache)
+
+//----------------------------------------------------------------------------
+class vtkMapTileDiskCache::vtkMapTileDiskCacheInternals
+{
+public:
+  std::string Directory;
+  std::string Extension;
+  std::string JournalPath;
+  vtkPackedTileStore *Store;
+
+  vtkMultiThreader *Threader;
+  int ThreadId;
+
+  // Members below are guarded by Lock
+  bool Running;
+  bool Scanned;
+  bool CheckQuota;
+  TileIndex Tiles;
+  std::vector<PendingRecord> Pending;
+  vtkTypeUInt64 AccessCounter;  // last access stamp
+  vtkTypeInt64 TilesSize;       // sum of tile sizes
+  vtkTypeInt64 StoreSize;       // of the pack and index files, if packed
+  vtkTypeInt64 JournalRecords;
+  vtkTypeInt64 MaxSize;
+  int MaxNumberOfTiles;
+  vtkTypeInt64 NumberOfEvictedTiles;
+  int FlushRequested;
+  int FlushCompleted;
+
+  // Members below are only used by the background thread
+  FILE *Journal;
+  bool Journaling;  // while a quota is set
+  std::vector<vtkTypeUInt64> JournalKeys;  // to be appended
+};
+
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE StaticBackgroundThreadExecute(void *arg)
+{
+  vtkMapTileDiskCache *self;
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  self = static_cast<vtkMapTileDiskCache*>(info->UserData);
+  self->BackgroundThreadExecute();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileDiskCache::vtkMapTileDiskCache()
+{
+  this->Internals = new vtkMapTileDiskCacheInternals;
+  this->Internals->Store = NULL;
+  this->Internals->Threader = vtkMultiThreader::New();
+  this->Internals->ThreadId = -1;
+  this->Internals->Running = false;
+  this->Internals->Scanned = false;
+  this->Internals->CheckQuota = false;
+  this->Internals->AccessCounter = 0;
+  this->Internals->TilesSize = 0;
+  this->Internals->StoreSize = 0;
+  this->Internals->JournalRecords = 0;
+  this->Internals->MaxSize = 0;
+  this->Internals->MaxNumberOfTiles = 0;
+  this->Internals->NumberOfEvictedTiles = 0;
+  this->Internals->FlushRequested = 0;
+  this->Internals->FlushCompleted = 0;
+  this->Internals->Journal = NULL;
+  this->Internals->Journaling = false;
+  this->Lock = vtkMutexLock::New();
+  this->Condition = vtkConditionVariable::New();
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileDiskCache::~vtkMapTileDiskCache()
+{
+  this->Close();
+  this->Internals->Threader->Delete();
+  this->Condition->Delete();
+  this->Lock->Delete();
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileDiskCache::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Directory: " << this->Internals->Directory << "\n"
+     << indent << "MaxSize: " << this->GetMaxSize() << "\n"
+     << indent << "MaxNumberOfTiles: " << this->GetMaxNumberOfTiles() << "\n"
+     << indent << "DiskUsage: " << this->GetDiskUsage() << "\n"
+     << indent << "NumberOfTiles: " << this->GetNumberOfTiles() << "\n"
+     << indent << "NumberOfEvictedTiles: " << this->GetNumberOfEvictedTiles()
+     << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileDiskCache::Open(const char *directory, const char *extension,
+                               vtkPackedTileStore *store)
+{
+  this->Close();
+
+  vtkMapTileDiskCacheInternals *internals = this->Internals;
+  internals->Directory = directory;
+  internals->Extension = extension;
+  internals->JournalPath = internals->Directory + "/tiles.journal";
+
+  this->Lock->Lock();
+  internals->Store = store;
+  if (store)
+    {
+    store->Register(this);
+    }
+  internals->Running = true;
+  internals->Scanned = false;
+  internals->CheckQuota = false;
+  internals->Tiles.Clear();
+  internals->Pending.clear();
+  internals->AccessCounter = 0;
+  internals->TilesSize = 0;
+  internals->StoreSize = 0;
+  internals->JournalRecords = 0;
+  this->Lock->Unlock();
+  internals->Journaling = false;
+
+  internals->ThreadId =
+    internals->Threader->SpawnThread(StaticBackgroundThreadExecute, this);
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileDiskCache::Close()
+{
+  vtkMapTileDiskCacheInternals *internals = this->Internals;
+  this->Lock->Lock();
+  bool running = internals->Running;
+  internals->Running = false;
+  this->Condition->Broadcast();
+  this->Lock->Unlock();
+  if (!running)
+    {
+    return;
+    }
+
+  // Background thread writes pending accesses before exiting
+  internals->Threader->TerminateThread(internals->ThreadId);
+  internals->ThreadId = -1;
+  if (internals->Journal)
+    {
+    fclose(internals->Journal);
+    internals->Journal = NULL;
+    }
+
+  this->Lock->Lock();
+  if (internals->Store)
+    {
+    internals->Store->UnRegister(this);
+    internals->Store = NULL;
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileDiskCache::SetMaxSize(vtkTypeInt64 size)
+{
+  this->Lock->Lock();
+  this->Internals->MaxSize = size;
+  this->Internals->CheckQuota = true;
+  this->Condition->Broadcast();
+  this->Lock->Unlock();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileDiskCache::GetMaxSize()
+{
+  this->Lock->Lock();
+  vtkTypeInt64 size = this->Internals->MaxSize;
+  this->Lock->Unlock();
+  return size;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileDiskCache::SetMaxNumberOfTiles(int count)
+{
+  this->Lock->Lock();
+  this->Internals->MaxNumberOfTiles = count;
+  this->Internals->CheckQuota = true;
+  this->Condition->Broadcast();
+  this->Lock->Unlock();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileDiskCache::GetMaxNumberOfTiles()
+{
+  this->Lock->Lock();
+  int count = this->Internals->MaxNumberOfTiles;
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileDiskCache::RecordAccess(int zoom, int x, int y)
+{
+  PendingRecord record;
+  record.Key = TileIndex::MakeKey(zoom, x, y);
+  record.Size = -1;
+
+  this->Lock->Lock();
+  if (this->Internals->Running)
+    {
+    this->Internals->Pending.push_back(record);
+    if (this->Internals->Pending.size() >= PendingBatchSize)
+      {
+      this->Condition->Broadcast();
+      }
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileDiskCache::RecordInsert(int zoom, int x, int y,
+                                       vtkTypeInt64 size)
+{
+  PendingRecord record;
+  record.Key = TileIndex::MakeKey(zoom, x, y);
+
+  this->Lock->Lock();
+  if (this->Internals->Running)
+    {
+    record.Size = size +
+      (this->Internals->Store ? vtkPackedTileStore::RecordOverhead : 0);
+    this->Internals->Pending.push_back(record);
+    // Wake up background thread to check quota
+    this->Condition->Broadcast();
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileDiskCache::Flush()
+{
+  this->Lock->Lock();
+  if (this->Internals->Running)
+    {
+    int target = ++this->Internals->FlushRequested;
+    this->Condition->Broadcast();
+    while (this->Internals->FlushCompleted < target)
+      {
+      this->Condition->Wait(this->Lock);
+      }
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileDiskCache::GetDiskUsage()
+{
+  this->Lock->Lock();
+  vtkTypeInt64 usage = this->ComputeDiskUsage();
+  this->Lock->Unlock();
+  return usage;
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileDiskCache::GetNumberOfTiles()
+{
+  this->Lock->Lock();
+  int count = static_cast<int>(this->Internals->Tiles.Size());
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileDiskCache::GetNumberOfEvictedTiles()
+{
+  this->Lock->Lock();
+  vtkTypeInt64 count = this->Internals->NumberOfEvictedTiles;
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileDiskCache::BackgroundThreadExecute()
+{
+  vtkDebugMacro("Enter BackgroundThreadExecute()");
+  LowerThreadPriority();
+  this->ScanCache();
+
+  vtkMapTileDiskCacheInternals *internals = this->Internals;
+  this->UpdateStoreSize();
+  this->Lock->Lock();
+  for (;;)
+    {
+    bool running = internals->Running;
+    int flushTarget = internals->FlushRequested;
+    if (running && flushTarget == internals->FlushCompleted &&
+        internals->Pending.empty() && !internals->CheckQuota)
+      {
+      this->Condition->Wait(this->Lock);
+      continue;
+      }
+
+    // Apply recorded accesses, in order, as new access stamps
+    std::vector<PendingRecord>::iterator iter = internals->Pending.begin();
+    for (; internals->Scanned && iter != internals->Pending.end(); iter++)
+      {
+      TileEntry *entry = internals->Tiles.Find(iter->Key);
+      if (iter->Size >= 0)
+        {
+        if (!entry)
+          {
+          internals->Tiles.Insert(iter->Key, TileEntry());
+          entry = internals->Tiles.Find(iter->Key);
+          }
+        internals->TilesSize += iter->Size - entry->Size;
+        entry->Size = iter->Size;
+        }
+      if (entry)
+        {
+        entry->Stamp = ++internals->AccessCounter;
+        internals->JournalKeys.push_back(iter->Key);
+        }
+      }
+    internals->Pending.clear();
+    internals->CheckQuota = false;
+    bool overQuota = internals->Scanned && this->IsOverQuota();
+    bool journal = internals->Scanned &&
+      (internals->MaxSize > 0 || internals->MaxNumberOfTiles > 0);
+    this->Lock->Unlock();
+
+    // Without a quota, the cache is only scanned for its statistics, and
+    // accesses are not journaled. The journal is rewritten from the
+    // access stamps when a quota is set.
+    if (journal && !internals->Journaling)
+      {
+      internals->JournalKeys.clear();
+      this->CompactJournal();
+      }
+    internals->Journaling = journal;
+    if (journal)
+      {
+      this->AppendJournal();
+      }
+    else
+      {
+      internals->JournalKeys.clear();
+      }
+    if (overQuota)
+      {
+      this->EvictTiles();
+      }
+
+    this->UpdateStoreSize();
+    this->Lock->Lock();
+    internals->FlushCompleted = flushTarget;
+    this->Condition->Broadcast();
+    if (!running)
+      {
+      break;
+      }
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+// Builds the tile index from the cache contents and the journal.
+// Called by the background thread.
+void vtkMapTileDiskCache::ScanCache()
+{
+  vtkMapTileDiskCacheInternals *internals = this->Internals;
+  TileIndex tiles;
+  vtkTypeInt64 tilesSize = 0;
+
+  if (internals->Store)
+    {
+    std::vector<vtkTypeUInt64> keys;
+    std::vector<vtkTypeUInt32> sizes;
+    internals->Store->GetTileSizes(keys, sizes);
+    for (std::size_t i = 0; i < keys.size(); ++i)
+      {
+      TileEntry entry;
+      entry.Size = sizes[i] + vtkPackedTileStore::RecordOverhead;
+      tiles.Insert(keys[i], entry);
+      tilesSize += entry.Size;
+      }
+    }
+  else
+    {
+    vtksys::Directory dir;
+    dir.Load(internals->Directory);
+    std::string suffix = "." + internals->Extension;
+    for (unsigned long i = 0; i < dir.GetNumberOfFiles(); ++i)
+      {
+      // Large caches take a while, don't hold up Close()
+      if (i % 256 == 0)
+        {
+        this->Lock->Lock();
+        bool running = internals->Running;
+        this->Lock->Unlock();
+        if (!running)
+          {
+          return;
+          }
+        }
+
+      std::string name = dir.GetFile(i);
+      std::string path = internals->Directory + "/" + name;
+      // Temporary files of writes that never finished, see
+      // vtkOsmLayer::WriteTileFile(). Recent ones may still be written.
+      if (name.size() > 5 &&
+          name.compare(name.size() - 5, 5, ".part") == 0 &&
+          vtksys::SystemTools::ModifiedTime(path) + 3600 < time(NULL))
+        {
+        vtksys::SystemTools::RemoveFile(path);
+        continue;
+        }
+
+      int zoom, x, y;
+      char tail;
+      if (name.size() <= suffix.size() ||
+          name.compare(name.size() - suffix.size(), suffix.size(),
+                       suffix) != 0 ||
+          sscanf(name.c_str(), "%d-%d-%d%c", &zoom, &x, &y, &tail) != 4 ||
+          tail != '.')
+        {
+        continue;
+        }
+      TileEntry entry;
+      entry.Size = static_cast<vtkTypeInt64>(
+        vtksys::SystemTools::FileLength(path));
+      tiles.Insert(TileIndex::MakeKey(zoom, x, y), entry);
+      tilesSize += entry.Size;
+      }
+    }
+
+  // Replay journal: later records are more recent accesses. It is
+  // rewritten, and reopened for appending, once a quota is set.
+  vtkTypeUInt64 counter = 0;
+  vtkTypeInt64 records = 0;
+  bool valid = false;
+  FILE *fp = fopen(internals->JournalPath.c_str(), "rb");
+  if (fp)
+    {
+    char magic[8];
+    vtkTypeUInt32 version = 0;
+    valid = fread(magic, 1, 8, fp) == 8 &&
+      memcmp(magic, JournalMagic, 8) == 0 &&
+      fread(&version, sizeof(version), 1, fp) == 1 &&
+      version == JournalVersion;
+    vtkTypeUInt64 key;
+    while (valid && fread(&key, sizeof(key), 1, fp) == 1)
+      {
+      ++records;
+      TileEntry *entry = tiles.Find(key);
+      if (entry)
+        {
+        entry->Stamp = ++counter;
+        }
+      }
+    fclose(fp);
+    }
+
+  this->Lock->Lock();
+  internals->Tiles = tiles;
+  internals->TilesSize = tilesSize;
+  internals->AccessCounter = counter;
+  internals->JournalRecords = records;
+  internals->Scanned = true;
+  internals->CheckQuota = true;
+  this->Lock->Unlock();
+  vtkDebugMacro("Scanned " << tiles.Size() << " tiles, " << tilesSize
+                << " bytes in " << internals->Directory);
+}
+
+//----------------------------------------------------------------------------
+// Called by the background thread.
+void vtkMapTileDiskCache::AppendJournal()
+{
+  vtkMapTileDiskCacheInternals *internals = this->Internals;
+  if (internals->JournalKeys.empty())
+    {
+    return;
+    }
+
+  std::size_t count = internals->JournalKeys.size();
+  if (!internals->Journal ||
+      fwrite(&internals->JournalKeys[0], sizeof(vtkTypeUInt64), count,
+             internals->Journal) != count ||
+      fflush(internals->Journal) != 0)
+    {
+    vtkWarningMacro("Cannot write tile access journal "
+                    << internals->JournalPath);
+    }
+  internals->JournalKeys.clear();
+
+  // Rewrite journal when it is mostly made of superseded records
+  this->Lock->Lock();
+  internals->JournalRecords += count;
+  bool compact = internals->JournalRecords >
+    2 * static_cast<vtkTypeInt64>(internals->Tiles.Size()) + 4096;
+  this->Lock->Unlock();
+  if (compact)
+    {
+    this->CompactJournal();
+    }
+}
+
+//----------------------------------------------------------------------------
+// Rewrites the journal with one record per accessed tile, oldest first.
+// Called by the background thread.
+void vtkMapTileDiskCache::CompactJournal()
+{
+  vtkMapTileDiskCacheInternals *internals = this->Internals;
+  std::vector<EvictionCandidate> order;
+  std::vector<vtkTypeUInt64> keys;
+  this->Lock->Lock();
+  internals->Tiles.GetKeys(keys);
+  for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+    TileEntry *entry = internals->Tiles.Find(keys[i]);
+    if (entry->Stamp > 0)
+      {
+      EvictionCandidate item = { entry->Stamp, keys[i], entry->Size };
+      order.push_back(item);
+      }
+    }
+  this->Lock->Unlock();
+  std::sort(order.begin(), order.end(), sortCandidatesByStamp());
+
+  if (internals->Journal)
+    {
+    fclose(internals->Journal);
+    internals->Journal = NULL;
+    }
+
+  std::string tempPath = internals->JournalPath + ".tmp";
+  FILE *fp = fopen(tempPath.c_str(), "wb");
+  bool ok = fp && fwrite(JournalMagic, 1, 8, fp) == 8 &&
+    fwrite(&JournalVersion, sizeof(JournalVersion), 1, fp) == 1;
+  for (std::size_t i = 0; ok && i < order.size(); ++i)
+    {
+    ok = fwrite(&order[i].Key, sizeof(vtkTypeUInt64), 1, fp) == 1;
+    }
+  ok = (!fp || fclose(fp) == 0) && ok;
+#ifdef _WIN32
+  // The journal is only a hint, so losing it on a crash here is harmless
+  remove(internals->JournalPath.c_str());
+#endif
+  ok = ok && rename(tempPath.c_str(), internals->JournalPath.c_str()) == 0;
+  if (!ok)
+    {
+    vtkWarningMacro("Cannot write tile access journal "
+                    << internals->JournalPath);
+    remove(tempPath.c_str());
+    }
+
+  internals->Journal = fopen(internals->JournalPath.c_str(), "ab");
+  this->Lock->Lock();
+  internals->JournalRecords = ok ? static_cast<vtkTypeInt64>(order.size()) : 0;
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+// Samples the size of the packed tile store, which grows with superseded
+// and removed tiles until compacted. Called by the background thread.
+void vtkMapTileDiskCache::UpdateStoreSize()
+{
+  vtkPackedTileStore *store = this->Internals->Store;
+  vtkTypeInt64 size = store ? store->GetPackSize() + store->GetIndexSize() : 0;
+  this->Lock->Lock();
+  if (size != this->Internals->StoreSize)
+    {
+    // Tiles written since the last check may put the store over quota
+    this->Internals->StoreSize = size;
+    this->Internals->CheckQuota = this->IsOverQuota();
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+// Must be called with Lock held.
+vtkTypeInt64 vtkMapTileDiskCache::ComputeTilesUsage()
+{
+  vtkTypeInt64 journalSize = this->Internals->JournalRecords > 0 ?
+    JournalHeaderSize + this->Internals->JournalRecords * JournalRecordSize :
+    0;
+  return this->Internals->TilesSize + journalSize;
+}
+
+//----------------------------------------------------------------------------
+// Must be called with Lock held.
+vtkTypeInt64 vtkMapTileDiskCache::ComputeDiskUsage()
+{
+  // The pack and index files also hold the bytes of superseded and
+  // removed tiles, up to the compaction threshold
+  vtkMapTileDiskCacheInternals *internals = this->Internals;
+  vtkTypeInt64 usage = this->ComputeTilesUsage();
+  if (internals->Store && internals->Scanned)
+    {
+    vtkTypeInt64 journalSize = usage - internals->TilesSize;
+    usage = std::max(usage, internals->StoreSize + journalSize);
+    }
+  return usage;
+}
+
+//----------------------------------------------------------------------------
+// Must be called with Lock held.
+bool vtkMapTileDiskCache::IsOverQuota()
+{
+  vtkMapTileDiskCacheInternals *internals = this->Internals;
+  return (internals->MaxSize > 0 &&
+          this->ComputeDiskUsage() > internals->MaxSize) ||
+    (internals->MaxNumberOfTiles > 0 &&
+     internals->Tiles.Size() >
+       static_cast<std::size_t>(internals->MaxNumberOfTiles));
+}
+
+//----------------------------------------------------------------------------
+// Deletes least recently used tiles until the cache is below 90% of quota.
+// Called by the background thread.
+void vtkMapTileDiskCache::EvictTiles()
+{
+  vtkMapTileDiskCacheInternals *internals = this->Internals;
+  std::vector<EvictionCandidate> candidates;
+  std::vector<vtkTypeUInt64> keys;
+
+  // Evict down to a low-water mark below the quota, so that eviction
+  // does not run again on every download
+  this->Lock->Lock();
+  vtkTypeInt64 maxSize = internals->MaxSize;
+  vtkTypeInt64 maxCount = internals->MaxNumberOfTiles;
+  vtkTypeInt64 excessSize = maxSize > 0 ?
+    this->ComputeTilesUsage() - (maxSize - maxSize / 10) : 0;
+  vtkTypeInt64 excessCount = maxCount > 0 ?
+    static_cast<vtkTypeInt64>(internals->Tiles.Size()) -
+    (maxCount - maxCount / 10) : 0;
+  internals->Tiles.GetKeys(keys);
+  candidates.reserve(keys.size());
+  for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+    TileEntry *entry = internals->Tiles.Find(keys[i]);
+    EvictionCandidate candidate = { entry->Stamp, keys[i], entry->Size };
+    candidates.push_back(candidate);
+    }
+  this->Lock->Unlock();
+
+  std::sort(candidates.begin(), candidates.end(), sortCandidatesByStamp());
+  std::size_t numCandidates = 0;
+  for (; numCandidates < candidates.size() &&
+         (excessSize > 0 || excessCount > 0); ++numCandidates)
+    {
+    excessSize -= candidates[numCandidates].Size;
+    --excessCount;
+    }
+
+  // Delete in small batches, pausing in between to leave the disk to
+  // foreground tile loading
+  std::stringstream ss;
+  std::vector<vtkTypeUInt64> batch;
+  vtkTypeInt64 numEvicted = 0;
+  for (std::size_t start = 0; start < numCandidates;
+       start += EvictionBatchSize)
+    {
+    std::size_t end = std::min(start + EvictionBatchSize, numCandidates);
+    batch.clear();
+    this->Lock->Lock();
+    bool running = internals->Running;
+    for (std::size_t i = start; i < end; ++i)
+      {
+      TileEntry *entry = internals->Tiles.Find(candidates[i].Key);
+      if (entry)
+        {
+        internals->TilesSize -= entry->Size;
+        internals->Tiles.Erase(candidates[i].Key);
+        batch.push_back(candidates[i].Key);
+        }
+      }
+    internals->NumberOfEvictedTiles += batch.size();
+    this->Lock->Unlock();
+
+    for (std::size_t i = 0; i < batch.size(); ++i)
+      {
+      int zoom, x, y;
+      TileIndex::SplitKey(batch[i], zoom, x, y);
+      if (internals->Store)
+        {
+        internals->Store->Remove(zoom, x, y);
+        }
+      else
+        {
+        ss.str("");
+        ss << internals->Directory << "/" << zoom << "-" << x << "-" << y
+           << "." << internals->Extension;
+        remove(ss.str().c_str());
+        }
+      }
+    numEvicted += batch.size();
+
+    if (!running)
+      {
+      // Closing, finish in a later session
+      break;
+      }
+    vtksys::SystemTools::Delay(10);
+    }
+
+  // Evicted tiles only free their space in the packed tile store when
+  // it is compacted, which is also needed when space left by superseded
+  // tiles alone puts the store over quota
+  if (internals->Store)
+    {
+    std::vector<vtkTypeUInt64> keys;
+    std::vector<vtkTypeUInt32> sizes;
+    internals->Store->GetTileSizes(keys, sizes);
+    vtkTypeInt64 liveSize = 0;
+    for (std::size_t i = 0; i < sizes.size(); ++i)
+      {
+      liveSize += sizes[i] + vtkPackedTileStore::RecordOverhead;
+      }
+    vtkTypeInt64 storeSize = internals->Store->GetPackSize() +
+      internals->Store->GetIndexSize();
+    vtkTypeInt64 deadSize = storeSize - liveSize;
+    this->Lock->Lock();
+    vtkTypeInt64 journalSize = this->ComputeTilesUsage() - internals->TilesSize;
+    this->Lock->Unlock();
+    if (deadSize > CompactionThreshold * storeSize ||
+        (deadSize > 0 && maxSize > 0 && storeSize + journalSize > maxSize))
+      {
+      internals->Store->Compact();
+      }
+    }
+  vtkDebugMacro("Evicted " << numEvicted << " tiles from "
+                << internals->Directory);
+}
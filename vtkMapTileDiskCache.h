@@ -0,0 +1,131 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileDiskCache.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileDiskCache - quota for the on-disk map-tile cache
+// .SECTION Description
+// Keeps the on-disk tile cache of a vtkOsmLayer within a quota, given
+// in bytes and/or number of tiles. The cache is either a directory of
+// "<zoom>-<x>-<y>.<ext>" files or a vtkPackedTileStore.
+//
+// While a quota is set, tile accesses are recorded in a small
+// append-only journal file in the cache directory (tiles.journal), so
+// that least-recently-used order survives restarts without relying on
+// file access times. Without a quota, the cache is only scanned, to
+// report its disk usage. A background
+// thread, running at reduced priority, scans the cache after Open(),
+// writes recorded accesses to the journal, and deletes the least
+// recently used tiles when the cache is over quota, down to 90% of the
+// quota. A packed tile store is compacted once deleted tiles take up
+// half of its files, or when they alone put the store over quota, as
+// its files count toward the quota.
+//
+// Tiles are identified by their OSM (zoom, x, y) indices.
+// All methods are thread safe.
+
+#ifndef __vtkMapTileDiskCache_h
+#define __vtkMapTileDiskCache_h
+
+#include "vtkmap_export.h"
+#include <vtkObject.h>
+
+class vtkConditionVariable;
+class vtkMutexLock;
+class vtkPackedTileStore;
+
+class VTKMAP_EXPORT vtkMapTileDiskCache : public vtkObject
+{
+public:
+  static vtkMapTileDiskCache *New();
+  vtkTypeMacro(vtkMapTileDiskCache, vtkObject)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Start managing the cache in the given directory: the tile files
+  // with the given extension or, if store is not NULL, the tiles in the
+  // packed tile store. Starts the background thread.
+  void Open(const char *directory, const char *extension,
+            vtkPackedTileStore *store);
+
+  // Description:
+  // Write pending accesses to the journal and stop the background thread
+  void Close();
+
+  // Description:
+  // Get/Set maximum size of the cache in bytes.
+  // 0 means no limit, which is the default.
+  void SetMaxSize(vtkTypeInt64 size);
+  vtkTypeInt64 GetMaxSize();
+
+  // Description:
+  // Get/Set maximum number of tiles in the cache.
+  // 0 means no limit, which is the default.
+  void SetMaxNumberOfTiles(int count);
+  int GetMaxNumberOfTiles();
+
+  // Description:
+  // Record that a tile was read from the cache
+  void RecordAccess(int zoom, int x, int y);
+
+  // Description:
+  // Record that a tile of the given size in bytes was written to the cache
+  void RecordInsert(int zoom, int x, int y, vtkTypeInt64 size);
+
+  // Description:
+  // Block until recorded accesses are written to the journal and
+  // the cache is within quota
+  void Flush();
+
+  // Description:
+  // Bytes used by the cached tiles and the journal. For a packed tile
+  // store, this is the size of its files, which also hold superseded and
+  // deleted tiles until the store is compacted.
+  vtkTypeInt64 GetDiskUsage();
+
+  // Description:
+  // Number of tiles in the cache. Both this and GetDiskUsage() are 0
+  // until the background thread has scanned the cache.
+  int GetNumberOfTiles();
+
+  // Description:
+  // Total number of tiles deleted to stay within quota
+  vtkTypeInt64 GetNumberOfEvictedTiles();
+
+  // Description:
+  // Threaded method for scanning the cache and evicting tiles
+  void BackgroundThreadExecute();
+
+protected:
+  vtkMapTileDiskCache();
+  ~vtkMapTileDiskCache();
+
+  void ScanCache();
+  void AppendJournal();
+  void CompactJournal();
+  void UpdateStoreSize();
+  vtkTypeInt64 ComputeTilesUsage();
+  vtkTypeInt64 ComputeDiskUsage();
+  bool IsOverQuota();
+  void EvictTiles();
+
+  class vtkMapTileDiskCacheInternals;
+  vtkMapTileDiskCacheInternals *Internals;
+  vtkMutexLock *Lock;
+  vtkConditionVariable *Condition;
+
+private:
+  vtkMapTileDiskCache(const vtkMapTileDiskCache&);  // Not implemented
+  void operator=(const vtkMapTileDiskCache&); // Not implemented
+};
+
+#endif // __vtkMapTileDiskCache_h
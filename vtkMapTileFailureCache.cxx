@@ -0,0 +1,351 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileFailureCache.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileFailureCache.h"
+#include "vtkMapTileIndexInternal.h"
+
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+
+#include <algorithm>
+
+namespace
+{
+  struct FailureRecord
+  {
+    int Failures;        // in a row
+    double RetryTime;    // as vtkTimerLog::GetUniversalTime()
+
+    FailureRecord() : Failures(0), RetryTime(0.0) {}
+  };
+
+  typedef vtkMapTileIndexInternal<FailureRecord> FailureIndex;
+
+  //--------------------------------------------------------------------------
+  // Failures the server is responsible for, rather than the tile
+  bool IsServerFailure(long httpStatus)
+  {
+    return httpStatus == 0 || httpStatus == 429 || httpStatus >= 500;
+  }
+}
+
+vtkStandardNewMacro(vtkMapTileFailureCache)
+
+//----------------------------------------------------------------------------
+class vtkMapTileFailureCache::vtkMapTileFailureCacheInternals
+{
+public:
+  FailureIndex Tiles;
+  double InitialDelay;
+  double MaxDelay;
+  int CircuitBreakerThreshold;
+  double CircuitBreakerDelay;
+
+  int ServerFailures;         // in a row
+  bool CircuitOpen;
+  double CircuitRetryTime;    // when the server is probed next
+  double CircuitDelay;        // current delay, doubled by failed probes
+  bool ProbeInFlight;
+  vtkTypeInt64 SkippedRequests;
+
+  double Backoff(int failures) const
+  {
+    double delay = this->InitialDelay;
+    for (int i = 1; i < failures && delay < this->MaxDelay; ++i)
+      {
+      delay *= 2.0;
+      }
+    return std::min(delay, this->MaxDelay);
+  }
+};
+
+//----------------------------------------------------------------------------
+vtkMapTileFailureCache::vtkMapTileFailureCache()
+{
+  this->Internals = new vtkMapTileFailureCacheInternals;
+  this->Internals->InitialDelay = 5.0;
+  this->Internals->MaxDelay = 3600.0;
+  this->Internals->CircuitBreakerThreshold = 5;
+  this->Internals->CircuitBreakerDelay = 30.0;
+  this->Internals->SkippedRequests = 0;
+  this->Lock = vtkMutexLock::New();
+  this->Reset();
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileFailureCache::~vtkMapTileFailureCache()
+{
+  this->Lock->Delete();
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "InitialDelay: " << this->GetInitialDelay() << "\n"
+     << indent << "MaxDelay: " << this->GetMaxDelay() << "\n"
+     << indent << "CircuitBreakerThreshold: "
+     << this->GetCircuitBreakerThreshold() << "\n"
+     << indent << "CircuitBreakerDelay: "
+     << this->GetCircuitBreakerDelay() << "\n"
+     << indent << "CircuitOpen: " << this->IsCircuitOpen() << "\n"
+     << indent << "NumberOfFailedTiles: "
+     << this->GetNumberOfFailedTiles() << "\n"
+     << indent << "NumberOfSkippedRequests: "
+     << this->GetNumberOfSkippedRequests() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileFailureCache::ShouldRequest(int zoom, int x, int y)
+{
+  vtkMapTileFailureCacheInternals *internals = this->Internals;
+  double now = vtkTimerLog::GetUniversalTime();
+
+  this->Lock->Lock();
+  FailureRecord *record =
+    internals->Tiles.Find(FailureIndex::MakeKey(zoom, x, y));
+  bool result = !record || record->RetryTime <= now;
+  if (result && internals->CircuitOpen)
+    {
+    // Half-open once the delay is over: one request probes the server
+    result = !internals->ProbeInFlight && internals->CircuitRetryTime <= now;
+    internals->ProbeInFlight = internals->ProbeInFlight || result;
+    }
+  if (!result)
+    {
+    ++internals->SkippedRequests;
+    }
+  this->Lock->Unlock();
+  return result;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::RecordSuccess(int zoom, int x, int y)
+{
+  vtkMapTileFailureCacheInternals *internals = this->Internals;
+  this->Lock->Lock();
+  internals->Tiles.Erase(FailureIndex::MakeKey(zoom, x, y));
+  if (internals->CircuitOpen)
+    {
+    vtkDebugMacro("Tile server is back, closing circuit");
+    }
+  internals->ServerFailures = 0;
+  internals->CircuitOpen = false;
+  internals->ProbeInFlight = false;
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::RecordFailure(int zoom, int x, int y,
+                                           long httpStatus)
+{
+  vtkMapTileFailureCacheInternals *internals = this->Internals;
+  vtkTypeUInt64 key = FailureIndex::MakeKey(zoom, x, y);
+  double now = vtkTimerLog::GetUniversalTime();
+
+  this->Lock->Lock();
+  FailureRecord record;
+  FailureRecord *found = internals->Tiles.Find(key);
+  if (found)
+    {
+    record = *found;
+    }
+  ++record.Failures;
+  record.RetryTime = now + internals->Backoff(record.Failures);
+  internals->Tiles.Insert(key, record);
+
+  bool probe = internals->ProbeInFlight;
+  internals->ProbeInFlight = false;
+  if (!IsServerFailure(httpStatus))
+    {
+    // The server answered, so it is up
+    internals->ServerFailures = 0;
+    internals->CircuitOpen = false;
+    }
+  else if (internals->CircuitOpen)
+    {
+    if (probe)
+      {
+      // Still down, wait longer before the next probe
+      internals->CircuitDelay =
+        std::min(2.0 * internals->CircuitDelay, internals->MaxDelay);
+      internals->CircuitRetryTime = now + internals->CircuitDelay;
+      }
+    }
+  else if (internals->CircuitBreakerThreshold > 0 &&
+           ++internals->ServerFailures >=
+           internals->CircuitBreakerThreshold)
+    {
+    vtkDebugMacro("Tile server failed " << internals->ServerFailures
+                  << " times in a row, opening circuit");
+    internals->CircuitOpen = true;
+    internals->CircuitDelay = internals->CircuitBreakerDelay;
+    internals->CircuitRetryTime = now + internals->CircuitDelay;
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::RecordInvalidTile(int zoom, int x, int y)
+{
+  vtkMapTileFailureCacheInternals *internals = this->Internals;
+  vtkTypeUInt64 key = FailureIndex::MakeKey(zoom, x, y);
+  double now = vtkTimerLog::GetUniversalTime();
+
+  this->Lock->Lock();
+  FailureRecord record;
+  FailureRecord *found = internals->Tiles.Find(key);
+  if (found)
+    {
+    record = *found;
+    }
+  ++record.Failures;
+  record.RetryTime = now + internals->Backoff(record.Failures);
+  internals->Tiles.Insert(key, record);
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileFailureCache::HasFailed(int zoom, int x, int y)
+{
+  this->Lock->Lock();
+  bool failed =
+    this->Internals->Tiles.Find(FailureIndex::MakeKey(zoom, x, y)) != NULL;
+  this->Lock->Unlock();
+  return failed;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileFailureCache::IsBackingOff(int zoom, int x, int y)
+{
+  double now = vtkTimerLog::GetUniversalTime();
+  this->Lock->Lock();
+  FailureRecord *record =
+    this->Internals->Tiles.Find(FailureIndex::MakeKey(zoom, x, y));
+  bool backingOff = record && record->RetryTime > now;
+  this->Lock->Unlock();
+  return backingOff;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileFailureCache::IsCircuitOpen()
+{
+  this->Lock->Lock();
+  bool open = this->Internals->CircuitOpen;
+  this->Lock->Unlock();
+  return open;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::Reset()
+{
+  vtkMapTileFailureCacheInternals *internals = this->Internals;
+  this->Lock->Lock();
+  internals->Tiles.Clear();
+  internals->ServerFailures = 0;
+  internals->CircuitOpen = false;
+  internals->CircuitRetryTime = 0.0;
+  internals->CircuitDelay = internals->CircuitBreakerDelay;
+  internals->ProbeInFlight = false;
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::SetInitialDelay(double seconds)
+{
+  this->Lock->Lock();
+  this->Internals->InitialDelay = std::max(0.0, seconds);
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileFailureCache::GetInitialDelay()
+{
+  this->Lock->Lock();
+  double seconds = this->Internals->InitialDelay;
+  this->Lock->Unlock();
+  return seconds;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::SetMaxDelay(double seconds)
+{
+  this->Lock->Lock();
+  this->Internals->MaxDelay = std::max(0.0, seconds);
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileFailureCache::GetMaxDelay()
+{
+  this->Lock->Lock();
+  double seconds = this->Internals->MaxDelay;
+  this->Lock->Unlock();
+  return seconds;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::SetCircuitBreakerThreshold(int count)
+{
+  this->Lock->Lock();
+  this->Internals->CircuitBreakerThreshold = std::max(0, count);
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileFailureCache::GetCircuitBreakerThreshold()
+{
+  this->Lock->Lock();
+  int count = this->Internals->CircuitBreakerThreshold;
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::SetCircuitBreakerDelay(double seconds)
+{
+  this->Lock->Lock();
+  this->Internals->CircuitBreakerDelay = std::max(0.0, seconds);
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileFailureCache::GetCircuitBreakerDelay()
+{
+  this->Lock->Lock();
+  double seconds = this->Internals->CircuitBreakerDelay;
+  this->Lock->Unlock();
+  return seconds;
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileFailureCache::GetNumberOfFailedTiles()
+{
+  this->Lock->Lock();
+  int count = static_cast<int>(this->Internals->Tiles.Size());
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileFailureCache::GetNumberOfSkippedRequests()
+{
+  this->Lock->Lock();
+  vtkTypeInt64 count = this->Internals->SkippedRequests;
+  this->Lock->Unlock();
+  return count;
+}
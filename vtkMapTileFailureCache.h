@@ -0,0 +1,130 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileFailureCache.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileFailureCache - backoff for failing map-tile downloads
+// .SECTION Description
+// Records failed tile downloads of a vtkOsmLayer, so that missing tiles
+// and unreachable servers are not requested again on every view update.
+//
+// Each failed tile is retried only after a delay, starting at
+// InitialDelay and doubling with every further failure of the tile, up
+// to MaxDelay. Transport errors and server errors (HTTP 5xx and 429)
+// also count against the tile server: after CircuitBreakerThreshold of
+// them in a row, no tile is requested for CircuitBreakerDelay seconds.
+// Then a single request probes the server, and either closes the
+// circuit or keeps it open for twice as long (up to MaxDelay). Other
+// responses, such as 404 for a tile the server does not have, only
+// affect that tile.
+//
+// Tiles are identified by their OSM (zoom, x, y) indices.
+// All methods are thread safe.
+
+#ifndef __vtkMapTileFailureCache_h
+#define __vtkMapTileFailureCache_h
+
+#include "vtkmap_export.h"
+#include <vtkObject.h>
+
+class vtkMutexLock;
+
+class VTKMAP_EXPORT vtkMapTileFailureCache : public vtkObject
+{
+public:
+  static vtkMapTileFailureCache *New();
+  vtkTypeMacro(vtkMapTileFailureCache, vtkObject)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Return true if the tile may be requested now: it is not waiting
+  // for a retry, and the circuit is closed. While the circuit is
+  // half-open, only the first caller gets true, to probe the server.
+  // Requests made after true is returned must be followed by
+  // RecordSuccess() or RecordFailure().
+  bool ShouldRequest(int zoom, int x, int y);
+
+  // Description:
+  // Record the outcome of a request. httpStatus is the response status,
+  // or 0 if there was no response.
+  void RecordSuccess(int zoom, int x, int y);
+  void RecordFailure(int zoom, int x, int y, long httpStatus);
+
+  // Description:
+  // Record a tile whose data turned out to be unusable, e.g. an image
+  // that does not decode. The tile backs off as after a failure, but
+  // the circuit is left as it is, since the data may not come from the
+  // server at all.
+  void RecordInvalidTile(int zoom, int x, int y);
+
+  // Description:
+  // Return true if the last request for the tile failed
+  bool HasFailed(int zoom, int x, int y);
+
+  // Description:
+  // Return true if the tile failed and is waiting for its retry time
+  bool IsBackingOff(int zoom, int x, int y);
+
+  // Description:
+  // Return true while requests to the server are suspended
+  bool IsCircuitOpen();
+
+  // Description:
+  // Forget all failures, e.g. when the tile server changes
+  void Reset();
+
+  // Description:
+  // Get/Set the delay, in seconds, before the first retry of a failed
+  // tile. Default is 5.
+  void SetInitialDelay(double seconds);
+  double GetInitialDelay();
+
+  // Description:
+  // Get/Set the longest delay, in seconds, between retries of a tile
+  // or probes of the server. Default is 1 hour.
+  void SetMaxDelay(double seconds);
+  double GetMaxDelay();
+
+  // Description:
+  // Get/Set the number of server failures in a row that opens the
+  // circuit. 0 disables the circuit breaker. Default is 5.
+  void SetCircuitBreakerThreshold(int count);
+  int GetCircuitBreakerThreshold();
+
+  // Description:
+  // Get/Set the delay, in seconds, before the server is probed after
+  // the circuit opens. Default is 30.
+  void SetCircuitBreakerDelay(double seconds);
+  double GetCircuitBreakerDelay();
+
+  // Description:
+  // Number of tiles whose last request failed
+  int GetNumberOfFailedTiles();
+
+  // Description:
+  // Number of requests refused by ShouldRequest()
+  vtkTypeInt64 GetNumberOfSkippedRequests();
+
+protected:
+  vtkMapTileFailureCache();
+  ~vtkMapTileFailureCache();
+
+  class vtkMapTileFailureCacheInternals;
+  vtkMapTileFailureCacheInternals *Internals;
+  vtkMutexLock *Lock;
+
+private:
+  vtkMapTileFailureCache(const vtkMapTileFailureCache&);  // Not implemented
+  void operator=(const vtkMapTileFailureCache&); // Not implemented
+};
+
+#endif // __vtkMapTileFailureCache_h
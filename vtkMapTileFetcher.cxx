@@ -0,0 +1,435 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileFetcher.h"
+#include "vtkMapTileCacheInfo.h"
+
+#include <vtkAtomic.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+
+vtkStandardNewMacro(vtkMapTileFetcher)
+
+namespace
+{
+  //--------------------------------------------------------------------------
+  size_t AppendToBuffer(void *contents, size_t size, size_t nmemb,
+                        void *userData)
+  {
+    std::vector<unsigned char> *buffer =
+      static_cast<std::vector<unsigned char>*>(userData);
+    unsigned char *bytes = static_cast<unsigned char*>(contents);
+    buffer->insert(buffer->end(), bytes, bytes + size * nmemb);
+    return size * nmemb;
+  }
+
+  //--------------------------------------------------------------------------
+  size_t AppendToString(void *contents, size_t size, size_t nmemb,
+                        void *userData)
+  {
+    static_cast<std::string*>(userData)->append(
+      static_cast<char*>(contents), size * nmemb);
+    return size * nmemb;
+  }
+
+  //--------------------------------------------------------------------------
+  // Update info from the caching headers of the last response in
+  // headers. Validators missing from the response are kept if
+  // keepValidators is set, as 304 responses need not repeat them.
+  void ParseCacheHeaders(const std::string& headers, bool keepValidators,
+                         vtkMapTileCacheInfo& info)
+  {
+    std::string etag, lastModified, cacheControl, expires, date;
+    double age = 0.0;
+    std::istringstream stream(headers);
+    std::string line;
+    while (std::getline(stream, line))
+      {
+      if (line.compare(0, 5, "HTTP/") == 0)
+        {
+        // Response after a redirect or an interim response
+        etag.clear();
+        lastModified.clear();
+        cacheControl.clear();
+        expires.clear();
+        date.clear();
+        age = 0.0;
+        continue;
+        }
+      std::size_t colon = line.find(':');
+      if (colon == std::string::npos)
+        {
+        continue;
+        }
+      std::string name = line.substr(0, colon);
+      std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+      std::size_t first = line.find_first_not_of(" \t", colon + 1);
+      std::size_t last = line.find_last_not_of(" \t\r");
+      std::string value = first == std::string::npos || last < first ?
+        std::string() : line.substr(first, last - first + 1);
+      if (name == "etag")
+        {
+        etag = value;
+        }
+      else if (name == "last-modified")
+        {
+        lastModified = value;
+        }
+      else if (name == "cache-control")
+        {
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+        cacheControl += value + ",";
+        }
+      else if (name == "expires")
+        {
+        expires = value;
+        }
+      else if (name == "date")
+        {
+        date = value;
+        }
+      else if (name == "age")
+        {
+        age = atof(value.c_str());
+        }
+      }
+
+    if (!keepValidators || !etag.empty())
+      {
+      info.ETag = etag;
+      }
+    if (!keepValidators || !lastModified.empty())
+      {
+      info.LastModified = lastModified;
+      }
+
+    // Cache-Control takes precedence over Expires, which is relative to
+    // the server's Date in case the clocks differ
+    double now = vtkTimerLog::GetUniversalTime();
+    std::size_t maxAge = cacheControl.find("max-age=");
+    if (cacheControl.find("no-cache") != std::string::npos ||
+        cacheControl.find("no-store") != std::string::npos)
+      {
+      info.Expires = now;
+      }
+    else if (maxAge != std::string::npos)
+      {
+      info.Expires = now + std::max(0.0,
+        atof(cacheControl.c_str() + maxAge + 8) - age);
+      }
+    else if (!expires.empty())
+      {
+      time_t expiresTime = curl_getdate(expires.c_str(), NULL);
+      time_t dateTime = date.empty() ? -1 : curl_getdate(date.c_str(), NULL);
+      if (expiresTime == -1)
+        {
+        // Invalid dates, such as "0", mean already expired
+        info.Expires = now;
+        }
+      else
+        {
+        double base = dateTime == -1 ? now : static_cast<double>(dateTime);
+        info.Expires = now + std::max(0.0,
+          static_cast<double>(expiresTime) - base);
+        }
+      }
+    else
+      {
+      info.Expires = 0.0;
+      }
+  }
+}
+
+//----------------------------------------------------------------------------
+class vtkMapTileFetcher::vtkMapTileFetcherInternals
+{
+public:
+  // Shared DNS, TLS session and connection caches, with one lock per
+  // kind of shared data as libcurl asks for
+  CURLSH *Share;
+  vtkMutexLock *ShareLocks[CURL_LOCK_DATA_LAST];
+
+  // Handles not in use by a request
+  std::vector<CURL*> IdleHandles;
+  vtkMutexLock *HandlesLock;
+
+  vtkAtomic<vtkTypeInt64> NumberOfRequests;
+  vtkAtomic<vtkTypeInt64> NumberOfConnections;
+  vtkAtomic<vtkTypeInt64> NumberOfNotModified;
+
+  static void LockShare(CURL *, curl_lock_data data, curl_lock_access,
+                        void *userData)
+  {
+    static_cast<vtkMapTileFetcherInternals*>(userData)->
+      ShareLocks[data]->Lock();
+  }
+
+  static void UnlockShare(CURL *, curl_lock_data data, void *userData)
+  {
+    static_cast<vtkMapTileFetcherInternals*>(userData)->
+      ShareLocks[data]->Unlock();
+  }
+};
+
+//----------------------------------------------------------------------------
+vtkMapTileFetcher::vtkMapTileFetcher()
+{
+  this->UseHttp2 = true;
+  this->MaxIdleConnections = 16;
+
+  // Not thread safe, so done here rather than implicitly by the first
+  // curl_easy_init() in a download thread
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+
+  this->Internals = new vtkMapTileFetcherInternals;
+  this->Internals->HandlesLock = vtkMutexLock::New();
+  this->Internals->NumberOfRequests = 0;
+  this->Internals->NumberOfConnections = 0;
+  this->Internals->NumberOfNotModified = 0;
+  for (int i = 0; i < CURL_LOCK_DATA_LAST; ++i)
+    {
+    this->Internals->ShareLocks[i] = vtkMutexLock::New();
+    }
+
+  CURLSH *share = curl_share_init();
+  this->Internals->Share = share;
+  if (share)
+    {
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC,
+                      vtkMapTileFetcherInternals::LockShare);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC,
+                      vtkMapTileFetcherInternals::UnlockShare);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this->Internals);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileFetcher::~vtkMapTileFetcher()
+{
+  // Handles first, the share cannot be cleaned up while in use
+  std::vector<CURL*>& handles = this->Internals->IdleHandles;
+  for (std::size_t i = 0; i < handles.size(); ++i)
+    {
+    curl_easy_cleanup(handles[i]);
+    }
+  if (this->Internals->Share)
+    {
+    curl_share_cleanup(this->Internals->Share);
+    }
+  for (int i = 0; i < CURL_LOCK_DATA_LAST; ++i)
+    {
+    this->Internals->ShareLocks[i]->Delete();
+    }
+  this->Internals->HandlesLock->Delete();
+  delete this->Internals;
+  curl_global_cleanup();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFetcher::PrintSelf(ostream &os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "UseHttp2: " << this->UseHttp2 << "\n"
+     << indent << "MaxIdleConnections: " << this->MaxIdleConnections << "\n"
+     << indent << "NumberOfRequests: " << this->GetNumberOfRequests() << "\n"
+     << indent << "NumberOfConnections: " << this->GetNumberOfConnections()
+     << "\n"
+     << indent << "NumberOfNotModified: " << this->GetNumberOfNotModified()
+     << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileFetcher::Fetch(const std::string& url,
+                              std::vector<unsigned char>& data,
+                              long *httpStatus, std::string *errorMessage,
+                              vtkMapTileCacheInfo *cacheInfo)
+{
+  data.clear();
+  if (httpStatus)
+    {
+    *httpStatus = 0;
+    }
+
+  // Reuse an idle handle, which keeps its connection open
+  CURL *curl = NULL;
+  this->Internals->HandlesLock->Lock();
+  if (!this->Internals->IdleHandles.empty())
+    {
+    curl = this->Internals->IdleHandles.back();
+    this->Internals->IdleHandles.pop_back();
+    }
+  this->Internals->HandlesLock->Unlock();
+  if (!curl)
+    {
+    curl = curl_easy_init();
+    if (!curl)
+      {
+      if (errorMessage)
+        {
+        *errorMessage = "curl_easy_init() failed";
+        }
+      return false;
+      }
+    if (this->Internals->Share)
+      {
+      curl_easy_setopt(curl, CURLOPT_SHARE, this->Internals->Share);
+      }
+    // prevent random crashes due to thread-unsafe signals (see https://stackoverflow.com/a/22957000)
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, AppendToBuffer);
+    }
+
+  // Conditional request with the validators of the cached tile, and
+  // response headers for the new ones and the expiry time
+  struct curl_slist *requestHeaders = NULL;
+  std::string responseHeaders;
+  if (cacheInfo)
+    {
+    if (!cacheInfo->ETag.empty())
+      {
+      requestHeaders = curl_slist_append(requestHeaders,
+        ("If-None-Match: " + cacheInfo->ETag).c_str());
+      }
+    if (!cacheInfo->LastModified.empty())
+      {
+      requestHeaders = curl_slist_append(requestHeaders,
+        ("If-Modified-Since: " + cacheInfo->LastModified).c_str());
+      }
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, AppendToString);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &responseHeaders);
+    }
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, requestHeaders);
+
+  char errorBuffer[CURL_ERROR_SIZE];
+  errorBuffer[0] = '\0';
+  long status = 0;
+  long numConnects = 0;
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errorBuffer);
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &data);
+  curl_easy_setopt(curl, CURLOPT_MAXCONNECTS,
+                   static_cast<long>(this->MaxIdleConnections));
+#if LIBCURL_VERSION_NUM >= 0x072f00
+  curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, this->UseHttp2 ?
+                   CURL_HTTP_VERSION_2TLS : CURL_HTTP_VERSION_1_1);
+#endif
+  CURLcode res = curl_easy_perform(curl);
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+  // -1 if the response has no Content-Length header
+#if LIBCURL_VERSION_NUM >= 0x073700
+  curl_off_t contentLength = -1;
+  curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &contentLength);
+#else
+  double contentLength = -1.0;
+  curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &contentLength);
+#endif
+  curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &numConnects);
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, NULL);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, NULL);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, NULL);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, NULL);
+  curl_slist_free_all(requestHeaders);
+
+  this->Internals->NumberOfRequests++;
+  this->Internals->NumberOfConnections += numConnects;
+  this->Internals->HandlesLock->Lock();
+  this->Internals->IdleHandles.push_back(curl);
+  this->Internals->HandlesLock->Unlock();
+
+  if (httpStatus)
+    {
+    *httpStatus = status;
+    }
+  if (res != CURLE_OK)
+    {
+    if (errorMessage)
+      {
+      *errorMessage = errorBuffer[0] ? errorBuffer : curl_easy_strerror(res);
+      }
+    data.clear();
+    return false;
+    }
+  if (cacheInfo && status == 304 && requestHeaders)
+    {
+    // Cached tile is still valid
+    this->Internals->NumberOfNotModified++;
+    ParseCacheHeaders(responseHeaders, true, *cacheInfo);
+    data.clear();
+    return true;
+    }
+  if (status != 200 || data.empty())
+    {
+    if (errorMessage)
+      {
+      std::stringstream ss;
+      ss << "status " << status;
+      *errorMessage = ss.str();
+      }
+    data.clear();
+    return false;
+    }
+  if (contentLength >= 0 &&
+      static_cast<double>(contentLength) != static_cast<double>(data.size()))
+    {
+    // Truncated response
+    if (errorMessage)
+      {
+      std::stringstream ss;
+      ss << "received " << data.size() << " of " << contentLength
+         << " bytes";
+      *errorMessage = ss.str();
+      }
+    data.clear();
+    return false;
+    }
+
+  if (cacheInfo)
+    {
+    ParseCacheHeaders(responseHeaders, false, *cacheInfo);
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileFetcher::GetNumberOfRequests()
+{
+  return this->Internals->NumberOfRequests;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileFetcher::GetNumberOfConnections()
+{
+  return this->Internals->NumberOfConnections;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileFetcher::GetNumberOfNotModified()
+{
+  return this->Internals->NumberOfNotModified;
+}
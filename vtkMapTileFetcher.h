@@ -0,0 +1,103 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileFetcher - map-tile downloads over reused connections
+// .SECTION Description
+// Downloads map tiles with libcurl, keeping connections open between
+// requests instead of paying for a new TCP and TLS handshake and DNS
+// lookup per tile. Curl handles are pooled rather than created for each
+// request, and all of them share one DNS cache, TLS session cache and,
+// with libcurl 7.57 or later, connection cache, so that any thread can
+// reuse a connection opened by another. HTTP/2 is used with servers
+// that support it over TLS, which saves header bytes and lets a
+// connection opened by one thread serve the others' later requests.
+// Requests run concurrently on separate connections, as each thread
+// performs its own transfers.
+//
+// Each vtkOsmLayer owns a fetcher used for all of its downloads.
+// All methods are thread safe.
+
+#ifndef __vtkMapTileFetcher_h
+#define __vtkMapTileFetcher_h
+
+#include "vtkmap_export.h"
+#include <vtkObject.h>
+
+#include <string>
+#include <vector>
+
+class vtkMapTileCacheInfo;
+
+class VTKMAP_EXPORT vtkMapTileFetcher : public vtkObject
+{
+public:
+  static vtkMapTileFetcher *New();
+  vtkTypeMacro(vtkMapTileFetcher, vtkObject)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Download url into memory. Returns false on transfer errors, and
+  // unless the server responded with status 200 and a non-empty body,
+  // as long as its Content-Length header says.
+  // If not NULL, httpStatus is set to the response status (0 if there
+  // was no response), and errorMessage describes the failure.
+  //
+  // If cacheInfo is not NULL, the request is conditional on its
+  // validators, and cacheInfo is updated from the response headers.
+  // A 304 (Not Modified) response then also returns true, with data
+  // left empty. The expiry time is left at 0 if the response has no
+  // Cache-Control max-age or Expires header.
+  bool Fetch(const std::string& url, std::vector<unsigned char>& data,
+             long *httpStatus = NULL, std::string *errorMessage = NULL,
+             vtkMapTileCacheInfo *cacheInfo = NULL);
+
+  // Description:
+  // Get/Set whether HTTP/2 is negotiated with servers that support it
+  // over TLS. Plain http requests always use HTTP/1.1. Default is on.
+  vtkGetMacro(UseHttp2, bool);
+  vtkSetMacro(UseHttp2, bool);
+  vtkBooleanMacro(UseHttp2, bool);
+
+  // Description:
+  // Get/Set the maximum number of idle connections kept open.
+  // Default is 16.
+  vtkGetMacro(MaxIdleConnections, int);
+  vtkSetClampMacro(MaxIdleConnections, int, 1, VTK_INT_MAX);
+
+  // Description:
+  // Number of requests made, and number of new connections opened for
+  // them. With connection reuse, the latter stays close to the number
+  // of concurrent requests.
+  vtkTypeInt64 GetNumberOfRequests();
+  vtkTypeInt64 GetNumberOfConnections();
+
+  // Description:
+  // Number of conditional requests answered with 304 (Not Modified)
+  vtkTypeInt64 GetNumberOfNotModified();
+
+protected:
+  vtkMapTileFetcher();
+  ~vtkMapTileFetcher();
+
+  bool UseHttp2;
+  int MaxIdleConnections;
+
+  class vtkMapTileFetcherInternals;
+  vtkMapTileFetcherInternals *Internals;
+
+private:
+  vtkMapTileFetcher(const vtkMapTileFetcher&);  // Not implemented
+  void operator=(const vtkMapTileFetcher&); // Not implemented
+};
+
+#endif // __vtkMapTileFetcher_h
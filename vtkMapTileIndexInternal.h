@@ -0,0 +1,264 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileIndexInternal.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileIndexInternal - flat hash table keyed by tile (zoom, x, y)
+// .SECTION Description
+// Open-addressing hash table (linear probing, backward-shift deletion)
+// mapping a 64-bit packed tile key to a value. Lookups never allocate.
+// Used internally by vtkOsmLayer and subclasses.
+
+#ifndef __vtkMapTileIndexInternal_h
+#define __vtkMapTileIndexInternal_h
+
+#include <vtkType.h>
+
+#include <cstddef>
+#include <vector>
+
+template <typename ValueType>
+class vtkMapTileIndexInternal
+{
+public:
+  vtkMapTileIndexInternal();
+
+  // Description:
+  // Pack (zoom, x, y) into a single key. Zoom occupies the top 6 bits,
+  // x and y 29 bits each, which covers every valid tile up to zoom 29.
+  static vtkTypeUInt64 MakeKey(int zoom, int x, int y);
+  static void SplitKey(vtkTypeUInt64 key, int& zoom, int& x, int& y);
+
+  // Description:
+  // Return pointer to the value stored for key, or NULL if not present
+  ValueType *Find(vtkTypeUInt64 key);
+
+  // Description:
+  // Insert or replace the value stored for key
+  void Insert(vtkTypeUInt64 key, const ValueType& value);
+
+  // Description:
+  // Remove key, returns true if it was present
+  bool Erase(vtkTypeUInt64 key);
+
+  void Clear();
+  std::size_t Size() const { return this->Count; }
+
+  // Description:
+  // Append all keys, in no particular order
+  void GetKeys(std::vector<vtkTypeUInt64>& keys) const;
+
+private:
+  struct Slot
+  {
+    vtkTypeUInt64 Key;
+    ValueType Value;
+  };
+
+  // All-ones cannot be produced by MakeKey() (zoom would be 63)
+  static vtkTypeUInt64 EmptyKey() { return ~static_cast<vtkTypeUInt64>(0); }
+
+  std::size_t Bucket(vtkTypeUInt64 key) const;
+  void Grow();
+
+  std::vector<Slot> Slots;  // capacity is always a power of two
+  std::size_t Mask;
+  std::size_t Count;
+};
+
+//----------------------------------------------------------------------------
+template <typename ValueType>
+inline vtkMapTileIndexInternal<ValueType>::vtkMapTileIndexInternal()
+{
+  this->Mask = 0;
+  this->Count = 0;
+}
+
+//----------------------------------------------------------------------------
+template <typename ValueType>
+inline vtkTypeUInt64
+vtkMapTileIndexInternal<ValueType>::MakeKey(int zoom, int x, int y)
+{
+  const vtkTypeUInt64 mask29 = (static_cast<vtkTypeUInt64>(1) << 29) - 1;
+  return (static_cast<vtkTypeUInt64>(zoom & 0x3f) << 58) |
+    ((static_cast<vtkTypeUInt64>(x) & mask29) << 29) |
+    (static_cast<vtkTypeUInt64>(y) & mask29);
+}
+
+//----------------------------------------------------------------------------
+template <typename ValueType>
+inline void vtkMapTileIndexInternal<ValueType>::SplitKey(
+  vtkTypeUInt64 key, int& zoom, int& x, int& y)
+{
+  const vtkTypeUInt64 mask29 = (static_cast<vtkTypeUInt64>(1) << 29) - 1;
+  zoom = static_cast<int>(key >> 58);
+  x = static_cast<int>((key >> 29) & mask29);
+  y = static_cast<int>(key & mask29);
+}
+
+//----------------------------------------------------------------------------
+template <typename ValueType>
+inline std::size_t
+vtkMapTileIndexInternal<ValueType>::Bucket(vtkTypeUInt64 key) const
+{
+  // Finalizer from splitmix64, spreads neighboring tiles across buckets
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31;
+  return static_cast<std::size_t>(key) & this->Mask;
+}
+
+//----------------------------------------------------------------------------
+template <typename ValueType>
+inline ValueType *vtkMapTileIndexInternal<ValueType>::Find(vtkTypeUInt64 key)
+{
+  if (this->Count == 0)
+    {
+    return NULL;
+    }
+
+  std::size_t i = this->Bucket(key);
+  while (this->Slots[i].Key != EmptyKey())
+    {
+    if (this->Slots[i].Key == key)
+      {
+      return &this->Slots[i].Value;
+      }
+    i = (i + 1) & this->Mask;
+    }
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+template <typename ValueType>
+inline void vtkMapTileIndexInternal<ValueType>::Insert(
+  vtkTypeUInt64 key, const ValueType& value)
+{
+  // Keep load factor at or below 1/2 so probe sequences stay short
+  if (2 * (this->Count + 1) > this->Slots.size())
+    {
+    this->Grow();
+    }
+
+  std::size_t i = this->Bucket(key);
+  while (this->Slots[i].Key != EmptyKey())
+    {
+    if (this->Slots[i].Key == key)
+      {
+      this->Slots[i].Value = value;
+      return;
+      }
+    i = (i + 1) & this->Mask;
+    }
+  this->Slots[i].Key = key;
+  this->Slots[i].Value = value;
+  ++this->Count;
+}
+
+//----------------------------------------------------------------------------
+template <typename ValueType>
+inline bool vtkMapTileIndexInternal<ValueType>::Erase(vtkTypeUInt64 key)
+{
+  if (this->Count == 0)
+    {
+    return false;
+    }
+
+  std::size_t i = this->Bucket(key);
+  while (this->Slots[i].Key != key)
+    {
+    if (this->Slots[i].Key == EmptyKey())
+      {
+      return false;
+      }
+    i = (i + 1) & this->Mask;
+    }
+
+  // Backward-shift deletion: move later entries of the probe sequence
+  // into the hole, so that no tombstones are needed
+  std::size_t hole = i;
+  std::size_t j = i;
+  for (;;)
+    {
+    j = (j + 1) & this->Mask;
+    if (this->Slots[j].Key == EmptyKey())
+      {
+      break;
+      }
+    std::size_t home = this->Bucket(this->Slots[j].Key);
+    // Entry at j may fill the hole only if its home bucket does not
+    // lie cyclically in (hole, j]
+    bool movable = (hole <= j) ? (home <= hole || home > j)
+                               : (home <= hole && home > j);
+    if (movable)
+      {
+      this->Slots[hole] = this->Slots[j];
+      hole = j;
+      }
+    }
+  this->Slots[hole].Key = EmptyKey();
+  this->Slots[hole].Value = ValueType();
+  --this->Count;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+template <typename ValueType>
+inline void vtkMapTileIndexInternal<ValueType>::Clear()
+{
+  this->Slots.clear();
+  this->Mask = 0;
+  this->Count = 0;
+}
+
+//----------------------------------------------------------------------------
+template <typename ValueType>
+inline void vtkMapTileIndexInternal<ValueType>::GetKeys(
+  std::vector<vtkTypeUInt64>& keys) const
+{
+  typename std::vector<Slot>::const_iterator iter = this->Slots.begin();
+  for (; iter != this->Slots.end(); iter++)
+    {
+    if (iter->Key != EmptyKey())
+      {
+      keys.push_back(iter->Key);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+template <typename ValueType>
+inline void vtkMapTileIndexInternal<ValueType>::Grow()
+{
+  std::size_t capacity = this->Slots.empty() ? 64 : 2 * this->Slots.size();
+  Slot empty;
+  empty.Key = EmptyKey();
+  empty.Value = ValueType();
+
+  std::vector<Slot> oldSlots(capacity, empty);
+  oldSlots.swap(this->Slots);
+  this->Mask = capacity - 1;
+  this->Count = 0;
+
+  typename std::vector<Slot>::const_iterator iter = oldSlots.begin();
+  for (; iter != oldSlots.end(); iter++)
+    {
+    if (iter->Key != EmptyKey())
+      {
+      this->Insert(iter->Key, iter->Value);
+      }
+    }
+}
+
+#endif // __vtkMapTileIndexInternal_h
@@ -0,0 +1,336 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileMetrics.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileMetrics.h"
+
+#include <vtkAtomic.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+
+#include <cmath>
+
+vtkStandardNewMacro(vtkMapTileMetrics)
+
+namespace
+{
+const char *CounterNames[vtkMapTileMetrics::NumberOfCounters] =
+{
+  "LayerCacheHits",
+  "LayerCacheMisses",
+  "ImageCacheHits",
+  "EncodedCacheHits",
+  "DiskCacheHits",
+  "DiskCacheMisses",
+  "Downloads",
+  "DownloadFailures",
+  "DownloadedBytes",
+  "DecodedTiles",
+  "DecodeFailures",
+  "EvictedTiles",
+  "CancelledRequests"
+};
+
+const char *HistogramNames[vtkMapTileMetrics::NumberOfHistograms] =
+{
+  "DownloadTime",
+  "DecodeTime",
+  "QueueDepth",
+  "TilesPerResolve"
+};
+
+// Histogram sums are kept in thousandths, to stay integers
+const double SumScale = 1000.0;
+
+// Histogram updated by any thread
+struct AtomicHistogram
+{
+  vtkAtomic<vtkTypeInt64> Count;
+  vtkAtomic<vtkTypeInt64> Sum;
+  vtkAtomic<vtkTypeInt64> Buckets[vtkMapTileMetrics::NumberOfBuckets];
+};
+}
+
+//----------------------------------------------------------------------------
+class vtkMapTileMetrics::vtkMapTileMetricsInternals
+{
+public:
+  vtkAtomic<vtkTypeInt64> Counters[NumberOfCounters];
+  AtomicHistogram Histograms[NumberOfHistograms];
+};
+
+//----------------------------------------------------------------------------
+vtkMapTileMetrics::vtkMapTileMetrics()
+{
+  this->Internals = new vtkMapTileMetricsInternals;
+  this->Reset();
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileMetrics::~vtkMapTileMetrics()
+{
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileMetrics::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  vtkMapTileMetricsSnapshot snapshot;
+  this->GetSnapshot(snapshot);
+  for (int i = 0; i < NumberOfCounters; ++i)
+    {
+    os << indent << CounterNames[i] << ": " << snapshot.Counters[i] << "\n";
+    }
+  for (int i = 0; i < NumberOfHistograms; ++i)
+    {
+    const vtkMapTileMetricsSnapshot::Histogram& histogram =
+      snapshot.Histograms[i];
+    os << indent << HistogramNames[i] << ": count " << histogram.Count
+       << ", mean " << histogram.GetMean()
+       << ", 90th percentile " << histogram.GetPercentile(0.9) << "\n";
+    }
+  os.flush();
+}
+
+//----------------------------------------------------------------------------
+const char *vtkMapTileMetrics::GetCounterName(int counter)
+{
+  return counter >= 0 && counter < NumberOfCounters ?
+    CounterNames[counter] : NULL;
+}
+
+//----------------------------------------------------------------------------
+const char *vtkMapTileMetrics::GetHistogramName(int histogram)
+{
+  return histogram >= 0 && histogram < NumberOfHistograms ?
+    HistogramNames[histogram] : NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileMetrics::Increment(int counter, vtkTypeInt64 amount)
+{
+  this->Internals->Counters[counter] += amount;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileMetrics::Record(int histogram, double value)
+{
+  AtomicHistogram& target = this->Internals->Histograms[histogram];
+  ++target.Count;
+  target.Sum += static_cast<vtkTypeInt64>(value * SumScale + 0.5);
+  ++target.Buckets[GetBucket(value)];
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileMetrics::GetCounter(int counter)
+{
+  return this->Internals->Counters[counter];
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileMetrics::GetBucket(double value)
+{
+  if (!(value >= 1.0))
+    {
+    return 0;
+    }
+  int exponent;
+  std::frexp(value, &exponent);  // value in [2^(exponent-1), 2^exponent)
+  return exponent < NumberOfBuckets ? exponent : NumberOfBuckets - 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileMetrics::GetSnapshot(vtkMapTileMetricsSnapshot& snapshot)
+{
+  snapshot.Time = vtkTimerLog::GetUniversalTime();
+  for (int i = 0; i < NumberOfCounters; ++i)
+    {
+    snapshot.Counters[i] = this->Internals->Counters[i];
+    }
+  for (int i = 0; i < NumberOfHistograms; ++i)
+    {
+    AtomicHistogram& source = this->Internals->Histograms[i];
+    vtkMapTileMetricsSnapshot::Histogram& histogram = snapshot.Histograms[i];
+    histogram.Count = source.Count;
+    histogram.Sum = static_cast<double>(source.Sum) / SumScale;
+    for (int j = 0; j < NumberOfBuckets; ++j)
+      {
+      histogram.Buckets[j] = source.Buckets[j];
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileMetrics::Reset()
+{
+  for (int i = 0; i < NumberOfCounters; ++i)
+    {
+    this->Internals->Counters[i] = 0;
+    }
+  for (int i = 0; i < NumberOfHistograms; ++i)
+    {
+    AtomicHistogram& histogram = this->Internals->Histograms[i];
+    histogram.Count = 0;
+    histogram.Sum = 0;
+    for (int j = 0; j < NumberOfBuckets; ++j)
+      {
+      histogram.Buckets[j] = 0;
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileMetricsSnapshot::Histogram::GetMean() const
+{
+  return this->Count > 0 ? this->Sum / static_cast<double>(this->Count) : 0.0;
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileMetricsSnapshot::Histogram::GetPercentile(
+  double fraction) const
+{
+  // Bucket counts may be ahead of Count in a snapshot taken while
+  // values are recorded, so add them up
+  vtkTypeInt64 total = 0;
+  for (int i = 0; i < vtkMapTileMetrics::NumberOfBuckets; ++i)
+    {
+    total += this->Buckets[i];
+    }
+  if (total == 0)
+    {
+    return 0.0;
+    }
+  double rank = fraction * static_cast<double>(total);
+  vtkTypeInt64 count = 0;
+  int bucket = 0;
+  for (; bucket < vtkMapTileMetrics::NumberOfBuckets - 1; ++bucket)
+    {
+    count += this->Buckets[bucket];
+    if (static_cast<double>(count) >= rank && count > 0)
+      {
+      break;
+      }
+    }
+  return std::ldexp(1.0, bucket);
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileMetricsSnapshot::vtkMapTileMetricsSnapshot()
+{
+  this->Time = 0.0;
+  for (int i = 0; i < vtkMapTileMetrics::NumberOfCounters; ++i)
+    {
+    this->Counters[i] = 0;
+    }
+  for (int i = 0; i < vtkMapTileMetrics::NumberOfHistograms; ++i)
+    {
+    this->Histograms[i].Count = 0;
+    this->Histograms[i].Sum = 0.0;
+    for (int j = 0; j < vtkMapTileMetrics::NumberOfBuckets; ++j)
+      {
+      this->Histograms[i].Buckets[j] = 0;
+      }
+    }
+  this->NumberOfCachedTiles = 0;
+  this->CacheSize = 0;
+  this->NumberOfScheduledTiles = 0;
+  this->NumberOfPendingTiles = 0;
+  this->NumberOfActiveDownloads = 0;
+}
+
+//----------------------------------------------------------------------------
+// Tiles drawn from memory, from disk and downloaded
+static void CountTileOrigins(const vtkMapTileMetricsSnapshot& snapshot,
+                             double origins[3])
+{
+  const vtkTypeInt64 *counters = snapshot.Counters;
+  origins[0] = static_cast<double>(
+    counters[vtkMapTileMetrics::LayerCacheHits] +
+    counters[vtkMapTileMetrics::ImageCacheHits] +
+    counters[vtkMapTileMetrics::EncodedCacheHits]);
+  origins[1] = static_cast<double>(counters[vtkMapTileMetrics::DiskCacheHits]);
+  origins[2] = static_cast<double>(
+    counters[vtkMapTileMetrics::Downloads] -
+    counters[vtkMapTileMetrics::DownloadFailures]);
+}
+
+//----------------------------------------------------------------------------
+static double GetOriginRate(const vtkMapTileMetricsSnapshot& snapshot,
+                            int origin)
+{
+  double origins[3];
+  CountTileOrigins(snapshot, origins);
+  double total = origins[0] + origins[1] + origins[2];
+  return total > 0.0 ? origins[origin] / total : 0.0;
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileMetricsSnapshot::GetMemoryHitRate() const
+{
+  return GetOriginRate(*this, 0);
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileMetricsSnapshot::GetDiskHitRate() const
+{
+  return GetOriginRate(*this, 1);
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileMetricsSnapshot::GetDownloadRate() const
+{
+  return GetOriginRate(*this, 2);
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileMetricsSnapshot::PrintJson(ostream& os) const
+{
+  std::streamsize precision = os.precision(6);
+  os << "{\"Time\": " << std::fixed << this->Time << ", \"Counters\": {";
+  os.unsetf(std::ios_base::floatfield);
+  for (int i = 0; i < vtkMapTileMetrics::NumberOfCounters; ++i)
+    {
+    os << (i > 0 ? ", " : "") << "\""
+       << vtkMapTileMetrics::GetCounterName(i) << "\": " << this->Counters[i];
+    }
+  os << "}, \"Histograms\": {";
+  for (int i = 0; i < vtkMapTileMetrics::NumberOfHistograms; ++i)
+    {
+    const Histogram& histogram = this->Histograms[i];
+    os << (i > 0 ? ", " : "") << "\""
+       << vtkMapTileMetrics::GetHistogramName(i) << "\": {"
+       << "\"Count\": " << histogram.Count
+       << ", \"Mean\": " << histogram.GetMean()
+       << ", \"P50\": " << histogram.GetPercentile(0.5)
+       << ", \"P90\": " << histogram.GetPercentile(0.9)
+       << ", \"P99\": " << histogram.GetPercentile(0.99)
+       << ", \"Buckets\": [";
+    for (int j = 0; j < vtkMapTileMetrics::NumberOfBuckets; ++j)
+      {
+      os << (j > 0 ? ", " : "") << histogram.Buckets[j];
+      }
+    os << "]}";
+    }
+  os << "}, \"MemoryHitRate\": " << this->GetMemoryHitRate()
+     << ", \"DiskHitRate\": " << this->GetDiskHitRate()
+     << ", \"DownloadRate\": " << this->GetDownloadRate()
+     << ", \"NumberOfCachedTiles\": " << this->NumberOfCachedTiles
+     << ", \"CacheSize\": " << this->CacheSize
+     << ", \"NumberOfScheduledTiles\": " << this->NumberOfScheduledTiles
+     << ", \"NumberOfPendingTiles\": " << this->NumberOfPendingTiles
+     << ", \"NumberOfActiveDownloads\": " << this->NumberOfActiveDownloads
+     << "}";
+  os.precision(precision);
+}
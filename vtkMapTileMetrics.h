@@ -0,0 +1,163 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileMetrics.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileMetrics - counters and histograms of a tile layer
+// .SECTION Description
+// Instrumentation of the tile pipeline of a vtkOsmLayer: where tiles
+// come from (layer cache, shared image cache, encoded tiles kept in
+// memory, disk cache, tile source), download and decode times, bytes
+// downloaded, request queue depths, tiles added per ResolveAsync() and
+// evictions.
+//
+// Counters and histograms are updated with atomic operations only, so
+// request threads never wait on each other to record them. A snapshot,
+// see vtkOsmLayer::GetMetricsSnapshot(), copies them together with the
+// current state of the layer, e.g. for printing as JSON. Snapshots
+// taken while tiles load are consistent per value, not across values.
+//
+// Histograms have power-of-two buckets: bucket 0 counts values below 1,
+// and bucket i values in [2^(i-1), 2^i). Times are in milliseconds.
+
+#ifndef __vtkMapTileMetrics_h
+#define __vtkMapTileMetrics_h
+
+#include "vtkmap_export.h"
+#include <vtkObject.h>
+
+class vtkMapTileMetricsSnapshot;
+
+class VTKMAP_EXPORT vtkMapTileMetrics : public vtkObject
+{
+public:
+  static vtkMapTileMetrics *New();
+  vtkTypeMacro(vtkMapTileMetrics, vtkObject)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Counters
+  enum Counter
+  {
+    LayerCacheHits = 0,     // tiles in view cached by the layer
+    LayerCacheMisses,       // tiles in view to load
+    ImageCacheHits,         // tiles sharing a decoded image
+    EncodedCacheHits,       // tiles decoded from bytes kept in memory
+    DiskCacheHits,          // tiles read from the disk cache
+    DiskCacheMisses,        // disk cache lookups without the tile
+    Downloads,              // tiles fetched from the tile source
+    DownloadFailures,       // failed or invalid fetches
+    DownloadedBytes,        // bytes of the tiles fetched
+    DecodedTiles,           // images decoded
+    DecodeFailures,         // images that could not be decoded
+    EvictedTiles,           // tiles evicted from the layer cache
+    CancelledRequests,      // queued requests for tiles left out of view
+    NumberOfCounters
+  };
+
+  // Description:
+  // Histograms
+  enum Histogram
+  {
+    DownloadTime = 0,       // milliseconds per fetch
+    DecodeTime,             // milliseconds per decoded image
+    QueueDepth,             // queued requests after each view update
+    TilesPerResolve,        // tiles added by each ResolveAsync() call
+    NumberOfHistograms
+  };
+
+  enum { NumberOfBuckets = 32 };
+
+  // Description:
+  // Name of a counter or histogram, as printed
+  static const char *GetCounterName(int counter);
+  static const char *GetHistogramName(int histogram);
+
+  // Description:
+  // Add to a counter, or record a value in a histogram. Thread safe and
+  // lock free.
+  void Increment(int counter, vtkTypeInt64 amount = 1);
+  void Record(int histogram, double value);
+
+  // Description:
+  // Current value of a counter
+  vtkTypeInt64 GetCounter(int counter);
+
+  // Description:
+  // Copy the counters and histograms into the snapshot
+  void GetSnapshot(vtkMapTileMetricsSnapshot& snapshot);
+
+  // Description:
+  // Set all counters and histograms back to 0
+  void Reset();
+
+  // Description:
+  // Bucket of a histogram value
+  static int GetBucket(double value);
+
+protected:
+  vtkMapTileMetrics();
+  ~vtkMapTileMetrics();
+
+  class vtkMapTileMetricsInternals;
+  vtkMapTileMetricsInternals *Internals;
+
+private:
+  vtkMapTileMetrics(const vtkMapTileMetrics&);  // Not implemented
+  void operator=(const vtkMapTileMetrics&); // Not implemented
+};
+
+// Description:
+// Values of the metrics of a layer at one time
+class VTKMAP_EXPORT vtkMapTileMetricsSnapshot
+{
+public:
+  class Histogram
+  {
+  public:
+    vtkTypeInt64 Count;
+    double Sum;
+    vtkTypeInt64 Buckets[vtkMapTileMetrics::NumberOfBuckets];
+
+    double GetMean() const;
+
+    // Upper bound of the bucket holding the given fraction (0 to 1) of
+    // the values, i.e. an estimate within a factor of 2
+    double GetPercentile(double fraction) const;
+  };
+
+  double Time;  // as vtkTimerLog::GetUniversalTime()
+  vtkTypeInt64 Counters[vtkMapTileMetrics::NumberOfCounters];
+  Histogram Histograms[vtkMapTileMetrics::NumberOfHistograms];
+
+  // State of the layer when the snapshot was taken
+  int NumberOfCachedTiles;
+  vtkTypeInt64 CacheSize;
+  int NumberOfScheduledTiles;   // asynchronous layers only
+  int NumberOfPendingTiles;     // asynchronous layers only
+  int NumberOfActiveDownloads;  // asynchronous layers only
+
+  vtkMapTileMetricsSnapshot();
+
+  // Description:
+  // Fractions of the tiles drawn that were found in memory (layer or
+  // shared caches), on disk, or downloaded. 0 if none were drawn.
+  double GetMemoryHitRate() const;
+  double GetDiskHitRate() const;
+  double GetDownloadRate() const;
+
+  // Description:
+  // Print as one line of JSON, without a line break
+  void PrintJson(ostream& os) const;
+};
+
+#endif // __vtkMapTileMetrics_h
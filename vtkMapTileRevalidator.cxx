@@ -0,0 +1,655 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileRevalidator.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileRevalidator.h"
+#include "vtkMapTileCacheInfo.h"
+#include "vtkMapTileFailureCache.h"
+#include "vtkMapTileIndexInternal.h"
+#include "vtkOsmLayer.h"
+#include "vtkPackedTileStore.h"
+#include "vtkTileSource.h"
+
+#include <vtkConditionVariable.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace
+{
+  typedef vtkMapTileIndexInternal<vtkMapTileCacheInfo> CacheInfoIndex;
+
+  // Superseded records tolerated in the sidecar before it is compacted
+  const vtkTypeInt64 MinCompactionRecords = 1024;
+
+  //--------------------------------------------------------------------------
+  // One record per line: zoom, x, y, expiry time, ETag, Last-Modified,
+  // separated by tabs, which header values do not contain
+  std::string FormatRecord(vtkTypeUInt64 key, const vtkMapTileCacheInfo& info)
+  {
+    int zoom, x, y;
+    CacheInfoIndex::SplitKey(key, zoom, x, y);
+    std::stringstream ss;
+    ss.precision(15);
+    ss << zoom << '\t' << x << '\t' << y << '\t' << info.Expires << '\t'
+       << info.ETag << '\t' << info.LastModified << '\n';
+    return ss.str();
+  }
+
+  //--------------------------------------------------------------------------
+  bool ParseRecord(const std::string& line, vtkTypeUInt64& key,
+                   vtkMapTileCacheInfo& info)
+  {
+    std::vector<std::string> fields;
+    std::size_t start = 0;
+    for (;;)
+      {
+      std::size_t end = line.find('\t', start);
+      fields.push_back(line.substr(start, end - start));
+      if (end == std::string::npos)
+        {
+        break;
+        }
+      start = end + 1;
+      }
+    if (fields.size() != 6)
+      {
+      return false;
+      }
+    key = CacheInfoIndex::MakeKey(atoi(fields[0].c_str()),
+                                  atoi(fields[1].c_str()),
+                                  atoi(fields[2].c_str()));
+    info.Expires = atof(fields[3].c_str());
+    info.ETag = fields[4];
+    info.LastModified = fields[5];
+    return true;
+  }
+}
+
+vtkStandardNewMacro(vtkMapTileRevalidator)
+
+//----------------------------------------------------------------------------
+class vtkMapTileRevalidator::vtkMapTileRevalidatorInternals
+{
+public:
+  std::string SidecarPath;
+
+  vtkMultiThreader *Threader;
+  int ThreadId;
+
+  // Members below are guarded by Lock. Tiles are revalidated with the
+  // first layer, and reported updated to all of them.
+  std::vector<vtkOsmLayer*> Layers;
+  vtkOsmLayer *ActiveLayer;  // of the revalidation in progress
+  bool Running;
+  CacheInfoIndex Tiles;
+  FILE *Sidecar;
+  vtkTypeInt64 SidecarRecords;
+  std::deque<vtkTypeUInt64> Queue;
+  vtkMapTileIndexInternal<bool> Queued;  // including the active tile
+  bool Active;
+  std::map<vtkOsmLayer*, std::vector<vtkTypeUInt64> > UpdatedTiles;
+  double MaxRequestsPerSecond;
+  double DefaultMaxAge;
+  double NextRequestTime;
+  vtkTypeInt64 NumberOfRevalidations;
+  vtkTypeInt64 NumberOfNotModified;
+  vtkTypeInt64 NumberOfUpdatedTiles;
+};
+
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE StaticBackgroundThreadExecute(void *arg)
+{
+  vtkMapTileRevalidator *self;
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  self = static_cast<vtkMapTileRevalidator*>(info->UserData);
+  self->BackgroundThreadExecute();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileRevalidator::vtkMapTileRevalidator()
+{
+  this->Internals = new vtkMapTileRevalidatorInternals;
+  this->Internals->ActiveLayer = NULL;
+  this->Internals->Threader = vtkMultiThreader::New();
+  this->Internals->ThreadId = -1;
+  this->Internals->Running = false;
+  this->Internals->Sidecar = NULL;
+  this->Internals->SidecarRecords = 0;
+  this->Internals->Active = false;
+  this->Internals->MaxRequestsPerSecond = 2.0;
+  this->Internals->DefaultMaxAge = 7 * 24 * 3600.0;
+  this->Internals->NextRequestTime = 0.0;
+  this->Internals->NumberOfRevalidations = 0;
+  this->Internals->NumberOfNotModified = 0;
+  this->Internals->NumberOfUpdatedTiles = 0;
+  this->Lock = vtkMutexLock::New();
+  this->Condition = vtkConditionVariable::New();
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileRevalidator::~vtkMapTileRevalidator()
+{
+  this->Close();
+  this->Internals->Threader->Delete();
+  this->Condition->Delete();
+  this->Lock->Delete();
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRevalidator::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "SidecarPath: " << this->Internals->SidecarPath << "\n"
+     << indent << "MaxRequestsPerSecond: "
+     << this->GetMaxRequestsPerSecond() << "\n"
+     << indent << "DefaultMaxAge: " << this->GetDefaultMaxAge() << "\n"
+     << indent << "NumberOfQueuedTiles: "
+     << this->GetNumberOfQueuedTiles() << "\n"
+     << indent << "NumberOfRevalidations: "
+     << this->GetNumberOfRevalidations() << "\n"
+     << indent << "NumberOfNotModified: "
+     << this->GetNumberOfNotModified() << "\n"
+     << indent << "NumberOfUpdatedTiles: "
+     << this->GetNumberOfUpdatedTiles() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRevalidator::Open(vtkOsmLayer *layer, const char *directory)
+{
+  this->Close();
+
+  vtkMapTileRevalidatorInternals *internals = this->Internals;
+  internals->SidecarPath = std::string(directory) + "/tiles.http";
+
+  this->Lock->Lock();
+  this->LoadSidecar();
+  if (internals->SidecarRecords >
+      2 * static_cast<vtkTypeInt64>(internals->Tiles.Size()) +
+      MinCompactionRecords)
+    {
+    this->CompactSidecar();
+    }
+  internals->Sidecar = fopen(internals->SidecarPath.c_str(), "ab");
+  if (!internals->Sidecar)
+    {
+    vtkErrorMacro("Unable to open " << internals->SidecarPath);
+    }
+  internals->Running = true;
+  internals->Queue.clear();
+  internals->Queued.Clear();
+  internals->UpdatedTiles.clear();
+  internals->Layers.assign(1, layer);
+  internals->UpdatedTiles[layer];
+  this->Lock->Unlock();
+
+  internals->ThreadId =
+    internals->Threader->SpawnThread(StaticBackgroundThreadExecute, this);
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRevalidator::Close()
+{
+  vtkMapTileRevalidatorInternals *internals = this->Internals;
+  this->Lock->Lock();
+  bool running = internals->Running;
+  internals->Running = false;
+  this->Condition->Broadcast();
+  this->Lock->Unlock();
+  if (!running)
+    {
+    return;
+    }
+
+  // Waits for the revalidation in progress
+  internals->Threader->TerminateThread(internals->ThreadId);
+  internals->ThreadId = -1;
+
+  this->Lock->Lock();
+  if (internals->Sidecar)
+    {
+    fclose(internals->Sidecar);
+    internals->Sidecar = NULL;
+    }
+  internals->Queue.clear();
+  internals->Queued.Clear();
+  internals->Tiles.Clear();
+  internals->Layers.clear();
+  internals->UpdatedTiles.clear();
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRevalidator::AddLayer(vtkOsmLayer *layer)
+{
+  vtkMapTileRevalidatorInternals *internals = this->Internals;
+  this->Lock->Lock();
+  if (std::find(internals->Layers.begin(), internals->Layers.end(),
+                layer) == internals->Layers.end())
+    {
+    internals->Layers.push_back(layer);
+    internals->UpdatedTiles[layer];
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRevalidator::RemoveLayer(vtkOsmLayer *layer)
+{
+  vtkMapTileRevalidatorInternals *internals = this->Internals;
+  this->Lock->Lock();
+  internals->Layers.erase(std::remove(internals->Layers.begin(),
+                                      internals->Layers.end(), layer),
+                          internals->Layers.end());
+  internals->UpdatedTiles.erase(layer);
+  // The layer may be deleted once its revalidation is done
+  while (internals->ActiveLayer == layer)
+    {
+    this->Condition->Wait(this->Lock);
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileRevalidator::GetNumberOfLayers()
+{
+  this->Lock->Lock();
+  int count = static_cast<int>(this->Internals->Layers.size());
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+// Called with Lock held
+void vtkMapTileRevalidator::LoadSidecar()
+{
+  vtkMapTileRevalidatorInternals *internals = this->Internals;
+  internals->Tiles.Clear();
+  internals->SidecarRecords = 0;
+
+  // Later records supersede earlier ones. A truncated last record,
+  // left by a crash, is skipped.
+  std::ifstream file(internals->SidecarPath.c_str(), std::ios::binary);
+  std::string line;
+  vtkTypeUInt64 key;
+  vtkMapTileCacheInfo info;
+  while (std::getline(file, line))
+    {
+    if (file.eof())
+      {
+      break;
+      }
+    if (ParseRecord(line, key, info))
+      {
+      internals->Tiles.Insert(key, info);
+      ++internals->SidecarRecords;
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Called with Lock held, before the sidecar is opened for appending
+void vtkMapTileRevalidator::CompactSidecar()
+{
+  vtkMapTileRevalidatorInternals *internals = this->Internals;
+  std::string tempPath = internals->SidecarPath + ".tmp";
+  FILE *fp = fopen(tempPath.c_str(), "wb");
+  if (!fp)
+    {
+    return;
+    }
+
+  std::vector<vtkTypeUInt64> keys;
+  internals->Tiles.GetKeys(keys);
+  bool written = true;
+  for (std::size_t i = 0; i < keys.size() && written; ++i)
+    {
+    std::string record =
+      FormatRecord(keys[i], *internals->Tiles.Find(keys[i]));
+    written = fwrite(record.data(), 1, record.size(), fp) == record.size();
+    }
+  written = fclose(fp) == 0 && written;
+#ifdef _WIN32
+  // Losing the metadata only makes the tiles expire
+  remove(internals->SidecarPath.c_str());
+#endif
+  if (written &&
+      rename(tempPath.c_str(), internals->SidecarPath.c_str()) == 0)
+    {
+    internals->SidecarRecords = static_cast<vtkTypeInt64>(keys.size());
+    }
+  else
+    {
+    vtkWarningMacro("Cannot compact " << internals->SidecarPath);
+    remove(tempPath.c_str());
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileRevalidator::GetCacheInfo(int zoom, int x, int y,
+                                         vtkMapTileCacheInfo& info)
+{
+  this->Lock->Lock();
+  vtkMapTileCacheInfo *found =
+    this->Internals->Tiles.Find(CacheInfoIndex::MakeKey(zoom, x, y));
+  if (found)
+    {
+    info = *found;
+    }
+  this->Lock->Unlock();
+  return found != NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRevalidator::SetCacheInfo(int zoom, int x, int y,
+                                         const vtkMapTileCacheInfo& info)
+{
+  vtkMapTileRevalidatorInternals *internals = this->Internals;
+  vtkTypeUInt64 key = CacheInfoIndex::MakeKey(zoom, x, y);
+  vtkMapTileCacheInfo record = info;
+
+  this->Lock->Lock();
+  if (record.Expires <= 0.0)
+    {
+    record.Expires =
+      vtkTimerLog::GetUniversalTime() + internals->DefaultMaxAge;
+    }
+  internals->Tiles.Insert(key, record);
+  if (internals->Sidecar)
+    {
+    std::string line = FormatRecord(key, record);
+    fwrite(line.data(), 1, line.size(), internals->Sidecar);
+    fflush(internals->Sidecar);
+    ++internals->SidecarRecords;
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileRevalidator::IsExpired(int zoom, int x, int y)
+{
+  double now = vtkTimerLog::GetUniversalTime();
+  this->Lock->Lock();
+  vtkMapTileCacheInfo *found =
+    this->Internals->Tiles.Find(CacheInfoIndex::MakeKey(zoom, x, y));
+  bool expired = !found || found->Expires <= now;
+  this->Lock->Unlock();
+  return expired;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileRevalidator::CheckTile(int zoom, int x, int y)
+{
+  vtkMapTileRevalidatorInternals *internals = this->Internals;
+  vtkTypeUInt64 key = CacheInfoIndex::MakeKey(zoom, x, y);
+  double now = vtkTimerLog::GetUniversalTime();
+
+  this->Lock->Lock();
+  vtkMapTileCacheInfo *found = internals->Tiles.Find(key);
+  bool queue = internals->Running && (!found || found->Expires <= now) &&
+    !internals->Queued.Find(key);
+  if (queue)
+    {
+    internals->Queue.push_back(key);
+    internals->Queued.Insert(key, true);
+    this->Condition->Broadcast();
+    }
+  this->Lock->Unlock();
+  return queue;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRevalidator::GetUpdatedTiles(vtkOsmLayer *layer,
+                                            std::vector<vtkTypeUInt64>& keys)
+{
+  this->Lock->Lock();
+  std::map<vtkOsmLayer*, std::vector<vtkTypeUInt64> >::iterator iter =
+    this->Internals->UpdatedTiles.find(layer);
+  if (iter != this->Internals->UpdatedTiles.end())
+    {
+    keys.insert(keys.end(), iter->second.begin(), iter->second.end());
+    iter->second.clear();
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileRevalidator::HasUpdatedTiles(vtkOsmLayer *layer)
+{
+  this->Lock->Lock();
+  std::map<vtkOsmLayer*, std::vector<vtkTypeUInt64> >::iterator iter =
+    this->Internals->UpdatedTiles.find(layer);
+  bool result = iter != this->Internals->UpdatedTiles.end() &&
+    !iter->second.empty();
+  this->Lock->Unlock();
+  return result;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRevalidator::Flush()
+{
+  this->Lock->Lock();
+  while (this->Internals->Running &&
+         (!this->Internals->Queue.empty() || this->Internals->Active))
+    {
+    this->Condition->Wait(this->Lock);
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRevalidator::SetMaxRequestsPerSecond(double rate)
+{
+  this->Lock->Lock();
+  this->Internals->MaxRequestsPerSecond = std::max(0.0, rate);
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileRevalidator::GetMaxRequestsPerSecond()
+{
+  this->Lock->Lock();
+  double rate = this->Internals->MaxRequestsPerSecond;
+  this->Lock->Unlock();
+  return rate;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRevalidator::SetDefaultMaxAge(double seconds)
+{
+  this->Lock->Lock();
+  this->Internals->DefaultMaxAge = std::max(0.0, seconds);
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileRevalidator::GetDefaultMaxAge()
+{
+  this->Lock->Lock();
+  double seconds = this->Internals->DefaultMaxAge;
+  this->Lock->Unlock();
+  return seconds;
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileRevalidator::GetNumberOfQueuedTiles()
+{
+  this->Lock->Lock();
+  int count = static_cast<int>(this->Internals->Queued.Size());
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileRevalidator::GetNumberOfRevalidations()
+{
+  this->Lock->Lock();
+  vtkTypeInt64 count = this->Internals->NumberOfRevalidations;
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileRevalidator::GetNumberOfNotModified()
+{
+  this->Lock->Lock();
+  vtkTypeInt64 count = this->Internals->NumberOfNotModified;
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileRevalidator::GetNumberOfUpdatedTiles()
+{
+  this->Lock->Lock();
+  vtkTypeInt64 count = this->Internals->NumberOfUpdatedTiles;
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRevalidator::BackgroundThreadExecute()
+{
+  vtkDebugMacro("Enter BackgroundThreadExecute()");
+  vtkMapTileRevalidatorInternals *internals = this->Internals;
+  this->Lock->Lock();
+  while (internals->Running)
+    {
+    if (internals->Queue.empty())
+      {
+      // Wakes up Flush() too
+      this->Condition->Broadcast();
+      this->Condition->Wait(this->Lock);
+      continue;
+      }
+
+    // Space requests evenly, checking for Close() meanwhile
+    double now = vtkTimerLog::GetUniversalTime();
+    if (now < internals->NextRequestTime)
+      {
+      double wait = std::min(0.05, internals->NextRequestTime - now);
+      this->Lock->Unlock();
+      vtksys::SystemTools::Delay(static_cast<unsigned int>(1000.0 * wait));
+      this->Lock->Lock();
+      continue;
+      }
+    if (internals->MaxRequestsPerSecond > 0.0)
+      {
+      internals->NextRequestTime =
+        std::max(now, internals->NextRequestTime) +
+        1.0 / internals->MaxRequestsPerSecond;
+      }
+
+    vtkTypeUInt64 key = internals->Queue.front();
+    internals->Queue.pop_front();
+    internals->Active = true;
+    internals->ActiveLayer =
+      internals->Layers.empty() ? NULL : internals->Layers.front();
+    this->Lock->Unlock();
+
+    if (internals->ActiveLayer)
+      {
+      this->RevalidateTile(internals->ActiveLayer, key);
+      }
+
+    this->Lock->Lock();
+    internals->Queued.Erase(key);
+    internals->Active = false;
+    internals->ActiveLayer = NULL;
+    // Wakes up RemoveLayer()
+    this->Condition->Broadcast();
+    }
+  this->Condition->Broadcast();
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRevalidator::RevalidateTile(vtkOsmLayer *layer,
+                                           vtkTypeUInt64 key)
+{
+  vtkMapTileRevalidatorInternals *internals = this->Internals;
+  int zoom, x, y;
+  CacheInfoIndex::SplitKey(key, zoom, x, y);
+
+  // Cached tiles stay usable, so wait for the next load of the tile
+  // while the server is down
+  if (layer->GetFailureCache()->IsCircuitOpen())
+    {
+    return;
+    }
+
+  // Without metadata the request is unconditional
+  vtkMapTileCacheInfo info;
+  this->GetCacheInfo(zoom, x, y, info);
+  std::string url = layer->GetTileUrl(zoom, x, y);
+  std::vector<unsigned char> data;
+  std::string message;
+  bool success = layer->GetTileSource()->FetchTile(
+    zoom, x, y, data, NULL, &message, &info);
+
+  this->Lock->Lock();
+  ++internals->NumberOfRevalidations;
+  this->Lock->Unlock();
+  if (!success)
+    {
+    vtkWarningMacro("Revalidation of " << url << " failed: " << message);
+    return;
+    }
+
+  if (!data.empty())
+    {
+    // Changed on the server
+    if (!vtkPackedTileStore::IsCompleteImage(&data[0], data.size()))
+      {
+      vtkWarningMacro("Invalid image data from " << url);
+      return;
+      }
+    if (!layer->StoreTileData(zoom, x, y, data))
+      {
+      return;
+      }
+    }
+  this->SetCacheInfo(zoom, x, y, info);
+
+  this->Lock->Lock();
+  if (data.empty())
+    {
+    ++internals->NumberOfNotModified;
+    }
+  else
+    {
+    ++internals->NumberOfUpdatedTiles;
+    std::map<vtkOsmLayer*, std::vector<vtkTypeUInt64> >::iterator iter =
+      internals->UpdatedTiles.begin();
+    for (; iter != internals->UpdatedTiles.end(); iter++)
+      {
+      iter->second.push_back(key);
+      }
+    }
+  this->Lock->Unlock();
+}
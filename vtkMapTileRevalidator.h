@@ -0,0 +1,152 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileRevalidator.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileRevalidator - refresh expired map tiles in the background
+// .SECTION Description
+// Keeps the HTTP caching metadata (see vtkMapTileCacheInfo) of the tiles
+// in the on-disk cache of a vtkOsmLayer, in an append-only sidecar file
+// in the cache directory (tiles.http), and revalidates expired tiles
+// with the tile server.
+//
+// Expired tiles are still served from the cache right away: CheckTile()
+// only queues them for a background thread, which sends conditional
+// requests, so that a tile that did not change costs a 304 response
+// without body. Changed tiles are written to the layer's cache and
+// reported by GetUpdatedTiles(), for the layer to reload them. Layers
+// sharing the cache directory share its revalidator, see
+// vtkMapTileStorage: tiles are revalidated with the first layer, and
+// reported to all of them.
+// Revalidation requests are limited to MaxRequestsPerSecond, separately
+// from the layer's own downloads.
+//
+// Tiles without metadata, such as tiles cached by earlier versions, are
+// considered expired. Tiles are identified by their OSM (zoom, x, y)
+// indices. All methods are thread safe.
+
+#ifndef __vtkMapTileRevalidator_h
+#define __vtkMapTileRevalidator_h
+
+#include "vtkmap_export.h"
+#include <vtkObject.h>
+
+#include <vector>
+
+class vtkConditionVariable;
+class vtkMapTileCacheInfo;
+class vtkMutexLock;
+class vtkOsmLayer;
+
+class VTKMAP_EXPORT vtkMapTileRevalidator : public vtkObject
+{
+public:
+  static vtkMapTileRevalidator *New();
+  vtkTypeMacro(vtkMapTileRevalidator, vtkObject)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Start managing the metadata of the tiles in the given cache
+  // directory, and start the background thread. Tiles are revalidated
+  // with the layer's tile server and fetcher, and stored in its cache.
+  // The layer is added as with AddLayer().
+  void Open(vtkOsmLayer *layer, const char *directory);
+
+  // Description:
+  // Stop the background thread. Queued tiles are dropped.
+  void Close();
+
+  // Description:
+  // Add/Remove a layer sharing the cache directory. Removing a layer
+  // waits for a revalidation in progress with it. The layers are not
+  // reference counted.
+  void AddLayer(vtkOsmLayer *layer);
+  void RemoveLayer(vtkOsmLayer *layer);
+  int GetNumberOfLayers();
+
+  // Description:
+  // Get the metadata of the tile. Returns false if there is none.
+  bool GetCacheInfo(int zoom, int x, int y, vtkMapTileCacheInfo& info);
+
+  // Description:
+  // Record the metadata of a tile just downloaded. Tiles without
+  // expiry time expire DefaultMaxAge seconds from now.
+  void SetCacheInfo(int zoom, int x, int y, const vtkMapTileCacheInfo& info);
+
+  // Description:
+  // Return true if the tile is expired or has no metadata
+  bool IsExpired(int zoom, int x, int y);
+
+  // Description:
+  // Queue the tile for revalidation if it is expired. Call when a tile
+  // is loaded from the cache. Returns true if the tile was queued.
+  bool CheckTile(int zoom, int x, int y);
+
+  // Description:
+  // Append the keys, as made by vtkMapTileIndexInternal::MakeKey(), of
+  // the tiles changed on the server and rewritten in the cache since
+  // the last call for the layer
+  void GetUpdatedTiles(vtkOsmLayer *layer, std::vector<vtkTypeUInt64>& keys);
+  bool HasUpdatedTiles(vtkOsmLayer *layer);
+
+  // Description:
+  // Block until all queued tiles are revalidated
+  void Flush();
+
+  // Description:
+  // Get/Set the maximum number of revalidation requests per second.
+  // 0 means no limit. Default is 2.
+  void SetMaxRequestsPerSecond(double rate);
+  double GetMaxRequestsPerSecond();
+
+  // Description:
+  // Get/Set how long, in seconds, tiles stay fresh when the server does
+  // not say, with Cache-Control max-age or Expires headers.
+  // Default is 7 days.
+  void SetDefaultMaxAge(double seconds);
+  double GetDefaultMaxAge();
+
+  // Description:
+  // Number of tiles queued for revalidation, including the tile being
+  // revalidated
+  int GetNumberOfQueuedTiles();
+
+  // Description:
+  // Revalidation statistics: requests made, tiles found unchanged
+  // (304 responses), and tiles updated
+  vtkTypeInt64 GetNumberOfRevalidations();
+  vtkTypeInt64 GetNumberOfNotModified();
+  vtkTypeInt64 GetNumberOfUpdatedTiles();
+
+  // Description:
+  // Threaded method for revalidating queued tiles
+  void BackgroundThreadExecute();
+
+protected:
+  vtkMapTileRevalidator();
+  ~vtkMapTileRevalidator();
+
+  void LoadSidecar();
+  void CompactSidecar();
+  void RevalidateTile(vtkOsmLayer *layer, vtkTypeUInt64 key);
+
+  class vtkMapTileRevalidatorInternals;
+  vtkMapTileRevalidatorInternals *Internals;
+  vtkMutexLock *Lock;
+  vtkConditionVariable *Condition;
+
+private:
+  vtkMapTileRevalidator(const vtkMapTileRevalidator&);  // Not implemented
+  void operator=(const vtkMapTileRevalidator&); // Not implemented
+};
+
+#endif // __vtkMapTileRevalidator_h
@@ -0,0 +1,603 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileSeeder.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileSeeder.h"
+#include "vtkMapTileCacheInfo.h"
+#include "vtkMapTileRevalidator.h"
+#include "vtkMercator.h"
+#include "vtkOsmLayer.h"
+#include "vtkPackedTileStore.h"
+#include "vtkTileSource.h"
+
+#include <vtkAtomic.h>
+#include <vtkCommand.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+  // Web Mercator tiles cover latitudes up to atan(sinh(pi))
+  const double MaxTileLatitude = 85.0511;
+
+  // Seconds between progress events and resume file updates
+  const double ProgressInterval = 1.0;
+
+  struct WorkerInfo
+  {
+    vtkMapTileSeeder *Self;
+    int Index;
+  };
+}
+
+vtkStandardNewMacro(vtkMapTileSeeder)
+
+//----------------------------------------------------------------------------
+class vtkMapTileSeeder::vtkMapTileSeederInternals
+{
+public:
+  // Tiles of one zoom level, and position of the first one in the list
+  struct ZoomRange
+  {
+    int Zoom;
+    int Col[2];
+    int Row[2];
+    vtkTypeInt64 First;
+  };
+  std::vector<ZoomRange> Ranges;
+  vtkTypeInt64 NumberOfTiles;
+  std::string ResumePath;
+
+  vtkMultiThreader *Threader;
+  std::vector<int> ThreadIds;
+  std::vector<WorkerInfo> Workers;
+
+  // Members below are guarded by Lock
+  vtkMutexLock *Lock;
+  vtkTypeInt64 NextOrdinal;
+  std::vector<vtkTypeInt64> InFlight;  // per worker, -1 if idle
+  vtkTypeInt64 FirstFailed;            // -1 if none
+  double NextRequestTime;
+
+  vtkAtomic<vtkTypeInt32> Aborted;
+  vtkAtomic<vtkTypeInt32> RunningWorkers;
+  vtkAtomic<vtkTypeInt64> ProcessedTiles;
+  vtkAtomic<vtkTypeInt64> DownloadedTiles;
+  vtkAtomic<vtkTypeInt64> SkippedTiles;
+  vtkAtomic<vtkTypeInt64> FailedTiles;
+  vtkAtomic<vtkTypeInt64> DownloadedBytes;
+  double StartTime;
+  double StopTime;  // 0 while running
+};
+
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE StaticWorkerThreadExecute(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  WorkerInfo *worker = static_cast<WorkerInfo*>(info->UserData);
+  worker->Self->WorkerThreadExecute(worker->Index);
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileSeeder::vtkMapTileSeeder()
+{
+  this->Layer = NULL;
+  this->Bounds[0] = this->Bounds[1] = this->Bounds[2] = this->Bounds[3] = 0.0;
+  this->MinZoom = 0;
+  this->MaxZoom = 10;
+  this->NumberOfThreads = 4;
+  this->MaxRequestsPerSecond = 10.0;
+  this->Resume = true;
+
+  this->Internals = new vtkMapTileSeederInternals;
+  this->Internals->NumberOfTiles = 0;
+  this->Internals->Threader = vtkMultiThreader::New();
+  this->Internals->Lock = vtkMutexLock::New();
+  this->Internals->NextOrdinal = 0;
+  this->Internals->FirstFailed = -1;
+  this->Internals->NextRequestTime = 0.0;
+  this->Internals->Aborted = 0;
+  this->Internals->RunningWorkers = 0;
+  this->Internals->ProcessedTiles = 0;
+  this->Internals->DownloadedTiles = 0;
+  this->Internals->SkippedTiles = 0;
+  this->Internals->FailedTiles = 0;
+  this->Internals->DownloadedBytes = 0;
+  this->Internals->StartTime = 0.0;
+  this->Internals->StopTime = 0.0;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileSeeder::~vtkMapTileSeeder()
+{
+  this->SetLayer(NULL);
+  this->Internals->Threader->Delete();
+  this->Internals->Lock->Delete();
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Layer: " << this->Layer << "\n"
+     << indent << "Bounds: " << this->Bounds[0] << " " << this->Bounds[1]
+     << " " << this->Bounds[2] << " " << this->Bounds[3] << "\n"
+     << indent << "MinZoom: " << this->MinZoom << "\n"
+     << indent << "MaxZoom: " << this->MaxZoom << "\n"
+     << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n"
+     << indent << "MaxRequestsPerSecond: " << this->MaxRequestsPerSecond
+     << "\n"
+     << indent << "Resume: " << this->Resume << "\n"
+     << indent << "NumberOfProcessedTiles: "
+     << this->GetNumberOfProcessedTiles() << "\n"
+     << indent << "NumberOfDownloadedTiles: "
+     << this->GetNumberOfDownloadedTiles() << "\n"
+     << indent << "NumberOfSkippedTiles: "
+     << this->GetNumberOfSkippedTiles() << "\n"
+     << indent << "NumberOfFailedTiles: "
+     << this->GetNumberOfFailedTiles() << "\n"
+     << indent << "NumberOfDownloadedBytes: "
+     << this->GetNumberOfDownloadedBytes() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::SetLayer(vtkOsmLayer *layer)
+{
+  if (layer == this->Layer)
+    {
+    return;
+    }
+  if (this->Layer)
+    {
+    this->Layer->UnRegister(this);
+    }
+  this->Layer = layer;
+  if (this->Layer)
+    {
+    this->Layer->Register(this);
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::ComputeTileRanges()
+{
+  double latitude[2] =
+    {
+    std::min(this->Bounds[0], this->Bounds[2]),
+    std::max(this->Bounds[0], this->Bounds[2])
+    };
+  double longitude[2] =
+    {
+    std::min(this->Bounds[1], this->Bounds[3]),
+    std::max(this->Bounds[1], this->Bounds[3])
+    };
+  for (int i = 0; i < 2; ++i)
+    {
+    latitude[i] =
+      std::max(-MaxTileLatitude, std::min(MaxTileLatitude, latitude[i]));
+    longitude[i] = std::max(-180.0, std::min(180.0, longitude[i]));
+    }
+
+  this->Internals->Ranges.clear();
+  this->Internals->NumberOfTiles = 0;
+  for (int zoom = this->MinZoom; zoom <= this->MaxZoom; ++zoom)
+    {
+    int maxIndex = (1 << zoom) - 1;
+    vtkMapTileSeederInternals::ZoomRange range;
+    range.Zoom = zoom;
+    range.Col[0] = vtkMercator::long2tilex(longitude[0], zoom);
+    range.Col[1] = vtkMercator::long2tilex(longitude[1], zoom);
+    range.Row[0] = vtkMercator::lat2tiley(latitude[1], zoom);  // north
+    range.Row[1] = vtkMercator::lat2tiley(latitude[0], zoom);
+    for (int i = 0; i < 2; ++i)
+      {
+      range.Col[i] = std::max(0, std::min(maxIndex, range.Col[i]));
+      range.Row[i] = std::max(0, std::min(maxIndex, range.Row[i]));
+      }
+    range.First = this->Internals->NumberOfTiles;
+    this->Internals->NumberOfTiles +=
+      static_cast<vtkTypeInt64>(range.Col[1] - range.Col[0] + 1) *
+      (range.Row[1] - range.Row[0] + 1);
+    this->Internals->Ranges.push_back(range);
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileSeeder::GetNumberOfTiles()
+{
+  // The workers use the ranges while Seed() runs
+  if (this->Internals->RunningWorkers == 0)
+    {
+    this->ComputeTileRanges();
+    }
+  return this->Internals->NumberOfTiles;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::GetTileIndices(vtkTypeInt64 ordinal,
+                                      int& zoom, int& x, int& y)
+{
+  std::size_t i = 0;
+  while (i + 1 < this->Internals->Ranges.size() &&
+         this->Internals->Ranges[i + 1].First <= ordinal)
+    {
+    ++i;
+    }
+  vtkMapTileSeederInternals::ZoomRange& range = this->Internals->Ranges[i];
+  vtkTypeInt64 offset = ordinal - range.First;
+  vtkTypeInt64 width = range.Col[1] - range.Col[0] + 1;
+  zoom = range.Zoom;
+  x = range.Col[0] + static_cast<int>(offset % width);
+  y = range.Row[0] + static_cast<int>(offset / width);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileSeeder::Seed()
+{
+  if (!this->Layer || !this->Layer->GetCacheDirectory())
+    {
+    vtkErrorMacro("Layer with a cache directory is required");
+    return false;
+    }
+  if (this->MinZoom > this->MaxZoom)
+    {
+    vtkErrorMacro("MinZoom " << this->MinZoom << " is above MaxZoom "
+                  << this->MaxZoom);
+    return false;
+    }
+
+  vtkMapTileSeederInternals *internals = this->Internals;
+  this->ComputeTileRanges();
+  internals->ResumePath =
+    std::string(this->Layer->GetCacheDirectory()) + "/seed.resume";
+
+  vtkTypeInt64 start = this->Resume ? this->ReadResumeFile() : 0;
+  if (start > 0)
+    {
+    vtkDebugMacro("Resuming at tile " << start << " of "
+                  << internals->NumberOfTiles);
+    }
+
+  internals->NextOrdinal = start;
+  internals->FirstFailed = -1;
+  internals->NextRequestTime = 0.0;
+  internals->Aborted = 0;
+  internals->ProcessedTiles = start;
+  internals->DownloadedTiles = 0;
+  internals->SkippedTiles = 0;
+  internals->FailedTiles = 0;
+  internals->DownloadedBytes = 0;
+  internals->StartTime = vtkTimerLog::GetUniversalTime();
+  internals->StopTime = 0.0;
+
+  // Start the workers
+  int numWorkers = static_cast<int>(std::min(
+    static_cast<vtkTypeInt64>(this->NumberOfThreads),
+    std::max(internals->NumberOfTiles - start, static_cast<vtkTypeInt64>(1))));
+  internals->InFlight.assign(numWorkers, -1);
+  internals->Workers.resize(numWorkers);
+  internals->ThreadIds.resize(numWorkers);
+  internals->RunningWorkers = numWorkers;
+  for (int i = 0; i < numWorkers; ++i)
+    {
+    internals->Workers[i].Self = this;
+    internals->Workers[i].Index = i;
+    internals->ThreadIds[i] = internals->Threader->SpawnThread(
+      StaticWorkerThreadExecute, &internals->Workers[i]);
+    }
+
+  // Report progress and save checkpoints until the workers are done
+  double lastReport = internals->StartTime;
+  double progress;
+  while (internals->RunningWorkers > 0)
+    {
+    vtksys::SystemTools::Delay(50);
+    double now = vtkTimerLog::GetUniversalTime();
+    if (now - lastReport >= ProgressInterval)
+      {
+      lastReport = now;
+      this->WriteResumeFile(this->GetCheckpoint());
+      progress = internals->NumberOfTiles > 0 ?
+        static_cast<double>(internals->ProcessedTiles) /
+        internals->NumberOfTiles : 1.0;
+      this->InvokeEvent(vtkCommand::ProgressEvent, &progress);
+      }
+    }
+  for (int i = 0; i < numWorkers; ++i)
+    {
+    internals->Threader->TerminateThread(internals->ThreadIds[i]);
+    }
+  internals->StopTime = vtkTimerLog::GetUniversalTime();
+
+  // Keep the resume file until every tile is in the cache
+  vtkTypeInt64 checkpoint = this->GetCheckpoint();
+  bool complete = checkpoint >= internals->NumberOfTiles;
+  if (complete)
+    {
+    vtksys::SystemTools::RemoveFile(internals->ResumePath.c_str());
+    }
+  else
+    {
+    this->WriteResumeFile(checkpoint);
+    }
+
+  progress = 1.0;
+  this->InvokeEvent(vtkCommand::ProgressEvent, &progress);
+  return complete;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::Abort()
+{
+  this->Internals->Aborted = 1;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::WorkerThreadExecute(int workerIndex)
+{
+  vtkMapTileSeederInternals *internals = this->Internals;
+
+  while (!internals->Aborted)
+    {
+    internals->Lock->Lock();
+    vtkTypeInt64 ordinal = internals->NextOrdinal;
+    if (ordinal < internals->NumberOfTiles)
+      {
+      internals->NextOrdinal++;
+      internals->InFlight[workerIndex] = ordinal;
+      }
+    internals->Lock->Unlock();
+    if (ordinal >= internals->NumberOfTiles)
+      {
+      break;
+      }
+
+    int zoom, x, y;
+    this->GetTileIndices(ordinal, zoom, x, y);
+    bool success = this->SeedTile(zoom, x, y);
+
+    internals->Lock->Lock();
+    internals->InFlight[workerIndex] = -1;
+    if (!success && (internals->FirstFailed < 0 ||
+                     ordinal < internals->FirstFailed))
+      {
+      internals->FirstFailed = ordinal;
+      }
+    internals->Lock->Unlock();
+    internals->ProcessedTiles++;
+    }
+
+  internals->RunningWorkers--;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileSeeder::SeedTile(int zoom, int x, int y)
+{
+  vtkMapTileSeederInternals *internals = this->Internals;
+  vtkPackedTileStore *store = this->Layer->GetTileStore();
+  std::string path = this->Layer->GetTileFileSystemPath(zoom, x, y);
+
+  // Skip tiles that are already in the cache
+  if (store ? store->Contains(zoom, x, y) :
+      vtksys::SystemTools::FileExists(path.c_str(), true))
+    {
+    internals->SkippedTiles++;
+    return true;
+    }
+
+  this->WaitForRequestSlot();
+  if (internals->Aborted)
+    {
+    return false;
+    }
+
+  std::string url = this->Layer->GetTileUrl(zoom, x, y);
+  // Read through the layer's tile source, which for tile servers reuses
+  // connections across tiles and threads
+  std::vector<unsigned char> data;
+  std::string message;
+  vtkMapTileCacheInfo info;
+  if (!this->Layer->GetTileSource()->FetchTile(zoom, x, y, data, NULL,
+                                               &message, &info))
+    {
+    vtkWarningMacro("Download " << url << " failed: " << message);
+    internals->FailedTiles++;
+    return false;
+    }
+  if (data.empty() ||
+      !vtkPackedTileStore::IsCompleteImage(&data[0], data.size()))
+    {
+    vtkWarningMacro("Invalid image data from " << url);
+    internals->FailedTiles++;
+    return false;
+    }
+
+  // Files are written under a temporary name first, so that an
+  // interrupted run leaves no partial tile to be skipped
+  if (!this->Layer->StoreTileData(zoom, x, y, data))
+    {
+    internals->FailedTiles++;
+    return false;
+    }
+  if (this->Layer->GetRevalidator())
+    {
+    this->Layer->GetRevalidator()->SetCacheInfo(zoom, x, y, info);
+    }
+
+  vtkTypeInt64 size = static_cast<vtkTypeInt64>(data.size());
+  internals->DownloadedTiles++;
+  internals->DownloadedBytes += size;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::WaitForRequestSlot()
+{
+  if (this->MaxRequestsPerSecond <= 0.0)
+    {
+    return;
+    }
+
+  // Requests are spaced evenly, in the order threads ask for a slot
+  this->Internals->Lock->Lock();
+  double now = vtkTimerLog::GetUniversalTime();
+  double slot = std::max(now, this->Internals->NextRequestTime);
+  this->Internals->NextRequestTime = slot + 1.0 / this->MaxRequestsPerSecond;
+  this->Internals->Lock->Unlock();
+
+  while (slot > now && !this->Internals->Aborted)
+    {
+    double wait = std::min(slot - now, 0.1);
+    vtksys::SystemTools::Delay(static_cast<unsigned int>(wait * 1000.0) + 1);
+    now = vtkTimerLog::GetUniversalTime();
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileSeeder::GetCheckpoint()
+{
+  vtkMapTileSeederInternals *internals = this->Internals;
+  internals->Lock->Lock();
+  vtkTypeInt64 checkpoint = internals->NextOrdinal;
+  for (std::size_t i = 0; i < internals->InFlight.size(); ++i)
+    {
+    if (internals->InFlight[i] >= 0)
+      {
+      checkpoint = std::min(checkpoint, internals->InFlight[i]);
+      }
+    }
+  if (internals->FirstFailed >= 0)
+    {
+    checkpoint = std::min(checkpoint, internals->FirstFailed);
+    }
+  internals->Lock->Unlock();
+  return checkpoint;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkMapTileSeeder::GetResumeKey()
+{
+  std::stringstream ss;
+  ss.precision(10);
+  ss << this->Layer->GetTileUrl(0, 0, 0) << " "
+     << this->Bounds[0] << " " << this->Bounds[1] << " "
+     << this->Bounds[2] << " " << this->Bounds[3] << " "
+     << this->MinZoom << " " << this->MaxZoom;
+  return ss.str();
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileSeeder::ReadResumeFile()
+{
+  std::ifstream in(this->Internals->ResumePath.c_str());
+  std::string key;
+  vtkTypeInt64 checkpoint = 0;
+  if (!in || !std::getline(in, key) || key != this->GetResumeKey() ||
+      !(in >> checkpoint))
+    {
+    // No resume file, or one for a different area
+    return 0;
+    }
+  return std::max(static_cast<vtkTypeInt64>(0),
+                  std::min(checkpoint, this->Internals->NumberOfTiles));
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::WriteResumeFile(vtkTypeInt64 checkpoint)
+{
+  std::string path = this->Internals->ResumePath;
+  std::string tempPath = path + ".tmp";
+  {
+  std::ofstream out(tempPath.c_str(), std::ios::trunc);
+  out << this->GetResumeKey() << "\n" << checkpoint << "\n";
+  if (!out)
+    {
+    vtkWarningMacro("Unable to write resume file " << tempPath);
+    return;
+    }
+  }
+  remove(path.c_str());
+  rename(tempPath.c_str(), path.c_str());
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileSeeder::GetNumberOfProcessedTiles()
+{
+  return this->Internals->ProcessedTiles;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileSeeder::GetNumberOfDownloadedTiles()
+{
+  return this->Internals->DownloadedTiles;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileSeeder::GetNumberOfSkippedTiles()
+{
+  return this->Internals->SkippedTiles;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileSeeder::GetNumberOfFailedTiles()
+{
+  return this->Internals->FailedTiles;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileSeeder::GetNumberOfDownloadedBytes()
+{
+  return this->Internals->DownloadedBytes;
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileSeeder::GetElapsedTime()
+{
+  if (this->Internals->StartTime == 0.0)
+    {
+    return 0.0;
+    }
+  double stop = this->Internals->StopTime > 0.0 ?
+    this->Internals->StopTime : vtkTimerLog::GetUniversalTime();
+  return stop - this->Internals->StartTime;
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileSeeder::GetTilesPerSecond()
+{
+  double elapsed = this->GetElapsedTime();
+  return elapsed > 0.0 ?
+    static_cast<double>(this->Internals->DownloadedTiles) / elapsed : 0.0;
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileSeeder::GetBytesPerSecond()
+{
+  double elapsed = this->GetElapsedTime();
+  return elapsed > 0.0 ?
+    static_cast<double>(this->Internals->DownloadedBytes) / elapsed : 0.0;
+}
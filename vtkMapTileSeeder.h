@@ -0,0 +1,167 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileSeeder.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileSeeder - fill a map-tile cache for offline use
+// .SECTION Description
+// Downloads the tiles covering a lat-lon bounding box, over a range of
+// zoom levels, from the map tile server of a vtkOsmLayer, and stores
+// them in the layer's cache: its packed tile store if it has one,
+// otherwise one file per tile, at the paths the layer reads them from.
+//
+// Tiles already in the cache are skipped. The position in the list of
+// tiles is checkpointed to a resume file in the cache directory
+// (seed.resume), so that a run that was interrupted resumes where it
+// stopped. Tiles are requested by several threads at once, at most
+// MaxRequestsPerSecond overall.
+//
+// Seed() invokes vtkCommand::ProgressEvent about once per second, with
+// a pointer to the fraction (double) of tiles processed. The observer
+// can read the statistics below, and can call Abort().
+
+#ifndef __vtkMapTileSeeder_h
+#define __vtkMapTileSeeder_h
+
+#include "vtkmap_export.h"
+#include <vtkObject.h>
+
+#include <string>
+
+class vtkOsmLayer;
+
+class VTKMAP_EXPORT vtkMapTileSeeder : public vtkObject
+{
+public:
+  static vtkMapTileSeeder *New();
+  vtkTypeMacro(vtkMapTileSeeder, vtkObject)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Get/Set the layer whose tile server and cache are used.
+  // The layer must have a cache directory, i.e. it must have been
+  // added to a vtkMap.
+  virtual void SetLayer(vtkOsmLayer *layer);
+  vtkGetObjectMacro(Layer, vtkOsmLayer);
+
+  // Description:
+  // Get/Set the area to seed, as for vtkMap::SetVisibleBounds():
+  // [latitude1, longitude1, latitude2, longitude2]
+  vtkSetVector4Macro(Bounds, double);
+  vtkGetVector4Macro(Bounds, double);
+
+  // Description:
+  // Get/Set the range of zoom levels to seed. Default is 0 to 10.
+  vtkSetClampMacro(MinZoom, int, 0, 20);
+  vtkGetMacro(MinZoom, int);
+  vtkSetClampMacro(MaxZoom, int, 0, 20);
+  vtkGetMacro(MaxZoom, int);
+
+  // Description:
+  // Get/Set the number of concurrent requests. Default is 4.
+  vtkSetClampMacro(NumberOfThreads, int, 1, 32);
+  vtkGetMacro(NumberOfThreads, int);
+
+  // Description:
+  // Get/Set the maximum number of requests per second, over all
+  // threads. 0 means no limit. Default is 10.
+  vtkSetClampMacro(MaxRequestsPerSecond, double, 0.0, VTK_DOUBLE_MAX);
+  vtkGetMacro(MaxRequestsPerSecond, double);
+
+  // Description:
+  // Get/Set whether Seed() continues from the resume file left by an
+  // interrupted run for the same area and zoom range. Default is on.
+  vtkSetMacro(Resume, bool);
+  vtkGetMacro(Resume, bool);
+  vtkBooleanMacro(Resume, bool);
+
+  // Description:
+  // Number of tiles covering the area over the zoom range
+  vtkTypeInt64 GetNumberOfTiles();
+
+  // Description:
+  // Download the missing tiles. Returns true if all tiles are in the
+  // cache afterwards, false on failure or if aborted.
+  bool Seed();
+
+  // Description:
+  // Stop a running Seed() after the current requests complete.
+  // Safe to call from any thread.
+  void Abort();
+
+  // Description:
+  // Statistics of the current or last run of Seed(). Processed tiles
+  // include tiles skipped by resuming, and tiles already in the cache.
+  vtkTypeInt64 GetNumberOfProcessedTiles();
+  vtkTypeInt64 GetNumberOfDownloadedTiles();
+  vtkTypeInt64 GetNumberOfSkippedTiles();
+  vtkTypeInt64 GetNumberOfFailedTiles();
+  vtkTypeInt64 GetNumberOfDownloadedBytes();
+
+  // Description:
+  // Seconds since Seed() started, and download throughput over that time
+  double GetElapsedTime();
+  double GetTilesPerSecond();
+  double GetBytesPerSecond();
+
+  // Description:
+  // Threaded method for downloading tiles
+  void WorkerThreadExecute(int workerIndex);
+
+protected:
+  vtkMapTileSeeder();
+  ~vtkMapTileSeeder();
+
+  // Description:
+  // Get the OSM indices of the tile with the given position in the
+  // list of tiles (by zoom level, then row, then column)
+  void GetTileIndices(vtkTypeInt64 ordinal, int& zoom, int& x, int& y);
+
+  // Description:
+  // Compute the tile ranges of each zoom level
+  void ComputeTileRanges();
+
+  // Description:
+  // Fetch one tile into the cache. Returns false on failure.
+  bool SeedTile(int zoom, int x, int y);
+
+  // Description:
+  // Wait for the rate limit to allow another request
+  void WaitForRequestSlot();
+
+  // Description:
+  // Position up to which all tiles are done
+  vtkTypeInt64 GetCheckpoint();
+
+  // Description:
+  // Resume file handling
+  std::string GetResumeKey();
+  vtkTypeInt64 ReadResumeFile();
+  void WriteResumeFile(vtkTypeInt64 checkpoint);
+
+  vtkOsmLayer *Layer;
+  double Bounds[4];
+  int MinZoom;
+  int MaxZoom;
+  int NumberOfThreads;
+  double MaxRequestsPerSecond;
+  bool Resume;
+
+  class vtkMapTileSeederInternals;
+  vtkMapTileSeederInternals *Internals;
+
+private:
+  vtkMapTileSeeder(const vtkMapTileSeeder&);  // Not implemented
+  void operator=(const vtkMapTileSeeder&); // Not implemented
+};
+
+#endif // __vtkMapTileSeeder_h
@@ -0,0 +1,891 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileService.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileService.h"
+#include "vtkMapTileConcurrencyController.h"
+#include "vtkMultiThreadedOsmLayer.h"
+
+#include <vtkAtomic.h>
+#include <vtkConditionVariable.h>
+#include <vtkImageData.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <vector>
+
+vtkStandardNewMacro(vtkMapTileService)
+
+namespace
+{
+// The service returned by GetGlobalInstance(), while referenced
+vtkMapTileService *GlobalInstance = NULL;
+vtkSimpleMutexLock GlobalInstanceLock;
+
+// Urls of the tiles kept in memory, least recently used first
+typedef std::list<std::string> UseList;
+
+// Tile kept in memory: its decoded image, its encoded bytes, or both,
+// each with its position in the use list of its kind
+struct CachedImage
+{
+  vtkImageData *Image;
+  vtkTypeInt64 Size;
+  UseList::iterator ImageUse;  // valid if Image is set
+  std::vector<unsigned char> Data;
+  UseList::iterator EncodedUse;  // valid if Data is not empty
+};
+
+// Load in progress, and its result once done, kept until the callers
+// waiting for it have taken it
+struct PendingLoad
+{
+  bool Done;
+  bool Loaded;
+  vtkImageData *Image;
+  int Waiters;
+};
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 GetImageSize(vtkImageData *image)
+{
+  // Reported in KiB
+  return static_cast<vtkTypeInt64>(image->GetActualMemorySize()) * 1024;
+}
+}
+
+//----------------------------------------------------------------------------
+class vtkMapTileService::vtkMapTileServiceInternals
+{
+public:
+  // Request threads, and the layers they serve, in turns. Layers are
+  // busy while a request thread processes one of their requests.
+  // All guarded by Lock.
+  vtkMultiThreader *RequestThreader;
+  std::vector<int> RequestThreadIds;
+  int NumberOfThreads;
+  bool ThreadingEnabled;
+  std::vector<vtkMultiThreadedOsmLayer*> Layers;
+  std::map<vtkMultiThreadedOsmLayer*, int> BusyLayers;
+  std::size_t NextLayer;
+  vtkTypeUInt64 WakeCount;
+  vtkMutexLock *Lock;
+  vtkConditionVariable *WorkCondition;  // requests queued or ended
+  vtkConditionVariable *IdleCondition;  // layer no longer busy
+
+  // Image cache, with the encoded bytes of tiles, and loads in
+  // progress, guarded by LoadLock
+  std::map<std::string, CachedImage> Images;
+  UseList ImageUses;
+  UseList EncodedUses;
+  vtkTypeInt64 ImageCacheSize;
+  vtkTypeInt64 MaxImageCacheSize;
+  int NumberOfImages;
+  vtkTypeInt64 EncodedCacheSize;
+  vtkTypeInt64 MaxEncodedCacheSize;
+  int NumberOfEncodedTiles;
+  std::map<std::string, PendingLoad> Loads;
+  vtkMutexLock *LoadLock;
+  vtkConditionVariable *LoadCondition;  // load done
+
+  vtkAtomic<vtkTypeInt64> SharedImages;
+  vtkAtomic<vtkTypeInt64> SharedEncodedTiles;
+  vtkAtomic<vtkTypeInt64> CoalescedLoads;
+
+  // Find the image at url, with a reference for the caller.
+  // LoadLock must be locked.
+  vtkImageData *FindImage(const std::string& url)
+  {
+    std::map<std::string, CachedImage>::iterator iter =
+      this->Images.find(url);
+    if (iter == this->Images.end() || !iter->second.Image)
+      {
+      return NULL;
+      }
+    this->Touch(iter->second);
+    iter->second.Image->Register(NULL);
+    return iter->second.Image;
+  }
+
+  // Copy the encoded bytes of the tile at url into data, if kept.
+  // LoadLock must be locked.
+  bool FindEncodedTile(const std::string& url,
+                       std::vector<unsigned char>& data)
+  {
+    std::map<std::string, CachedImage>::iterator iter =
+      this->Images.find(url);
+    if (iter == this->Images.end() || iter->second.Data.empty())
+      {
+      return false;
+      }
+    this->Touch(iter->second);
+    data = iter->second.Data;
+    return true;
+  }
+
+  // Entry of the tile at url, created empty if missing.
+  // LoadLock must be locked.
+  CachedImage& GetEntry(const std::string& url)
+  {
+    std::map<std::string, CachedImage>::iterator iter =
+      this->Images.find(url);
+    if (iter == this->Images.end())
+      {
+      CachedImage cached;
+      cached.Image = NULL;
+      cached.Size = 0;
+      iter = this->Images.insert(std::make_pair(url, cached)).first;
+      }
+    this->Touch(iter->second);
+    return iter->second;
+  }
+
+  // Move the image and encoded bytes of the tile to the end of their
+  // use lists. LoadLock must be locked.
+  void Touch(CachedImage& cached)
+  {
+    if (cached.Image)
+      {
+      this->ImageUses.splice(this->ImageUses.end(), this->ImageUses,
+                             cached.ImageUse);
+      }
+    if (!cached.Data.empty())
+      {
+      this->EncodedUses.splice(this->EncodedUses.end(), this->EncodedUses,
+                               cached.EncodedUse);
+      }
+  }
+
+  // Add the image at url, unless larger than the cache.
+  // LoadLock must be locked.
+  void AddImage(const std::string& url, vtkImageData *image)
+  {
+    vtkTypeInt64 size = GetImageSize(image);
+    if (size > this->MaxImageCacheSize)
+      {
+      return;
+      }
+    CachedImage& cached = this->GetEntry(url);
+    image->Register(NULL);
+    this->DropImage(cached);
+    cached.Image = image;
+    cached.Size = size;
+    cached.ImageUse = this->ImageUses.insert(this->ImageUses.end(), url);
+    this->ImageCacheSize += size;
+    ++this->NumberOfImages;
+    this->EvictImages();
+  }
+
+  // Add the encoded bytes of the tile at url, unless larger than the
+  // cache. LoadLock must be locked.
+  void AddEncodedTile(const std::string& url,
+                      const std::vector<unsigned char>& data)
+  {
+    vtkTypeInt64 size = static_cast<vtkTypeInt64>(data.size());
+    if (size == 0 || size > this->MaxEncodedCacheSize)
+      {
+      return;
+      }
+    CachedImage& cached = this->GetEntry(url);
+    this->DropEncodedTile(cached);
+    cached.Data = data;
+    cached.EncodedUse =
+      this->EncodedUses.insert(this->EncodedUses.end(), url);
+    this->EncodedCacheSize += size;
+    ++this->NumberOfEncodedTiles;
+    this->EvictEncodedTiles();
+  }
+
+  // Evict the least recently used images beyond the size limit, down
+  // to their encoded bytes if kept. LoadLock must be locked.
+  void EvictImages()
+  {
+    while (this->ImageCacheSize > this->MaxImageCacheSize)
+      {
+      std::map<std::string, CachedImage>::iterator oldest =
+        this->Images.find(this->ImageUses.front());
+      this->DropImage(oldest->second);
+      this->EraseIfEmpty(oldest);
+      }
+  }
+
+  // Evict the least recently used encoded bytes beyond the size limit.
+  // LoadLock must be locked.
+  void EvictEncodedTiles()
+  {
+    while (this->EncodedCacheSize > this->MaxEncodedCacheSize)
+      {
+      std::map<std::string, CachedImage>::iterator oldest =
+        this->Images.find(this->EncodedUses.front());
+      this->DropEncodedTile(oldest->second);
+      this->EraseIfEmpty(oldest);
+      }
+  }
+
+  // LoadLock must be locked
+  void DropImage(CachedImage& cached)
+  {
+    if (cached.Image)
+      {
+      this->ImageCacheSize -= cached.Size;
+      --this->NumberOfImages;
+      this->ImageUses.erase(cached.ImageUse);
+      cached.Image->UnRegister(NULL);
+      cached.Image = NULL;
+      cached.Size = 0;
+      }
+  }
+
+  // LoadLock must be locked
+  void DropEncodedTile(CachedImage& cached)
+  {
+    if (!cached.Data.empty())
+      {
+      this->EncodedCacheSize -=
+        static_cast<vtkTypeInt64>(cached.Data.size());
+      --this->NumberOfEncodedTiles;
+      this->EncodedUses.erase(cached.EncodedUse);
+      std::vector<unsigned char>().swap(cached.Data);
+      }
+  }
+
+  // LoadLock must be locked
+  void EraseIfEmpty(std::map<std::string, CachedImage>::iterator iter)
+  {
+    if (!iter->second.Image && iter->second.Data.empty())
+      {
+      this->Images.erase(iter);
+      }
+  }
+
+  // LoadLock must be locked
+  void RemoveImage(const std::string& url)
+  {
+    std::map<std::string, CachedImage>::iterator iter =
+      this->Images.find(url);
+    if (iter != this->Images.end())
+      {
+      this->DropImage(iter->second);
+      this->DropEncodedTile(iter->second);
+      this->Images.erase(iter);
+      }
+  }
+
+  // Forget a load once done and taken by all waiters.
+  // LoadLock must be locked.
+  void ReleaseLoad(std::map<std::string, PendingLoad>::iterator iter)
+  {
+    if (iter->second.Done && iter->second.Waiters == 0)
+      {
+      if (iter->second.Image)
+        {
+        iter->second.Image->UnRegister(NULL);
+        }
+      this->Loads.erase(iter);
+      }
+  }
+};
+
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE StaticRequestThreadExecute(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  vtkMapTileService *self = static_cast<vtkMapTileService*>(info->UserData);
+  self->RequestThreadExecute(info->ThreadID);
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileService::vtkMapTileService()
+{
+  this->ConcurrencyController = vtkMapTileConcurrencyController::New();
+  this->Internals = new vtkMapTileServiceInternals;
+  vtkMapTileServiceInternals *internals = this->Internals;
+  internals->RequestThreader = vtkMultiThreader::New();
+  internals->NumberOfThreads = 16;
+  internals->ThreadingEnabled = false;
+  internals->NextLayer = 0;
+  internals->WakeCount = 0;
+  internals->Lock = vtkMutexLock::New();
+  internals->WorkCondition = vtkConditionVariable::New();
+  internals->IdleCondition = vtkConditionVariable::New();
+  internals->ImageCacheSize = 0;
+  internals->MaxImageCacheSize = 64 * 1024 * 1024;
+  internals->NumberOfImages = 0;
+  internals->EncodedCacheSize = 0;
+  internals->MaxEncodedCacheSize = 32 * 1024 * 1024;
+  internals->NumberOfEncodedTiles = 0;
+  internals->LoadLock = vtkMutexLock::New();
+  internals->LoadCondition = vtkConditionVariable::New();
+  internals->SharedImages = 0;
+  internals->SharedEncodedTiles = 0;
+  internals->CoalescedLoads = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileService::~vtkMapTileService()
+{
+  // Layers hold references, so none is left
+  this->StopRequestThreads();
+  this->RemoveAllImages();
+
+  vtkMapTileServiceInternals *internals = this->Internals;
+  std::map<std::string, PendingLoad>::iterator iter =
+    internals->Loads.begin();
+  for (; iter != internals->Loads.end(); iter++)
+    {
+    if (iter->second.Image)
+      {
+      iter->second.Image->UnRegister(NULL);
+      }
+    }
+  internals->RequestThreader->Delete();
+  internals->Lock->Delete();
+  internals->WorkCondition->Delete();
+  internals->IdleCondition->Delete();
+  internals->LoadLock->Delete();
+  internals->LoadCondition->Delete();
+  delete this->Internals;
+  this->ConcurrencyController->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfThreads: " << this->GetNumberOfThreads() << "\n"
+     << indent << "NumberOfLayers: " << this->GetNumberOfLayers() << "\n"
+     << indent << "MaxImageCacheSize: " << this->GetMaxImageCacheSize()
+     << "\n"
+     << indent << "ImageCacheSize: " << this->GetImageCacheSize() << "\n"
+     << indent << "NumberOfCachedImages: "
+     << this->GetNumberOfCachedImages() << "\n"
+     << indent << "MaxEncodedCacheSize: " << this->GetMaxEncodedCacheSize()
+     << "\n"
+     << indent << "EncodedCacheSize: " << this->GetEncodedCacheSize() << "\n"
+     << indent << "NumberOfEncodedTiles: "
+     << this->GetNumberOfEncodedTiles() << "\n"
+     << indent << "NumberOfSharedImages: "
+     << this->GetNumberOfSharedImages() << "\n"
+     << indent << "NumberOfSharedEncodedTiles: "
+     << this->GetNumberOfSharedEncodedTiles() << "\n"
+     << indent << "NumberOfCoalescedLoads: "
+     << this->GetNumberOfCoalescedLoads() << "\n"
+     << indent << "ConcurrencyController: "
+     << this->ConcurrencyController << std::endl;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileService *vtkMapTileService::GetGlobalInstance()
+{
+  GlobalInstanceLock.Lock();
+  if (GlobalInstance)
+    {
+    GlobalInstance->Register(NULL);
+    }
+  else
+    {
+    GlobalInstance = vtkMapTileService::New();
+    }
+  vtkMapTileService *service = GlobalInstance;
+  GlobalInstanceLock.Unlock();
+  return service;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::UnRegister(vtkObjectBase *o)
+{
+  // References to the global instance are released under the lock, as
+  // GetGlobalInstance() adds them, so that the count checked here is the
+  // one released, and the instance is forgotten before it is deleted
+  GlobalInstanceLock.Lock();
+  if (this != GlobalInstance)
+    {
+    GlobalInstanceLock.Unlock();
+    this->Superclass::UnRegister(o);
+    return;
+    }
+  if (this->GetReferenceCount() == 1)
+    {
+    GlobalInstance = NULL;
+    }
+  this->Superclass::UnRegister(o);
+  GlobalInstanceLock.Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::SetNumberOfThreads(int count)
+{
+  count = std::max(1, std::min(count, 64));
+  vtkMapTileServiceInternals *internals = this->Internals;
+  internals->Lock->Lock();
+  bool changed = count != internals->NumberOfThreads;
+  bool running = !internals->RequestThreadIds.empty();
+  internals->NumberOfThreads = count;
+  internals->Lock->Unlock();
+  if (!changed)
+    {
+    return;
+    }
+
+  if (running)
+    {
+    this->StopRequestThreads();
+    this->StartRequestThreads();
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileService::GetNumberOfThreads()
+{
+  this->Internals->Lock->Lock();
+  int count = this->Internals->NumberOfThreads;
+  this->Internals->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::SetMaxImageCacheSize(vtkTypeInt64 bytes)
+{
+  bytes = std::max(bytes, static_cast<vtkTypeInt64>(0));
+  vtkMapTileServiceInternals *internals = this->Internals;
+  internals->LoadLock->Lock();
+  internals->MaxImageCacheSize = bytes;
+  internals->EvictImages();
+  internals->LoadLock->Unlock();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileService::GetMaxImageCacheSize()
+{
+  this->Internals->LoadLock->Lock();
+  vtkTypeInt64 bytes = this->Internals->MaxImageCacheSize;
+  this->Internals->LoadLock->Unlock();
+  return bytes;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileService::GetImageCacheSize()
+{
+  this->Internals->LoadLock->Lock();
+  vtkTypeInt64 bytes = this->Internals->ImageCacheSize;
+  this->Internals->LoadLock->Unlock();
+  return bytes;
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileService::GetNumberOfCachedImages()
+{
+  this->Internals->LoadLock->Lock();
+  int count = this->Internals->NumberOfImages;
+  this->Internals->LoadLock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::SetMaxEncodedCacheSize(vtkTypeInt64 bytes)
+{
+  bytes = std::max(bytes, static_cast<vtkTypeInt64>(0));
+  vtkMapTileServiceInternals *internals = this->Internals;
+  internals->LoadLock->Lock();
+  internals->MaxEncodedCacheSize = bytes;
+  internals->EvictEncodedTiles();
+  internals->LoadLock->Unlock();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileService::GetMaxEncodedCacheSize()
+{
+  this->Internals->LoadLock->Lock();
+  vtkTypeInt64 bytes = this->Internals->MaxEncodedCacheSize;
+  this->Internals->LoadLock->Unlock();
+  return bytes;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileService::GetEncodedCacheSize()
+{
+  this->Internals->LoadLock->Lock();
+  vtkTypeInt64 bytes = this->Internals->EncodedCacheSize;
+  this->Internals->LoadLock->Unlock();
+  return bytes;
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileService::GetNumberOfEncodedTiles()
+{
+  this->Internals->LoadLock->Lock();
+  int count = this->Internals->NumberOfEncodedTiles;
+  this->Internals->LoadLock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileService::GetNumberOfSharedImages()
+{
+  return this->Internals->SharedImages;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileService::GetNumberOfSharedEncodedTiles()
+{
+  return this->Internals->SharedEncodedTiles;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileService::GetNumberOfCoalescedLoads()
+{
+  return this->Internals->CoalescedLoads;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::AddLayer(vtkMultiThreadedOsmLayer *layer)
+{
+  vtkMapTileServiceInternals *internals = this->Internals;
+  internals->Lock->Lock();
+  bool found = std::find(internals->Layers.begin(), internals->Layers.end(),
+                         layer) != internals->Layers.end();
+  if (!found)
+    {
+    internals->Layers.push_back(layer);
+    ++internals->WakeCount;
+    internals->WorkCondition->Broadcast();
+    }
+  bool running = !internals->RequestThreadIds.empty();
+  internals->Lock->Unlock();
+
+  // Threads start with the first layer
+  if (!running)
+    {
+    this->StartRequestThreads();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::RemoveLayer(vtkMultiThreadedOsmLayer *layer)
+{
+  vtkMapTileServiceInternals *internals = this->Internals;
+  internals->Lock->Lock();
+  std::vector<vtkMultiThreadedOsmLayer*>::iterator iter =
+    std::find(internals->Layers.begin(), internals->Layers.end(), layer);
+  if (iter != internals->Layers.end())
+    {
+    internals->Layers.erase(iter);
+    }
+
+  // Waits for the requests in progress
+  while (internals->BusyLayers[layer] > 0)
+    {
+    internals->IdleCondition->Wait(internals->Lock);
+    }
+  internals->BusyLayers.erase(layer);
+  internals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileService::GetNumberOfLayers()
+{
+  this->Internals->Lock->Lock();
+  std::size_t count = this->Internals->Layers.size();
+  this->Internals->Lock->Unlock();
+  return static_cast<int>(count);
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::WakeRequestThreads()
+{
+  this->Internals->Lock->Lock();
+  ++this->Internals->WakeCount;
+  this->Internals->WorkCondition->Broadcast();
+  this->Internals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::StartRequestThreads()
+{
+  vtkMapTileServiceInternals *internals = this->Internals;
+  internals->Lock->Lock();
+  if (!internals->RequestThreadIds.empty())
+    {
+    internals->Lock->Unlock();
+    return;
+    }
+  internals->ThreadingEnabled = true;
+  for (int i = 0; i < internals->NumberOfThreads; ++i)
+    {
+    internals->RequestThreadIds.push_back(
+      internals->RequestThreader->SpawnThread(
+        StaticRequestThreadExecute, this));
+    }
+  internals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::StopRequestThreads()
+{
+  vtkMapTileServiceInternals *internals = this->Internals;
+  internals->Lock->Lock();
+  internals->ThreadingEnabled = false;
+  internals->WorkCondition->Broadcast();
+  std::vector<int> threadIds;
+  threadIds.swap(internals->RequestThreadIds);
+  internals->Lock->Unlock();
+
+  // Waits for the requests in progress
+  for (std::size_t i = 0; i < threadIds.size(); ++i)
+    {
+    internals->RequestThreader->TerminateThread(threadIds[i]);
+    vtkDebugMacro("Terminate Thread " << threadIds[i]);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Takes the next request of each layer in turn, and waits for more
+// when no layer has a request ready
+void vtkMapTileService::RequestThreadExecute(int vtkNotUsed(threadId))
+{
+  vtkMapTileServiceInternals *internals = this->Internals;
+  internals->Lock->Lock();
+  while (internals->ThreadingEnabled)
+    {
+    vtkTypeUInt64 wakeCount = internals->WakeCount;
+    std::size_t first = internals->NextLayer++;
+    bool processed = false;
+    bool delayed = false;
+    std::size_t numLayers = internals->Layers.size();
+    for (std::size_t i = 0; i < numLayers && !processed; ++i)
+      {
+      // Layers may have been removed meanwhile
+      if (internals->Layers.empty() || !internals->ThreadingEnabled)
+        {
+        break;
+        }
+      vtkMultiThreadedOsmLayer *layer =
+        internals->Layers[(first + i) % internals->Layers.size()];
+      ++internals->BusyLayers[layer];
+      internals->Lock->Unlock();
+
+      int result = layer->ProcessNextRequest();
+
+      internals->Lock->Lock();
+      if (--internals->BusyLayers[layer] == 0)
+        {
+        internals->IdleCondition->Broadcast();
+        }
+      processed = result == RequestProcessed;
+      delayed = delayed || result == RequestDelayed;
+      }
+
+    if (processed || !internals->ThreadingEnabled)
+      {
+      continue;
+      }
+    if (delayed)
+      {
+      // Requests waiting for time rather than for other requests
+      internals->Lock->Unlock();
+      vtksys::SystemTools::Delay(50);
+      internals->Lock->Lock();
+      }
+    else if (wakeCount == internals->WakeCount)
+      {
+      internals->WorkCondition->Wait(internals->Lock);
+      }
+    }
+  internals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileService::BeginLoad(const std::string& url,
+                                 const std::string& loadKey,
+                                 vtkImageData *&image,
+                                 std::vector<unsigned char> *data,
+                                 bool wait)
+{
+  vtkMapTileServiceInternals *internals = this->Internals;
+  bool waited = false;
+  image = NULL;
+  internals->LoadLock->Lock();
+  for (;;)
+    {
+    image = internals->FindImage(url);
+    if (image)
+      {
+      internals->LoadLock->Unlock();
+      ++internals->SharedImages;
+      return LoadShared;
+      }
+
+    std::map<std::string, PendingLoad>::iterator iter =
+      internals->Loads.find(loadKey);
+    if (iter == internals->Loads.end())
+      {
+      PendingLoad load;
+      load.Done = false;
+      load.Loaded = false;
+      load.Image = NULL;
+      load.Waiters = 0;
+      internals->Loads[loadKey] = load;
+      bool encoded = data && internals->FindEncodedTile(url, *data);
+      internals->LoadLock->Unlock();
+      if (encoded)
+        {
+        ++internals->SharedEncodedTiles;
+        return LoadEncoded;
+        }
+      return LoadTile;
+      }
+
+    // Same load in progress. Entries are only erased once done and
+    // taken, so iter stays valid while waiting.
+    if (!wait)
+      {
+      internals->LoadLock->Unlock();
+      return LoadInProgress;
+      }
+    if (!waited)
+      {
+      waited = true;
+      ++internals->CoalescedLoads;
+      }
+    ++iter->second.Waiters;
+    while (!iter->second.Done)
+      {
+      internals->LoadCondition->Wait(internals->LoadLock);
+      }
+    --iter->second.Waiters;
+    bool loaded = iter->second.Loaded;
+    image = iter->second.Image;
+    if (image)
+      {
+      image->Register(NULL);
+      }
+    internals->ReleaseLoad(iter);
+    if (image)
+      {
+      internals->LoadLock->Unlock();
+      ++internals->SharedImages;
+      return LoadShared;
+      }
+    if (!loaded)
+      {
+      internals->LoadLock->Unlock();
+      return LoadFailed;
+      }
+    // Loaded without an image, so loads it again
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::EndLoad(const std::string& url,
+                               const std::string& loadKey,
+                               vtkImageData *image, bool loaded)
+{
+  vtkMapTileServiceInternals *internals = this->Internals;
+  internals->LoadLock->Lock();
+  if (image)
+    {
+    internals->AddImage(url, image);
+    }
+  std::map<std::string, PendingLoad>::iterator iter =
+    internals->Loads.find(loadKey);
+  if (iter != internals->Loads.end() && !iter->second.Done)
+    {
+    iter->second.Done = true;
+    iter->second.Loaded = loaded;
+    iter->second.Image = image;
+    if (image)
+      {
+      image->Register(NULL);
+      }
+    internals->ReleaseLoad(iter);
+    internals->LoadCondition->Broadcast();
+    }
+  internals->LoadLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMapTileService::FindImage(const std::string& url)
+{
+  this->Internals->LoadLock->Lock();
+  vtkImageData *image = this->Internals->FindImage(url);
+  this->Internals->LoadLock->Unlock();
+  if (image)
+    {
+    ++this->Internals->SharedImages;
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::AddImage(const std::string& url, vtkImageData *image)
+{
+  if (!image)
+    {
+    return;
+    }
+  this->Internals->LoadLock->Lock();
+  this->Internals->AddImage(url, image);
+  this->Internals->LoadLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::AddEncodedTile(const std::string& url,
+                                       const std::vector<unsigned char>& data)
+{
+  this->Internals->LoadLock->Lock();
+  this->Internals->AddEncodedTile(url, data);
+  this->Internals->LoadLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::RemoveImage(const std::string& url)
+{
+  this->Internals->LoadLock->Lock();
+  this->Internals->RemoveImage(url);
+  this->Internals->LoadLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::RemoveAllImages()
+{
+  vtkMapTileServiceInternals *internals = this->Internals;
+  internals->LoadLock->Lock();
+  std::map<std::string, CachedImage>::iterator iter =
+    internals->Images.begin();
+  for (; iter != internals->Images.end(); iter++)
+    {
+    if (iter->second.Image)
+      {
+      iter->second.Image->UnRegister(NULL);
+      }
+    }
+  internals->Images.clear();
+  internals->ImageUses.clear();
+  internals->EncodedUses.clear();
+  internals->ImageCacheSize = 0;
+  internals->NumberOfImages = 0;
+  internals->EncodedCacheSize = 0;
+  internals->NumberOfEncodedTiles = 0;
+  internals->LoadLock->Unlock();
+}
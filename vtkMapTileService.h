@@ -0,0 +1,227 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileService.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileService - tile loading shared by map layers
+// .SECTION Description
+// Loads map tiles for all the vtkOsmLayer instances of a process, in
+// any number of vtkMap instances, so that a tile wanted by several
+// layers is fetched and decoded once:
+//
+// - Loads of the same tile in progress are coalesced: the first layer
+//   asking for a tile loads it, and the others wait for its result.
+// - Decoded tile images are kept in a memory cache, bounded in size,
+//   and shared by the tiles of all layers, which texture them as is.
+// - The encoded (PNG/JPEG) bytes of tiles are kept in a second memory
+//   cache, with a budget of its own, so that tiles whose images were
+//   evicted are decoded again rather than read from disk or downloaded.
+//
+// Tiles thus move through tiers of residency, driven by the views of
+// the layers: tiles in view and recently seen keep their textures, up
+// to vtkOsmLayer::SetMaxCacheSize() per layer; tiles evicted from a
+// layer leave their images here as the most recently used ones; least
+// recently used images are dropped down to their encoded bytes, and
+// those down to the disk cache of each layer.
+// - One pool of request threads serves the request queues of all
+//   vtkMultiThreadedOsmLayer instances, taking turns between them.
+// - Downloads from the same host are limited together, by one
+//   vtkMapTileConcurrencyController.
+//
+// Layers use the service returned by GetGlobalInstance(), which exists
+// as long as it is referenced. Layers can also be given a service of
+// their own with vtkOsmLayer::SetTileService(), to isolate them.
+//
+// Tiles are identified by their URLs, see vtkTileSource::GetTileUrl().
+// All methods are thread safe.
+
+#ifndef __vtkMapTileService_h
+#define __vtkMapTileService_h
+
+#include "vtkmap_export.h"
+#include <vtkObject.h>
+#include <string>
+#include <vector>
+
+class vtkImageData;
+class vtkMapTileConcurrencyController;
+class vtkMultiThreadedOsmLayer;
+
+class VTKMAP_EXPORT vtkMapTileService : public vtkObject
+{
+public:
+  static vtkMapTileService *New();
+  vtkTypeMacro(vtkMapTileService, vtkObject)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // The service shared by the layers of the process, created by the
+  // first call and deleted with its last reference. The caller gets a
+  // reference of its own, to be released with Delete().
+  static vtkMapTileService *GetGlobalInstance();
+
+  // Description:
+  // Override vtkObject::UnRegister(), to forget the global instance
+  // with its last reference
+  virtual void UnRegister(vtkObjectBase *o);
+
+  // Description:
+  // Get/Set the number of request threads. They start when the first
+  // vtkMultiThreadedOsmLayer is added. Changing the number restarts
+  // them, after the requests in progress are done. Default is 16.
+  void SetNumberOfThreads(int count);
+  int GetNumberOfThreads();
+
+  // Description:
+  // Get/Set the most memory, in bytes, held by the decoded images kept
+  // for sharing. Images still used by tiles stay in memory after they
+  // leave the cache. 0 keeps no images, so that only loads in progress
+  // are shared. Default is 64 MB.
+  void SetMaxImageCacheSize(vtkTypeInt64 bytes);
+  vtkTypeInt64 GetMaxImageCacheSize();
+
+  // Description:
+  // Memory held by the decoded images kept for sharing, and their number
+  vtkTypeInt64 GetImageCacheSize();
+  int GetNumberOfCachedImages();
+
+  // Description:
+  // Get/Set the most memory, in bytes, held by the encoded bytes of
+  // tiles kept in memory, least recently used dropped first. 0 keeps
+  // none. Default is 32 MB.
+  void SetMaxEncodedCacheSize(vtkTypeInt64 bytes);
+  vtkTypeInt64 GetMaxEncodedCacheSize();
+
+  // Description:
+  // Memory held by the encoded bytes of tiles kept, and their number
+  vtkTypeInt64 GetEncodedCacheSize();
+  int GetNumberOfEncodedTiles();
+
+  // Description:
+  // The controller limiting downloads per host, shared by the layers
+  vtkGetObjectMacro(ConcurrencyController, vtkMapTileConcurrencyController);
+
+  // Description:
+  // Add/Remove a layer whose request queue the request threads serve.
+  // Removing a layer waits for its requests in progress.
+  void AddLayer(vtkMultiThreadedOsmLayer *layer);
+  void RemoveLayer(vtkMultiThreadedOsmLayer *layer);
+  int GetNumberOfLayers();
+
+  // Description:
+  // Wake up the request threads, after requests were queued or
+  // downloads ended
+  void WakeRequestThreads();
+
+  // Description:
+  // Results of vtkMultiThreadedOsmLayer::ProcessNextRequest(): a request
+  // was processed, no request can start until the threads are woken up,
+  // or requests are to be tried again after a delay.
+  enum RequestResult
+  {
+    RequestProcessed = 0,
+    NoRequestReady,
+    RequestDelayed
+  };
+
+  // Description:
+  // Results of BeginLoad(): the caller is to load the tile, the image of
+  // the tile was found, the load of the tile by another caller failed,
+  // the caller is to decode the encoded bytes of the tile found, or the
+  // tile is being loaded by another caller that was not waited for
+  enum LoadResult
+  {
+    LoadTile = 0,
+    LoadShared,
+    LoadFailed,
+    LoadEncoded,
+    LoadInProgress
+  };
+
+  // Description:
+  // Start loading the tile at url. Returns LoadShared with the image set
+  // if a decoded image of the tile is kept, or was loaded meanwhile by
+  // another caller, which the call waits for if the same load is in
+  // progress. The image then has a reference for the caller. Returns
+  // LoadTile if the caller is to load the tile, and end the load with
+  // EndLoad(). loadKey identifies the load in progress, so that loads of
+  // different kinds, e.g. cache lookups and downloads, are not shared.
+  // If data is given and the encoded bytes of the tile are kept, returns
+  // LoadEncoded with a copy of them in data instead of LoadTile; the
+  // caller decodes them, and ends the load the same way. If wait is
+  // false, returns LoadInProgress instead of waiting for the same load
+  // in progress; the caller then loads the tile on its own, without
+  // ending the load.
+  int BeginLoad(const std::string& url, const std::string& loadKey,
+                vtkImageData *&image,
+                std::vector<unsigned char> *data = NULL,
+                bool wait = true);
+
+  // Description:
+  // End the load started by BeginLoad(), with the decoded image, if
+  // any, and whether the tile was loaded. A loaded tile without an
+  // image, e.g. decoded later, is loaded again by those waiting for it.
+  void EndLoad(const std::string& url, const std::string& loadKey,
+               vtkImageData *image, bool loaded);
+
+  // Description:
+  // Find the decoded image of the tile at url, with a reference for the
+  // caller, or return NULL
+  vtkImageData *FindImage(const std::string& url);
+
+  // Description:
+  // Add/Remove the decoded image of the tile at url to/from the cache,
+  // as the most recently used one. Removing also drops the encoded
+  // bytes of the tile. Tiles changed on the tile server must be removed.
+  void AddImage(const std::string& url, vtkImageData *image);
+  void RemoveImage(const std::string& url);
+  void RemoveAllImages();
+
+  // Description:
+  // Keep a copy of the encoded bytes of the tile at url, read or
+  // downloaded by the caller
+  void AddEncodedTile(const std::string& url,
+                      const std::vector<unsigned char>& data);
+
+  // Description:
+  // Statistics: number of tiles served from the image cache, number of
+  // tiles decoded from their encoded bytes kept, and number of loads
+  // that waited for the same load by another caller
+  vtkTypeInt64 GetNumberOfSharedImages();
+  vtkTypeInt64 GetNumberOfSharedEncodedTiles();
+  vtkTypeInt64 GetNumberOfCoalescedLoads();
+
+  // Description:
+  // Threaded method serving the request queues of the layers, until
+  // the request threads are stopped
+  void RequestThreadExecute(int threadId);
+
+protected:
+  vtkMapTileService();
+  ~vtkMapTileService();
+
+  // Description:
+  // Start and stop the request threads
+  void StartRequestThreads();
+  void StopRequestThreads();
+
+  vtkMapTileConcurrencyController *ConcurrencyController;
+
+  class vtkMapTileServiceInternals;
+  vtkMapTileServiceInternals *Internals;
+
+private:
+  vtkMapTileService(const vtkMapTileService&);  // Not implemented
+  void operator=(const vtkMapTileService&); // Not implemented
+};
+
+#endif // __vtkMapTileService_h
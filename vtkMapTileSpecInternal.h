@@ -27,6 +27,7 @@ public:
   double Corners[4];  // world coordinates
   int ZoomRowCol[3];  // OSM tile indices
   int ZoomXY[3];      // local cache indices
+  bool Prefetch;      // requested ahead of being in view
   vtkMapTile *Tile;
 
   vtkMapTileSpecInternal();
@@ -34,6 +35,7 @@ public:
 
 inline vtkMapTileSpecInternal::vtkMapTileSpecInternal()
 {
+  this->Prefetch = false;
   this->Tile = NULL;
 }
 
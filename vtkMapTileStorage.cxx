@@ -0,0 +1,195 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileStorage.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileStorage.h"
+#include "vtkMapTileDiskCache.h"
+#include "vtkMapTileRevalidator.h"
+#include "vtkPackedTileStore.h"
+
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <map>
+
+vtkStandardNewMacro(vtkMapTileStorage)
+
+namespace
+{
+// Storages returned by Acquire(), by directory, while referenced
+std::map<std::string, vtkMapTileStorage*> Storages;
+vtkSimpleMutexLock StoragesLock;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileStorage::vtkMapTileStorage()
+{
+  this->TileStore = NULL;
+  this->DiskCache = NULL;
+  this->Revalidator = NULL;
+  this->NumberOfRevalidatedLayers = 0;
+  this->Lock = vtkMutexLock::New();
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileStorage::~vtkMapTileStorage()
+{
+  // Layers remove themselves from the revalidator before releasing
+  // their references, so it is stopped already
+  if (this->Revalidator)
+    {
+    this->Revalidator->Delete();
+    }
+  if (this->DiskCache)
+    {
+    this->DiskCache->Delete();
+    }
+  if (this->TileStore)
+    {
+    this->TileStore->Delete();
+    }
+  this->Lock->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileStorage::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Directory: " << this->Directory << "\n"
+     << indent << "Extension: " << this->Extension << "\n"
+     << indent << "TileStore: " << this->TileStore << "\n"
+     << indent << "DiskCache: " << this->DiskCache << "\n"
+     << indent << "Revalidator: " << this->Revalidator << "\n"
+     << indent << "NumberOfRevalidatedLayers: "
+     << this->NumberOfRevalidatedLayers << std::endl;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileStorage *vtkMapTileStorage::Acquire(const char *directory,
+                                              bool packed,
+                                              const char *extension)
+{
+  std::string path = vtksys::SystemTools::CollapseFullPath(directory);
+  StoragesLock.Lock();
+  std::map<std::string, vtkMapTileStorage*>::iterator iter =
+    Storages.find(path);
+  if (iter != Storages.end())
+    {
+    vtkMapTileStorage *storage = iter->second;
+    storage->Register(NULL);
+    StoragesLock.Unlock();
+    if (packed != (storage->TileStore != NULL))
+      {
+      vtkWarningWithObjectMacro(storage, "Tiles in " << path << " are "
+                                << (packed ? "not " : "") << "packed by "
+                                << "another layer, storing them the same");
+      }
+    return storage;
+    }
+
+  vtkMapTileStorage *storage = vtkMapTileStorage::New();
+  storage->Directory = path;
+  if (packed)
+    {
+    std::string packPath = path + "/tiles.pack";
+    storage->TileStore = vtkPackedTileStore::New();
+    if (!storage->TileStore->Open(packPath.c_str()))
+      {
+      vtkErrorWithObjectMacro(storage, "Unable to open packed tile store "
+                              << packPath << ", using per-file cache");
+      storage->TileStore->Delete();
+      storage->TileStore = NULL;
+      }
+    }
+  storage->Extension = extension;
+  Storages[path] = storage;
+  StoragesLock.Unlock();
+  return storage;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileStorage::UnRegister(vtkObjectBase *o)
+{
+  // References are released under the lock, as Acquire() adds them, so
+  // that the storage is forgotten before it is deleted
+  StoragesLock.Lock();
+  if (this->GetReferenceCount() == 1)
+    {
+    Storages.erase(this->Directory);
+    }
+  this->Superclass::UnRegister(o);
+  StoragesLock.Unlock();
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileDiskCache *vtkMapTileStorage::GetDiskCache()
+{
+  this->Lock->Lock();
+  vtkMapTileDiskCache *diskCache = this->DiskCache;
+  this->Lock->Unlock();
+  return diskCache;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileDiskCache *vtkMapTileStorage::RequestDiskCache()
+{
+  this->Lock->Lock();
+  if (!this->DiskCache)
+    {
+    this->DiskCache = vtkMapTileDiskCache::New();
+    this->DiskCache->Open(this->Directory.c_str(), this->Extension.c_str(),
+                          this->TileStore);
+    }
+  vtkMapTileDiskCache *diskCache = this->DiskCache;
+  this->Lock->Unlock();
+  return diskCache;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileRevalidator *vtkMapTileStorage::AddRevalidatedLayer(
+  vtkOsmLayer *layer)
+{
+  this->Lock->Lock();
+  if (!this->Revalidator)
+    {
+    this->Revalidator = vtkMapTileRevalidator::New();
+    this->Revalidator->Open(layer, this->Directory.c_str());
+    }
+  else
+    {
+    this->Revalidator->AddLayer(layer);
+    }
+  ++this->NumberOfRevalidatedLayers;
+  vtkMapTileRevalidator *revalidator = this->Revalidator;
+  this->Lock->Unlock();
+  return revalidator;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileStorage::RemoveRevalidatedLayer(vtkOsmLayer *layer)
+{
+  this->Lock->Lock();
+  if (this->Revalidator)
+    {
+    // Waits for a revalidation in progress with the layer
+    this->Revalidator->RemoveLayer(layer);
+    if (--this->NumberOfRevalidatedLayers == 0)
+      {
+      this->Revalidator->Delete();
+      this->Revalidator = NULL;
+      }
+    }
+  this->Lock->Unlock();
+}
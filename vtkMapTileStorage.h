@@ -0,0 +1,105 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileStorage.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileStorage - on-disk tile cache shared by map layers
+// .SECTION Description
+// Owns the objects managing the files of one tile cache directory: the
+// vtkPackedTileStore (tiles.pack, tiles.idx), if the tiles are packed,
+// the vtkMapTileDiskCache (tiles.journal) and the vtkMapTileRevalidator
+// (tiles.http). Layers of any map and tile service using the same
+// cache directory, e.g. showing the same tile server, share one
+// storage, so that the files are only written by one set of objects.
+//
+// Storages are returned by Acquire(), which creates the storage of a
+// directory with its first reference, and forgets it with its last.
+// The first layer acquiring a directory decides whether its tiles are
+// packed, and the quota of the disk cache is the one last set. The
+// disk cache, which scans the whole directory, is only created once a
+// layer sets a quota or asks for the cache statistics.
+// All methods are thread safe.
+
+#ifndef __vtkMapTileStorage_h
+#define __vtkMapTileStorage_h
+
+#include "vtkmap_export.h"
+#include <vtkObject.h>
+#include <string>
+
+class vtkMapTileDiskCache;
+class vtkMapTileRevalidator;
+class vtkMutexLock;
+class vtkOsmLayer;
+class vtkPackedTileStore;
+
+class VTKMAP_EXPORT vtkMapTileStorage : public vtkObject
+{
+public:
+  vtkTypeMacro(vtkMapTileStorage, vtkObject)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // The storage of the cache directory, created if no other layer uses
+  // it, with a packed tile store if packed is true. The caller gets a
+  // reference of its own, to be released with Delete().
+  static vtkMapTileStorage *Acquire(const char *directory, bool packed,
+                                    const char *extension);
+
+  // Description:
+  // Override vtkObject::UnRegister(), to forget the storage of the
+  // directory with its last reference
+  virtual void UnRegister(vtkObjectBase *o);
+
+  // Description:
+  // The cache directory
+  const char *GetDirectory() { return this->Directory.c_str(); }
+
+  // Description:
+  // The packed tile store, or NULL if tiles are stored one per file
+  vtkGetObjectMacro(TileStore, vtkPackedTileStore);
+
+  // Description:
+  // The object keeping the cache within its quota, and accounting for
+  // its disk usage, or NULL if not requested yet
+  vtkMapTileDiskCache *GetDiskCache();
+
+  // Description:
+  // The disk cache, created if needed
+  vtkMapTileDiskCache *RequestDiskCache();
+
+  // Description:
+  // Add/Remove a layer whose cached tiles are revalidated. The
+  // revalidator is created with the first layer, and deleted with the
+  // last. Returns the revalidator.
+  vtkMapTileRevalidator *AddRevalidatedLayer(vtkOsmLayer *layer);
+  void RemoveRevalidatedLayer(vtkOsmLayer *layer);
+
+protected:
+  static vtkMapTileStorage *New();
+  vtkMapTileStorage();
+  ~vtkMapTileStorage();
+
+  std::string Directory;
+  std::string Extension;
+  vtkPackedTileStore *TileStore;
+  vtkMapTileDiskCache *DiskCache;
+  vtkMapTileRevalidator *Revalidator;
+  int NumberOfRevalidatedLayers;
+  vtkMutexLock *Lock;
+
+private:
+  vtkMapTileStorage(const vtkMapTileStorage&);  // Not implemented
+  void operator=(const vtkMapTileStorage&); // Not implemented
+};
+
+#endif // __vtkMapTileStorage_h
@@ -0,0 +1,335 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMercator.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMercator.h"
+
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
+#include <vtkType.h>
+
+#include <algorithm>
+#include <cstring>
+
+// The kernels below are branch-free, and take exponents apart with
+// integer arithmetic instead of calling frexp() and ldexp(), so that
+// the loops calling them vectorize.
+namespace
+{
+  const double Pi = 3.14159265358979323846;
+  const double Ln2Hi = 6.93147180369123816490e-01;
+  const double Ln2Lo = 1.90821492927058770002e-10;
+  const double InvLn2 = 1.44269504088896338700;
+  const double TwoPow52 = 4503599627370496.0;
+  const double RoundMagic = 6755399441055744.0;  // 1.5 * 2^52
+  const vtkIdType BlockSize = 1024;
+
+  //--------------------------------------------------------------------------
+  inline vtkTypeUInt64 AsBits(double value)
+  {
+    vtkTypeUInt64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  //--------------------------------------------------------------------------
+  inline double AsDouble(vtkTypeUInt64 bits)
+  {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  //--------------------------------------------------------------------------
+  // Natural logarithm of a positive, normal x. x = m * 2^e with m in
+  // [sqrt(1/2), sqrt(2)), and log(m) = 2 atanh((m - 1) / (m + 1)) from
+  // its series. Relative error below 1e-15.
+  inline double Log(double x)
+  {
+    vtkTypeUInt64 bits = AsBits(x);
+    // e + 1023, rounding the exponent up from sqrt(2)
+    vtkTypeUInt64 biased = (bits + 0x00095f619980c433ULL) >> 52;
+    double m = AsDouble(bits - (biased << 52) + 0x3ff0000000000000ULL);
+    double e = AsDouble(biased | 0x4330000000000000ULL) - TwoPow52 - 1023.0;
+
+    double u = (m - 1.0) / (m + 1.0);
+    double u2 = u * u;
+    double p = 1.0 / 17.0;
+    p = p * u2 + 1.0 / 15.0;
+    p = p * u2 + 1.0 / 13.0;
+    p = p * u2 + 1.0 / 11.0;
+    p = p * u2 + 1.0 / 9.0;
+    p = p * u2 + 1.0 / 7.0;
+    p = p * u2 + 1.0 / 5.0;
+    p = p * u2 + 1.0 / 3.0;
+    p = p * u2 + 1.0;
+    return e * Ln2Hi + (e * Ln2Lo + 2.0 * u * p);
+  }
+
+  //--------------------------------------------------------------------------
+  // Exponential of x, |x| < 700. x = k ln(2) + r with |r| <= ln(2) / 2,
+  // exp(r) from its series, and 2^k built from its bits. Relative error
+  // below 1e-15.
+  inline double Exp(double x)
+  {
+    double k = x * InvLn2 + RoundMagic;
+    vtkTypeUInt64 bits = AsBits(k);
+    k -= RoundMagic;
+    double r = (x - k * Ln2Hi) - k * Ln2Lo;
+
+    double p = 1.0 / 479001600.0;
+    p = p * r + 1.0 / 39916800.0;
+    p = p * r + 1.0 / 3628800.0;
+    p = p * r + 1.0 / 362880.0;
+    p = p * r + 1.0 / 40320.0;
+    p = p * r + 1.0 / 5040.0;
+    p = p * r + 1.0 / 720.0;
+    p = p * r + 1.0 / 120.0;
+    p = p * r + 1.0 / 24.0;
+    p = p * r + 1.0 / 6.0;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+    // The low bits of k + RoundMagic hold k
+    return p * AsDouble((bits + 1023) << 52);
+  }
+
+  //--------------------------------------------------------------------------
+  // Arc tangent of t, |t| <= 1. Above tan(pi/8), uses
+  // atan(t) = pi/4 + atan((t - 1) / (t + 1)). Least-squares polynomial,
+  // absolute error below 1e-13.
+  inline double Atan(double t)
+  {
+    double a = std::fabs(t);
+    // Computed unconditionally, and used in the comparison, so the
+    // compiler does not turn the selection into a branch
+    double reduced = (a - 1.0) / (a + 1.0);
+    bool shifted = -reduced < a;
+    double u = shifted ? reduced : a;
+    double v = u * u;
+    double p = 0.030701067969085345;
+    p = p * v - 0.05877164125558317;
+    p = p * v + 0.07564447129413558;
+    p = p * v - 0.09078500416951324;
+    p = p * v + 0.11110393796392316;
+    p = p * v - 0.14285690807876944;
+    p = p * v + 0.1999999961317681;
+    p = p * v - 0.3333333333087159;
+    p = p * v + 0.9999999999999745;
+    double result = u * p + (shifted ? 0.25 * Pi : 0.0);
+    return std::copysign(result, t);
+  }
+
+  //--------------------------------------------------------------------------
+  // y = log(tan(pi/4 + phi/2)) = log((cos h + sin h) / (cos h - sin h)),
+  // h = phi/2 in [-pi/4, pi/4], with sin and cos from their series
+  inline double Lat2Y(double lat)
+  {
+    double h = lat * (Pi / 360.0);
+    double h2 = h * h;
+    double s = -1.0 / 355687428096000.0;
+    s = s * h2 + 1.0 / 1307674368000.0;
+    s = s * h2 - 1.0 / 6227020800.0;
+    s = s * h2 + 1.0 / 39916800.0;
+    s = s * h2 - 1.0 / 362880.0;
+    s = s * h2 + 1.0 / 5040.0;
+    s = s * h2 - 1.0 / 120.0;
+    s = s * h2 + 1.0 / 6.0;
+    s = h - h * h2 * s;
+    double c = 1.0 / 6402373705728000.0;
+    c = c * h2 - 1.0 / 20922789888000.0;
+    c = c * h2 + 1.0 / 87178291200.0;
+    c = c * h2 - 1.0 / 479001600.0;
+    c = c * h2 + 1.0 / 3628800.0;
+    c = c * h2 - 1.0 / 40320.0;
+    c = c * h2 + 1.0 / 720.0;
+    c = c * h2 - 1.0 / 24.0;
+    c = c * h2 + 0.5;
+    c = 1.0 - h2 * c;
+    return (180.0 / Pi) * Log((c + s) / (c - s));
+  }
+
+  //--------------------------------------------------------------------------
+  // lat = 2 atan(exp(x)) - pi/2 = 2 atan(tanh(x/2)),
+  // tanh(x/2) = (exp(x) - 1) / (exp(x) + 1)
+  inline double Y2Lat(double y)
+  {
+    double e = Exp(y * (Pi / 180.0));
+    return (360.0 / Pi) * Atan((e - 1.0) / (e + 1.0));
+  }
+
+  //--------------------------------------------------------------------------
+  void Lat2YDouble(const double *lat, double *y, vtkIdType n)
+  {
+    for (vtkIdType i = 0; i < n; ++i)
+      {
+      y[i] = Lat2Y(lat[i]);
+      }
+  }
+
+  //--------------------------------------------------------------------------
+  void Y2LatDouble(const double *y, double *lat, vtkIdType n)
+  {
+    for (vtkIdType i = 0; i < n; ++i)
+      {
+      lat[i] = Y2Lat(y[i]);
+      }
+  }
+
+  //--------------------------------------------------------------------------
+  // Convert float values through a block of doubles
+  void ConvertFloats(const float *input, float *output, vtkIdType n,
+                     void (*kernel)(const double*, double*, vtkIdType))
+  {
+    double block[BlockSize];
+    for (vtkIdType start = 0; start < n; start += BlockSize)
+      {
+      vtkIdType count = std::min(BlockSize, n - start);
+      std::copy(input + start, input + start + count, block);
+      kernel(block, block, count);
+      for (vtkIdType i = 0; i < count; ++i)
+        {
+        output[start + i] = static_cast<float>(block[i]);
+        }
+      }
+  }
+
+  //--------------------------------------------------------------------------
+  // Convert one component of the values, gathering it into blocks
+  template <typename T>
+  void ConvertComponent(T *values, vtkIdType numTuples, int numComponents,
+                        void (*kernel)(const double*, double*, vtkIdType))
+  {
+    double block[BlockSize];
+    for (vtkIdType start = 0; start < numTuples; start += BlockSize)
+      {
+      vtkIdType count = std::min(BlockSize, numTuples - start);
+      T *tuple = values + start * numComponents;
+      for (vtkIdType i = 0; i < count; ++i)
+        {
+        block[i] = tuple[i * numComponents];
+        }
+      kernel(block, block, count);
+      for (vtkIdType i = 0; i < count; ++i)
+        {
+        tuple[i * numComponents] = static_cast<T>(block[i]);
+        }
+      }
+  }
+
+  //--------------------------------------------------------------------------
+  void ConvertArray(vtkDataArray *array, int component,
+                    void (*kernel)(const double*, double*, vtkIdType))
+  {
+    int numComponents = array->GetNumberOfComponents();
+    if (component < 0 || component >= numComponents)
+      {
+      return;
+      }
+    vtkIdType numTuples = array->GetNumberOfTuples();
+
+    if (vtkDoubleArray *doubles = vtkDoubleArray::SafeDownCast(array))
+      {
+      ConvertComponent(doubles->GetPointer(0) + component, numTuples,
+                       numComponents, kernel);
+      }
+    else if (vtkFloatArray *floats = vtkFloatArray::SafeDownCast(array))
+      {
+      ConvertComponent(floats->GetPointer(0) + component, numTuples,
+                       numComponents, kernel);
+      }
+    else
+      {
+      double block[BlockSize];
+      for (vtkIdType start = 0; start < numTuples; start += BlockSize)
+        {
+        vtkIdType count = std::min(BlockSize, numTuples - start);
+        for (vtkIdType i = 0; i < count; ++i)
+          {
+          block[i] = array->GetComponent(start + i, component);
+          }
+        kernel(block, block, count);
+        for (vtkIdType i = 0; i < count; ++i)
+          {
+          array->SetComponent(start + i, component, block[i]);
+          }
+        }
+      }
+    array->Modified();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkMercator::lat2y(const double *lat, double *y, vtkIdType n)
+{
+  Lat2YDouble(lat, y, n);
+}
+
+//----------------------------------------------------------------------------
+void vtkMercator::lat2y(const float *lat, float *y, vtkIdType n)
+{
+  ConvertFloats(lat, y, n, Lat2YDouble);
+}
+
+//----------------------------------------------------------------------------
+void vtkMercator::y2lat(const double *y, double *lat, vtkIdType n)
+{
+  Y2LatDouble(y, lat, n);
+}
+
+//----------------------------------------------------------------------------
+void vtkMercator::y2lat(const float *y, float *lat, vtkIdType n)
+{
+  ConvertFloats(y, lat, n, Y2LatDouble);
+}
+
+//----------------------------------------------------------------------------
+void vtkMercator::lat2y(vtkDataArray *array, int component)
+{
+  ConvertArray(array, component, Lat2YDouble);
+}
+
+//----------------------------------------------------------------------------
+void vtkMercator::y2lat(vtkDataArray *array, int component)
+{
+  ConvertArray(array, component, Y2LatDouble);
+}
+
+//----------------------------------------------------------------------------
+void vtkMercator::long2tilex(const double *lon, int *x, vtkIdType n, int z)
+{
+  double scale = std::ldexp(1.0, z) / 360.0;
+  for (vtkIdType i = 0; i < n; ++i)
+    {
+    x[i] = static_cast<int>(std::floor((lon[i] + 180.0) * scale));
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMercator::lat2tiley(const double *lat, int *y, vtkIdType n, int z)
+{
+  // lat2tiley() is (1 - lat2y() / 180) / 2 tiles at zoom level 0
+  double scale = std::ldexp(1.0, z) / 360.0;
+  double block[BlockSize];
+  for (vtkIdType start = 0; start < n; start += BlockSize)
+    {
+    vtkIdType count = std::min(BlockSize, n - start);
+    Lat2YDouble(lat + start, block, count);
+    for (vtkIdType i = 0; i < count; ++i)
+      {
+      y[start + i] = static_cast<int>(std::floor((180.0 - block[i]) * scale));
+      }
+    }
+}
@@ -16,12 +16,15 @@
 #ifndef __vtkMercator_h
 #define __vtkMercator_h
 
+#include "vtkmap_export.h"
 #include <vtkObject.h>
 #include <cmath>
 
+class vtkDataArray;
+
 #define WEB_MERCATOR_EXTENT 20037508.34
 
-class vtkMercator : vtkObject
+class VTKMAP_EXPORT vtkMercator : vtkObject
 {
 //by default visual studio doesn't provide the M_PI define as it is a
 //non standard function, but with the around defines it does. It is far to
@@ -45,26 +48,26 @@ public:
   //----------------------------------------------------------------------------
   static int long2tilex(double lon, int z)
   {
-    return (int)(floor((lon + 180.0) / 360.0 * std::pow(2.0, z)));
+    return (int)(floor((lon + 180.0) / 360.0 * std::ldexp(1.0, z)));
   }
 
   //----------------------------------------------------------------------------
   static int lat2tiley(double lat, int z)
   {
     return (int)(floor((1.0 - log( tan(lat * m_pi()/180.0) + 1.0 /
-      cos(lat * m_pi()/180.0)) / m_pi()) / 2.0 * std::pow(2.0, z)));
+      cos(lat * m_pi()/180.0)) / m_pi()) / 2.0 * std::ldexp(1.0, z)));
   }
 
   //----------------------------------------------------------------------------
   static double tilex2long(int x, int z)
   {
-    return x / std::pow(2.0, z) * 360.0 - 180;
+    return x / std::ldexp(1.0, z) * 360.0 - 180;
   }
 
   //----------------------------------------------------------------------------
   static double tiley2lat(int y, int z)
   {
-    double n = m_pi() - 2.0 * m_pi() * y / std::pow(2.0, z);
+    double n = m_pi() - 2.0 * m_pi() * y / std::ldexp(1.0, z);
     return 180.0 / m_pi() * atan(0.5 * (exp(n) - exp(-n)));
   }
 
@@ -115,6 +118,30 @@ public:
     return lon;
   }
 
+  //----------------------------------------------------------------------------
+  // Array versions of lat2y() and y2lat(), converting n values from
+  // input to output (which may be the same array). They use polynomial
+  // kernels instead of the math library, written for the compiler to
+  // vectorize. The absolute error is below 1e-10 degrees for latitudes
+  // within +/-89.9 degrees and for y within +/-180, i.e. well below the
+  // size of a pixel at zoom level 20. Float arrays are converted in
+  // double precision.
+  static void lat2y(const double *lat, double *y, vtkIdType n);
+  static void lat2y(const float *lat, float *y, vtkIdType n);
+  static void y2lat(const double *y, double *lat, vtkIdType n);
+  static void y2lat(const float *y, float *lat, vtkIdType n);
+
+  //----------------------------------------------------------------------------
+  // Convert one component of all tuples of the array in place, e.g.
+  // component 1 of <longitude, latitude, z> points with lat2y().
+  static void lat2y(vtkDataArray *array, int component);
+  static void y2lat(vtkDataArray *array, int component);
+
+  //----------------------------------------------------------------------------
+  // Array versions of long2tilex() and lat2tiley() at zoom level z
+  static void long2tilex(const double *lon, int *x, vtkIdType n, int z);
+  static void lat2tiley(const double *lat, int *y, vtkIdType n, int z);
+
   //----------------------------------------------------------------------------
   // Convert coodinate from web-mercator (EPSG:3857) to VTK map coordinates
   static double web2vtk(double webMercatorCoord)
@@ -15,72 +15,111 @@
 
 #include "vtkMultiThreadedOsmLayer.h"
 #include "vtkMapTile.h"
+#include "vtkMapTileConcurrencyController.h"
+#include "vtkMapTileDiskCache.h"
+#include "vtkMapTileFailureCache.h"
+#include "vtkMapTileMetrics.h"
+#include "vtkMapTileRevalidator.h"
+#include "vtkMapTileService.h"
+#include "vtkMercator.h"
+#include "vtkTileSource.h"
 
 #include <vtkAtomic.h>
 #include <vtkCallbackCommand.h>
-#include <vtkConditionVariable.h>
-#include <vtkMultiThreader.h>
+#include <vtkCamera.h>
+#include <vtkImageData.h>
 #include <vtkMutexLock.h>
 #include <vtkObjectFactory.h>
 #include <vtkRenderWindow.h>
 #include <vtkRenderWindowInteractor.h>
-#include <vtksys/SystemTools.hxx>
+#include <vtkTimerLog.h>
 
-#include <curl/curl.h>
-#include <cstdio>  // for remove()
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <set>
 #include <sstream>
-#include <stack>
-
-// Limit the number of concurrent http requests
-#define NUMBER_OF_REQUEST_THREADS 6
+#include <utility>
 
 vtkStandardNewMacro(vtkMultiThreadedOsmLayer)
 
-//----------------------------------------------------------------------------
-class vtkMultiThreadedOsmLayer::vtkMultiThreadedOsmLayerInternals
+namespace
 {
-public:
-  vtkMultiThreader *BackgroundThreader;  // for BackgroundThreadExecute()
-  vtkMultiThreader *RequestThreader;  // for RequestThreadExecute()
-  int BackgroundThreadId;
-  bool DownloadMode;  // sets RequestThreader behavior
-
-  vtkAtomic<vtkTypeInt32> ThreadingEnabled;
-  vtkConditionVariable *ThreadingCondition;
-
-  std::stack<TileSpecList> ScheduledTiles;
-  vtkAtomic<vtkTypeInt32> ScheduledStackSize;
-  vtkMutexLock *ScheduledTilesLock;
+// Tile spec waiting for a request thread
+struct TileRequest
+{
+  vtkMapTileSpecInternal Spec;
+  double Distance2;  // from the view center
+  bool CacheChecked;  // not in the image cache, so to be downloaded
+};
 
-  TileSpecList NewTiles;
-  vtkMutexLock *NewTilesLock;
+// Heap order of the request queue: tiles in view before prefetched
+// ones, then cache lookups before downloads, then nearest first
+struct lowerRequestPriority
+{
+  inline bool operator() (const TileRequest& request1,
+                          const TileRequest& request2) const
+  {
+    if (request1.Spec.Prefetch != request2.Spec.Prefetch)
+      {
+      return request1.Spec.Prefetch;
+      }
+    if (request1.CacheChecked != request2.CacheChecked)
+      {
+      return request1.CacheChecked;
+      }
+    return request1.Distance2 > request2.Distance2;
+  }
+};
 
-  // Allocate tile-spec list for each request thread
-  TileSpecList ThreadTileSpecs[NUMBER_OF_REQUEST_THREADS];
+// Same order for indices into the request queue
+struct lowerRequestIndexPriority
+{
+  lowerRequestIndexPriority(const std::vector<TileRequest>& requests)
+    : Requests(requests) {}
+  inline bool operator() (size_t index1, size_t index2) const
+  {
+    return lowerRequestPriority()(this->Requests[index1],
+                                  this->Requests[index2]);
+  }
+  const std::vector<TileRequest>& Requests;
 };
 
-//----------------------------------------------------------------------------
-static VTK_THREAD_RETURN_TYPE StaticBackgroundThreadExecute(void *arg)
+// Request being processed by a request thread. The generation is that
+// of the latest view wanting the tile, so the request is dropped after
+// the cache lookup unless the tile is still in view.
+struct ActiveRequest
 {
-  vtkMultiThreadedOsmLayer *self;
-  vtkMultiThreader::ThreadInfo *info =
-    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
-  self = static_cast<vtkMultiThreadedOsmLayer*>(info->UserData);
-  self->BackgroundThreadExecute();
-  return VTK_THREAD_RETURN_VALUE;
+  int Generation;
+  bool Prefetch;
+};
 }
 
 //----------------------------------------------------------------------------
-static VTK_THREAD_RETURN_TYPE StaticRequestThreadExecute(void *arg)
+class vtkMultiThreadedOsmLayer::vtkMultiThreadedOsmLayerInternals
 {
-  vtkMultiThreadedOsmLayer *self;
-  vtkMultiThreader::ThreadInfo *info =
-    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
-  self = static_cast<vtkMultiThreadedOsmLayer*>(info->UserData);
-  int threadId = info->ThreadID;
-  self->RequestThreadExecute(threadId);
-  return VTK_THREAD_RETURN_VALUE;
-}
+public:
+  // Requests for the latest view, as a heap ordered by
+  // lowerRequestPriority, and the requests being processed.
+  // All guarded by ScheduledTilesLock, including the prefetch budget.
+  std::vector<TileRequest> ScheduledTiles;
+  vtkMapTileIndexInternal<ActiveRequest> ActiveRequests;
+  int ViewGeneration;
+  vtkMutexLock *ScheduledTilesLock;
+  vtkAtomic<vtkTypeInt64> CancelledRequests;
+
+  TileSpecList NewTiles;
+  vtkMutexLock *NewTilesLock;
+
+  // New tiles not yet added to the cache (ResolveAsync() only)
+  TileSpecList ReadyTiles;
+
+  // Bandwidth cap, and budget in bytes
+  vtkAtomic<vtkTypeInt64> PrefetchMaxBandwidth;
+  vtkAtomic<vtkTypeInt64> PrefetchedBytes;
+  double PrefetchBudget;
+  double PrefetchBudgetTime;
+};
 
 //----------------------------------------------------------------------------
 vtkMultiThreadedOsmLayer::vtkMultiThreadedOsmLayer()
@@ -88,39 +127,44 @@ vtkMultiThreadedOsmLayer::vtkMultiThreadedOsmLayer()
   this->AsyncMode = true;
   this->Internals = new vtkMultiThreadedOsmLayerInternals;
 
-  this->Internals->BackgroundThreader = vtkMultiThreader::New();
-  this->Internals->ThreadingEnabled = 1;
-  this->Internals->ThreadingCondition = vtkConditionVariable::New();
-  this->Internals->ScheduledStackSize = 0;
+  this->Internals->ViewGeneration = 0;
   this->Internals->ScheduledTilesLock = vtkMutexLock::New();
+  this->Internals->CancelledRequests = 0;
   this->Internals->NewTilesLock = vtkMutexLock::New();
 
-  this->Internals->RequestThreader = vtkMultiThreader::New();
-  this->Internals->RequestThreader->SetNumberOfThreads(
-    NUMBER_OF_REQUEST_THREADS);
-  this->Internals->RequestThreader->SetSingleMethod(
-    StaticRequestThreadExecute, this);
+  // Concurrent http requests are limited by the concurrency controller,
+  // up to the number of requests processed at once
+  this->NumberOfThreads = 16;
+  this->DecodeTilesInBackground = true;
+  this->MaxResolveTime = 0.008;
+  this->MaxTilesPerResolve = 0;
+  this->Prefetch = true;
+  this->PrefetchLookahead = 1.0;
+  this->PrefetchMaxTiles = 16;
+  this->NumberOfPrefetchedTiles = 0;
+  this->NumberOfPrefetchHits = 0;
+  this->Internals->PrefetchMaxBandwidth = 256 * 1024;
+  this->Internals->PrefetchedBytes = 0;
+  this->Internals->PrefetchBudget = 0.0;
+  this->Internals->PrefetchBudgetTime = 0.0;
 
-  // Start the background thread
-  this->Internals->BackgroundThreadId =
-    this->Internals->BackgroundThreader->SpawnThread(
-      StaticBackgroundThreadExecute, this);
+  this->StartRequestThreads();
 }
 
 //----------------------------------------------------------------------------
 vtkMultiThreadedOsmLayer::~vtkMultiThreadedOsmLayer()
 {
-  this->Internals->ThreadingEnabled = 0;
-  this->Internals->ThreadingCondition->Broadcast();
-
-  this->Internals->BackgroundThreader->TerminateThread(
-    this->Internals->BackgroundThreadId);
-  vtkDebugMacro("Terminate Thread " << this->Internals->BackgroundThreadId);
+  this->StopRequestThreads();
 
-  this->Internals->BackgroundThreader->Delete();
-  this->Internals->RequestThreader->Delete();
+  // Tiles received but never added to the cache
+  TileSpecList& readyTiles = this->Internals->ReadyTiles;
+  readyTiles.insert(readyTiles.end(), this->Internals->NewTiles.begin(),
+                    this->Internals->NewTiles.end());
+  for (std::size_t i = 0; i < readyTiles.size(); ++i)
+    {
+    readyTiles[i].Tile->Delete();
+    }
 
-  this->Internals->ThreadingCondition->Delete();
   this->Internals->ScheduledTilesLock->Delete();
   this->Internals->NewTilesLock->Delete();
 
@@ -132,10 +176,27 @@ void vtkMultiThreadedOsmLayer::PrintSelf(ostream &os, vtkIndent indent)
 {
   Superclass::PrintSelf(os, indent);
   os << "vtkMultiThreadedOsmLayer"
-     << "\n" << indent << "BackgroundThreadId: "
-     << this->Internals->BackgroundThreadId
-     << "\n" << indent << "NumberOfRequestThreads: "
-     << this->Internals->RequestThreader->GetNumberOfThreads()
+     << "\n" << indent << "NumberOfThreads: " << this->NumberOfThreads
+     << "\n" << indent << "Concurrency: " << this->GetConcurrency()
+     << "\n" << indent << "NumberOfActiveDownloads: "
+     << this->GetNumberOfActiveDownloads()
+     << "\n" << indent << "NumberOfCancelledRequests: "
+     << this->GetNumberOfCancelledRequests()
+     << "\n" << indent << "DecodeTilesInBackground: "
+     << this->DecodeTilesInBackground
+     << "\n" << indent << "MaxResolveTime: " << this->MaxResolveTime
+     << "\n" << indent << "MaxTilesPerResolve: " << this->MaxTilesPerResolve
+     << "\n" << indent << "Prefetch: " << this->Prefetch
+     << "\n" << indent << "PrefetchLookahead: " << this->PrefetchLookahead
+     << "\n" << indent << "PrefetchMaxTiles: " << this->PrefetchMaxTiles
+     << "\n" << indent << "PrefetchMaxBandwidth: "
+     << this->GetPrefetchMaxBandwidth()
+     << "\n" << indent << "NumberOfPrefetchedTiles: "
+     << this->NumberOfPrefetchedTiles
+     << "\n" << indent << "NumberOfPrefetchHits: "
+     << this->NumberOfPrefetchHits
+     << "\n" << indent << "NumberOfPrefetchedBytes: "
+     << this->GetNumberOfPrefetchedBytes()
      << std::endl;
 }
 
@@ -146,175 +207,556 @@ void vtkMultiThreadedOsmLayer::Update()
 }
 
 //----------------------------------------------------------------------------
-void vtkMultiThreadedOsmLayer::BackgroundThreadExecute()
+void vtkMultiThreadedOsmLayer::
+SetPrefetchMaxBandwidth(vtkTypeInt64 bytesPerSecond)
 {
-  vtkDebugMacro("Enter BackgroundThreadExecute()");
-  TileSpecList tileSpecs;
-  TileSpecList newTiles;
-  int workingStackSize;  // snapshot of stack size
-  while (this->Internals->ThreadingEnabled)
+  if (bytesPerSecond < 0)
     {
-    // Check if there are scheduled tiles
-    this->Internals->ScheduledTilesLock->Lock();
-    workingStackSize = this->Internals->ScheduledTiles.size();
-    if (workingStackSize > 0)
-      {
-      tileSpecs = this->Internals->ScheduledTiles.top();
-      this->Internals->ScheduledTiles.pop();
-      workingStackSize--;
-      }
-    this->Internals->ScheduledStackSize = workingStackSize;
-    this->Internals->ScheduledTilesLock->Unlock();
+    bytesPerSecond = 0;
+    }
+  if (this->Internals->PrefetchMaxBandwidth != bytesPerSecond)
+    {
+    this->Internals->PrefetchMaxBandwidth = bytesPerSecond;
+    this->Modified();
+    }
+}
 
-    // Process tileSpecs (if any) using 2-pass algorithm
-    // The 1st pass initializes those tiles that have an
-    // image file available in the image cache
-    // (from a previous application/session).
-    // The 2nd pass performs http requests for the files
-    // that aren't already in the image cache.
-    if (!tileSpecs.empty())
-      {
-      // Pass 1 initializes new tiles that have image file in cache
-      this->AssignTileSpecsToThreads(tileSpecs);
-      this->Internals->DownloadMode = false;
-      this->Internals->RequestThreader->SingleMethodExecute();
-      newTiles.clear();
-      tileSpecs.clear();
-      this->CollateThreadResults(newTiles, tileSpecs);
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMultiThreadedOsmLayer::GetPrefetchMaxBandwidth()
+{
+  return this->Internals->PrefetchMaxBandwidth;
+}
 
-      // std::cout << "After pass 1: "
-      //           << "newTiles.size() " << newTiles.size()
-      //           << ", tileSpecs.size() " << tileSpecs.size()
-      //           << std::endl;
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMultiThreadedOsmLayer::GetNumberOfPrefetchedBytes()
+{
+  return this->Internals->PrefetchedBytes;
+}
 
-      // Copy new tiles to shared list
-      this->UpdateNewTiles(newTiles);
+//----------------------------------------------------------------------------
+double vtkMultiThreadedOsmLayer::GetPrefetchHitRate()
+{
+  if (this->NumberOfPrefetchedTiles == 0)
+    {
+    return 0.0;
+    }
+  return static_cast<double>(this->NumberOfPrefetchHits) /
+    static_cast<double>(this->NumberOfPrefetchedTiles);
+}
+
+//----------------------------------------------------------------------------
+void vtkMultiThreadedOsmLayer::ResetPrefetchStatistics()
+{
+  this->NumberOfPrefetchedTiles = 0;
+  this->NumberOfPrefetchHits = 0;
+  this->Internals->PrefetchedBytes = 0;
+}
 
-      // Check if there are newer tiles in the scheduled stack
-      if (this->Internals->ScheduledStackSize > workingStackSize)
+//----------------------------------------------------------------------------
+void vtkMultiThreadedOsmLayer::SetNumberOfThreads(int count)
+{
+  count = std::max(1, std::min(count, 32));
+  if (count == this->NumberOfThreads)
+    {
+    return;
+    }
+
+  // Requests in progress beyond the new number are left to finish
+  this->Internals->ScheduledTilesLock->Lock();
+  this->NumberOfThreads = count;
+  this->Internals->ScheduledTilesLock->Unlock();
+  this->TileService->WakeRequestThreads();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkMultiThreadedOsmLayer::GetNumberOfScheduledTiles()
+{
+  vtkMultiThreadedOsmLayerInternals *internals = this->Internals;
+  int count = 0;
+  internals->ScheduledTilesLock->Lock();
+  std::vector<TileRequest>::iterator requestIter =
+    internals->ScheduledTiles.begin();
+  for (; requestIter != internals->ScheduledTiles.end(); requestIter++)
+    {
+    count += requestIter->Spec.Prefetch ? 0 : 1;
+    }
+  std::vector<vtkTypeUInt64> keys;
+  internals->ActiveRequests.GetKeys(keys);
+  for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+    ActiveRequest *active = internals->ActiveRequests.Find(keys[i]);
+    count += active->Prefetch ? 0 : 1;
+    }
+  internals->ScheduledTilesLock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+int vtkMultiThreadedOsmLayer::GetConcurrency()
+{
+  std::vector<std::string> hosts;
+  this->GetTileSource()->GetHosts(hosts);
+  int count = 0;
+  for (std::size_t i = 0; i < hosts.size(); ++i)
+    {
+    count += this->ConcurrencyController->GetConcurrency(hosts[i]);
+    }
+  return count;
+}
+
+//----------------------------------------------------------------------------
+int vtkMultiThreadedOsmLayer::GetNumberOfActiveDownloads()
+{
+  std::vector<std::string> hosts;
+  this->GetTileSource()->GetHosts(hosts);
+  int count = 0;
+  for (std::size_t i = 0; i < hosts.size(); ++i)
+    {
+    count += this->ConcurrencyController->GetNumberOfActiveRequests(
+      hosts[i]);
+    }
+  return count;
+}
+
+//----------------------------------------------------------------------------
+void vtkMultiThreadedOsmLayer::GetMetricsSnapshot(
+  vtkMapTileMetricsSnapshot& snapshot)
+{
+  this->Superclass::GetMetricsSnapshot(snapshot);
+  snapshot.NumberOfScheduledTiles = this->GetNumberOfScheduledTiles();
+  snapshot.NumberOfPendingTiles = this->GetNumberOfPendingTiles();
+  snapshot.NumberOfActiveDownloads = this->GetNumberOfActiveDownloads();
+}
+
+//----------------------------------------------------------------------------
+void vtkMultiThreadedOsmLayer::SetTileSource(vtkTileSource *source)
+{
+  if (source == this->TileSource)
+    {
+    return;
+    }
+
+  // The request threads must not use the previous source any more
+  this->StopRequestThreads();
+  this->Superclass::SetTileSource(source);
+  this->StartRequestThreads();
+}
+
+//----------------------------------------------------------------------------
+void vtkMultiThreadedOsmLayer::SetTileService(vtkMapTileService *service)
+{
+  if (service && service == this->TileService)
+    {
+    return;
+    }
+
+  // Queued requests are kept for the threads of the new service
+  this->StopRequestThreads();
+  this->Superclass::SetTileService(service);
+  this->StartRequestThreads();
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMultiThreadedOsmLayer::GetNumberOfCancelledRequests()
+{
+  return this->Internals->CancelledRequests;
+}
+
+//----------------------------------------------------------------------------
+void vtkMultiThreadedOsmLayer::StartRequestThreads()
+{
+  this->TileService->AddLayer(this);
+}
+
+//----------------------------------------------------------------------------
+void vtkMultiThreadedOsmLayer::StopRequestThreads()
+{
+  // Waits for the requests in progress
+  this->TileService->RemoveLayer(this);
+}
+
+//----------------------------------------------------------------------------
+// Takes the most urgent request that can run from the queue, looks the
+// tile up in the image cache, or downloads it if the lookup was done
+// before. Requests are visited in priority order, so a host at its
+// concurrency limit, or prefetching out of bandwidth, only delays its
+// own requests.
+int vtkMultiThreadedOsmLayer::ProcessNextRequest()
+{
+  vtkMultiThreadedOsmLayerInternals *internals = this->Internals;
+  std::vector<TileRequest>& requests = internals->ScheduledTiles;
+  internals->ScheduledTilesLock->Lock();
+  if (requests.empty() ||
+      static_cast<int>(internals->ActiveRequests.Size()) >=
+        this->NumberOfThreads)
+    {
+    internals->ScheduledTilesLock->Unlock();
+    return vtkMapTileService::NoRequestReady;
+    }
+
+  // Walk the heap best first: the children of a visited request are the
+  // next candidates
+  lowerRequestPriority lower;
+  lowerRequestIndexPriority lowerIndex(requests);
+  std::vector<size_t> candidates(1, 0);
+  std::set<std::string> fullHosts;
+  bool isLocal = this->GetTileSource()->IsLocal();
+  bool delayed = false;
+  size_t index = requests.size();
+  std::string host;
+  bool limited = false;
+  while (!candidates.empty())
+    {
+    std::pop_heap(candidates.begin(), candidates.end(), lowerIndex);
+    size_t candidate = candidates.back();
+    candidates.pop_back();
+    const TileRequest& next = requests[candidate];
+
+    // Prefetch downloads come last and wait for bandwidth, so none of
+    // the remaining requests can run
+    if (next.Spec.Prefetch && next.CacheChecked &&
+        !this->HasPrefetchBandwidth())
+      {
+      delayed = true;
+      break;
+      }
+
+    // Downloads wait for the concurrency controller to allow them, and
+    // are tried again when another download ends
+    limited = next.CacheChecked && !isLocal;
+    if (limited)
+      {
+      host = vtkMapTileConcurrencyController::GetHost(this->GetTileUrl(
+        next.Spec.ZoomRowCol[0], next.Spec.ZoomRowCol[1],
+        next.Spec.ZoomRowCol[2]));
+      if (fullHosts.count(host) ||
+          !this->ConcurrencyController->TryBeginRequest(host))
         {
-        // If there are newer tiles, loop back and do them next
+        fullHosts.insert(host);
+        for (size_t child = 2 * candidate + 1;
+             child <= 2 * candidate + 2 && child < requests.size(); ++child)
+          {
+          candidates.push_back(child);
+          std::push_heap(candidates.begin(), candidates.end(), lowerIndex);
+          }
         continue;
         }
+      }
+    index = candidate;
+    break;
+    }
+  if (index == requests.size())
+    {
+    internals->ScheduledTilesLock->Unlock();
+    return delayed ? vtkMapTileService::RequestDelayed :
+      vtkMapTileService::NoRequestReady;
+    }
 
-      // Pass 2 downloads image files and initializes new tiles.
-      // Process one tile per thread so that we can break out
-      // sooner when new tiles are scheduled.
-      while (tileSpecs.size() > 0 &&
-             this->Internals->ScheduledStackSize == workingStackSize)
-        {
-        //std::cout << "Before pass 2: " << tileSpecs.size() << std::endl;
-        this->AssignOneTileSpecPerThread(tileSpecs);
-        //std::cout << "After assign : " << tileSpecs.size() << std::endl;
-        this->Internals->DownloadMode = true;
-        this->Internals->RequestThreader->SingleMethodExecute();
-        newTiles.clear();
-        this->CollateThreadResults(newTiles, tileSpecs);
-        //std::cout << "After collate : " << tileSpecs.size() << std::endl;
-        this->UpdateNewTiles(newTiles);
-        newTiles.clear();
-        }  // while
-      }  // if (tileSpecs not empty)
-
-    // If we broke out of loop early, continue processing
-    if (tileSpecs.size() > 0)
+  TileRequest request = requests[index];
+  if (index == 0)
+    {
+    std::pop_heap(requests.begin(), requests.end(), lower);
+    requests.pop_back();
+    }
+  else
+    {
+    requests[index] = requests.back();
+    requests.pop_back();
+    std::make_heap(requests.begin(), requests.end(), lower);
+    }
+  vtkTypeUInt64 key = vtkMapTileIndexInternal<ActiveRequest>::MakeKey(
+    request.Spec.ZoomXY[0], request.Spec.ZoomXY[1], request.Spec.ZoomXY[2]);
+  ActiveRequest active;
+  active.Generation = internals->ViewGeneration;
+  active.Prefetch = request.Spec.Prefetch;
+  internals->ActiveRequests.Insert(key, active);
+  internals->ScheduledTilesLock->Unlock();
+
+  bool download = request.CacheChecked;
+  vtkTypeInt64 bytes = 0;
+  bool loaded = this->LoadTile(request.Spec, download, bytes);
+
+  // Views scheduled meanwhile may have changed what the tile is for
+  internals->ScheduledTilesLock->Lock();
+  if (limited)
+    {
+    this->ConcurrencyController->EndRequest(host);
+    }
+  active = *internals->ActiveRequests.Find(key);
+  internals->ActiveRequests.Erase(key);
+  request.Spec.Prefetch = active.Prefetch;
+  if (download && request.Spec.Prefetch)
+    {
+    internals->PrefetchBudget -= static_cast<double>(bytes);
+    }
+  if (loaded)
+    {
+    // Delivered before the lock is released, so the tile is always
+    // either scheduled or pending in ResolveAsync()
+    TileSpecList newTiles(1, request.Spec);
+    this->UpdateNewTiles(newTiles);
+    }
+  else if (!download)
+    {
+    if (active.Generation == internals->ViewGeneration)
       {
-      continue;
+      // Not in the image cache, so download it next
+      request.CacheChecked = true;
+      requests.push_back(request);
+      std::push_heap(requests.begin(), requests.end(),
+                     lowerRequestPriority());
       }
-
-    // Check if there are more scheduled tiles to process now
-    this->Internals->ScheduledTilesLock->Lock();
-    if (this->Internals->ScheduledTiles.size() == 0)
+    else
       {
-      // If not, wait for condition variable
-      this->Internals->ThreadingCondition->Wait(
-        this->Internals->ScheduledTilesLock);
+      ++internals->CancelledRequests;
+      this->Metrics->Increment(vtkMapTileMetrics::CancelledRequests);
       }
-    this->Internals->ScheduledTilesLock->Unlock();
-    }  // while
+    }
+  // Failed downloads are retried by view updates after their backoff
+  internals->ScheduledTilesLock->Unlock();
+
+  // The download may have raised the limit of the host
+  if (limited)
+    {
+    this->TileService->WakeRequestThreads();
+    }
+  return vtkMapTileService::RequestProcessed;
 }
 
 //----------------------------------------------------------------------------
-// Checks if image file is in cache, and if so, creates tile
-void vtkMultiThreadedOsmLayer::RequestThreadExecute(int threadId)
+bool vtkMultiThreadedOsmLayer::LoadTile(vtkMapTileSpecInternal& spec,
+                                        bool download, vtkTypeInt64& bytes)
 {
-  //vtkDebugMacro("Enter RequestThreadExecute, thread " << threadId);
   std::stringstream oss;
+  this->MakeFileSystemPath(spec, oss);
+  std::string filename = oss.str();
+  this->MakeUrl(spec, oss);
+  std::string url = oss.str();
+  std::vector<unsigned char> data;
+  bytes = 0;
 
-  // Get reference to tiles assigned to this thread
-  TileSpecList& tileSpecs = this->Internals->ThreadTileSpecs[threadId];
-  if (tileSpecs.empty())
+  // Tiles loaded by other layers are shared, and the same loads in
+  // progress are waited for. Lookups of different cache files are not
+  // the same load. Tiles kept in memory encoded are only decoded again.
+  bool local = this->GetTileSource()->IsLocal();
+  std::string loadKey = download || local ? url : filename;
+  vtkImageData *image = NULL;
+  int load = this->TileService->BeginLoad(url, loadKey, image, &data);
+  if (load == vtkMapTileService::LoadShared)
     {
-    return;
+    this->CreateTile(spec, filename, url)->SetImage(image);
+    image->UnRegister(NULL);
+    this->Metrics->Increment(vtkMapTileMetrics::ImageCacheHits);
+    return true;
     }
-
-  // Process all tile specs
-  std::vector<vtkMapTileSpecInternal>::iterator tileSpecIter =
-    tileSpecs.begin();
-  std::string filename;
-  std::string url;
-  for (; tileSpecIter != tileSpecs.end(); tileSpecIter++)
+  else if (load == vtkMapTileService::LoadFailed)
     {
-    vtkMapTileSpecInternal& spec = *tileSpecIter;
-    this->MakeFileSystemPath(spec, oss);
-    filename = oss.str();
-    url.clear();
+    return false;
+    }
 
-    if (this->Internals->DownloadMode)
+  bool loaded = false;
+  if (load == vtkMapTileService::LoadEncoded)
+    {
+    this->Metrics->Increment(vtkMapTileMetrics::EncodedCacheHits);
+    loaded = true;
+    }
+  else if (local)
+    {
+    // Local tiles are not in the image cache, but read from their
+    // source right away, as cheap as a lookup
+    loaded = !download && this->DownloadTileData(spec, url, data);
+    }
+  else if (this->TileStore)
+    {
+    // Read from packed tile store, downloading into it if download is set
+    loaded = this->LoadTileData(spec, url, download, data);
+    if (loaded && download)
       {
-      // If DownloadMode, perform http request
-      this->MakeUrl(spec, oss);
-      url = oss.str();
-      if (this->DownloadImageFile(url, filename))
-        {
-        this->CreateTile(spec, filename, url);
-        }
+      bytes = static_cast<vtkTypeInt64>(data.size());
       }
-    else
+    }
+  else if (download)
+    {
+    // Perform http request
+    loaded = this->DownloadTileData(spec, url, data);
+    if (loaded)
       {
-      // If *not* DownloadMode, check for image file in cache
-      if (vtksys::SystemTools::FileExists(filename.c_str(), true))
+      bytes = static_cast<vtkTypeInt64>(data.size());
+      }
+    }
+  else
+    {
+    // Check for image file in cache, read here to validate it
+    loaded = this->ReadTileFile(filename, data);
+    this->Metrics->Increment(loaded ? vtkMapTileMetrics::DiskCacheHits :
+                             vtkMapTileMetrics::DiskCacheMisses);
+    if (loaded)
+      {
+      vtkMapTileDiskCache *diskCache = this->GetDiskCache();
+      if (diskCache)
         {
-        this->MakeUrl(spec, oss);
-        url = oss.str();
-        this->CreateTile(spec, filename, url);
+        diskCache->RecordAccess(
+          spec.ZoomRowCol[0], spec.ZoomRowCol[1], spec.ZoomRowCol[2]);
         }
+      this->CheckCachedTile(spec);
       }
-    }  // for
+    }
+  if (loaded)
+    {
+    if (load == vtkMapTileService::LoadTile)
+      {
+      this->TileService->AddEncodedTile(url, data);
+      }
+    this->CreateTile(spec, filename, url)->SetImageBuffer(data);
+    }
+
+  if (spec.Prefetch)
+    {
+    this->Internals->PrefetchedBytes += bytes;
+    }
+
+  // Decode the image here rather than in ResolveAsync(), which then
+  // only creates the texture and actor. Only decoded images are shared.
+  if (spec.Tile && this->DecodeTilesInBackground &&
+      !this->DecodeTile(spec.Tile))
+    {
+    spec.Tile->SetImage(NULL);
+    this->TileService->EndLoad(url, loadKey, NULL, false);
+    this->DropUndecodedTile(spec);
+    return false;
+    }
+  this->TileService->EndLoad(
+    url, loadKey, spec.Tile ? spec.Tile->GetImage() : NULL,
+    spec.Tile != NULL);
+  return spec.Tile != NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkMultiThreadedOsmLayer::DropUndecodedTile(vtkMapTileSpecInternal& spec)
+{
+  spec.Tile->Delete();
+  spec.Tile = NULL;
+  // Not a server failure: the data may come from the caches
+  this->FailureCache->RecordInvalidTile(
+    spec.ZoomRowCol[0], spec.ZoomRowCol[1], spec.ZoomRowCol[2]);
 }
 
+//----------------------------------------------------------------------------
+// Orders tile specs in view before prefetched ones, each by distance
+// from the tile center to the view center
+struct sortSpecsByDistance
+{
+  double Center[2];
+
+  double Distance2(const vtkMapTileSpecInternal& spec) const
+  {
+    double dx = 0.5 * (spec.Corners[0] + spec.Corners[2]) - this->Center[0];
+    double dy = 0.5 * (spec.Corners[1] + spec.Corners[3]) - this->Center[1];
+    return dx * dx + dy * dy;
+  }
+
+  inline bool operator() (const vtkMapTileSpecInternal& spec1,
+                          const vtkMapTileSpecInternal& spec2) const
+  {
+    if (spec1.Prefetch != spec2.Prefetch)
+      {
+      return spec2.Prefetch;
+      }
+    return this->Distance2(spec1) < this->Distance2(spec2);
+  }
+};
+
 //----------------------------------------------------------------------------
 vtkMap::AsyncState vtkMultiThreadedOsmLayer::ResolveAsync()
 {
-  // Check for new tiles
-  TileSpecList newTiles;
+  // Check for new tiles, and queue them with the ones not added yet
+  TileSpecList& readyTiles = this->Internals->ReadyTiles;
   this->Internals->NewTilesLock->Lock();
   if (this->Internals->NewTiles.size() > 0)
     {
-    // Copy to local list and clear Internals list
-    newTiles = this->Internals->NewTiles;
+    readyTiles.insert(readyTiles.end(), this->Internals->NewTiles.begin(),
+                      this->Internals->NewTiles.end());
     this->Internals->NewTiles.clear();
     }
   this->Internals->NewTilesLock->Unlock();
 
-  // Add newTiles to cache
-  TileSpecList::iterator specIter = newTiles.begin();
-  for (; specIter != newTiles.end(); specIter++)
+  // Nearest to the view center first
+  if (readyTiles.size() > 1 && this->Renderer)
+    {
+    double focalPoint[3];
+    this->Renderer->GetActiveCamera()->GetFocalPoint(focalPoint);
+    sortSpecsByDistance sorter;
+    sorter.Center[0] = focalPoint[0];
+    sorter.Center[1] = focalPoint[1];
+    std::stable_sort(readyTiles.begin(), readyTiles.end(), sorter);
+    }
+
+  // Add tiles to cache within the time and count budgets, but at least
+  // one per call. The rest wait for the next calls.
+  double startTime = vtkTimerLog::GetUniversalTime();
+  bool tilesReady = !readyTiles.empty();
+  int numTilesAdded = 0;
+  std::size_t numTilesInView = 0;
+  TileSpecList::iterator specIter = readyTiles.begin();
+  for (; specIter != readyTiles.end(); specIter++)
     {
+    if (numTilesAdded > 0 &&
+        ((this->MaxTilesPerResolve > 0 &&
+          numTilesAdded >= this->MaxTilesPerResolve) ||
+         (this->MaxResolveTime > 0.0 &&
+          vtkTimerLog::GetUniversalTime() - startTime >=
+            this->MaxResolveTime)))
+      {
+      break;
+      }
+
     vtkMapTileSpecInternal spec = *specIter;
     int zoom = spec.ZoomXY[0];
     int x = spec.ZoomXY[1];
     int y = spec.ZoomXY[2];
+    if (this->GetCachedTile(zoom, x, y))
+      {
+      // Same tile was scheduled by more than one view update
+      spec.Tile->Delete();
+      continue;
+      }
     spec.Tile->SetLayer(this);
+    spec.Tile->SetActorPool(this->ActorPool);
+    if (!this->DecodeTile(spec.Tile))  // unless already done
+      {
+      spec.Tile->SetImage(NULL);
+      this->DropUndecodedTile(spec);
+      continue;
+      }
     spec.Tile->Init();
     this->AddTileToCache(zoom, x, y, spec.Tile);
+    ++numTilesAdded;
+    if (spec.Prefetch)
+      {
+      spec.Tile->SetPrefetched(true);
+      ++this->NumberOfPrefetchedTiles;
+      }
+    else
+      {
+      ++numTilesInView;
+      }
     }
+  readyTiles.erase(readyTiles.begin(), specIter);
+  this->EvictTiles();
+  if (tilesReady)
+    {
+    this->Metrics->Record(vtkMapTileMetrics::TilesPerResolve, numTilesAdded);
+    }
+  this->LogMetrics();
 
+  // Prefetched tiles are not in view, so they need no redraw
   vtkMap::AsyncState result = vtkMap::AsyncIdle;  // return value
-  bool tilesTodo = this->Internals->ScheduledStackSize > 0;
-  if (newTiles.size() > 0)
+  // Scheduled tiles first, since they become pending when loaded
+  bool tilesTodo = this->GetNumberOfScheduledTiles() > 0 ||
+    this->GetNumberOfPendingTiles() > 0;
+  if (numTilesInView > 0)
     {
-    //std::cout << "Added new tiles: " << newTiles.size() << std::endl;
     this->Modified();
     if (tilesTodo)
       {
@@ -325,6 +767,11 @@ vtkMap::AsyncState vtkMultiThreadedOsmLayer::ResolveAsync()
       result = vtkMap::AsyncFullUpdate;
       }
     }
+  else if (this->Revalidator && this->Revalidator->HasUpdatedTiles(this))
+    {
+    // Draw the map, which reloads the tiles changed on the server
+    result = vtkMap::AsyncPartialUpdate;
+    }
   else if (tilesTodo)
     {
     result = vtkMap::AsyncPending;
@@ -334,6 +781,16 @@ vtkMap::AsyncState vtkMultiThreadedOsmLayer::ResolveAsync()
 }
 
 
+//----------------------------------------------------------------------------
+int vtkMultiThreadedOsmLayer::GetNumberOfPendingTiles()
+{
+  this->Internals->NewTilesLock->Lock();
+  std::size_t count =
+    this->Internals->NewTiles.size() + this->Internals->ReadyTiles.size();
+  this->Internals->NewTilesLock->Unlock();
+  return static_cast<int>(count);
+}
+
 //----------------------------------------------------------------------------
 void vtkMultiThreadedOsmLayer::AddTiles()
 {
@@ -345,75 +802,124 @@ void vtkMultiThreadedOsmLayer::AddTiles()
   std::vector<vtkMapTile*> tiles;
   std::vector<vtkMapTileSpecInternal> tileSpecs;
 
+  // New view: tiles touched from here on are the ones in view
+  ++this->TileAccessCounter;
+
   if (this->Map->GetPerspectiveProjection())
     this->SelectTilesPerspective(tiles, tileSpecs);
   else
     this->SelectTiles(tiles, tileSpecs);
-  if (tileSpecs.size() > 0)
+  this->Metrics->Increment(vtkMapTileMetrics::LayerCacheHits,
+                           static_cast<vtkTypeInt64>(tiles.size()));
+  this->Metrics->Increment(vtkMapTileMetrics::LayerCacheMisses,
+                           static_cast<vtkTypeInt64>(tileSpecs.size()));
+  this->NumberOfMissingTiles = static_cast<int>(tileSpecs.size());
+
+  // Count prefetched tiles coming into view
+  std::vector<vtkMapTile*>::iterator tileIter = tiles.begin();
+  for (; tileIter != tiles.end(); tileIter++)
     {
-    // Add newTileSpecs to scheduled tiles stack
-    //std::cout << "Scheduling tiles " << newTileSpecs.size() << std::endl;
-    this->Internals->ScheduledTilesLock->Lock();
-    this->Internals->ScheduledTiles.push(tileSpecs);
-    this->Internals->ScheduledStackSize =
-      this->Internals->ScheduledTiles.size();
-    this->Internals->ThreadingCondition->Broadcast();
-    this->Internals->ScheduledTilesLock->Unlock();
+    if ((*tileIter)->GetPrefetched())
+      {
+      (*tileIter)->SetPrefetched(false);
+      ++this->NumberOfPrefetchHits;
+      }
     }
-  else
+
+  TileSpecList prefetchSpecs;
+  if (this->Prefetch && this->PrefetchMaxTiles > 0)
     {
-    this->RenderTiles(tiles);
+    this->SelectPrefetchTiles(prefetchSpecs);
     }
-}
+  tileSpecs.insert(tileSpecs.end(), prefetchSpecs.begin(),
+                   prefetchSpecs.end());
 
-//----------------------------------------------------------------------------
-// Note: This method is very similar to vtkMapTile::DownloadImage()
-bool vtkMultiThreadedOsmLayer::
-DownloadImageFile(std::string url, std::string filename)
-{
-  //std::cout << "Downloading " << filename << std::endl;
-  CURL* curl;
-  FILE* fp;
-  CURLcode res;
-  char errorBuffer[CURL_ERROR_SIZE];  // for debug
-  long httpStatus = 0;  // for debug
-  curl = curl_easy_init();
-  if (!curl)
+  double focalPoint[3];
+  this->Renderer->GetActiveCamera()->GetFocalPoint(focalPoint);
+  sortSpecsByDistance sorter;
+  sorter.Center[0] = focalPoint[0];
+  sorter.Center[1] = focalPoint[1];
+
+  // Replace the queued requests with the ones for this view. Requests
+  // for tiles no longer wanted are cancelled, and cache lookups already
+  // done are not repeated.
+  vtkMultiThreadedOsmLayerInternals *internals = this->Internals;
+  std::vector<TileRequest>& requests = internals->ScheduledTiles;
+  internals->ScheduledTilesLock->Lock();
+  int generation = ++internals->ViewGeneration;
+  vtkMapTileIndexInternal<bool> previousRequests;
+  std::vector<TileRequest>::iterator requestIter = requests.begin();
+  for (; requestIter != requests.end(); requestIter++)
     {
-    vtkErrorMacro(<< "curl_easy_init() failed" );
-    return false;
+    previousRequests.Insert(vtkMapTileIndexInternal<bool>::MakeKey(
+      requestIter->Spec.ZoomXY[0], requestIter->Spec.ZoomXY[1],
+      requestIter->Spec.ZoomXY[2]), requestIter->CacheChecked);
     }
+  std::size_t numPrevious = requests.size();
+  std::size_t numKept = 0;
+  requests.clear();
 
-  fp = fopen(filename.c_str(), "wb");
-  if(!fp)
+  vtkMapTileIndexInternal<bool> scheduledKeys;
+  TileRequest request;
+  TileSpecList::iterator specIter = tileSpecs.begin();
+  for (; specIter != tileSpecs.end(); specIter++)
     {
-    vtkErrorMacro( << "Cannot open file " << filename.c_str());
-    return false;
-    }
+    vtkTypeUInt64 key = vtkMapTileIndexInternal<bool>::MakeKey(
+      specIter->ZoomXY[0], specIter->ZoomXY[1], specIter->ZoomXY[2]);
+    if (scheduledKeys.Find(key))
+      {
+      continue;
+      }
+    scheduledKeys.Insert(key, true);
 
-  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errorBuffer);
-  // prevent random crashes due to thread-unsafe signals (see https://stackoverflow.com/a/22957000)
-  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
-  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
-  res = curl_easy_perform(curl);
+    // Failed tiles are not requested again until their retry time
+    if (this->FailureCache->IsBackingOff(specIter->ZoomRowCol[0],
+                                         specIter->ZoomRowCol[1],
+                                         specIter->ZoomRowCol[2]))
+      {
+      continue;
+      }
 
-  curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &httpStatus);
-  vtkDebugMacro("Download " << url.c_str() << " status: " << httpStatus);
-  curl_easy_cleanup(curl);
-  fclose(fp);
+    // Tiles being loaded are still wanted, once
+    ActiveRequest *active = internals->ActiveRequests.Find(key);
+    if (active)
+      {
+      active->Generation = generation;
+      active->Prefetch = active->Prefetch && specIter->Prefetch;
+      continue;
+      }
 
-  // If there was an error, remove invalid image file
-  if (res != CURLE_OK)
+    bool *cacheChecked = previousRequests.Find(key);
+    request.Spec = *specIter;
+    request.Distance2 = sorter.Distance2(*specIter);
+    request.CacheChecked = cacheChecked && *cacheChecked;
+    numKept += cacheChecked ? 1 : 0;
+    requests.push_back(request);
+    }
+  std::make_heap(requests.begin(), requests.end(), lowerRequestPriority());
+  internals->CancelledRequests +=
+    static_cast<vtkTypeInt64>(numPrevious - numKept);
+  this->Metrics->Increment(vtkMapTileMetrics::CancelledRequests,
+                           static_cast<vtkTypeInt64>(numPrevious - numKept));
+  this->Metrics->Record(vtkMapTileMetrics::QueueDepth,
+                        static_cast<double>(requests.size()));
+  bool queued = !requests.empty();
+  internals->ScheduledTilesLock->Unlock();
+  if (queued)
     {
-    //std::cerr << "Removing invalid file: " << filename << std::endl;
-    remove(filename.c_str());
-    vtkErrorMacro(<< errorBuffer);
-    return false;
+    this->TileService->WakeRequestThreads();
     }
 
-  return true;
+  if (tileSpecs.size() > prefetchSpecs.size())
+    {
+    // Until ResolveAsync() delivers them, draw cached
+    // tiles of other zoom levels in their place
+    tileSpecs.resize(tileSpecs.size() - prefetchSpecs.size());
+    this->SelectFallbackTiles(tiles, tileSpecs);
+    }
+  this->RenderTiles(tiles);
+  this->PruneFallbackTiles(false);
+  this->EvictTiles();
 }
 
 //----------------------------------------------------------------------------
@@ -435,84 +941,287 @@ vtkMapTile *vtkMultiThreadedOsmLayer::CreateTile(
 }
 
 //----------------------------------------------------------------------------
-void vtkMultiThreadedOsmLayer::
-AssignTileSpecsToThreads(TileSpecList& tileSpecs)
+void vtkMultiThreadedOsmLayer::UpdateNewTiles(TileSpecList& newTiles)
 {
-  // Clear current thread tile spec lists
-  int numThreads = this->Internals->RequestThreader->GetNumberOfThreads();
-  for (int i=0; i<numThreads; i++)
+  if (newTiles.empty())
     {
-    this->Internals->ThreadTileSpecs[i].clear();
+    return;
     }
 
-  // Distribute inputs across threads
-  int index;
-  for (int i=0; i<tileSpecs.size(); i++)
-    {
-    index = i % numThreads;
-    this->Internals->ThreadTileSpecs[index].push_back(tileSpecs[i]);
-    }
+  this->Internals->NewTilesLock->Lock();
+  this->Internals->NewTiles.insert(this->Internals->NewTiles.begin(),
+                                   newTiles.begin(), newTiles.end());
+  this->Internals->NewTilesLock->Unlock();
 }
 
+
 //----------------------------------------------------------------------------
-void vtkMultiThreadedOsmLayer::
-AssignOneTileSpecPerThread(TileSpecList& tileSpecs)
+namespace
 {
-  // Move tileSpecs from end of tileSpecs to thread
-  int numThreads = this->Internals->RequestThreader->GetNumberOfThreads();
-  for (int i=0; i<numThreads; i++)
-    {
-    this->Internals->ThreadTileSpecs[i].clear();
-    if (tileSpecs.size() > 0)
+// Inclusive range of OSM tile indices at one zoom level
+struct TileRange
+{
+  int Zoom;
+  int Col[2];
+  int Row[2];  // top row first, since OSM rows grow southward
+
+  // Set to the tiles covering world bounds (xmin, ymin, xmax, ymax)
+  void SetBounds(int zoom, const double bounds[4])
+  {
+    int maxIndex = (1 << zoom) - 1;
+    this->Zoom = zoom;
+    this->Col[0] = vtkMercator::long2tilex(bounds[0], zoom);
+    this->Col[1] = vtkMercator::long2tilex(bounds[2], zoom);
+    this->Row[0] = vtkMercator::lat2tiley(vtkMercator::y2lat(bounds[3]), zoom);
+    this->Row[1] = vtkMercator::lat2tiley(vtkMercator::y2lat(bounds[1]), zoom);
+    for (int i = 0; i < 2; ++i)
       {
-      // vtkMapTileSpecInternal spec = tileSpecs.back();
-      // std::stringstream oss;
-      // oss << "Assign "
-      //     << spec.ZoomRowCol[0] << spec.ZoomRowCol[1] << spec.ZoomRowCol[2]
-      //     << std::endl;
-      // std::cout << oss.str();
+      this->Col[i] = std::max(0, std::min(maxIndex, this->Col[i]));
+      this->Row[i] = std::max(0, std::min(maxIndex, this->Row[i]));
+      }
+  }
 
-      this->Internals->ThreadTileSpecs[i].push_back(tileSpecs.back());
-      tileSpecs.pop_back();
+  bool Contains(int col, int row) const
+  {
+    return col >= this->Col[0] && col <= this->Col[1] &&
+      row >= this->Row[0] && row <= this->Row[1];
+  }
+};
+
+// Appends the tiles of range at a distance of d tiles from center
+void AppendRingTiles(const TileRange& center, int d, const TileRange& range,
+                     std::vector<std::pair<int, int> >& tiles)
+{
+  int col0 = center.Col[0] - d;
+  int col1 = center.Col[1] + d;
+  int row0 = center.Row[0] - d;
+  int row1 = center.Row[1] + d;
+  int firstRow = std::max(row0, range.Row[0]);
+  int lastRow = std::min(row1, range.Row[1]);
+  for (int col = std::max(col0, range.Col[0]);
+       col <= std::min(col1, range.Col[1]); ++col)
+    {
+    if (d == 0 || col == col0 || col == col1)
+      {
+      for (int row = firstRow; row <= lastRow; ++row)
+        {
+        tiles.push_back(std::make_pair(col, row));
+        }
+      continue;
+      }
+    if (row0 >= range.Row[0])
+      {
+      tiles.push_back(std::make_pair(col, row0));
+      }
+    if (row1 <= range.Row[1])
+      {
+      tiles.push_back(std::make_pair(col, row1));
       }
     }
 }
 
 //----------------------------------------------------------------------------
-// Checks thread results and updates lists
-void vtkMultiThreadedOsmLayer::
-CollateThreadResults(TileSpecList& newTiles, TileSpecList& tileSpecs)
+void MakePrefetchSpec(int zoom, int col, int row, vtkMapTileSpecInternal& spec)
+{
+  int zoomLevelFactor = 1 << zoom;
+  double tileSize = 360.0 / zoomLevelFactor;
+  int xIndex = col;
+  int yIndex = zoomLevelFactor - 1 - row;
+
+  spec.Corners[0] = -180.0 + xIndex * tileSize;
+  spec.Corners[1] = -180.0 + yIndex * tileSize;
+  spec.Corners[2] = -180.0 + (xIndex + 1) * tileSize;
+  spec.Corners[3] = -180.0 + (yIndex + 1) * tileSize;
+  spec.ZoomRowCol[0] = zoom;
+  spec.ZoomRowCol[1] = col;
+  spec.ZoomRowCol[2] = row;
+  spec.ZoomXY[0] = zoom;
+  spec.ZoomXY[1] = xIndex;
+  spec.ZoomXY[2] = yIndex;
+  spec.Prefetch = true;
+}
+
+// Cache lookups per prefetched tile, bounding the work of a view update
+// over cached areas
+const int PrefetchLookupsPerTile = 4;
+}
+
+//----------------------------------------------------------------------------
+// Visits the candidate tiles nearest first, ring by ring, until enough
+// uncached ones are found
+void vtkMultiThreadedOsmLayer::SelectPrefetchTiles(TileSpecList& specs)
 {
-  int numThreads = this->Internals->RequestThreader->GetNumberOfThreads();
-  for (int i=0; i<numThreads; i++)
+  // Perspective views select tiles of varying zoom levels, which the
+  // viewport rectangle below does not match
+  if (this->Map->GetPerspectiveProjection())
+    {
+    return;
+    }
+
+  // World bounds of the viewport on the map plane
+  int width, height, llx, lly;
+  this->Renderer->GetTiledSizeAndOrigin(&width, &height, &llx, &lly);
+  if (width <= 0 || height <= 0)
+    {
+    return;
+    }
+  double displayCoords[2] = { static_cast<double>(llx),
+                              static_cast<double>(lly) };
+  double latLngCoords[3];
+  double bounds[4];
+  this->Map->ComputeLatLngCoords(displayCoords, 0.0, latLngCoords);
+  bounds[0] = latLngCoords[1];
+  bounds[1] = vtkMercator::lat2y(latLngCoords[0]);
+  displayCoords[0] += width;
+  displayCoords[1] += height;
+  this->Map->ComputeLatLngCoords(displayCoords, 0.0, latLngCoords);
+  bounds[2] = latLngCoords[1];
+  bounds[3] = vtkMercator::lat2y(latLngCoords[0]);
+  double extent[2] = { bounds[2] - bounds[0], bounds[3] - bounds[1] };
+
+  int zoom = this->Map->GetZoom();
+  TileRange visible;
+  visible.SetBounds(zoom, bounds);
+
+  std::size_t maxTiles = static_cast<std::size_t>(this->PrefetchMaxTiles);
+  int lookups = PrefetchLookupsPerTile * this->PrefetchMaxTiles;
+  std::vector<std::pair<int, int> > ring;
+  vtkMapTileSpecInternal spec;
+
+  // Tiles ahead of the camera motion. Motion slower than 5% of the
+  // viewport over the lookahead time is ignored.
+  double *velocity = this->Map->GetCameraVelocity();
+  double shift[2];
+  int direction[2];
+  for (int i = 0; i < 2; ++i)
+    {
+    shift[i] = velocity[i] * this->PrefetchLookahead;
+    direction[i] = 0;
+    if (std::fabs(shift[i]) > 0.05 * std::fabs(extent[i]))
+      {
+      direction[i] = shift[i] > 0.0 ? 1 : -1;
+      }
+    }
+  if (direction[0] != 0 || direction[1] != 0)
     {
-    TileSpecList::iterator specIter =
-      this->Internals->ThreadTileSpecs[i].begin();
-    for (; specIter != this->Internals->ThreadTileSpecs[i].end(); specIter++)
+    double aheadBounds[4] =
+      {
+      bounds[0] + (direction[0] ? shift[0] : 0.0),
+      bounds[1] + (direction[1] ? shift[1] : 0.0),
+      bounds[2] + (direction[0] ? shift[0] : 0.0),
+      bounds[3] + (direction[1] ? shift[1] : 0.0)
+      };
+    TileRange ahead;
+    ahead.SetBounds(zoom, aheadBounds);
+
+    // Reach at least one tile past the viewport, and cover the gap
+    // between the viewport and the extrapolated viewport
+    int maxIndex = (1 << zoom) - 1;
+    if (direction[0] > 0)
+      {
+      ahead.Col[0] = visible.Col[0];
+      ahead.Col[1] = std::min(maxIndex, std::max(ahead.Col[1],
+                                                 visible.Col[1] + 1));
+      }
+    else if (direction[0] < 0)
+      {
+      ahead.Col[0] = std::max(0, std::min(ahead.Col[0], visible.Col[0] - 1));
+      ahead.Col[1] = visible.Col[1];
+      }
+    // World y points north, OSM rows south
+    if (direction[1] > 0)
+      {
+      ahead.Row[0] = std::max(0, std::min(ahead.Row[0], visible.Row[0] - 1));
+      ahead.Row[1] = visible.Row[1];
+      }
+    else if (direction[1] < 0)
+      {
+      ahead.Row[0] = visible.Row[0];
+      ahead.Row[1] = std::min(maxIndex, std::max(ahead.Row[1],
+                                                 visible.Row[1] + 1));
+      }
+
+    int maxDistance = std::max(
+      std::max(visible.Col[0] - ahead.Col[0], ahead.Col[1] - visible.Col[1]),
+      std::max(visible.Row[0] - ahead.Row[0], ahead.Row[1] - visible.Row[1]));
+    for (int d = 1; d <= maxDistance && specs.size() < maxTiles &&
+           lookups > 0; ++d)
       {
-      vtkMapTileSpecInternal& spec = *specIter;
-      if (spec.Tile)
+      ring.clear();
+      AppendRingTiles(visible, d, ahead, ring);
+      for (std::size_t i = 0; i < ring.size() && specs.size() < maxTiles &&
+             lookups > 0; ++i, --lookups)
         {
-        newTiles.push_back(spec);
+        MakePrefetchSpec(zoom, ring[i].first, ring[i].second, spec);
+        if (!this->GetCachedTile(zoom, spec.ZoomXY[1], spec.ZoomXY[2]))
+          {
+          specs.push_back(spec);
+          }
         }
-      else
+      }
+    }
+
+  // Tiles of the next zoom level in the zoom direction (zooming in when
+  // there is none), covering the view that zoom would show
+  int zoomDirection = this->Map->GetZoomDirection() < 0 ? -1 : 1;
+  int nextZoom = zoom + zoomDirection;
+  if (nextZoom >= 0 && nextZoom <= MaxZoom)
+    {
+    double focalPoint[3];
+    this->Renderer->GetActiveCamera()->GetFocalPoint(focalPoint);
+    double scale = zoomDirection > 0 ? 0.25 : 1.0;
+    double nextBounds[4] =
+      {
+      focalPoint[0] - scale * extent[0],
+      focalPoint[1] - scale * extent[1],
+      focalPoint[0] + scale * extent[0],
+      focalPoint[1] + scale * extent[1]
+      };
+    TileRange next;
+    next.SetBounds(nextZoom, nextBounds);
+    TileRange focal;
+    focal.Zoom = nextZoom;
+    focal.Col[0] = focal.Col[1] = vtkMercator::long2tilex(focalPoint[0],
+                                                          nextZoom);
+    focal.Row[0] = focal.Row[1] = vtkMercator::lat2tiley(
+      vtkMercator::y2lat(focalPoint[1]), nextZoom);
+
+    int maxDistance = std::max(
+      std::max(focal.Col[0] - next.Col[0], next.Col[1] - focal.Col[0]),
+      std::max(focal.Row[0] - next.Row[0], next.Row[1] - focal.Row[0]));
+    for (int d = 0; d <= maxDistance && specs.size() < maxTiles &&
+           lookups > 0; ++d)
+      {
+      ring.clear();
+      AppendRingTiles(focal, d, next, ring);
+      for (std::size_t i = 0; i < ring.size() && specs.size() < maxTiles &&
+             lookups > 0; ++i, --lookups)
         {
-        tileSpecs.push_back(spec);
+        MakePrefetchSpec(nextZoom, ring[i].first, ring[i].second, spec);
+        if (!this->GetCachedTile(nextZoom, spec.ZoomXY[1], spec.ZoomXY[2]))
+          {
+          specs.push_back(spec);
+          }
         }
       }
     }
 }
 
 //----------------------------------------------------------------------------
-void vtkMultiThreadedOsmLayer::UpdateNewTiles(TileSpecList& newTiles)
+bool vtkMultiThreadedOsmLayer::HasPrefetchBandwidth()
 {
-  if (newTiles.empty())
+  double rate =
+    static_cast<double>(this->Internals->PrefetchMaxBandwidth);
+  if (rate <= 0.0)
     {
-    return;
+    return true;
     }
 
-  this->Internals->NewTilesLock->Lock();
-  this->Internals->NewTiles.insert(this->Internals->NewTiles.begin(),
-                                   newTiles.begin(), newTiles.end());
-  this->Internals->NewTilesLock->Unlock();
+  // Token bucket, allowing bursts of up to one second of bandwidth
+  double now = vtkTimerLog::GetUniversalTime();
+  double elapsed = now - this->Internals->PrefetchBudgetTime;
+  this->Internals->PrefetchBudget =
+    std::min(rate, this->Internals->PrefetchBudget + rate * elapsed);
+  this->Internals->PrefetchBudgetTime = now;
+  return this->Internals->PrefetchBudget > 0.0;
 }
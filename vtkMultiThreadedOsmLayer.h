@@ -16,15 +16,40 @@
 // .SECTION Description
 // A multithreaded subclass of vtkOsmLayer.
 // It performs concurrent map-tile requests in background threads,
-// in order to circumvent I/O blocking. On initialization, the class
-// starts a single background thread that supervises the overall logic
-// for both: (i) requesting files from the map tile server and
-// (ii) constructing new vtkMapTile instances. This supervisory thread
-// in turn executes a set of additional threads concurrently to perform
-// file I/O and http I/O actions. Because map tiles are generated
-// asynchronously, the class overrides the vtkLayer::ResolveAsync()
-// method; if new tiles have been created by the background threads,
-// they are added to the layer's map-tile cache in ResolveAsync().
+// in order to circumvent I/O blocking. The request threads of the
+// layer's vtkMapTileService, shared with the other layers, take tile
+// specs from the layer's request queue, look them up in the image
+// cache, download the missing ones and construct new vtkMapTile
+// instances. Each thread takes the next request as soon as it is done
+// with the previous one, so a slow download does not hold up the
+// others. Tiles loaded by other layers, or being loaded, are shared
+// rather than loaded again. The queue only holds requests
+// for the latest view: requests for tiles that left the view are
+// cancelled, and the others are served nearest to the view center
+// first, with cache lookups ahead of downloads. Because map tiles
+// are generated asynchronously, the class overrides the
+// vtkLayer::ResolveAsync() method; if new tiles have been created by
+// the request threads, they are added to the layer's map-tile cache in
+// ResolveAsync(), nearest to the view center first. To bound the time
+// each polling tick adds to the frame, ResolveAsync() stops after a
+// time or tile count budget, and adds the remaining tiles in the next
+// calls.
+//
+// While no tiles in view are queued, the request threads also
+// prefetch tiles likely to come into view next, based on the camera
+// motion hints of vtkMap: tiles just outside the viewport in the
+// direction of motion, and tiles of the next zoom level around the
+// focal point. Prefetching is capped in number of tiles per view update
+// and in download bandwidth. Perspective views are not prefetched.
+//
+// The request threads also decode the tile images, so that adding a
+// batch of new tiles in ResolveAsync() only creates their textures and
+// actors on the rendering thread.
+//
+// The number of downloads in progress adapts to the tile server: it
+// grows while the server keeps up, and shrinks when the server slows
+// down, fails, or asks for fewer requests, between the floor and
+// ceiling of the layer's vtkMapTileConcurrencyController.
 
 #ifndef __vtkMultiThreadedOsmLayer_h
 #define __vtkMultiThreadedOsmLayer_h
@@ -49,18 +74,123 @@ public:
   virtual void Update();
 
   // Description:
-  // Threaded method for managing tile requests, to prevent blocking.
-  void BackgroundThreadExecute();
+  // Process the next queued tile request, if one can start: look the
+  // tile up in the image cache, or download it if the lookup was done.
+  // Called by the request threads of the tile service. Returns a
+  // vtkMapTileService::RequestResult.
+  int ProcessNextRequest();
 
   // Description:
-  // Threaded method for concurrent tile requests.
-  void RequestThreadExecute(int threadId);
+  // Get/Set the most requests of the layer processed at once by the
+  // request threads, and so its most concurrent http requests. How many
+  // of them download at once is chosen by the concurrency controller.
+  // The number of threads is that of the tile service, see
+  // vtkMapTileService::SetNumberOfThreads(). Default is 16.
+  void SetNumberOfThreads(int count);
+  vtkGetMacro(NumberOfThreads, int);
+
+  // Description:
+  // Number of concurrent downloads from the tile source currently
+  // allowed by the concurrency controller, and number in progress,
+  // summed over the hosts of the source. Both are 0 for local sources.
+  int GetConcurrency();
+  int GetNumberOfActiveDownloads();
+
+  // Description:
+  // Override vtkOsmLayer::SetTileSource(), waiting for the requests in
+  // progress first
+  virtual void SetTileSource(vtkTileSource *source);
+
+  // Description:
+  // Override vtkOsmLayer::SetTileService(), moving the request queue to
+  // the request threads of the new service
+  virtual void SetTileService(vtkMapTileService *service);
+
+  // Description:
+  // Number of tiles in view that are queued or being loaded
+  int GetNumberOfScheduledTiles();
+
+  // Description:
+  // Number of queued requests cancelled because their tiles left the
+  // view before being loaded, including prefetch requests
+  vtkTypeInt64 GetNumberOfCancelledRequests();
+
+  // Description:
+  // Override vtkOsmLayer::GetMetricsSnapshot(), adding the state of the
+  // request queue
+  virtual void GetMetricsSnapshot(vtkMapTileMetricsSnapshot& snapshot);
 
   // Description:
   // Override vtkLayer::ResolveAsync()
-  // Update tile cache with any new tiles
+  // Update tile cache with new tiles, nearest to the view center first,
+  // within the MaxResolveTime and MaxTilesPerResolve budgets. Returns
+  // vtkMap::AsyncPartialUpdate while new tiles remain to be added.
   virtual vtkMap::AsyncState ResolveAsync();
 
+  // Description:
+  // Get/Set the time, in seconds, that ResolveAsync() may spend adding
+  // new tiles to the cache per call, bounding the stall of the frame
+  // that follows. At least one tile is added per call. 0 means no limit.
+  // Default is 0.008 seconds.
+  vtkGetMacro(MaxResolveTime, double);
+  vtkSetClampMacro(MaxResolveTime, double, 0.0, VTK_DOUBLE_MAX);
+
+  // Description:
+  // Get/Set the maximum number of new tiles that ResolveAsync() adds to
+  // the cache per call. 0 means no limit. Default is 0.
+  vtkGetMacro(MaxTilesPerResolve, int);
+  vtkSetClampMacro(MaxTilesPerResolve, int, 0, VTK_INT_MAX);
+
+  // Description:
+  // Number of tiles loaded by the request threads and not yet added to
+  // the cache by ResolveAsync()
+  int GetNumberOfPendingTiles();
+
+  // Description:
+  // Get/Set whether the request threads decode tile images. If off, new
+  // tiles are decoded in ResolveAsync(), on the thread rendering the map.
+  // Default is on.
+  vtkGetMacro(DecodeTilesInBackground, bool);
+  vtkSetMacro(DecodeTilesInBackground, bool);
+  vtkBooleanMacro(DecodeTilesInBackground, bool);
+
+  // Description:
+  // Get/Set whether tiles are prefetched. Only orthographic views are
+  // prefetched. Default is on.
+  vtkGetMacro(Prefetch, bool);
+  vtkSetMacro(Prefetch, bool);
+  vtkBooleanMacro(Prefetch, bool);
+
+  // Description:
+  // Get/Set how far ahead of the camera motion, in seconds, tiles are
+  // prefetched. While the camera moves, at least one row or column of
+  // tiles past the viewport is prefetched. Default is 1 second.
+  vtkGetMacro(PrefetchLookahead, double);
+  vtkSetClampMacro(PrefetchLookahead, double, 0.0, VTK_DOUBLE_MAX);
+
+  // Description:
+  // Get/Set the maximum number of tiles prefetched per view update.
+  // Default is 16.
+  vtkGetMacro(PrefetchMaxTiles, int);
+  vtkSetClampMacro(PrefetchMaxTiles, int, 0, VTK_INT_MAX);
+
+  // Description:
+  // Get/Set the maximum download rate for prefetched tiles, in bytes
+  // per second. 0 means no limit. Default is 256 KB/s.
+  void SetPrefetchMaxBandwidth(vtkTypeInt64 bytesPerSecond);
+  vtkTypeInt64 GetPrefetchMaxBandwidth();
+
+  // Description:
+  // Prefetch statistics: number of tiles loaded by prefetching, how
+  // many of them came into view afterwards (hits), and bytes downloaded
+  // for them. The hit rate is hits per prefetched tile, and can be used
+  // to tune PrefetchLookahead and PrefetchMaxTiles.
+  vtkGetMacro(NumberOfPrefetchedTiles, vtkTypeInt64);
+  vtkGetMacro(NumberOfPrefetchHits, vtkTypeInt64);
+  vtkTypeInt64 GetNumberOfPrefetchedBytes();
+  double GetPrefetchHitRate();
+  void ResetPrefetchStatistics();
+
 protected:
   vtkMultiThreadedOsmLayer();
   ~vtkMultiThreadedOsmLayer();
@@ -69,10 +199,6 @@ protected:
   // Update needed tiles to draw current map display
   virtual void AddTiles();
 
-  // Description:
-  // Download image file, returns boolean indicating success
-  bool DownloadImageFile(std::string url, std::string filename);
-
   // Description:
   // Instantiate and initialize vtkMapTile
   vtkMapTile *CreateTile(
@@ -81,24 +207,46 @@ protected:
     const std::string& remoteUrl);
 
   // Description:
-  // Assign tile specs evenly across request threads
-  void AssignTileSpecsToThreads(TileSpecList& specs);
+  // Start and stop serving the request queue by the request threads of
+  // the tile service. Stopping waits for the requests in progress.
+  void StartRequestThreads();
+  void StopRequestThreads();
 
   // Description:
-  // Assign 1 tile spec to each thread
-  void AssignOneTileSpecPerThread(TileSpecList& specs);
+  // Load the tile for spec from the image cache, or from the tile
+  // server if download is true. Sets spec.Tile and returns true on
+  // success, and sets bytes to the number of bytes downloaded.
+  bool LoadTile(vtkMapTileSpecInternal& spec, bool download,
+                vtkTypeInt64& bytes);
 
   // Description:
-  // Separate tile specs from threads into two lists,
-  // depending on whether they have initialized tile or not.
-  // Does not clear lists, but appends data to them.
-  void CollateThreadResults(TileSpecList& newTiles,
-                            TileSpecList& tileSpecs);
+  // Delete spec.Tile, whose image could not be decoded, and record the
+  // failure, so that the tile is retried after a backoff
+  void DropUndecodedTile(vtkMapTileSpecInternal& spec);
 
   // Description:
   // Copies new tiles to shared list.
   void UpdateNewTiles(TileSpecList& newTiles);
 
+  // Description:
+  // Select tiles to prefetch for the current view, most likely first
+  void SelectPrefetchTiles(TileSpecList& specs);
+
+  // Description:
+  // Whether the prefetch bandwidth budget allows another download.
+  // Must be called with the request queue locked.
+  bool HasPrefetchBandwidth();
+
+  int NumberOfThreads;
+  bool DecodeTilesInBackground;
+  double MaxResolveTime;
+  int MaxTilesPerResolve;
+  bool Prefetch;
+  double PrefetchLookahead;
+  int PrefetchMaxTiles;
+  vtkTypeInt64 NumberOfPrefetchedTiles;
+  vtkTypeInt64 NumberOfPrefetchHits;
+
   class vtkMultiThreadedOsmLayerInternals;
   vtkMultiThreadedOsmLayerInternals *Internals;
 private:
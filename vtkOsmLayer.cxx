@@ -14,26 +14,61 @@
 
 #include "vtkOsmLayer.h"
 
+#include "vtkHttpTileSource.h"
 #include "vtkMercator.h"
 #include "vtkMapTile.h"
+#include "vtkMapTileAtlas.h"
+#include "vtkMapTileCacheInfo.h"
+#include "vtkMapTileConcurrencyController.h"
+#include "vtkMapTileDiskCache.h"
+#include "vtkMapTileFailureCache.h"
+#include "vtkMapTileFetcher.h"
+#include "vtkMapTileMetrics.h"
+#include "vtkMapTileRevalidator.h"
+#include "vtkMapTileService.h"
+#include "vtkMapTileStorage.h"
+#include "vtkPackedTileStore.h"
+#include "vtkTileSource.h"
 
 #include <vtkObjectFactory.h>
 #include <vtksys/SystemTools.hxx>
 #include <vtkTextActor.h>
 #include <vtkTextProperty.h>
 
+#include <vtkActor.h>
 #include <vtkCamera.h>
+#include <vtkImageData.h>
+#include <vtkMath.h>
 #include <vtkPerspectiveTransform.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkRenderWindow.h>
+#include <vtkTexture.h>
+#include <vtkTimerLog.h>
+
+#include <vtkAtomic.h>
 
 #include <algorithm>
+#include <cstdio>
 #include <cstring>  // strdup
+#include <fstream>
 #include <iomanip>
 #include <iterator>
 #include <math.h>
+#include <queue>
 #include <sstream>
 
+#ifdef _WIN32
+#include <io.h>  // _commit()
+#include <process.h>  // _getpid()
+#include <windows.h>  // MoveFileExA()
+#else
+#include <unistd.h>  // fsync(), getpid()
+#endif
+
 vtkStandardNewMacro(vtkOsmLayer)
 
+const int vtkOsmLayer::MaxZoom = 19;
+
 //----------------------------------------------------------------------------
 struct sortTiles
 {
@@ -52,6 +87,40 @@ vtkOsmLayer::vtkOsmLayer() : vtkFeatureLayer()
   this->MapTileAttribution = strdup("(c) OpenStreetMap contributors");
   this->AttributionActor = NULL;
   this->CacheDirectory = NULL;
+  this->UsePackedTileStore = false;
+  this->Storage = NULL;
+  this->TileStore = NULL;
+  this->TileFetcher = vtkMapTileFetcher::New();
+  this->TileSource = NULL;
+  this->DefaultTileSource = vtkHttpTileSource::New();
+  this->DefaultTileSource->SetTileFetcher(this->TileFetcher);
+  this->DefaultTileSource->SetUrlTemplate(
+    "http://tile.openstreetmap.org/{z}/{x}/{y}.png");
+  this->FailureCache = vtkMapTileFailureCache::New();
+  this->TileService = vtkMapTileService::GetGlobalInstance();
+  this->ConcurrencyController =
+    this->TileService->GetConcurrencyController();
+  this->ConcurrencyController->Register(this);
+  this->RevalidateTiles = true;
+  this->Revalidator = NULL;
+  this->ActorPool = vtkMapTileActorPool::New();
+  this->UseTileAtlas = false;
+  this->TileAtlas = NULL;
+  this->FallbackZoomLevels = 4;
+  this->PlaceholderTexture = NULL;
+  this->PerspectiveTileScreenSize = 256.0;
+  this->MaxPerspectiveTiles = 128;
+  this->MaxDiskCacheSize = 0;
+  this->MaxDiskCacheTiles = 0;
+  this->MaxCacheSize = 256 * 1024 * 1024;
+  this->CacheSize = 0;
+  this->NumberOfEvictedTiles = 0;
+  this->NumberOfMissingTiles = 0;
+  this->Metrics = vtkMapTileMetrics::New();
+  this->MetricsLogInterval = 0.0;
+  this->MetricsLogFileName = NULL;
+  this->MetricsLogTime = 0.0;
+  this->TileAccessCounter = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -62,6 +131,27 @@ vtkOsmLayer::~vtkOsmLayer()
     this->AttributionActor->Delete();
     }
   this->RemoveTiles();
+  this->ReleaseStorage();
+  if (this->TileSource)
+    {
+    this->TileSource->UnRegister(this);
+    }
+  this->DefaultTileSource->Delete();
+  this->TileFetcher->Delete();
+  this->FailureCache->Delete();
+  this->ConcurrencyController->UnRegister(this);
+  this->TileService->UnRegister(this);
+  if (this->PlaceholderTexture)
+    {
+    this->PlaceholderTexture->Delete();
+    }
+  this->ActorPool->Delete();
+  if (this->TileAtlas)
+    {
+    this->TileAtlas->Delete();
+    }
+  this->Metrics->Delete();
+  this->SetMetricsLogFileName(NULL);
   free(this->CacheDirectory);
   free(this->MapTileAttribution);
   free(this->MapTileExtension);
@@ -72,6 +162,35 @@ vtkOsmLayer::~vtkOsmLayer()
 void vtkOsmLayer::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "MaxCacheSize: " << this->MaxCacheSize << "\n"
+     << indent << "CacheSize: " << this->CacheSize << "\n"
+     << indent << "NumberOfCachedTiles: " << this->CachedTiles.size() << "\n"
+     << indent << "NumberOfEvictedTiles: " << this->NumberOfEvictedTiles << "\n"
+     << indent << "NumberOfMissingTiles: " << this->NumberOfMissingTiles << "\n"
+     << indent << "FallbackZoomLevels: " << this->FallbackZoomLevels << "\n"
+     << indent << "PerspectiveTileScreenSize: "
+     << this->PerspectiveTileScreenSize << "\n"
+     << indent << "MaxPerspectiveTiles: " << this->MaxPerspectiveTiles << "\n"
+     << indent << "UsePackedTileStore: " << this->UsePackedTileStore << "\n"
+     << indent << "MaxDiskCacheSize: " << this->MaxDiskCacheSize << "\n"
+     << indent << "MaxDiskCacheTiles: " << this->MaxDiskCacheTiles << "\n"
+     << indent << "DiskCache: " << this->GetDiskCache() << "\n"
+     << indent << "TileFetcher: " << this->TileFetcher << "\n"
+     << indent << "TileSource: " << this->GetTileSource() << "\n"
+     << indent << "FailureCache: " << this->FailureCache << "\n"
+     << indent << "ConcurrencyController: "
+     << this->ConcurrencyController << "\n"
+     << indent << "TileService: " << this->TileService << "\n"
+     << indent << "RevalidateTiles: " << this->RevalidateTiles << "\n"
+     << indent << "Revalidator: " << this->Revalidator << "\n"
+     << indent << "ActorPool: " << this->ActorPool << "\n"
+     << indent << "UseTileAtlas: " << this->UseTileAtlas << "\n"
+     << indent << "MetricsLogInterval: " << this->MetricsLogInterval << "\n"
+     << indent << "MetricsLogFileName: "
+     << (this->MetricsLogFileName ? this->MetricsLogFileName : "(none)")
+     << "\n"
+     << indent << "Metrics:\n";
+  this->Metrics->PrintSelf(os, indent.GetNextIndent());
 }
 
 //----------------------------------------------------------------------------
@@ -106,20 +225,17 @@ SetMapTileServer(const char *server, const char *attribution,
       }
     }
 
-  // Clear tile cached and update internals
-  // Remove tiles from renderer before calling RemoveTiles()
-  std::vector<vtkMapTile*>::iterator iter = this->CachedTiles.begin();
-  for (; iter != this->CachedTiles.end(); iter++)
-    {
-    vtkMapTile *tile = *iter;
-    this->Renderer->RemoveActor(tile->GetActor());
-    }
+  // Clear tile cache (and renderer) and update internals
   this->RemoveTiles();
+  this->FailureCache->Reset();
 
   this->MapTileExtension = strdup(extension);
   this->MapTileServer = strdup(server);
   this->MapTileAttribution = strdup(attribution);
   this->CacheDirectory = strdup(fullPath.c_str());
+  this->DefaultTileSource->SetUrlTemplate(std::string("http://") + server +
+                                          "/{z}/{x}/{y}." + extension);
+  this->UpdateTileStore();
 
   if (this->AttributionActor)
     {
@@ -128,6 +244,64 @@ SetMapTileServer(const char *server, const char *attribution,
     }
 }
 
+//----------------------------------------------------------------------------
+void vtkOsmLayer::SetTileSource(vtkTileSource *source)
+{
+  if (source == this->TileSource)
+    {
+    return;
+    }
+  if (source)
+    {
+    source->Register(this);
+    }
+  if (this->TileSource)
+    {
+    this->TileSource->UnRegister(this);
+    }
+  this->TileSource = source;
+
+  // Clear tile cache (and renderer), and revalidate only remote tiles
+  this->RemoveTiles();
+  this->FailureCache->Reset();
+  this->UpdateTileStore();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkTileSource *vtkOsmLayer::GetTileSource()
+{
+  if (this->TileSource)
+    {
+    return this->TileSource;
+    }
+  return this->DefaultTileSource;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::SetTileService(vtkMapTileService *service)
+{
+  if (!service)
+    {
+    service = vtkMapTileService::GetGlobalInstance();
+    this->SetTileService(service);
+    service->Delete();
+    return;
+    }
+  if (service == this->TileService)
+    {
+    return;
+    }
+
+  service->Register(this);
+  this->TileService->UnRegister(this);
+  this->TileService = service;
+  this->ConcurrencyController->UnRegister(this);
+  this->ConcurrencyController = service->GetConcurrencyController();
+  this->ConcurrencyController->Register(this);
+  this->Modified();
+}
+
 //----------------------------------------------------------------------------
 void vtkOsmLayer::Update()
 {
@@ -158,7 +332,9 @@ void vtkOsmLayer::Update()
     this->Map->GetRenderer()->AddActor2D(this->AttributionActor);
     }
 
+  this->ReleaseUpdatedTiles();
   this->AddTiles();
+  this->LogMetrics();
 
   this->Superclass::Update();
 }
@@ -189,19 +365,154 @@ void vtkOsmLayer::SetCacheSubDirectory(const char *relativePath)
     vtksys::SystemTools::MakeDirectory(fullPath.c_str());
     }
   this->CacheDirectory = strdup(fullPath.c_str());
+  this->UpdateTileStore();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::SetUsePackedTileStore(bool value)
+{
+  if (value == this->UsePackedTileStore)
+    {
+    return;
+    }
+  this->UsePackedTileStore = value;
+  // Recreate the storage of the directory if no other layer uses it
+  this->ReleaseStorage();
+  this->UpdateTileStore();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::SetMaxDiskCacheSize(vtkTypeInt64 size)
+{
+  if (size == this->MaxDiskCacheSize)
+    {
+    return;
+    }
+  this->MaxDiskCacheSize = size;
+  this->UpdateDiskCache();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::SetMaxDiskCacheTiles(int count)
+{
+  if (count == this->MaxDiskCacheTiles)
+    {
+    return;
+    }
+  this->MaxDiskCacheTiles = count;
+  this->UpdateDiskCache();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkOsmLayer::GetDiskCacheSize()
+{
+  return this->Storage ?
+    this->Storage->RequestDiskCache()->GetDiskUsage() : 0;
+}
+
+//----------------------------------------------------------------------------
+int vtkOsmLayer::GetNumberOfDiskCacheTiles()
+{
+  return this->Storage ?
+    this->Storage->RequestDiskCache()->GetNumberOfTiles() : 0;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileDiskCache *vtkOsmLayer::GetDiskCache()
+{
+  return this->Storage ? this->Storage->GetDiskCache() : NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::UpdateDiskCache()
+{
+  // The disk cache is only created for a quota, as it scans the whole
+  // cache directory. Without a quota, it only accounts for the tiles,
+  // and does not journal their accesses. Layers sharing it share the
+  // quota last set.
+  if (!this->Storage)
+    {
+    return;
+    }
+  vtkMapTileDiskCache *diskCache =
+    this->MaxDiskCacheSize > 0 || this->MaxDiskCacheTiles > 0 ?
+    this->Storage->RequestDiskCache() : this->Storage->GetDiskCache();
+  if (diskCache)
+    {
+    diskCache->SetMaxSize(this->MaxDiskCacheSize);
+    diskCache->SetMaxNumberOfTiles(this->MaxDiskCacheTiles);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::UpdateTileStore()
+{
+  // Layers using the same directory share its files, which one set of
+  // objects must manage. The new storage is acquired first, so that
+  // staying in the same directory keeps its disk cache, and the scan
+  // of the directory it made.
+  vtkMapTileStorage *storage = this->CacheDirectory ?
+    vtkMapTileStorage::Acquire(this->CacheDirectory,
+                               this->UsePackedTileStore,
+                               this->MapTileExtension) : NULL;
+  this->ReleaseStorage();
+  this->Storage = storage;
+  if (!storage)
+    {
+    return;
+    }
+
+  this->TileStore = storage->GetTileStore();
+  if (this->MaxDiskCacheSize > 0 || this->MaxDiskCacheTiles > 0)
+    {
+    this->UpdateDiskCache();
+    }
+
+  if (!this->GetTileSource()->IsLocal())
+    {
+    this->Revalidator = this->Storage->AddRevalidatedLayer(this);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::ReleaseStorage()
+{
+  if (this->Storage)
+    {
+    if (this->Revalidator)
+      {
+      // Waits for the tile being revalidated through the layer
+      this->Storage->RemoveRevalidatedLayer(this);
+      }
+    this->Storage->Delete();
+    this->Storage = NULL;
+    }
+  this->TileStore = NULL;
+  this->Revalidator = NULL;
 }
 
 //----------------------------------------------------------------------------
 void vtkOsmLayer::RemoveTiles()
 {
-  this->CachedTilesMap.clear();
+  this->PruneFallbackTiles(true);
+  this->CachedTilesIndex.Clear();
   std::vector<vtkMapTile*>::iterator iter = this->CachedTiles.begin();
   for (; iter != this->CachedTiles.end(); iter++)
     {
+    // The actor goes back to the pool, so must not stay in the renderer
     vtkMapTile *tile = *iter;
+    this->DetachTile(tile);
     tile->Delete();
     }
   this->CachedTiles.clear();
+  this->CacheSize = 0;
+  if (this->TileAtlas && this->Renderer)
+    {
+    this->Renderer->RemoveActor(this->TileAtlas->GetActor());
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -215,15 +526,26 @@ void vtkOsmLayer::AddTiles()
   std::vector<vtkMapTile*> tiles;
   std::vector<vtkMapTileSpecInternal> tileSpecs;
 
+  // New view: tiles touched from here on are the ones in view
+  ++this->TileAccessCounter;
+
   if (this->Map->GetPerspectiveProjection())
     this->SelectTilesPerspective(tiles, tileSpecs);
   else
     this->SelectTiles(tiles, tileSpecs);
+  this->Metrics->Increment(vtkMapTileMetrics::LayerCacheHits,
+                           static_cast<vtkTypeInt64>(tiles.size()));
+  this->Metrics->Increment(vtkMapTileMetrics::LayerCacheMisses,
+                           static_cast<vtkTypeInt64>(tileSpecs.size()));
   if (tileSpecs.size() > 0)
     {
     this->InitializeTiles(tiles, tileSpecs);
+    this->SelectFallbackTiles(tiles, tileSpecs);
     }
+  this->NumberOfMissingTiles = static_cast<int>(tileSpecs.size());
   this->RenderTiles(tiles);
+  this->PruneFallbackTiles(false);
+  this->EvictTiles();
 }
 
 
@@ -347,6 +669,7 @@ SelectTiles(std::vector<vtkMapTile*>& tiles,
         {
         tiles.push_back(tile);
         tile->SetVisible(true);
+        this->TouchTile(tile);
         }
       else
         {
@@ -372,191 +695,188 @@ SelectTiles(std::vector<vtkMapTile*>& tiles,
   }
 }
 
-static void GetViewCoords(double* devCoord, const double* worldCoord, vtkRenderer* renderer)
-{
-  devCoord[0] = worldCoord[0];
-  devCoord[1] = worldCoord[1];
-  devCoord[2] = worldCoord[2];
-  renderer->WorldToView(devCoord[0], devCoord[1], devCoord[2]);
-  
-  return;
-}
-
-static bool IsPointOnScreen(const double* worldCoord, vtkRenderer* renderer)
-{
-  double devCoord[3];
-  GetViewCoords(devCoord, worldCoord, renderer);
-  
-  return (devCoord[0] >= -1.0 && devCoord[0] <= 1.0) &&
-         (devCoord[1] >= -1.0 && devCoord[1] <= 1.0);
-}
-
-// Note: assumes an X-Y plane with constant Z coordinate
-static int IsRectOnScreen(const double* worldCoord1, const double* worldCoord2, vtkRenderer* renderer)
-{
-  int ptsOnScreen;
-  double tempWCoord[3];
-  
-  tempWCoord[2] = worldCoord1[2];
-  // D--C
-  // |  |
-  // A--B
-  ptsOnScreen = 0;
-  if (IsPointOnScreen(worldCoord1, renderer)) // test A
-    ptsOnScreen ++;
-  tempWCoord[0] = worldCoord1[0];
-  tempWCoord[1] = worldCoord2[1];
-  if (IsPointOnScreen(tempWCoord, renderer))  // test B
-    ptsOnScreen ++;
-  if (IsPointOnScreen(worldCoord2, renderer)) // test C
-    ptsOnScreen ++;
-  tempWCoord[0] = worldCoord2[0];
-  tempWCoord[1] = worldCoord1[1];
-  if (IsPointOnScreen(tempWCoord, renderer))  // test D
-    ptsOnScreen ++;
-  
-  if (ptsOnScreen == 0)
-    return 0; // completely off-screen
-  else if (ptsOnScreen == 4)
-    return 1; // completely on screen
-  else
-    return -1;  // partly on screen
-}
-
-static int IsTileOnScreen(const vtkMapTileSpecInternal* tileSpec, vtkRenderer* renderer)
+//----------------------------------------------------------------------------
+namespace
 {
-  double coordSt[3];
-  double coordEnd[3];
-  
-  coordSt[0] = tileSpec->Corners[0];
-  coordSt[1] = tileSpec->Corners[1];
-  coordEnd[0] = tileSpec->Corners[2];
-  coordEnd[1] = tileSpec->Corners[3];
-  coordSt[2] = coordEnd[2] = 0;
-  return IsRectOnScreen(coordSt, coordEnd, renderer);
-}
+  //--------------------------------------------------------------------------
+  // Node of the tile quadtree visited by SelectTilesPerspective(),
+  // y counting from the bottom as in vtkMapTileSpecInternal::ZoomXY
+  struct QuadtreeNode
+  {
+    int Zoom;
+    int X;
+    int Y;
+    double Corners[4];
+    double ScreenSize;  // projected edge length, in pixels
 
-int vtkOsmLayer::
-SelectTilesPerspective_DoTile(std::vector<vtkMapTile*>& tiles,
-                              std::vector<vtkMapTileSpecInternal>& tileSpecs,
-                              int tilex, int tiley, int zoomLevel, vtkRenderer* renderer)
-{
-  int zoomLevelFactor = 1 << zoomLevel; // Zoom levels are interpreted as powers of two.
-  if (tilex < 0 || tilex >= zoomLevelFactor || tiley < 0 || tiley >= zoomLevelFactor)
-    return 0;
-  
-  double degPerTile = 360.0 / zoomLevelFactor;
-  
-  int xIndex = tilex;
-  int yIndex = zoomLevelFactor - 1 - tiley;
-  
-  vtkMapTileSpecInternal tileSpec;
-  
-  tileSpec.Corners[0] = -180.0 + (xIndex + 0) * degPerTile;  // llx
-  tileSpec.Corners[1] = -180.0 + (yIndex + 0) * degPerTile;  // lly
-  tileSpec.Corners[2] = -180.0 + (xIndex + 1) * degPerTile;  // urx
-  tileSpec.Corners[3] = -180.0 + (yIndex + 1) * degPerTile;  // ury
-  
-  tileSpec.ZoomRowCol[0] = zoomLevel;
-  tileSpec.ZoomRowCol[1] = tilex;
-  tileSpec.ZoomRowCol[2] = tiley;
-  
-  tileSpec.ZoomXY[0] = zoomLevel;
-  tileSpec.ZoomXY[1] = xIndex;
-  tileSpec.ZoomXY[2] = yIndex;
-  
-  int retVal = IsTileOnScreen(&tileSpec, renderer);
-  if (retVal == 0)
-    return 0;
-  
-  vtkMapTile* tile = this->GetCachedTile(zoomLevel, xIndex, yIndex);
-  if (tile != nullptr)
+    bool operator<(const QuadtreeNode& other) const
+    {
+      return this->ScreenSize < other.ScreenSize;
+    }
+  };
+
+  //--------------------------------------------------------------------------
+  // Whether the tile is (possibly) inside the first five planes of the
+  // view frustum: left, right, bottom, top and near.
+  bool IsNodeInFrustum(const QuadtreeNode& node, const double planes[24])
   {
-    tiles.push_back(tile);
-    tile->SetVisible(true);
-    return 1;
+    for (int i = 0; i < 5; ++i)
+      {
+      const double *plane = planes + 4 * i;
+      // Corner of the tile furthest along the (inward) plane normal
+      double x = plane[0] > 0.0 ? node.Corners[2] : node.Corners[0];
+      double y = plane[1] > 0.0 ? node.Corners[3] : node.Corners[1];
+      if (plane[0] * x + plane[1] * y + plane[3] < 0.0)
+        {
+        return false;
+        }
+      }
+    return true;
   }
-  else
+
+  //--------------------------------------------------------------------------
+  // Initialize the node's corners, and estimate its size on screen from
+  // its distance to the camera. pixelsPerUnit is the number of pixels
+  // covered by one world unit at unit distance.
+  void InitNode(QuadtreeNode& node, int zoom, int x, int y,
+                const double cameraPosition[3], double pixelsPerUnit)
   {
-    tileSpecs.push_back(tileSpec);
-    return 2;
+    double degPerTile = 360.0 / (1 << zoom);
+    node.Zoom = zoom;
+    node.X = x;
+    node.Y = y;
+    node.Corners[0] = -180.0 + x * degPerTile;        // llx
+    node.Corners[1] = -180.0 + y * degPerTile;        // lly
+    node.Corners[2] = -180.0 + (x + 1) * degPerTile;  // urx
+    node.Corners[3] = -180.0 + (y + 1) * degPerTile;  // ury
+
+    // Nearest point of the tile to the camera
+    double dx = cameraPosition[0] -
+      std::max(node.Corners[0], std::min(cameraPosition[0], node.Corners[2]));
+    double dy = cameraPosition[1] -
+      std::max(node.Corners[1], std::min(cameraPosition[1], node.Corners[3]));
+    double distance =
+      sqrt(dx * dx + dy * dy + cameraPosition[2] * cameraPosition[2]);
+    node.ScreenSize = degPerTile * pixelsPerUnit / std::max(distance, 1.0e-9);
   }
 }
 
+//----------------------------------------------------------------------------
+// Selects tiles of mixed zoom levels by walking the tile quadtree from
+// zoom level 0, culling tiles outside the view frustum and refining
+// tiles larger than PerspectiveTileScreenSize on screen. The largest
+// tiles are refined first, so when MaxPerspectiveTiles is reached, the
+// remaining detail goes where it is most visible.
 void vtkOsmLayer::
 SelectTilesPerspective(std::vector<vtkMapTile*>& tiles,
                        std::vector<vtkMapTileSpecInternal>& tileSpecs)
 {
-  static const int TILE_LIMIT = 8;  // limit in every direction (+x, -x, +y, -y)
-  auto renderCam = this->Renderer->GetActiveCamera();
-  double focalPt[3];    // x, y, z
-  
-  renderCam->GetFocalPoint(focalPt);
-  /* alternate way for getting the screen center point
-  this->Renderer->SetWorldPoint(0.0, 0.0, 0.0, 1.0);
-  this->Renderer->WorldToView();
-  this->Renderer->GetViewPoint(focalPt);
-  
-  this->Renderer->SetViewPoint(0.0, 0.0, focalPt[2]);
-  this->Renderer->ViewToWorld();
-  this->Renderer->GetWorldPoint(focalPt);*/
-  
-  int zoomLevel = this->Map->GetZoom() + 1; // +1 due to perspective projection
-  int zoomLevelFactor = 1 << zoomLevel; // Zoom levels are interpreted as powers of two.
-  
-  int tbasex = vtkMercator::long2tilex(focalPt[0], zoomLevel);
-  int tbasey = vtkMercator::lat2tiley(vtkMercator::y2lat(focalPt[1]), zoomLevel);
-  int tilex, tiley;
-  
-  // tile selection method:
-  //  - start at focal point
-  //  - from there, draw tiles in each direction
-  //  - stop drawing tiles when a tile is completely off-screen OR the maximum number of tiles is reached
-  for (int j = 0; j < TILE_LIMIT; j ++)
-  {
-    tiley = tbasey + j;
-    if (tiley < 0 || tiley >= zoomLevelFactor)
-      continue;
-    for (int i = 0; i < TILE_LIMIT; i ++)
+  int width, height, llx, lly;
+  this->Renderer->GetTiledSizeAndOrigin(&width, &height, &llx, &lly);
+  if (width <= 0 || height <= 0)
     {
-      tilex = tbasex + i;
-      if (SelectTilesPerspective_DoTile(tiles, tileSpecs, tilex, tiley, zoomLevel, this->Renderer) == 0)
-        break;
+    return;
     }
-    for (int i = -1; i >= -TILE_LIMIT; i --)
+
+  vtkCamera *camera = this->Renderer->GetActiveCamera();
+  double planes[24];
+  camera->GetFrustumPlanes(this->Renderer->GetTiledAspectRatio(), planes);
+  double cameraPosition[3];
+  camera->GetPosition(cameraPosition);
+
+  // The clipping range follows the tiles already in the renderer, so
+  // replace the near plane by the plane through the camera, and ignore
+  // the far plane
+  double direction[3];
+  camera->GetDirectionOfProjection(direction);
+  std::copy(direction, direction + 3, planes + 16);
+  planes[19] = -vtkMath::Dot(direction, cameraPosition);
+  double pixelsPerUnit = 0.5 * height /
+    tan(vtkMath::RadiansFromDegrees(0.5 * camera->GetViewAngle()));
+
+  std::vector<QuadtreeNode> leaves;
+  std::priority_queue<QuadtreeNode> refinable;
+  QuadtreeNode root;
+  InitNode(root, 0, 0, 0, cameraPosition, pixelsPerUnit);
+  if (IsNodeInFrustum(root, planes))
     {
-      tilex = tbasex + i;
-      if (SelectTilesPerspective_DoTile(tiles, tileSpecs, tilex, tiley, zoomLevel, this->Renderer) == 0)
-        break;
+    refinable.push(root);
     }
-  }
-  for (int j = -1; j >= -TILE_LIMIT; j --)
-  {
-    tiley = tbasey + j;
-    if (tiley < 0 || tiley >= zoomLevelFactor)
-      continue;
-    for (int i = 0; i < TILE_LIMIT; i ++)
+  std::size_t numberOfTiles = refinable.size();
+
+  while (!refinable.empty())
     {
-      tilex = tbasex + i;
-      if (SelectTilesPerspective_DoTile(tiles, tileSpecs, tilex, tiley, zoomLevel, this->Renderer) == 0)
-        break;
+    QuadtreeNode node = refinable.top();
+    refinable.pop();
+    if (node.ScreenSize <= this->PerspectiveTileScreenSize ||
+        node.Zoom >= MaxZoom)
+      {
+      leaves.push_back(node);
+      continue;
+      }
+
+    QuadtreeNode children[4];
+    std::size_t numberOfChildren = 0;
+    for (int i = 0; i < 4; ++i)
+      {
+      QuadtreeNode& child = children[numberOfChildren];
+      InitNode(child, node.Zoom + 1, 2 * node.X + i % 2, 2 * node.Y + i / 2,
+               cameraPosition, pixelsPerUnit);
+      if (IsNodeInFrustum(child, planes))
+        {
+        ++numberOfChildren;
+        }
+      }
+    if (numberOfTiles - 1 + numberOfChildren >
+        static_cast<std::size_t>(this->MaxPerspectiveTiles))
+      {
+      leaves.push_back(node);
+      continue;
+      }
+    // The node is replaced by its children
+    numberOfTiles = numberOfTiles - 1 + numberOfChildren;
+    for (std::size_t i = 0; i < numberOfChildren; ++i)
+      {
+      refinable.push(children[i]);
+      }
     }
-    for (int i = -1; i >= -TILE_LIMIT; i --)
+
+  std::vector<QuadtreeNode>::iterator iter = leaves.begin();
+  for (; iter != leaves.end(); iter++)
     {
-      tilex = tbasex + i;
-      if (SelectTilesPerspective_DoTile(tiles, tileSpecs, tilex, tiley, zoomLevel, this->Renderer) == 0)
-        break;
+    vtkMapTile *tile = this->GetCachedTile(iter->Zoom, iter->X, iter->Y);
+    if (tile)
+      {
+      tiles.push_back(tile);
+      tile->SetVisible(true);
+      this->TouchTile(tile);
+      continue;
+      }
+
+    vtkMapTileSpecInternal tileSpec;
+    std::copy(iter->Corners, iter->Corners + 4, tileSpec.Corners);
+
+    tileSpec.ZoomRowCol[0] = iter->Zoom;
+    tileSpec.ZoomRowCol[1] = iter->X;
+    tileSpec.ZoomRowCol[2] = (1 << iter->Zoom) - 1 - iter->Y;
+
+    tileSpec.ZoomXY[0] = iter->Zoom;
+    tileSpec.ZoomXY[1] = iter->X;
+    tileSpec.ZoomXY[2] = iter->Y;
+
+    tileSpecs.push_back(tileSpec);
     }
-  }
 }
 
 //----------------------------------------------------------------------------
-// Instantiates and initializes tiles from spec objects
+// Instantiates and initializes tiles from spec objects.
+// Specs of tiles that could not be loaded are left in tileSpecs.
 void vtkOsmLayer::
 InitializeTiles(std::vector<vtkMapTile*>& tiles,
                 std::vector<vtkMapTileSpecInternal>& tileSpecs)
 {
   std::stringstream oss;
+  std::vector<vtkMapTileSpecInternal> failedSpecs;
   std::vector<vtkMapTileSpecInternal>::iterator tileSpecIter =
     tileSpecs.begin();
   for (; tileSpecIter != tileSpecs.end(); tileSpecIter++)
@@ -565,13 +885,95 @@ InitializeTiles(std::vector<vtkMapTile*>& tiles,
 
     vtkMapTile *tile = vtkMapTile::New();
     tile->SetLayer(this);
+    tile->SetActorPool(this->ActorPool);
     tile->SetCorners(spec.Corners);
 
     // Set the local & remote paths
     this->MakeFileSystemPath(spec, oss);
-    tile->SetFileSystemPath(oss.str());
+    std::string filename = oss.str();
+    tile->SetFileSystemPath(filename);
     this->MakeUrl(spec, oss);
-    tile->SetImageSource(oss.str());
+    std::string url = oss.str();
+    tile->SetImageSource(url);
+
+    // Tiles loaded by other layers are shared, and tiles kept in memory
+    // encoded are only decoded again. Tiles being loaded by other layers
+    // are loaded here too, as the render thread does not wait for them.
+    vtkImageData *image = NULL;
+    std::vector<unsigned char> data;
+    int load = this->TileService->BeginLoad(url, url, image, &data, false);
+
+    // Tile files are read and checked here, and missing ones downloaded
+    // here rather than by the tile, to keep their metadata
+    bool loaded;
+    if (load == vtkMapTileService::LoadShared)
+      {
+      tile->SetImage(image);
+      image->UnRegister(NULL);
+      this->Metrics->Increment(vtkMapTileMetrics::ImageCacheHits);
+      loaded = true;
+      }
+    else if (load == vtkMapTileService::LoadFailed)
+      {
+      loaded = false;
+      }
+    else if (load == vtkMapTileService::LoadEncoded)
+      {
+      this->Metrics->Increment(vtkMapTileMetrics::EncodedCacheHits);
+      loaded = true;
+      }
+    else if (this->TileStore)
+      {
+      loaded = this->LoadTileData(spec, url, true, data);
+      }
+    else
+      {
+      bool local = this->GetTileSource()->IsLocal();
+      loaded = !local && this->ReadTileFile(filename, data);
+      if (!local)
+        {
+        this->Metrics->Increment(loaded ? vtkMapTileMetrics::DiskCacheHits :
+                                 vtkMapTileMetrics::DiskCacheMisses);
+        }
+      if (loaded)
+        {
+        vtkMapTileDiskCache *diskCache = this->GetDiskCache();
+        if (diskCache)
+          {
+          diskCache->RecordAccess(
+            spec.ZoomRowCol[0], spec.ZoomRowCol[1], spec.ZoomRowCol[2]);
+          }
+        this->CheckCachedTile(spec);
+        }
+      else
+        {
+        loaded = this->DownloadTileData(spec, url, data);
+        }
+      }
+    if (load != vtkMapTileService::LoadShared &&
+        load != vtkMapTileService::LoadFailed)
+      {
+      // Decoded here to share the image
+      if (loaded)
+        {
+        if (load != vtkMapTileService::LoadEncoded)
+          {
+          this->TileService->AddEncodedTile(url, data);
+          }
+        tile->SetImageBuffer(data);
+        loaded = this->DecodeTile(tile);
+        }
+      if (load != vtkMapTileService::LoadInProgress)
+        {
+        this->TileService->EndLoad(url, url, tile->GetImage(), loaded);
+        }
+      }
+    if (!loaded)
+      {
+      tile->Delete();
+      failedSpecs.push_back(spec);
+      continue;
+      }
 
     // Initialize the tile and add to the cache
     tile->Init();
@@ -582,7 +984,7 @@ InitializeTiles(std::vector<vtkMapTile*>& tiles,
     tiles.push_back(tile);
     tile->SetVisible(true);
     }
-  tileSpecs.clear();
+  tileSpecs.swap(failedSpecs);
 }
 
 //----------------------------------------------------------------------------
@@ -592,18 +994,61 @@ void vtkOsmLayer::RenderTiles(std::vector<vtkMapTile*>& tiles)
   this->TileBorders[0] = this->TileBorders[1] = this->TileBorders[2] = this->TileBorders[3] = 0;
   if (tiles.size() > 0)
     {
-    // Remove old tiles
-    std::vector<vtkMapTile*>::iterator itr = this->CachedTiles.begin();
-    for (; itr != this->CachedTiles.end(); ++itr)
+    // Draw all tiles with the atlas actor, if they fit
+    bool drawAtlas = false;
+    if (this->UseTileAtlas)
+      {
+      if (!this->TileAtlas)
+        {
+        this->TileAtlas = vtkMapTileAtlas::New();
+        }
+      drawAtlas = this->TileAtlas->Update(tiles);
+      }
+    if (drawAtlas)
+      {
+      this->Renderer->AddActor(this->TileAtlas->GetActor());
+      }
+    else if (this->TileAtlas)
       {
-      this->Renderer->RemoveActor((*itr)->GetActor());
+      this->Renderer->RemoveActor(this->TileAtlas->GetActor());
+      }
+
+    // Add the actors of tiles new to the view and remove those of tiles
+    // that left it, by walking the sorted old and new sets together.
+    // Tiles in view do not overlap, so the order of actors is irrelevant.
+    std::vector<vtkMapTile*> attach;
+    if (!drawAtlas)
+      {
+      attach = tiles;
+      std::sort(attach.begin(), attach.end());
+      attach.erase(std::unique(attach.begin(), attach.end()), attach.end());
+      }
+    std::vector<vtkMapTile*>::iterator oldIter = this->AttachedTiles.begin();
+    std::vector<vtkMapTile*>::iterator newIter = attach.begin();
+    while (oldIter != this->AttachedTiles.end() || newIter != attach.end())
+      {
+      if (newIter == attach.end() ||
+          (oldIter != this->AttachedTiles.end() && *oldIter < *newIter))
+        {
+        this->Renderer->RemoveActor((*oldIter)->GetActor());
+        ++oldIter;
+        }
+      else if (oldIter == this->AttachedTiles.end() || *newIter < *oldIter)
+        {
+        this->Renderer->AddActor((*newIter)->GetActor());
+        ++newIter;
+        }
+      else
+        {
+        ++oldIter;
+        ++newIter;
+        }
       }
+    this->AttachedTiles.swap(attach);
 
     tiles[0]->GetCorners(this->TileBorders);
-    // Add new tiles
     for (std::size_t i = 0; i < tiles.size(); ++i)
       {
-      this->Renderer->AddActor(tiles[i]->GetActor());
       if (tiles[i]->GetCorners()[0] < this->TileBorders[0])
         this->TileBorders[0] = tiles[i]->GetCorners()[0];
       if (tiles[i]->GetCorners()[1] < this->TileBorders[1])
@@ -618,24 +1063,368 @@ void vtkOsmLayer::RenderTiles(std::vector<vtkMapTile*>& tiles)
     }
 }
 
+//----------------------------------------------------------------------------
+void vtkOsmLayer::
+SelectFallbackTiles(std::vector<vtkMapTile*>& tiles,
+                    std::vector<vtkMapTileSpecInternal>& tileSpecs)
+{
+  std::vector<vtkMapTileSpecInternal>::iterator iter = tileSpecs.begin();
+  for (; iter != tileSpecs.end(); iter++)
+    {
+    int zoom = iter->ZoomXY[0];
+    int x = iter->ZoomXY[1];
+    int y = iter->ZoomXY[2];
+
+    // Zooming out: the four tiles one level down cover this one
+    vtkMapTile *children[4];
+    int numChildren = 0;
+    for (int i = 0; i < 4 && this->FallbackZoomLevels > 0; ++i)
+      {
+      vtkMapTile *child =
+        this->GetCachedTile(zoom + 1, 2 * x + (i & 1), 2 * y + (i >> 1));
+      if (child)
+        {
+        children[numChildren++] = child;
+        }
+      }
+
+    // Zooming in: stretch part of a lower-zoom tile, unless
+    // higher-resolution tiles cover all of the area
+    vtkMapTile *fallback = NULL;
+    if (this->FallbackZoomLevels > 0 && numChildren < 4)
+      {
+      fallback = this->GetFallbackTile(*iter);
+      }
+
+    // Nothing cached stands in for a failed tile: mark it as missing
+    if (!fallback && numChildren == 0 &&
+        this->FailureCache->HasFailed(
+          iter->ZoomRowCol[0], iter->ZoomRowCol[1], iter->ZoomRowCol[2]))
+      {
+      fallback = this->GetPlaceholderTile(*iter);
+      }
+    if (fallback)
+      {
+      tiles.push_back(fallback);
+      this->TouchTile(fallback);
+      }
+    else
+      {
+      for (int i = 0; i < numChildren; ++i)
+        {
+        tiles.push_back(children[i]);
+        this->TouchTile(children[i]);
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkMapTile* vtkOsmLayer::GetFallbackTile(vtkMapTileSpecInternal& tileSpec)
+{
+  int zoom = tileSpec.ZoomXY[0];
+  int x = tileSpec.ZoomXY[1];
+  int y = tileSpec.ZoomXY[2];
+
+  // Parent indices are child indices shifted right, for both
+  // the x index and the (bottom-up) y index
+  vtkMapTile *ancestor = NULL;
+  for (int level = 1; level <= this->FallbackZoomLevels && level <= zoom;
+       ++level)
+    {
+    ancestor = this->GetCachedTile(zoom - level, x >> level, y >> level);
+    if (ancestor && ancestor->GetActor())
+      {
+      break;
+      }
+    ancestor = NULL;
+    }
+
+  // Reuse fallback tile from earlier views unless a closer ancestor
+  // is available now. It holds a reference to the ancestor's texture,
+  // so remains usable after the ancestor is evicted.
+  vtkTypeUInt64 key = vtkMapTileIndexInternal<vtkMapTile*>::MakeKey(zoom, x, y);
+  vtkMapTile **found = this->FallbackTilesIndex.Find(key);
+  if (found)
+    {
+    if (!ancestor ||
+        (*found)->GetActor()->GetTexture() == ancestor->GetActor()->GetTexture())
+      {
+      return *found;
+      }
+    // Drop it, PruneFallbackTiles() removes it from FallbackTiles
+    (*found)->SetLastAccess(0);
+    this->FallbackTilesIndex.Erase(key);
+    }
+  if (!ancestor)
+    {
+    return NULL;
+    }
+
+  vtkMapTile *tile = vtkMapTile::New();
+  tile->SetLayer(this);
+  tile->SetActorPool(this->ActorPool);
+  tile->SetCorners(tileSpec.Corners);
+  tile->SetZoomXY(zoom, x, y);
+  tile->InitFromAncestor(ancestor);
+  tile->SetVisible(true);
+  this->FallbackTilesIndex.Insert(key, tile);
+  this->FallbackTiles.push_back(tile);
+  return tile;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTile* vtkOsmLayer::GetPlaceholderTile(vtkMapTileSpecInternal& tileSpec)
+{
+  int zoom = tileSpec.ZoomXY[0];
+  int x = tileSpec.ZoomXY[1];
+  int y = tileSpec.ZoomXY[2];
+  vtkTypeUInt64 key = vtkMapTileIndexInternal<vtkMapTile*>::MakeKey(zoom, x, y);
+  vtkMapTile **found = this->FallbackTilesIndex.Find(key);
+  if (found)
+    {
+    return *found;
+    }
+
+  // All placeholders share a small checkered texture
+  if (!this->PlaceholderTexture)
+    {
+    const int size = 16;
+    vtkImageData *image = vtkImageData::New();
+    image->SetDimensions(size, size, 1);
+    image->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
+    unsigned char *pixel =
+      static_cast<unsigned char*>(image->GetScalarPointer());
+    for (int j = 0; j < size; ++j)
+      {
+      for (int i = 0; i < size; ++i, pixel += 3)
+        {
+        pixel[0] = pixel[1] = pixel[2] =
+          ((i / 8 + j / 8) & 1) ? 200 : 224;
+        }
+      }
+    this->PlaceholderTexture = vtkTexture::New();
+    this->PlaceholderTexture->SetInputData(image);
+    this->PlaceholderTexture->SetInterpolate(0);
+    image->Delete();
+    }
+
+  vtkMapTile *tile = vtkMapTile::New();
+  tile->SetLayer(this);
+  tile->SetActorPool(this->ActorPool);
+  tile->SetCorners(tileSpec.Corners);
+  tile->SetZoomXY(zoom, x, y);
+  tile->InitPlaceholder(this->PlaceholderTexture);
+  tile->SetVisible(true);
+  this->FallbackTilesIndex.Insert(key, tile);
+  this->FallbackTiles.push_back(tile);
+  return tile;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::PruneFallbackTiles(bool all)
+{
+  std::vector<vtkMapTile*> keep;
+  std::vector<vtkMapTile*>::iterator iter = this->FallbackTiles.begin();
+  for (; iter != this->FallbackTiles.end(); iter++)
+    {
+    vtkMapTile *tile = *iter;
+    if (!all && tile->GetLastAccess() == this->TileAccessCounter)
+      {
+      keep.push_back(tile);
+      continue;
+      }
+
+    int *zoomXY = tile->GetZoomXY();
+    vtkTypeUInt64 key = vtkMapTileIndexInternal<vtkMapTile*>::MakeKey(
+      zoomXY[0], zoomXY[1], zoomXY[2]);
+    vtkMapTile **found = this->FallbackTilesIndex.Find(key);
+    if (found && *found == tile)
+      {
+      this->FallbackTilesIndex.Erase(key);
+      }
+
+    // The texture belongs to the ancestor tile, and the actor with its
+    // mapper goes back to the pool, so there is nothing to release
+    this->DetachTile(tile);
+    tile->Delete();
+    }
+  this->FallbackTiles.swap(keep);
+}
+
 //----------------------------------------------------------------------------
 void vtkOsmLayer::AddTileToCache(int zoom, int x, int y, vtkMapTile* tile)
 {
-  this->CachedTilesMap[zoom][x][y] = tile;
+  this->CachedTilesIndex.Insert(
+    vtkMapTileIndexInternal<vtkMapTile*>::MakeKey(zoom, x, y), tile);
   this->CachedTiles.push_back(tile);
+  tile->SetZoomXY(zoom, x, y);
+  this->TouchTile(tile);
+  this->CacheSize += tile->GetMemorySize();
 }
 
 //----------------------------------------------------------------------------
-vtkMapTile *vtkOsmLayer::GetCachedTile(int zoom, int x, int y)
+int vtkOsmLayer::GetNumberOfCachedTiles()
+{
+  return static_cast<int>(this->CachedTiles.size());
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::TouchTile(vtkMapTile* tile)
+{
+  tile->SetLastAccess(this->TileAccessCounter);
+}
+
+//----------------------------------------------------------------------------
+struct sortTilesByLastAccess
 {
-  if (this->CachedTilesMap.find(zoom) == this->CachedTilesMap.end() &&
-      this->CachedTilesMap[zoom].find(x) == this->CachedTilesMap[zoom].end() &&
-      this->CachedTilesMap[zoom][x].find(y) == this->CachedTilesMap[zoom][x].end())
+  inline bool operator() (vtkMapTile* tile1,  vtkMapTile* tile2)
+  {
+    return (tile1->GetLastAccess() < tile2->GetLastAccess());
+  }
+};
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::EvictTiles()
+{
+  if (this->MaxCacheSize <= 0 || this->CacheSize <= this->MaxCacheSize)
     {
-    return NULL;
+    return;
+    }
+
+  // Evict down to a low-water mark below the budget, so that the
+  // candidate sort below is not repeated on every view update
+  vtkTypeInt64 target = this->MaxCacheSize - this->MaxCacheSize / 10;
+
+  // Candidates are all tiles not used by the current view, oldest first
+  std::vector<vtkMapTile*> candidates;
+  std::vector<vtkMapTile*>::iterator iter = this->CachedTiles.begin();
+  for (; iter != this->CachedTiles.end(); iter++)
+    {
+    if ((*iter)->GetLastAccess() != this->TileAccessCounter)
+      {
+      candidates.push_back(*iter);
+      }
+    }
+  std::sort(candidates.begin(), candidates.end(), sortTilesByLastAccess());
+
+  // Evicted tiles release their textures, and leave their images to
+  // the tile service, as its most recently used ones, oldest first
+  std::size_t numEvicted = 0;
+  for (; numEvicted < candidates.size() && this->CacheSize > target;
+       ++numEvicted)
+    {
+    vtkMapTile *tile = candidates[numEvicted];
+    this->CacheSize -= tile->GetMemorySize();
+    if (tile->GetImage())
+      {
+      this->TileService->AddImage(tile->GetImageSource(), tile->GetImage());
+      }
+    // Access stamps start at 1, so 0 marks the tile for removal below
+    tile->SetLastAccess(0);
+    }
+  if (numEvicted == 0)
+    {
+    return;
+    }
+
+  // Compact CachedTiles, keeping the tiles that were not evicted
+  std::vector<vtkMapTile*> keep;
+  keep.reserve(this->CachedTiles.size() - numEvicted);
+  for (iter = this->CachedTiles.begin(); iter != this->CachedTiles.end();
+       iter++)
+    {
+    if ((*iter)->GetLastAccess() != 0)
+      {
+      keep.push_back(*iter);
+      }
+    }
+  for (std::size_t i = 0; i < numEvicted; ++i)
+    {
+    this->ReleaseTile(candidates[i]);
+    }
+  this->CachedTiles.swap(keep);
+  this->NumberOfEvictedTiles += numEvicted;
+  this->Metrics->Increment(vtkMapTileMetrics::EvictedTiles,
+                           static_cast<vtkTypeInt64>(numEvicted));
+  vtkDebugMacro("Evicted " << numEvicted << " tiles, cache size now "
+                << this->CacheSize << " bytes");
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::ReleaseTile(vtkMapTile* tile)
+{
+  int *zoomXY = tile->GetZoomXY();
+  vtkTypeUInt64 key = vtkMapTileIndexInternal<vtkMapTile*>::MakeKey(
+    zoomXY[0], zoomXY[1], zoomXY[2]);
+  vtkMapTile **found = this->CachedTilesIndex.Find(key);
+  if (found && *found == tile)
+    {
+    this->CachedTilesIndex.Erase(key);
     }
 
-  return this->CachedTilesMap[zoom][x][y];
+  // Release the texture only, the actor with its mapper goes back to
+  // the pool. Fallback tiles cropped from this tile share its texture,
+  // which stays in use while they reference it.
+  this->DetachTile(tile);
+  vtkActor *actor = tile->GetActor();
+  if (actor && this->Renderer)
+    {
+    vtkTexture *texture = actor->GetTexture();
+    if (texture && texture->GetReferenceCount() == 1 &&
+        this->Renderer->GetRenderWindow())
+      {
+      texture->ReleaseGraphicsResources(this->Renderer->GetRenderWindow());
+      }
+    }
+  tile->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::DetachTile(vtkMapTile* tile)
+{
+  std::vector<vtkMapTile*>::iterator found = std::lower_bound(
+    this->AttachedTiles.begin(), this->AttachedTiles.end(), tile);
+  if (found != this->AttachedTiles.end() && *found == tile)
+    {
+    if (this->Renderer)
+      {
+      this->Renderer->RemoveActor(tile->GetActor());
+      }
+    this->AttachedTiles.erase(found);
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkMapTile *vtkOsmLayer::GetCachedTile(int zoom, int x, int y)
+{
+  vtkMapTile **tile = this->CachedTilesIndex.Find(
+    vtkMapTileIndexInternal<vtkMapTile*>::MakeKey(zoom, x, y));
+  return tile ? *tile : NULL;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkOsmLayer::GetTileFileSystemPath(int zoom, int x, int y)
+{
+  vtkMapTileSpecInternal tileSpec;
+  tileSpec.ZoomRowCol[0] = zoom;
+  tileSpec.ZoomRowCol[1] = x;
+  tileSpec.ZoomRowCol[2] = y;
+  std::stringstream ss;
+  this->MakeFileSystemPath(tileSpec, ss);
+  return ss.str();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkOsmLayer::GetTileUrl(int zoom, int x, int y)
+{
+  vtkMapTileSpecInternal tileSpec;
+  tileSpec.ZoomRowCol[0] = zoom;
+  tileSpec.ZoomRowCol[1] = x;
+  tileSpec.ZoomRowCol[2] = y;
+  std::stringstream ss;
+  this->MakeUrl(tileSpec, ss);
+  return ss.str();
 }
 
 //----------------------------------------------------------------------------
@@ -655,9 +1444,311 @@ void vtkOsmLayer::MakeUrl(
   vtkMapTileSpecInternal& tileSpec, std::stringstream& ss)
 {
   ss.str("");
-  ss << "http://" << this->MapTileServer
-     << "/" << tileSpec.ZoomRowCol[0]
-     << "/" << tileSpec.ZoomRowCol[1]
-     << "/" << tileSpec.ZoomRowCol[2]
-     << "." << this->MapTileExtension;;
+  ss << this->GetTileSource()->GetTileUrl(
+    tileSpec.ZoomRowCol[0], tileSpec.ZoomRowCol[1], tileSpec.ZoomRowCol[2]);
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsmLayer::LoadTileData(vtkMapTileSpecInternal& tileSpec,
+                               const std::string& url, bool download,
+                               std::vector<unsigned char>& data)
+{
+  int zoom = tileSpec.ZoomRowCol[0];
+  int x = tileSpec.ZoomRowCol[1];
+  int y = tileSpec.ZoomRowCol[2];
+  if (!this->GetTileSource()->IsLocal())
+    {
+    if (this->TileStore->Get(zoom, x, y, data))
+      {
+      this->Metrics->Increment(vtkMapTileMetrics::DiskCacheHits);
+      vtkMapTileDiskCache *diskCache = this->GetDiskCache();
+      if (diskCache)
+        {
+        diskCache->RecordAccess(zoom, x, y);
+        }
+      this->CheckCachedTile(tileSpec);
+      return true;
+      }
+    this->Metrics->Increment(vtkMapTileMetrics::DiskCacheMisses);
+    }
+  return download && this->DownloadTileData(tileSpec, url, data);
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsmLayer::DownloadTileData(vtkMapTileSpecInternal& tileSpec,
+                                   const std::string& url,
+                                   std::vector<unsigned char>& data)
+{
+  // Failed tiles are retried after a delay, and no tile is requested
+  // while the server is down
+  int zoom = tileSpec.ZoomRowCol[0];
+  int x = tileSpec.ZoomRowCol[1];
+  int y = tileSpec.ZoomRowCol[2];
+  if (!this->FailureCache->ShouldRequest(zoom, x, y))
+    {
+    return false;
+    }
+
+  long status;
+  std::string message;
+  vtkMapTileCacheInfo info;
+  vtkTileSource *source = this->GetTileSource();
+  bool remote = !source->IsLocal();
+  double start = vtkTimerLog::GetUniversalTime();
+  bool fetched = source->FetchTile(zoom, x, y, data, &status, &message,
+                                   remote ? &info : NULL);
+  double elapsed = vtkTimerLog::GetUniversalTime() - start;
+  if (remote)
+    {
+    this->ConcurrencyController->RecordResponse(
+      vtkMapTileConcurrencyController::GetHost(url), elapsed, status);
+    }
+  this->Metrics->Increment(vtkMapTileMetrics::Downloads);
+  this->Metrics->Record(vtkMapTileMetrics::DownloadTime, 1000.0 * elapsed);
+  if (!fetched)
+    {
+    this->Metrics->Increment(vtkMapTileMetrics::DownloadFailures);
+    this->FailureCache->RecordFailure(zoom, x, y, status);
+    vtkErrorMacro("Download " << url << " failed: " << message);
+    return false;
+    }
+  if (data.empty() ||
+      !vtkPackedTileStore::IsCompleteImage(&data[0], data.size()))
+    {
+    this->Metrics->Increment(vtkMapTileMetrics::DownloadFailures);
+    this->FailureCache->RecordFailure(zoom, x, y, status);
+    vtkErrorMacro("Invalid image data from " << url);
+    return false;
+    }
+  this->FailureCache->RecordSuccess(zoom, x, y);
+  this->Metrics->Increment(vtkMapTileMetrics::DownloadedBytes,
+                           static_cast<vtkTypeInt64>(data.size()));
+
+  // The tile is usable even if it could not be cached. Local tiles
+  // are read from their source again instead.
+  if (remote && this->StoreTileData(zoom, x, y, data) && this->Revalidator)
+    {
+    this->Revalidator->SetCacheInfo(zoom, x, y, info);
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsmLayer::StoreTileData(int zoom, int x, int y,
+                                const std::vector<unsigned char>& data)
+{
+  if (data.empty())
+    {
+    return false;
+    }
+
+  bool stored = this->TileStore ?
+    this->TileStore->Put(zoom, x, y, &data[0], data.size()) :
+    WriteTileFile(this->GetTileFileSystemPath(zoom, x, y), data);
+  if (!stored)
+    {
+    vtkErrorMacro("Unable to store tile " << zoom << "-" << x << "-" << y);
+    return false;
+    }
+
+  vtkMapTileDiskCache *diskCache = this->GetDiskCache();
+  if (diskCache)
+    {
+    diskCache->RecordInsert(zoom, x, y,
+                            static_cast<vtkTypeInt64>(data.size()));
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsmLayer::WriteTileFile(const std::string& path,
+                                const std::vector<unsigned char>& data)
+{
+  // Written to a temporary file, unique to the writer, which is flushed
+  // to disk before it is renamed to the tile file. Readers thus never
+  // see a partial tile, even after a crash.
+  static vtkAtomic<vtkTypeInt64> counter;
+  std::stringstream ss;
+#ifdef _WIN32
+  ss << path << "." << _getpid() << "-" << ++counter << ".part";
+#else
+  ss << path << "." << getpid() << "-" << ++counter << ".part";
+#endif
+  std::string partPath = ss.str();
+
+  FILE *fp = fopen(partPath.c_str(), "wb");
+  if (!fp)
+    {
+    return false;
+    }
+  bool written = !data.empty() &&
+    fwrite(&data[0], 1, data.size(), fp) == data.size() &&
+    fflush(fp) == 0;
+#ifdef _WIN32
+  written = written && _commit(_fileno(fp)) == 0;
+#else
+  written = written && fsync(fileno(fp)) == 0;
+#endif
+  written = fclose(fp) == 0 && written;
+
+#ifdef _WIN32
+  // Unlike rename(), replaces an existing tile file
+  written = written && MoveFileExA(partPath.c_str(), path.c_str(),
+                                   MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  written = written && rename(partPath.c_str(), path.c_str()) == 0;
+#endif
+  if (!written)
+    {
+    remove(partPath.c_str());
+    }
+  return written;
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsmLayer::ReadTileFile(const std::string& path,
+                               std::vector<unsigned char>& data)
+{
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp)
+    {
+    return false;
+    }
+  data.resize(static_cast<std::size_t>(
+    vtksys::SystemTools::FileLength(path)));
+  bool valid = !data.empty() &&
+    fread(&data[0], 1, data.size(), fp) == data.size();
+  fclose(fp);
+
+  // Files left truncated by earlier versions are downloaded again
+  valid = valid && vtkPackedTileStore::IsCompleteImage(&data[0], data.size());
+  if (!valid)
+    {
+    vtkWarningMacro("Removing invalid tile file " << path);
+    remove(path.c_str());
+    data.clear();
+    }
+  return valid;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::CheckCachedTile(vtkMapTileSpecInternal& tileSpec)
+{
+  if (this->RevalidateTiles && this->Revalidator)
+    {
+    this->Revalidator->CheckTile(tileSpec.ZoomRowCol[0],
+                                 tileSpec.ZoomRowCol[1],
+                                 tileSpec.ZoomRowCol[2]);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::ReleaseUpdatedTiles()
+{
+  std::vector<vtkTypeUInt64> keys;
+  if (this->Revalidator)
+    {
+    this->Revalidator->GetUpdatedTiles(this, keys);
+    }
+  if (keys.empty())
+    {
+    return;
+    }
+
+  // Updated tiles are identified by OSM indices, cached tiles by
+  // (zoom, x, y) with y counted from the bottom
+  std::size_t numReleased = 0;
+  for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+    int zoom, col, row;
+    vtkMapTileIndexInternal<vtkMapTile*>::SplitKey(keys[i], zoom, col, row);
+    this->TileService->RemoveImage(this->GetTileUrl(zoom, col, row));
+    vtkMapTile *tile = this->GetCachedTile(zoom, col, (1 << zoom) - 1 - row);
+    if (tile)
+      {
+      this->CacheSize -= tile->GetMemorySize();
+      // Access stamps start at 1, so 0 marks the tile for removal below
+      tile->SetLastAccess(0);
+      ++numReleased;
+      }
+    }
+  if (numReleased == 0)
+    {
+    return;
+    }
+
+  std::vector<vtkMapTile*> keep;
+  keep.reserve(this->CachedTiles.size() - numReleased);
+  std::vector<vtkMapTile*>::iterator iter = this->CachedTiles.begin();
+  for (; iter != this->CachedTiles.end(); iter++)
+    {
+    if ((*iter)->GetLastAccess() != 0)
+      {
+      keep.push_back(*iter);
+      }
+    else
+      {
+      this->ReleaseTile(*iter);
+      }
+    }
+  this->CachedTiles.swap(keep);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsmLayer::DecodeTile(vtkMapTile *tile)
+{
+  if (tile->GetImage())
+    {
+    return true;
+    }
+  double start = vtkTimerLog::GetUniversalTime();
+  bool decoded = tile->Decode();
+  this->Metrics->Record(vtkMapTileMetrics::DecodeTime,
+                        1000.0 * (vtkTimerLog::GetUniversalTime() - start));
+  this->Metrics->Increment(decoded ? vtkMapTileMetrics::DecodedTiles :
+                           vtkMapTileMetrics::DecodeFailures);
+  return decoded;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::GetMetricsSnapshot(vtkMapTileMetricsSnapshot& snapshot)
+{
+  this->Metrics->GetSnapshot(snapshot);
+  snapshot.NumberOfCachedTiles = this->GetNumberOfCachedTiles();
+  snapshot.CacheSize = this->CacheSize;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::LogMetrics()
+{
+  if (this->MetricsLogInterval <= 0.0 ||
+      (!this->MetricsLogFileName && !this->Debug))
+    {
+    return;
+    }
+  double now = vtkTimerLog::GetUniversalTime();
+  if (now - this->MetricsLogTime < this->MetricsLogInterval)
+    {
+    return;
+    }
+  this->MetricsLogTime = now;
+
+  vtkMapTileMetricsSnapshot snapshot;
+  this->GetMetricsSnapshot(snapshot);
+  if (!this->MetricsLogFileName)
+    {
+    std::stringstream json;
+    snapshot.PrintJson(json);
+    vtkDebugMacro("Tile metrics: " << json.str());
+    return;
+    }
+  std::ofstream file(this->MetricsLogFileName, std::ios::app);
+  if (!file)
+    {
+    vtkWarningMacro("Cannot write metrics to " << this->MetricsLogFileName);
+    return;
+    }
+  snapshot.PrintJson(file);
+  file << "\n";
 }
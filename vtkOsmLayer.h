@@ -20,6 +20,7 @@
 
 #include "vtkFeatureLayer.h"
 #include "vtkMapTile.h"
+#include "vtkMapTileIndexInternal.h"
 #include "vtkMapTileSpecInternal.h"
 #include "vtkmap_export.h"
 
@@ -27,11 +28,26 @@
 #include <vtkObject.h>
 #include <vtkRenderer.h>
 
-#include <map>
 #include <sstream>
+#include <string>
 #include <vector>
 
+class vtkHttpTileSource;
+class vtkMapTileActorPool;
+class vtkMapTileAtlas;
+class vtkMapTileConcurrencyController;
+class vtkMapTileDiskCache;
+class vtkMapTileFailureCache;
+class vtkMapTileFetcher;
+class vtkMapTileMetrics;
+class vtkMapTileMetricsSnapshot;
+class vtkMapTileRevalidator;
+class vtkMapTileService;
+class vtkMapTileStorage;
+class vtkPackedTileStore;
 class vtkTextActor;
+class vtkTexture;
+class vtkTileSource;
 
 class VTKMAP_EXPORT vtkOsmLayer : public vtkFeatureLayer
 {
@@ -48,11 +64,31 @@ public:
                         const char *attribution,
                         const char *extension);
 
+  // Description:
+  // Get the map tile server and file extension
+  vtkGetStringMacro(MapTileServer);
+  vtkGetStringMacro(MapTileExtension);
+
   // Description:
   // The full path to the directory used for caching map-tile files.
   // Set automatically by vtkMap.
   vtkGetStringMacro(CacheDirectory);
 
+  // Description:
+  // Get/Set the source tiles are downloaded from. By default, or if set
+  // to NULL, tiles come from the map-tile server, through a
+  // vtkHttpTileSource with the URL template
+  // "http://<server>/{z}/{x}/{y}.<extension>". The cache directory is
+  // still named after the map-tile server. Setting it clears the tiles.
+  virtual void SetTileSource(vtkTileSource *source);
+  vtkTileSource *GetTileSource();
+
+  // Description:
+  // Path of the cache file, and URL in the tile source,
+  // of the tile with the given OSM indices
+  std::string GetTileFileSystemPath(int zoom, int x, int y);
+  std::string GetTileUrl(int zoom, int x, int y);
+
   // Description:
   virtual void Update();
 
@@ -65,6 +101,192 @@ public:
   // Description: get borders of loaded tiles
   vtkGetVector4Macro(TileBorders, double);
 
+  // Description:
+  // Get/Set the memory budget, in bytes, of the in-memory tile cache.
+  // When the cache grows past the budget, the least recently used tiles
+  // outside the current view are evicted. Tiles in view are never evicted.
+  // A value of 0 disables eviction. The default is 256 MB.
+  // Cached tiles keep their textures. The images of evicted tiles stay
+  // in memory, decoded then encoded, within the budgets of the tile
+  // service, see vtkMapTileService::SetMaxImageCacheSize() and
+  // vtkMapTileService::SetMaxEncodedCacheSize().
+  vtkGetMacro(MaxCacheSize, vtkTypeInt64);
+  vtkSetMacro(MaxCacheSize, vtkTypeInt64);
+
+  // Description:
+  // Estimated memory, in bytes, held by the cached tiles
+  vtkGetMacro(CacheSize, vtkTypeInt64);
+
+  // Description:
+  // Store downloaded tiles in a single packed file (tiles.pack in the
+  // cache directory) instead of one file per tile. See vtkPackedTileStore.
+  // Layers sharing the cache directory share its store, as set by the
+  // first one, see vtkMapTileStorage. Default is off.
+  void SetUsePackedTileStore(bool value);
+  vtkGetMacro(UsePackedTileStore, bool);
+  vtkBooleanMacro(UsePackedTileStore, bool);
+
+  // Description:
+  // The packed tile store, or NULL if UsePackedTileStore is off
+  // or the cache directory is not set yet.
+  vtkGetObjectMacro(TileStore, vtkPackedTileStore);
+
+  // Description:
+  // Get/Set how many zoom levels to search for cached tiles to draw in
+  // place of tiles that are still loading: the nearest cached ancestor,
+  // cropped to the missing tile, or when zooming out, the cached tiles
+  // one level down. 0 disables fallback tiles. The default is 4.
+  vtkGetMacro(FallbackZoomLevels, int);
+  vtkSetMacro(FallbackZoomLevels, int);
+
+  // Description:
+  // Get/Set the largest size, in pixels, at which a tile is drawn in
+  // perspective views. Larger tiles are replaced by their four children,
+  // so the zoom level varies across the view, from fine near the camera
+  // to coarse towards the horizon. The default, 256, is the size of the
+  // tile images, i.e. tiles are never magnified.
+  vtkGetMacro(PerspectiveTileScreenSize, double);
+  vtkSetClampMacro(PerspectiveTileScreenSize, double, 16.0, 4096.0);
+
+  // Description:
+  // Get/Set the maximum number of tiles selected for a perspective view.
+  // Tiles largest on screen are refined first, so the detail left out
+  // when the limit is reached is the least visible. Default is 128.
+  vtkGetMacro(MaxPerspectiveTiles, int);
+  vtkSetClampMacro(MaxPerspectiveTiles, int, 1, 4096);
+
+  // Description:
+  // Get/Set whether visible tiles are drawn by a single actor, from a
+  // texture atlas holding their images, instead of one actor per tile.
+  // Falls back to one actor per tile when the tiles do not fit into the
+  // atlas. See vtkMapTileAtlas. Default is off.
+  vtkGetMacro(UseTileAtlas, bool);
+  vtkSetMacro(UseTileAtlas, bool);
+  vtkBooleanMacro(UseTileAtlas, bool);
+
+  // Description:
+  // The tile atlas, or NULL if UseTileAtlas has not been used yet
+  vtkGetObjectMacro(TileAtlas, vtkMapTileAtlas);
+
+  // Description:
+  // Get/Set the quota of the on-disk tile cache, in bytes and in number
+  // of tiles. When either is exceeded, the least recently used tiles are
+  // deleted by a background thread. 0 means no limit (the default).
+  // See vtkMapTileDiskCache.
+  void SetMaxDiskCacheSize(vtkTypeInt64 size);
+  vtkGetMacro(MaxDiskCacheSize, vtkTypeInt64);
+  void SetMaxDiskCacheTiles(int count);
+  vtkGetMacro(MaxDiskCacheTiles, int);
+
+  // Description:
+  // Bytes used by, and number of tiles in, the on-disk tile cache,
+  // shared by the layers using the cache directory. The first call
+  // starts scanning the cache, and both are 0 until it is scanned.
+  vtkTypeInt64 GetDiskCacheSize();
+  int GetNumberOfDiskCacheTiles();
+
+  // Description:
+  // The object enforcing the on-disk cache quota, or NULL if the cache
+  // directory is not set yet, or if no layer using it has set a quota
+  // or asked for the cache statistics
+  vtkMapTileDiskCache *GetDiskCache();
+
+  // Description:
+  // The object downloading the layer's tiles, over connections reused
+  // across tiles and threads
+  vtkGetObjectMacro(TileFetcher, vtkMapTileFetcher);
+
+  // Description:
+  // The record of failed tile downloads, which delays retries of
+  // failed tiles and suspends requests while the tile server is down.
+  // Failed tiles with no cached tile to stand in for them are drawn as
+  // gray placeholders. See vtkMapTileFailureCache.
+  vtkGetObjectMacro(FailureCache, vtkMapTileFailureCache);
+
+  // Description:
+  // The controller of the number of concurrent requests to each tile
+  // server, which adapts it to the server's responses. It gets the
+  // response time and status of each download, and vtkMultiThreadedOsmLayer
+  // starts no more downloads than it allows. Its floor and ceiling can be
+  // set, see vtkMapTileConcurrencyController. It is that of the tile
+  // service, shared with the other layers using the service.
+  vtkGetObjectMacro(ConcurrencyController, vtkMapTileConcurrencyController);
+
+  // Description:
+  // Get/Set the service through which the layer shares tile loads,
+  // decoded tile images, request threads and download limits with other
+  // layers, in the same or other vtkMap instances. By default, or if set
+  // to NULL, the global instance of vtkMapTileService.
+  virtual void SetTileService(vtkMapTileService *service);
+  vtkGetObjectMacro(TileService, vtkMapTileService);
+
+  // Description:
+  // Get/Set whether expired tiles loaded from the on-disk cache are
+  // revalidated with the tile server in the background, with
+  // conditional requests. Tiles changed on the server are reloaded by
+  // the next update. See vtkMapTileRevalidator. Default is on.
+  vtkGetMacro(RevalidateTiles, bool);
+  vtkSetMacro(RevalidateTiles, bool);
+  vtkBooleanMacro(RevalidateTiles, bool);
+
+  // Description:
+  // The object keeping the HTTP caching metadata of the cached tiles,
+  // or NULL if the cache directory is not set yet
+  vtkGetObjectMacro(Revalidator, vtkMapTileRevalidator);
+
+  // Description:
+  // Write encoded image bytes for the tile with the given OSM indices
+  // to the packed tile store or the tile's cache file, replacing any
+  // previous version, and record it with the disk cache quota.
+  // Returns false on failure.
+  bool StoreTileData(int zoom, int x, int y,
+                     const std::vector<unsigned char>& data);
+
+  // Description:
+  // Write data to the file at path, such that the file either keeps its
+  // previous contents or holds all of data, even if the process dies:
+  // data goes to a temporary file, which is flushed to disk and renamed.
+  // Returns false on failure.
+  static bool WriteTileFile(const std::string& path,
+                            const std::vector<unsigned char>& data);
+
+  // Description:
+  // The pool of geometry and actors shared by the layer's tiles
+  vtkGetObjectMacro(ActorPool, vtkMapTileActorPool);
+
+  // Description:
+  // Number of tiles currently held in the cache
+  int GetNumberOfCachedTiles();
+
+  // Description:
+  // Total number of tiles evicted from the cache
+  vtkGetMacro(NumberOfEvictedTiles, vtkTypeInt64);
+
+  // Description:
+  // Number of tiles in the last view drawn that were not loaded yet, or
+  // failed to load: cached tiles of other zoom levels or placeholders
+  // stand in for them, if any
+  vtkGetMacro(NumberOfMissingTiles, int);
+
+  // Description:
+  // Counters and histograms of the layer's tile pipeline
+  vtkGetObjectMacro(Metrics, vtkMapTileMetrics);
+
+  // Description:
+  // Copy the metrics, with the current state of the layer, into the
+  // snapshot
+  virtual void GetMetricsSnapshot(vtkMapTileMetricsSnapshot& snapshot);
+
+  // Description:
+  // Get/Set the interval, in seconds, at which a snapshot of the
+  // metrics is printed as one line of JSON, on view updates, to the
+  // file named MetricsLogFileName, or as a debug message if not set
+  // (see vtkObject::DebugOn()). 0 prints none. Default is 0.
+  vtkSetMacro(MetricsLogInterval, double);
+  vtkGetMacro(MetricsLogInterval, double);
+  vtkSetStringMacro(MetricsLogFileName);
+  vtkGetStringMacro(MetricsLogFileName);
+
 protected:
   vtkOsmLayer();
   virtual ~vtkOsmLayer();
@@ -74,28 +296,124 @@ protected:
   virtual void AddTiles();
   void RemoveTiles();
 
-  // Next 5 methods used to add tiles to layer
+  // Next 4 methods used to add tiles to layer
   void SelectTiles(std::vector<vtkMapTile*>& tiles,
                    std::vector<vtkMapTileSpecInternal>& tileSpecs);
-  int SelectTilesPerspective_DoTile(std::vector<vtkMapTile*>& tiles,
-                                    std::vector<vtkMapTileSpecInternal>& tileSpecs,
-                                    int tilex, int tiley, int zoomLevel, vtkRenderer* renderer);
   void SelectTilesPerspective(std::vector<vtkMapTile*>& tiles,
                               std::vector<vtkMapTileSpecInternal>& tileSpecs);
   void InitializeTiles(std::vector<vtkMapTile*>& tiles,
                        std::vector<vtkMapTileSpecInternal>& tileSpecs);
   void RenderTiles(std::vector<vtkMapTile*>& tiles);
 
+  // Description:
+  // Add cached tiles standing in for the tiles in tileSpecs,
+  // which are not loaded yet
+  void SelectFallbackTiles(std::vector<vtkMapTile*>& tiles,
+                           std::vector<vtkMapTileSpecInternal>& tileSpecs);
+
+  // Description:
+  // Get tile showing the nearest cached ancestor of the tile,
+  // or NULL if there is none
+  vtkMapTile* GetFallbackTile(vtkMapTileSpecInternal& tileSpec);
+
+  // Description:
+  // Get tile drawing a placeholder in place of the tile, which failed
+  // to load
+  vtkMapTile* GetPlaceholderTile(vtkMapTileSpecInternal& tileSpec);
+
+  // Description:
+  // Remove fallback tiles not used by the current view,
+  // or all fallback tiles
+  void PruneFallbackTiles(bool all);
+
   void AddTileToCache(int zoom, int x, int y, vtkMapTile* tile);
   vtkMapTile* GetCachedTile(int zoom, int x, int y);
 
+  // Description:
+  // Mark tile as used by the current view
+  void TouchTile(vtkMapTile* tile);
+
+  // Description:
+  // Evict least recently used tiles until the cache is within budget
+  void EvictTiles();
+
+  // Description:
+  // Remove tile from renderer and cache index, release its graphics
+  // resources, and delete it. Does not update CachedTiles.
+  void ReleaseTile(vtkMapTile* tile);
+
+  // Description:
+  // Remove the tile's actor from the renderer, if it was added by
+  // RenderTiles()
+  void DetachTile(vtkMapTile* tile);
+
   // Construct paths for local & remote tile access
   // A stringstream is passed in for performance reasons
   void MakeFileSystemPath(
     vtkMapTileSpecInternal& tileSpec, std::stringstream& ss);
   void MakeUrl(vtkMapTileSpecInternal& tileSpec, std::stringstream& ss);
 
+  // Description:
+  // Acquire the storage of the current cache directory, shared with
+  // the other layers using it, and release the previous one
+  void UpdateTileStore();
+
+  // Description:
+  // Release the storage, if any, and the objects of it the layer uses
+  void ReleaseStorage();
+
+  // Description:
+  // Set the quota of the layer on the disk cache of the storage,
+  // creating the disk cache if the layer has a quota
+  void UpdateDiskCache();
+
+  // Description:
+  // Get encoded image bytes for the tile from the packed tile store,
+  // downloading (and storing) them if needed. Returns false on failure.
+  bool LoadTileData(vtkMapTileSpecInternal& tileSpec,
+                    const std::string& url, bool download,
+                    std::vector<unsigned char>& data);
+
+  // Description:
+  // Download the tile from the tile source into memory and, unless the
+  // source is local, store it in the cache, recording its HTTP caching
+  // metadata. url is the tile's URL, for messages. Returns false unless
+  // valid image data was downloaded. Failures are recorded in the
+  // failure cache, and tiles it holds back are not requested.
+  bool DownloadTileData(vtkMapTileSpecInternal& tileSpec,
+                        const std::string& url,
+                        std::vector<unsigned char>& data);
+
+  // Description:
+  // Queue the tile, just loaded from the on-disk cache, for
+  // revalidation if it is expired
+  void CheckCachedTile(vtkMapTileSpecInternal& tileSpec);
+
+  // Description:
+  // Read the tile file at path into data. Returns false if the file is
+  // missing or does not hold a complete image, and removes it then.
+  bool ReadTileFile(const std::string& path,
+                    std::vector<unsigned char>& data);
+
+  // Description:
+  // Remove the tiles updated by the revalidator from the in-memory
+  // cache, so that they are loaded again
+  void ReleaseUpdatedTiles();
+
+  // Description:
+  // Decode the tile's image, recording the time taken. Returns false if
+  // the image could not be decoded.
+  bool DecodeTile(vtkMapTile *tile);
+
+  // Description:
+  // Print a snapshot of the metrics if MetricsLogInterval elapsed
+  // since the last one
+  void LogMetrics();
+
 protected:
+  // Finest zoom level served by OSM tile servers
+  static const int MaxZoom;
+
   char *MapTileExtension;
   char *MapTileServer;
   char *MapTileAttribution;
@@ -103,9 +421,45 @@ protected:
   double TileBorders[4];
 
   char *CacheDirectory;
-  std::map< int, std::map< int, std::map <int, vtkMapTile*> > > CachedTilesMap;
+  bool UsePackedTileStore;
+  vtkMapTileStorage *Storage;
+  vtkPackedTileStore *TileStore;  // of the storage
+  vtkMapTileFetcher *TileFetcher;
+  vtkTileSource *TileSource;
+  vtkHttpTileSource *DefaultTileSource;
+  vtkMapTileFailureCache *FailureCache;
+  vtkMapTileConcurrencyController *ConcurrencyController;
+  vtkMapTileService *TileService;
+  bool RevalidateTiles;
+  vtkMapTileRevalidator *Revalidator;  // of the storage
+  vtkTypeInt64 MaxDiskCacheSize;
+  int MaxDiskCacheTiles;
+  vtkMapTileIndexInternal<vtkMapTile*> CachedTilesIndex;
   std::vector<vtkMapTile*> CachedTiles;
 
+  vtkMapTileActorPool *ActorPool;
+  // Tiles whose actors are in the renderer, sorted by address
+  std::vector<vtkMapTile*> AttachedTiles;
+  bool UseTileAtlas;
+  vtkMapTileAtlas *TileAtlas;
+
+  int FallbackZoomLevels;
+  double PerspectiveTileScreenSize;
+  int MaxPerspectiveTiles;
+  vtkMapTileIndexInternal<vtkMapTile*> FallbackTilesIndex;
+  std::vector<vtkMapTile*> FallbackTiles;
+  vtkTexture *PlaceholderTexture;
+
+  vtkTypeInt64 MaxCacheSize;
+  vtkTypeInt64 CacheSize;
+  vtkTypeInt64 NumberOfEvictedTiles;
+  int NumberOfMissingTiles;
+  vtkMapTileMetrics *Metrics;
+  double MetricsLogInterval;
+  char *MetricsLogFileName;
+  double MetricsLogTime;
+  unsigned long TileAccessCounter;  // incremented once per view update
+
 private:
   vtkOsmLayer(const vtkOsmLayer&);    // Not implemented
   vtkOsmLayer& operator=(const vtkOsmLayer&); // Not implemented
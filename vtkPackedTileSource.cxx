@@ -0,0 +1,156 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkPackedTileSource.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkPackedTileSource.h"
+#include "vtkPackedTileStore.h"
+
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+
+#include <cstring>
+#include <sstream>
+
+vtkStandardNewMacro(vtkPackedTileSource)
+
+//----------------------------------------------------------------------------
+vtkPackedTileSource::vtkPackedTileSource()
+{
+  this->FileName = NULL;
+  this->TileStore = NULL;
+  this->OpenFailed = false;
+  this->Lock = vtkMutexLock::New();
+}
+
+//----------------------------------------------------------------------------
+vtkPackedTileSource::~vtkPackedTileSource()
+{
+  this->SetFileName(NULL);
+  this->Lock->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkPackedTileSource::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: "
+     << (this->FileName ? this->FileName : "(none)") << "\n"
+     << indent << "TileStore: " << this->TileStore << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkPackedTileSource::SetFileName(const char *fileName)
+{
+  this->Lock->Lock();
+  delete [] this->FileName;
+  this->FileName = NULL;
+  if (fileName)
+    {
+    this->FileName = new char[strlen(fileName) + 1];
+    strcpy(this->FileName, fileName);
+    }
+  if (this->TileStore)
+    {
+    this->TileStore->Delete();
+    this->TileStore = NULL;
+    }
+  this->OpenFailed = false;
+  this->Lock->Unlock();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkPackedTileStore *vtkPackedTileSource::GetTileStore()
+{
+  vtkPackedTileStore *store = this->OpenTileStore();
+  if (store)
+    {
+    store->UnRegister(this);
+    }
+  return store;
+}
+
+//----------------------------------------------------------------------------
+vtkPackedTileStore *vtkPackedTileSource::OpenTileStore()
+{
+  this->Lock->Lock();
+  if (!this->TileStore && !this->OpenFailed && this->FileName)
+    {
+    this->TileStore = vtkPackedTileStore::New();
+    if (!this->TileStore->Open(this->FileName))
+      {
+      // Not retried on every tile
+      vtkErrorMacro("Unable to open packed tile store " << this->FileName);
+      this->TileStore->Delete();
+      this->TileStore = NULL;
+      this->OpenFailed = true;
+      }
+    }
+  vtkPackedTileStore *store = this->TileStore;
+  if (store)
+    {
+    store->Register(this);
+    }
+  this->Lock->Unlock();
+  return store;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPackedTileSource::FetchTile(int zoom, int x, int y,
+                                    std::vector<unsigned char>& data,
+                                    long *httpStatus,
+                                    std::string *errorMessage,
+                                    vtkMapTileCacheInfo *vtkNotUsed(info))
+{
+  vtkPackedTileStore *store = this->OpenTileStore();
+  bool found = store && store->Get(zoom, x, y, data);
+  bool opened = store != NULL;
+  if (store)
+    {
+    store->UnRegister(this);
+    }
+  if (!found)
+    {
+    data.clear();
+    }
+
+  // Reported like the responses of tile servers
+  if (httpStatus)
+    {
+    *httpStatus = found ? 200 : 404;
+    }
+  if (errorMessage && !found)
+    {
+    this->Lock->Lock();
+    *errorMessage = !opened ? std::string("cannot open packed tile store") :
+      "no tile in " + std::string(this->FileName ? this->FileName : "");
+    this->Lock->Unlock();
+    }
+  return found;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPackedTileSource::GetTileUrl(int zoom, int x, int y)
+{
+  std::stringstream ss;
+  ss << "file://" << (this->FileName ? this->FileName : "")
+     << "#" << zoom << "/" << x << "/" << y;
+  return ss.str();
+}
+
+//----------------------------------------------------------------------------
+bool vtkPackedTileSource::IsLocal()
+{
+  return true;
+}
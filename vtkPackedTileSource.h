@@ -0,0 +1,74 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkPackedTileSource.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkPackedTileSource - map tiles from a vtkPackedTileStore file
+// .SECTION Description
+// Reads map tiles from a pack file written by vtkPackedTileStore, e.g.
+// the "tiles.pack" file of a vtkOsmLayer cache directory filled by
+// vtkMapTileSeeder. The store is opened on the first read.
+
+#ifndef __vtkPackedTileSource_h
+#define __vtkPackedTileSource_h
+
+#include "vtkTileSource.h"
+
+class vtkMutexLock;
+class vtkPackedTileStore;
+
+class VTKMAP_EXPORT vtkPackedTileSource : public vtkTileSource
+{
+public:
+  static vtkPackedTileSource *New();
+  vtkTypeMacro(vtkPackedTileSource, vtkTileSource)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Get/Set the path of the pack file. Setting it closes the store, once
+  // the reads in progress are done.
+  void SetFileName(const char *fileName);
+  vtkGetStringMacro(FileName);
+
+  // Description:
+  // The store tiles are read from, opened if needed, and valid until
+  // the file name is set. Returns NULL if it cannot be opened.
+  vtkPackedTileStore *GetTileStore();
+
+  virtual bool FetchTile(int zoom, int x, int y,
+                         std::vector<unsigned char>& data,
+                         long *httpStatus = NULL,
+                         std::string *errorMessage = NULL,
+                         vtkMapTileCacheInfo *cacheInfo = NULL);
+  virtual std::string GetTileUrl(int zoom, int x, int y);
+  virtual bool IsLocal();
+
+protected:
+  vtkPackedTileSource();
+  ~vtkPackedTileSource();
+
+  // Description:
+  // Like GetTileStore(), but with a reference for the caller, so that
+  // the store stays open while read, even if the file name is set
+  vtkPackedTileStore *OpenTileStore();
+
+  char *FileName;
+  vtkPackedTileStore *TileStore;
+  bool OpenFailed;
+  vtkMutexLock *Lock;
+
+private:
+  vtkPackedTileSource(const vtkPackedTileSource&);  // Not implemented
+  void operator=(const vtkPackedTileSource&); // Not implemented
+};
+
+#endif // __vtkPackedTileSource_h
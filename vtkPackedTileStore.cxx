@@ -0,0 +1,863 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkPackedTileStore.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkPackedTileStore.h"
+#include "vtkMapTileIndexInternal.h"
+
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtksys/Directory.hxx>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  const char PackMagic[8] = { 'V', 'T', 'K', 'M', 'A', 'P', 'P', 'K' };
+  const char IndexMagic[8] = { 'V', 'T', 'K', 'M', 'A', 'P', 'I', 'X' };
+  const vtkTypeUInt32 FormatVersion = 1;
+  const vtkTypeInt64 HeaderSize = 12;        // magic + version
+  const vtkTypeInt64 RecordHeaderSize = 12;  // key + length
+  const vtkTypeInt64 IndexRecordSize = 20;   // key + offset + length
+  const vtkTypeUInt32 MaxTileSize = 16 * 1024 * 1024;
+
+  struct TileEntry
+  {
+    vtkTypeInt64 Offset;  // of image bytes in pack file
+    vtkTypeUInt32 Length;
+    TileEntry() : Offset(0), Length(0) {}
+  };
+
+  typedef vtkMapTileIndexInternal<TileEntry> TileIndex;
+
+  //--------------------------------------------------------------------------
+  bool WriteHeader(FILE *fp, const char magic[8])
+  {
+    return fwrite(magic, 1, 8, fp) == 8 &&
+      fwrite(&FormatVersion, sizeof(FormatVersion), 1, fp) == 1;
+  }
+
+  //--------------------------------------------------------------------------
+  bool CheckHeader(FILE *fp, const char magic[8])
+  {
+    char buffer[8];
+    vtkTypeUInt32 version = 0;
+    return fseek(fp, 0, SEEK_SET) == 0 &&
+      fread(buffer, 1, 8, fp) == 8 && memcmp(buffer, magic, 8) == 0 &&
+      fread(&version, sizeof(version), 1, fp) == 1 &&
+      version == FormatVersion;
+  }
+
+  //--------------------------------------------------------------------------
+  bool TruncateFile(FILE *fp, vtkTypeInt64 size)
+  {
+    fflush(fp);
+#ifdef _WIN32
+    return _chsize_s(_fileno(fp), size) == 0;
+#else
+    return ftruncate(fileno(fp), static_cast<off_t>(size)) == 0;
+#endif
+  }
+
+  //--------------------------------------------------------------------------
+  vtkTypeInt64 FileSize(FILE *fp)
+  {
+    if (fseek(fp, 0, SEEK_END) != 0)
+      {
+      return -1;
+      }
+#ifdef _WIN32
+    return _ftelli64(fp);
+#else
+    return static_cast<vtkTypeInt64>(ftello(fp));
+#endif
+  }
+
+  //--------------------------------------------------------------------------
+  bool ReplaceFile(const std::string& from, const std::string& to)
+  {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(),
+                       MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+  }
+
+  //--------------------------------------------------------------------------
+  bool SeekFile(FILE *fp, vtkTypeInt64 offset)
+  {
+#ifdef _WIN32
+    return _fseeki64(fp, offset, SEEK_SET) == 0;
+#else
+    return fseeko(fp, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+  }
+}
+
+vtkStandardNewMacro(vtkPackedTileStore)
+
+//----------------------------------------------------------------------------
+class vtkPackedTileStore::vtkPackedTileStoreInternals
+{
+public:
+  std::string PackPath;
+  std::string IndexPath;
+  FILE *Pack;
+  FILE *Index;
+  vtkTypeInt64 PackSize;  // also the offset of the next record
+  vtkTypeInt64 IndexSize;
+  TileIndex Tiles;
+
+  // Read-only mapping of the pack file (not used on Windows)
+  const unsigned char *Map;
+  vtkTypeInt64 MapSize;
+  vtkTypeInt64 MapFailedSize;  // pack size when mapping last failed
+
+  vtkPackedTileStoreInternals()
+    : Pack(NULL), Index(NULL), PackSize(0), IndexSize(0), Map(NULL),
+      MapSize(0), MapFailedSize(0) {}
+};
+
+//----------------------------------------------------------------------------
+vtkPackedTileStore::vtkPackedTileStore()
+{
+  this->Internals = new vtkPackedTileStoreInternals;
+  this->Lock = vtkMutexLock::New();
+}
+
+//----------------------------------------------------------------------------
+vtkPackedTileStore::~vtkPackedTileStore()
+{
+  this->Close();
+  this->Lock->Delete();
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void vtkPackedTileStore::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "PackPath: " << this->Internals->PackPath << "\n"
+     << indent << "NumberOfTiles: " << this->Internals->Tiles.Size() << "\n"
+     << indent << "PackSize: " << this->Internals->PackSize << "\n"
+     << indent << "IndexSize: " << this->Internals->IndexSize
+     << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPackedTileStore::Open(const char *path)
+{
+  this->Lock->Lock();
+  this->CloseFiles();
+  this->Internals->PackPath = path;
+  this->Internals->IndexPath = this->Internals->PackPath + ".idx";
+  bool ok = this->OpenFiles();
+  if (!ok)
+    {
+    this->CloseFiles();
+    }
+  this->Lock->Unlock();
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+void vtkPackedTileStore::Close()
+{
+  this->Lock->Lock();
+  this->CloseFiles();
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+// Opens pack file (creating it if needed) and loads index.
+// Must be called with Lock held.
+bool vtkPackedTileStore::OpenFiles()
+{
+  vtkPackedTileStoreInternals *internals = this->Internals;
+  internals->Pack = fopen(internals->PackPath.c_str(), "r+b");
+  if (!internals->Pack)
+    {
+    internals->Pack = fopen(internals->PackPath.c_str(), "w+b");
+    if (!internals->Pack || !WriteHeader(internals->Pack, PackMagic))
+      {
+      vtkErrorMacro("Cannot create tile pack file " << internals->PackPath);
+      return false;
+      }
+    fflush(internals->Pack);
+    }
+  else if (!CheckHeader(internals->Pack, PackMagic))
+    {
+    vtkErrorMacro("Not a tile pack file: " << internals->PackPath);
+    return false;
+    }
+  internals->PackSize = FileSize(internals->Pack);
+
+  if (!this->LoadIndex())
+    {
+    return false;
+    }
+  internals->IndexSize = FileSize(internals->Index);
+  this->MapPack(internals->PackSize);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Must be called with Lock held.
+void vtkPackedTileStore::CloseFiles()
+{
+  this->UnmapPack();
+  if (this->Internals->Pack)
+    {
+    fclose(this->Internals->Pack);
+    this->Internals->Pack = NULL;
+    }
+  if (this->Internals->Index)
+    {
+    fclose(this->Internals->Index);
+    this->Internals->Index = NULL;
+    }
+  this->Internals->Tiles.Clear();
+  this->Internals->PackSize = 0;
+  this->Internals->IndexSize = 0;
+  this->Internals->MapFailedSize = 0;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPackedTileStore::IsOpen()
+{
+  return this->Internals->Pack != NULL;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPackedTileStore::Contains(int zoom, int x, int y)
+{
+  this->Lock->Lock();
+  bool found = this->Internals->Tiles.Find(
+    TileIndex::MakeKey(zoom, x, y)) != NULL;
+  this->Lock->Unlock();
+  return found;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPackedTileStore::Get(int zoom, int x, int y,
+                             std::vector<unsigned char>& data)
+{
+  this->Lock->Lock();
+  TileEntry *entry = this->Internals->Tiles.Find(
+    TileIndex::MakeKey(zoom, x, y));
+  if (!entry)
+    {
+    this->Lock->Unlock();
+    return false;
+    }
+
+  data.resize(entry->Length);
+  bool ok = this->ReadPack(entry->Offset, entry->Length, &data[0]);
+  this->Lock->Unlock();
+
+  if (!ok)
+    {
+    data.clear();
+    }
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPackedTileStore::Put(int zoom, int x, int y,
+                             const unsigned char *data, std::size_t length)
+{
+  if (length == 0 || length > MaxTileSize)
+    {
+    vtkErrorMacro("Invalid tile size " << length);
+    return false;
+    }
+
+  this->Lock->Lock();
+  vtkPackedTileStoreInternals *internals = this->Internals;
+  if (!internals->Pack)
+    {
+    this->Lock->Unlock();
+    vtkErrorMacro("Tile store is not open");
+    return false;
+    }
+
+  bool ok = this->AppendPackRecord(TileIndex::MakeKey(zoom, x, y), data,
+                                   static_cast<vtkTypeUInt32>(length));
+  this->Lock->Unlock();
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPackedTileStore::Remove(int zoom, int x, int y)
+{
+  this->Lock->Lock();
+  vtkTypeUInt64 key = TileIndex::MakeKey(zoom, x, y);
+  bool ok = this->Internals->Pack && this->Internals->Tiles.Find(key) &&
+    this->AppendPackRecord(key, NULL, 0);
+  this->Lock->Unlock();
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+struct sortKeysByOffset
+{
+  inline bool operator() (const std::pair<vtkTypeInt64, vtkTypeUInt64>& a,
+                          const std::pair<vtkTypeInt64, vtkTypeUInt64>& b)
+  {
+    return a.first < b.first;
+  }
+};
+
+//----------------------------------------------------------------------------
+bool vtkPackedTileStore::Compact()
+{
+  this->Lock->Lock();
+  vtkPackedTileStoreInternals *internals = this->Internals;
+  if (!internals->Pack)
+    {
+    this->Lock->Unlock();
+    vtkErrorMacro("Tile store is not open");
+    return false;
+    }
+
+  std::string packPath = internals->PackPath;
+  std::string indexPath = internals->IndexPath;
+  std::string packTemp = packPath + ".tmp";
+  std::string indexTemp = indexPath + ".tmp";
+  FILE *pack = fopen(packTemp.c_str(), "wb");
+  FILE *index = fopen(indexTemp.c_str(), "wb");
+  bool ok = pack && index && WriteHeader(pack, PackMagic) &&
+    WriteHeader(index, IndexMagic);
+
+  // Copy tiles in pack order, so tiles stored together stay together
+  std::vector<vtkTypeUInt64> keys;
+  internals->Tiles.GetKeys(keys);
+  std::vector<std::pair<vtkTypeInt64, vtkTypeUInt64> > order;
+  order.reserve(keys.size());
+  for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+    order.push_back(
+      std::make_pair(internals->Tiles.Find(keys[i])->Offset, keys[i]));
+    }
+  std::sort(order.begin(), order.end(), sortKeysByOffset());
+
+  std::vector<unsigned char> data;
+  vtkTypeInt64 position = HeaderSize;
+  for (std::size_t i = 0; ok && i < order.size(); ++i)
+    {
+    vtkTypeUInt64 key = order[i].second;
+    TileEntry *entry = internals->Tiles.Find(key);
+    vtkTypeInt64 offset = position + RecordHeaderSize;
+    data.resize(entry->Length);
+    ok = this->ReadPack(entry->Offset, entry->Length, &data[0]) &&
+      fwrite(&key, sizeof(key), 1, pack) == 1 &&
+      fwrite(&entry->Length, sizeof(entry->Length), 1, pack) == 1 &&
+      fwrite(&data[0], 1, data.size(), pack) == data.size() &&
+      fwrite(&key, sizeof(key), 1, index) == 1 &&
+      fwrite(&offset, sizeof(offset), 1, index) == 1 &&
+      fwrite(&entry->Length, sizeof(entry->Length), 1, index) == 1;
+    position = offset + entry->Length;
+    }
+  ok = (!pack || fclose(pack) == 0) && ok;
+  ok = (!index || fclose(index) == 0) && ok;
+  if (!ok)
+    {
+    remove(packTemp.c_str());
+    remove(indexTemp.c_str());
+    this->Lock->Unlock();
+    vtkErrorMacro("Failed compacting tile pack " << packPath);
+    return false;
+    }
+
+  // Swap in the new files. The old index goes first: if interrupted,
+  // whichever pack file remains is re-indexed by the next Open().
+  this->CloseFiles();
+  ok = remove(indexPath.c_str()) == 0 &&
+    ReplaceFile(packTemp, packPath) && ReplaceFile(indexTemp, indexPath);
+  if (!ok)
+    {
+    vtkErrorMacro("Failed replacing tile pack " << packPath);
+    }
+  if (!this->OpenFiles())
+    {
+    this->CloseFiles();
+    ok = false;
+    }
+  this->Lock->Unlock();
+
+  vtkDebugMacro("Compacted " << packPath << " to " << position << " bytes");
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+int vtkPackedTileStore::ImportDirectory(const char *directory,
+                                        const char *extension)
+{
+  vtksys::Directory dir;
+  if (!this->IsOpen() || !dir.Load(directory))
+    {
+    vtkErrorMacro("Cannot import tiles from " << directory);
+    return -1;
+    }
+
+  std::string suffix = std::string(".") + extension;
+  int count = 0;
+  std::vector<unsigned char> data;
+  for (unsigned long i = 0; i < dir.GetNumberOfFiles(); ++i)
+    {
+    std::string name = dir.GetFile(i);
+    int zoom, x, y;
+    char tail;
+    if (name.size() <= suffix.size() ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0 ||
+        sscanf(name.c_str(), "%d-%d-%d%c", &zoom, &x, &y, &tail) != 4 ||
+        tail != '.')
+      {
+      continue;
+      }
+    if (this->Contains(zoom, x, y))
+      {
+      continue;
+      }
+
+    std::string path = std::string(directory) + "/" + name;
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp)
+      {
+      continue;
+      }
+    vtkTypeInt64 size = FileSize(fp);
+    bool ok = size > 0 && size <= MaxTileSize && fseek(fp, 0, SEEK_SET) == 0;
+    if (ok)
+      {
+      data.resize(static_cast<std::size_t>(size));
+      ok = fread(&data[0], 1, data.size(), fp) == data.size();
+      }
+    fclose(fp);
+
+    // Skip truncated or otherwise invalid image files
+    if (ok && IsCompleteImage(&data[0], data.size()) &&
+        this->Put(zoom, x, y, &data[0], data.size()))
+      {
+      ++count;
+      }
+    }
+
+  return count;
+}
+
+//----------------------------------------------------------------------------
+int vtkPackedTileStore::ExportDirectory(const char *directory,
+                                        const char *extension)
+{
+  if (!this->IsOpen())
+    {
+    vtkErrorMacro("Tile store is not open");
+    return -1;
+    }
+  if (!vtksys::SystemTools::FileIsDirectory(directory) &&
+      !vtksys::SystemTools::MakeDirectory(directory))
+    {
+    vtkErrorMacro("Cannot create directory " << directory);
+    return -1;
+    }
+
+  std::vector<vtkTypeUInt64> keys;
+  this->Lock->Lock();
+  this->Internals->Tiles.GetKeys(keys);
+  this->Lock->Unlock();
+
+  int count = 0;
+  std::stringstream ss;
+  std::vector<unsigned char> data;
+  for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+    int zoom, x, y;
+    TileIndex::SplitKey(keys[i], zoom, x, y);
+    if (!this->Get(zoom, x, y, data))
+      {
+      continue;
+      }
+
+    ss.str("");
+    ss << directory << "/" << zoom << "-" << x << "-" << y
+       << "." << extension;
+    FILE *fp = fopen(ss.str().c_str(), "wb");
+    if (!fp)
+      {
+      vtkErrorMacro("Cannot open file " << ss.str());
+      return -1;
+      }
+    bool ok = fwrite(&data[0], 1, data.size(), fp) == data.size();
+    ok = (fclose(fp) == 0) && ok;
+    count += ok ? 1 : 0;
+    }
+
+  return count;
+}
+
+//----------------------------------------------------------------------------
+int vtkPackedTileStore::GetNumberOfTiles()
+{
+  this->Lock->Lock();
+  int count = static_cast<int>(this->Internals->Tiles.Size());
+  this->Lock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkPackedTileStore::GetPackSize()
+{
+  this->Lock->Lock();
+  vtkTypeInt64 size = this->Internals->PackSize;
+  this->Lock->Unlock();
+  return size;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkPackedTileStore::GetIndexSize()
+{
+  this->Lock->Lock();
+  vtkTypeInt64 size = this->Internals->IndexSize;
+  this->Lock->Unlock();
+  return size;
+}
+
+//----------------------------------------------------------------------------
+void vtkPackedTileStore::GetTileSizes(std::vector<vtkTypeUInt64>& keys,
+                                      std::vector<vtkTypeUInt32>& sizes)
+{
+  this->Lock->Lock();
+  std::size_t first = keys.size();
+  this->Internals->Tiles.GetKeys(keys);
+  for (std::size_t i = first; i < keys.size(); ++i)
+    {
+    sizes.push_back(this->Internals->Tiles.Find(keys[i])->Length);
+    }
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+bool vtkPackedTileStore::IsImageData(const unsigned char *data,
+                                     std::size_t length)
+{
+  static const unsigned char pngMagic[8] =
+    { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+  static const unsigned char jpegMagic[3] = { 0xff, 0xd8, 0xff };
+  if (length >= 8 && memcmp(data, pngMagic, 8) == 0)
+    {
+    return true;
+    }
+  return length >= 3 && memcmp(data, jpegMagic, 3) == 0;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPackedTileStore::IsCompleteImage(const unsigned char *data,
+                                         std::size_t length)
+{
+  if (!IsImageData(data, length))
+    {
+    return false;
+    }
+
+  if (data[0] == 0x89)
+    {
+    // Empty IEND chunk: zero length, type, CRC
+    static const unsigned char pngEnd[12] =
+      { 0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xae, 0x42, 0x60, 0x82 };
+    return length >= 8 + 12 &&
+      memcmp(data + length - 12, pngEnd, 12) == 0;
+    }
+
+  // EOI marker, possibly followed by a few bytes of padding
+  std::size_t start = length > 32 ? length - 32 : 3;
+  for (std::size_t i = length - 1; i > start; --i)
+    {
+    if (data[i - 1] == 0xff && data[i] == 0xd9)
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+// Loads index file into memory. Must be called with Lock held.
+bool vtkPackedTileStore::LoadIndex()
+{
+  vtkPackedTileStoreInternals *internals = this->Internals;
+  internals->Tiles.Clear();
+
+  internals->Index = fopen(internals->IndexPath.c_str(), "r+b");
+  if (!internals->Index || !CheckHeader(internals->Index, IndexMagic))
+    {
+    // Missing or unreadable index: rebuild from pack file
+    if (internals->Index)
+      {
+      fclose(internals->Index);
+      }
+    internals->Index = fopen(internals->IndexPath.c_str(), "w+b");
+    if (!internals->Index || !WriteHeader(internals->Index, IndexMagic))
+      {
+      vtkErrorMacro("Cannot create tile index " << internals->IndexPath);
+      return false;
+      }
+    return this->RecoverIndex(HeaderSize);
+    }
+
+  // Read fixed-size records
+  vtkTypeInt64 indexedEnd = HeaderSize;
+  vtkTypeInt64 validSize = HeaderSize;
+  vtkTypeUInt64 key;
+  vtkTypeInt64 offset;
+  vtkTypeUInt32 length;
+  while (fread(&key, sizeof(key), 1, internals->Index) == 1 &&
+         fread(&offset, sizeof(offset), 1, internals->Index) == 1 &&
+         fread(&length, sizeof(length), 1, internals->Index) == 1)
+    {
+    if (offset < HeaderSize + RecordHeaderSize ||
+        offset + length > internals->PackSize)
+      {
+      // Index refers past the pack file; discard the rest
+      break;
+      }
+    if (length == 0)
+      {
+      // Removed tile
+      internals->Tiles.Erase(key);
+      }
+    else
+      {
+      TileEntry entry;
+      entry.Offset = offset;
+      entry.Length = length;
+      internals->Tiles.Insert(key, entry);
+      }
+    indexedEnd = offset + length > indexedEnd ? offset + length : indexedEnd;
+    validSize += IndexRecordSize;
+    }
+
+  // Drop any partial or invalid trailing index records, so that
+  // new records are appended at a record boundary
+  if (FileSize(internals->Index) != validSize)
+    {
+    TruncateFile(internals->Index, validSize);
+    }
+
+  // Pick up records appended to the pack but not yet indexed
+  return this->RecoverIndex(indexedEnd);
+}
+
+//----------------------------------------------------------------------------
+// Scans pack records starting at the given offset and adds them to the
+// index. A partial record at the end of the pack file is truncated.
+// Must be called with Lock held.
+bool vtkPackedTileStore::RecoverIndex(vtkTypeInt64 start)
+{
+  vtkPackedTileStoreInternals *internals = this->Internals;
+  vtkTypeInt64 position = start;
+  int recovered = 0;
+  vtkTypeUInt64 key;
+  vtkTypeUInt32 length;
+  while (position + RecordHeaderSize <= internals->PackSize)
+    {
+    if (!SeekFile(internals->Pack, position) ||
+        fread(&key, sizeof(key), 1, internals->Pack) != 1 ||
+        fread(&length, sizeof(length), 1, internals->Pack) != 1 ||
+        length > MaxTileSize ||
+        position + RecordHeaderSize + length > internals->PackSize)
+      {
+      break;
+      }
+    vtkTypeInt64 offset = position + RecordHeaderSize;
+    if (length == 0)
+      {
+      // Removed tile
+      internals->Tiles.Erase(key);
+      }
+    else
+      {
+      TileEntry entry;
+      entry.Offset = offset;
+      entry.Length = length;
+      internals->Tiles.Insert(key, entry);
+      }
+    if (!this->AppendIndexRecord(key, offset, length))
+      {
+      return false;
+      }
+    position = offset + length;
+    ++recovered;
+    }
+
+  if (position < internals->PackSize)
+    {
+    vtkWarningMacro("Discarding " << (internals->PackSize - position)
+                    << " bytes of incomplete data from "
+                    << internals->PackPath);
+    TruncateFile(internals->Pack, position);
+    internals->PackSize = position;
+    }
+  if (recovered > 0)
+    {
+    vtkDebugMacro("Recovered " << recovered << " tiles into index");
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Appends a record to the pack file, then to the index file, and updates
+// the in-memory index. A zero length marks the tile as removed. A crash
+// between the two writes is repaired by RecoverIndex() on the next Open().
+// Must be called with Lock held.
+bool vtkPackedTileStore::AppendPackRecord(vtkTypeUInt64 key,
+                                          const unsigned char *data,
+                                          vtkTypeUInt32 length)
+{
+  vtkPackedTileStoreInternals *internals = this->Internals;
+  vtkTypeInt64 offset = internals->PackSize + RecordHeaderSize;
+  bool ok = SeekFile(internals->Pack, internals->PackSize) &&
+    fwrite(&key, sizeof(key), 1, internals->Pack) == 1 &&
+    fwrite(&length, sizeof(length), 1, internals->Pack) == 1 &&
+    (length == 0 || fwrite(data, 1, length, internals->Pack) == length) &&
+    fflush(internals->Pack) == 0;
+  if (!ok)
+    {
+    // Drop partial record
+    TruncateFile(internals->Pack, internals->PackSize);
+    vtkErrorMacro("Failed writing to tile pack " << internals->PackPath);
+    return false;
+    }
+
+  internals->PackSize = offset + length;
+  if (length == 0)
+    {
+    internals->Tiles.Erase(key);
+    }
+  else
+    {
+    TileEntry entry;
+    entry.Offset = offset;
+    entry.Length = length;
+    internals->Tiles.Insert(key, entry);
+    }
+  return this->AppendIndexRecord(key, offset, length);
+}
+
+//----------------------------------------------------------------------------
+// Must be called with Lock held.
+bool vtkPackedTileStore::AppendIndexRecord(vtkTypeUInt64 key,
+                                           vtkTypeInt64 offset,
+                                           vtkTypeUInt32 length)
+{
+  FILE *fp = this->Internals->Index;
+  bool ok = fseek(fp, 0, SEEK_END) == 0 &&
+    fwrite(&key, sizeof(key), 1, fp) == 1 &&
+    fwrite(&offset, sizeof(offset), 1, fp) == 1 &&
+    fwrite(&length, sizeof(length), 1, fp) == 1 &&
+    fflush(fp) == 0;
+  if (!ok)
+    {
+    vtkErrorMacro("Failed writing to tile index "
+                  << this->Internals->IndexPath);
+    return false;
+    }
+  this->Internals->IndexSize += IndexRecordSize;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Must be called with Lock held.
+bool vtkPackedTileStore::MapPack(vtkTypeInt64 size)
+{
+  // On failure, the pack is read from the file until it has doubled
+  this->Internals->MapFailedSize = size;
+#ifdef _WIN32
+  return false;
+#else
+  this->UnmapPack();
+  if (size <= 0)
+    {
+    return false;
+    }
+  void *address = mmap(NULL, static_cast<std::size_t>(size), PROT_READ,
+                       MAP_SHARED, fileno(this->Internals->Pack), 0);
+  if (address == MAP_FAILED)
+    {
+    vtkWarningMacro("Cannot memory-map " << this->Internals->PackPath
+                    << ", falling back to file reads");
+    return false;
+    }
+  this->Internals->Map = static_cast<const unsigned char*>(address);
+  this->Internals->MapSize = size;
+  this->Internals->MapFailedSize = 0;
+  return true;
+#endif
+}
+
+//----------------------------------------------------------------------------
+// Must be called with Lock held.
+void vtkPackedTileStore::UnmapPack()
+{
+#ifndef _WIN32
+  if (this->Internals->Map)
+    {
+    munmap(const_cast<unsigned char*>(this->Internals->Map),
+           static_cast<std::size_t>(this->Internals->MapSize));
+    }
+#endif
+  this->Internals->Map = NULL;
+  this->Internals->MapSize = 0;
+}
+
+//----------------------------------------------------------------------------
+// Copies bytes from the pack file, preferring the memory mapping. Tiles
+// appended since the pack was mapped are read from the file, and the
+// pack is mapped again once it has doubled, so frequent appends do not
+// remap it on every read. The same goes for a pack that failed to map.
+// Must be called with Lock held.
+bool vtkPackedTileStore::ReadPack(vtkTypeInt64 offset, std::size_t length,
+                                  unsigned char *buffer)
+{
+  vtkPackedTileStoreInternals *internals = this->Internals;
+  if (offset + static_cast<vtkTypeInt64>(length) > internals->MapSize &&
+      internals->PackSize >= 2 * internals->MapSize &&
+      internals->PackSize >= 2 * internals->MapFailedSize)
+    {
+    this->MapPack(internals->PackSize);
+    }
+  if (internals->Map &&
+      offset + static_cast<vtkTypeInt64>(length) <= internals->MapSize)
+    {
+    memcpy(buffer, internals->Map + offset, length);
+    return true;
+    }
+
+  return SeekFile(internals->Pack, offset) &&
+    fread(buffer, 1, length, internals->Pack) == length;
+}
@@ -0,0 +1,156 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkPackedTileStore.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkPackedTileStore - single-file on-disk map-tile store
+// .SECTION Description
+// Stores encoded map-tile images (png/jpg bytes) in one append-only
+// pack file, with a small companion index file of fixed-size records
+// (key, offset, length). The index is loaded into memory on Open(), so
+// checking whether a tile is present never touches the file system,
+// and tile data is read from a read-only memory mapping of the pack
+// file. Tiles appended since the mapping are read from the file, until
+// the pack has doubled and is mapped again. If the index is missing or
+// behind the pack file (e.g. after a crash), it is rebuilt by scanning
+// the self-describing pack records.
+//
+// Removing a tile appends a zero-length record to both files; the
+// space is reclaimed by Compact().
+//
+// Tiles are keyed by their OSM (zoom, x, y) indices, i.e. the same
+// numbers used in the per-file cache names "<zoom>-<x>-<y>.<ext>".
+// Both files use native byte order. All methods are thread safe.
+
+#ifndef __vtkPackedTileStore_h
+#define __vtkPackedTileStore_h
+
+#include "vtkmap_export.h"
+#include <vtkObject.h>
+
+#include <string>
+#include <vector>
+
+class vtkMutexLock;
+
+class VTKMAP_EXPORT vtkPackedTileStore : public vtkObject
+{
+public:
+  static vtkPackedTileStore *New();
+  vtkTypeMacro(vtkPackedTileStore, vtkObject)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Open (creating if needed) the store at the given path. The pack
+  // file is <path> and the index file is <path>.idx.
+  // Returns true on success.
+  bool Open(const char *path);
+  void Close();
+  bool IsOpen();
+
+  // Description:
+  // Check if tile is in the store. Does not perform any I/O.
+  bool Contains(int zoom, int x, int y);
+
+  // Description:
+  // Copy the encoded image bytes of the tile into data.
+  // Returns false if the tile is not in the store.
+  bool Get(int zoom, int x, int y, std::vector<unsigned char>& data);
+
+  // Description:
+  // Append the encoded image bytes of the tile. A tile that is already
+  // present is superseded; the old bytes stay in the pack file.
+  bool Put(int zoom, int x, int y, const unsigned char *data,
+           std::size_t length);
+
+  // Description:
+  // Remove the tile from the store. The space it used in the pack file
+  // is reclaimed by Compact(). Returns false if the tile is not present.
+  bool Remove(int zoom, int x, int y);
+
+  // Description:
+  // Rewrite the pack and index files with only the current tiles,
+  // reclaiming space from removed and superseded tiles.
+  bool Compact();
+
+  // Description:
+  // Import all "<zoom>-<x>-<y>.<extension>" files from a per-file cache
+  // directory (as written by vtkOsmLayer). Tiles already in the store
+  // are skipped. Returns the number of tiles imported, or -1 on error.
+  int ImportDirectory(const char *directory, const char *extension);
+
+  // Description:
+  // Export all tiles to a per-file cache directory, using the
+  // "<zoom>-<x>-<y>.<extension>" layout. Returns the number of tiles
+  // exported, or -1 on error.
+  int ExportDirectory(const char *directory, const char *extension);
+
+  // Description:
+  // Number of tiles in the store
+  int GetNumberOfTiles();
+
+  // Description:
+  // Size of the pack file in bytes
+  vtkTypeInt64 GetPackSize();
+
+  // Description:
+  // Size of the index file in bytes
+  vtkTypeInt64 GetIndexSize();
+
+  // Description:
+  // Append the key (as made by vtkMapTileIndexInternal::MakeKey())
+  // and encoded size of every tile in the store
+  void GetTileSizes(std::vector<vtkTypeUInt64>& keys,
+                    std::vector<vtkTypeUInt32>& sizes);
+
+  // Description:
+  // Bytes used per tile in the pack and index files, in addition
+  // to the encoded image bytes
+  static const int RecordOverhead = 32;
+
+  // Description:
+  // Return true if data starts with PNG or JPEG magic bytes
+  static bool IsImageData(const unsigned char *data, std::size_t length);
+
+  // Description:
+  // Return true if data is PNG or JPEG data that is not truncated:
+  // besides the magic bytes, it ends with the PNG IEND chunk or the
+  // JPEG end-of-image marker. Does not decode the image.
+  static bool IsCompleteImage(const unsigned char *data, std::size_t length);
+
+protected:
+  vtkPackedTileStore();
+  ~vtkPackedTileStore();
+
+  bool OpenFiles();
+  void CloseFiles();
+  bool LoadIndex();
+  bool RecoverIndex(vtkTypeInt64 start);
+  bool AppendIndexRecord(vtkTypeUInt64 key, vtkTypeInt64 offset,
+                         vtkTypeUInt32 length);
+  bool AppendPackRecord(vtkTypeUInt64 key, const unsigned char *data,
+                        vtkTypeUInt32 length);
+  bool MapPack(vtkTypeInt64 size);
+  void UnmapPack();
+  bool ReadPack(vtkTypeInt64 offset, std::size_t length,
+                unsigned char *buffer);
+
+  class vtkPackedTileStoreInternals;
+  vtkPackedTileStoreInternals *Internals;
+  vtkMutexLock *Lock;
+
+private:
+  vtkPackedTileStore(const vtkPackedTileStore&);  // Not implemented
+  void operator=(const vtkPackedTileStore&); // Not implemented
+};
+
+#endif // __vtkPackedTileStore_h
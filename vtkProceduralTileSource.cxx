@@ -0,0 +1,159 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkProceduralTileSource.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkProceduralTileSource.h"
+
+#include <vtkAtomic.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPNGWriter.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <sstream>
+
+vtkStandardNewMacro(vtkProceduralTileSource)
+
+//----------------------------------------------------------------------------
+class vtkProceduralTileSource::vtkProceduralTileSourceInternals
+{
+public:
+  vtkAtomic<vtkTypeInt64> GeneratedTiles;
+};
+
+//----------------------------------------------------------------------------
+vtkProceduralTileSource::vtkProceduralTileSource()
+{
+  this->TileSize = 256;
+  this->MaxZoom = 19;
+  this->Latency = 0.0;
+  this->Local = true;
+  this->Internals = new vtkProceduralTileSourceInternals;
+  this->Internals->GeneratedTiles = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkProceduralTileSource::~vtkProceduralTileSource()
+{
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void vtkProceduralTileSource::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "TileSize: " << this->TileSize << "\n"
+     << indent << "MaxZoom: " << this->MaxZoom << "\n"
+     << indent << "Latency: " << this->Latency << "\n"
+     << indent << "NumberOfGeneratedTiles: "
+     << this->GetNumberOfGeneratedTiles() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkProceduralTileSource::GetNumberOfGeneratedTiles()
+{
+  return this->Internals->GeneratedTiles;
+}
+
+//----------------------------------------------------------------------------
+bool vtkProceduralTileSource::FetchTile(int zoom, int x, int y,
+                                        std::vector<unsigned char>& data,
+                                        long *httpStatus,
+                                        std::string *errorMessage,
+                                        vtkMapTileCacheInfo *vtkNotUsed(info))
+{
+  data.clear();
+  int count = zoom >= 0 && zoom <= this->MaxZoom ? 1 << zoom : 0;
+  if (x < 0 || x >= count || y < 0 || y >= count)
+    {
+    if (httpStatus)
+      {
+      *httpStatus = 404;
+      }
+    if (errorMessage)
+      {
+      *errorMessage = "no tile " + this->GetTileUrl(zoom, x, y);
+      }
+    return false;
+    }
+
+  if (this->Latency > 0.0)
+    {
+    vtksys::SystemTools::Delay(
+      static_cast<unsigned int>(1000.0 * this->Latency + 0.5));
+    }
+
+  // Checkerboard of 8x8 squares, in two shades of a color made from
+  // the tile indices, inside a dark border
+  unsigned int hash = static_cast<unsigned int>(zoom) * 73856093u ^
+    static_cast<unsigned int>(x) * 19349663u ^
+    static_cast<unsigned int>(y) * 83492791u;
+  unsigned char color[3] =
+    {
+    static_cast<unsigned char>(64 + (hash & 0x7f)),
+    static_cast<unsigned char>(64 + ((hash >> 8) & 0x7f)),
+    static_cast<unsigned char>(64 + ((hash >> 16) & 0x7f))
+    };
+  int size = this->TileSize;
+  int square = size >= 8 ? size / 8 : 1;
+
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(size, size, 1);
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
+  unsigned char *pixel =
+    static_cast<unsigned char*>(image->GetScalarPointer());
+  for (int j = 0; j < size; ++j)
+    {
+    for (int i = 0; i < size; ++i, pixel += 3)
+      {
+      bool border = i == 0 || j == 0 || i == size - 1 || j == size - 1;
+      bool dark = ((i / square) + (j / square)) % 2 != 0;
+      for (int c = 0; c < 3; ++c)
+        {
+        pixel[c] = border ? 32 : (dark ? color[c] / 2 : color[c]);
+        }
+      }
+    }
+
+  vtkNew<vtkPNGWriter> writer;
+  writer->SetInputData(image.GetPointer());
+  writer->WriteToMemoryOn();
+  writer->Write();
+  vtkUnsignedCharArray *result = writer->GetResult();
+  unsigned char *bytes = result->GetPointer(0);
+  data.assign(bytes, bytes + result->GetNumberOfTuples());
+  ++this->Internals->GeneratedTiles;
+
+  if (httpStatus)
+    {
+    *httpStatus = 200;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkProceduralTileSource::GetTileUrl(int zoom, int x, int y)
+{
+  std::stringstream ss;
+  ss << "procedural://" << zoom << "/" << x << "/" << y << ".png";
+  return ss.str();
+}
+
+//----------------------------------------------------------------------------
+bool vtkProceduralTileSource::IsLocal()
+{
+  return this->Local;
+}
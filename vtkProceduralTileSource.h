@@ -0,0 +1,90 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkProceduralTileSource.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkProceduralTileSource - generated map tiles
+// .SECTION Description
+// Generates PNG map tiles in process: a checkerboard, colored after
+// the tile indices, with a border marking the tile edges. The same
+// tile always has the same bytes, so the whole tile pipeline can be
+// tested and benchmarked deterministically without a network. A delay
+// can be added to each tile to stand in for a tile server, which can
+// also be treated as remote, so that tiles go through the disk cache.
+
+#ifndef __vtkProceduralTileSource_h
+#define __vtkProceduralTileSource_h
+
+#include "vtkTileSource.h"
+
+class VTKMAP_EXPORT vtkProceduralTileSource : public vtkTileSource
+{
+public:
+  static vtkProceduralTileSource *New();
+  vtkTypeMacro(vtkProceduralTileSource, vtkTileSource)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Get/Set the width and height of tiles in pixels. Default is 256.
+  vtkGetMacro(TileSize, int);
+  vtkSetClampMacro(TileSize, int, 1, 4096);
+
+  // Description:
+  // Get/Set the highest zoom level with tiles. Tiles past it are
+  // missing, with status 404. Default is 19.
+  vtkGetMacro(MaxZoom, int);
+  vtkSetClampMacro(MaxZoom, int, 0, 30);
+
+  // Description:
+  // Get/Set the time, in seconds, added to the generation of each tile.
+  // Default is 0.
+  vtkGetMacro(Latency, double);
+  vtkSetClampMacro(Latency, double, 0.0, VTK_DOUBLE_MAX);
+
+  // Description:
+  // Get/Set whether the source is treated as local (see
+  // vtkTileSource::IsLocal()). Turn off to have the tiles cached on
+  // disk like those of a tile server. Default is on.
+  vtkGetMacro(Local, bool);
+  vtkSetMacro(Local, bool);
+  vtkBooleanMacro(Local, bool);
+
+  // Description:
+  // Number of tiles generated
+  vtkTypeInt64 GetNumberOfGeneratedTiles();
+
+  virtual bool FetchTile(int zoom, int x, int y,
+                         std::vector<unsigned char>& data,
+                         long *httpStatus = NULL,
+                         std::string *errorMessage = NULL,
+                         vtkMapTileCacheInfo *cacheInfo = NULL);
+  virtual std::string GetTileUrl(int zoom, int x, int y);
+  virtual bool IsLocal();
+
+protected:
+  vtkProceduralTileSource();
+  ~vtkProceduralTileSource();
+
+  int TileSize;
+  int MaxZoom;
+  double Latency;
+  bool Local;
+
+  class vtkProceduralTileSourceInternals;
+  vtkProceduralTileSourceInternals *Internals;
+
+private:
+  vtkProceduralTileSource(const vtkProceduralTileSource&);  // Not implemented
+  void operator=(const vtkProceduralTileSource&); // Not implemented
+};
+
+#endif // __vtkProceduralTileSource_h
@@ -0,0 +1,88 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkTileSource.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkTileSource.h"
+
+#include <sstream>
+
+//----------------------------------------------------------------------------
+vtkTileSource::vtkTileSource()
+{
+}
+
+//----------------------------------------------------------------------------
+vtkTileSource::~vtkTileSource()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkTileSource::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Local: " << this->IsLocal() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkTileSource::IsLocal()
+{
+  return false;
+}
+
+//----------------------------------------------------------------------------
+void vtkTileSource::GetHosts(std::vector<std::string>& vtkNotUsed(hosts))
+{
+}
+
+//----------------------------------------------------------------------------
+std::string vtkTileSource::ExpandTemplate(const std::string& pattern,
+                                          int zoom, int x, int y)
+{
+  std::stringstream ss;
+  std::string::size_type pos = 0;
+  while (pos < pattern.size())
+    {
+    std::string::size_type start = pattern.find('{', pos);
+    if (start == std::string::npos)
+      {
+      break;
+      }
+    ss << pattern.substr(pos, start - pos);
+    if (pattern.compare(start, 3, "{z}") == 0)
+      {
+      ss << zoom;
+      }
+    else if (pattern.compare(start, 3, "{x}") == 0)
+      {
+      ss << x;
+      }
+    else if (pattern.compare(start, 3, "{y}") == 0)
+      {
+      ss << y;
+      }
+    else
+      {
+      // Not ours, e.g. {s} of vtkHttpTileSource
+      ss << '{';
+      pos = start + 1;
+      continue;
+      }
+    pos = start + 3;
+    }
+  if (pos < pattern.size())
+    {
+    ss << pattern.substr(pos);
+    }
+  return ss.str();
+}
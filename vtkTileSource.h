@@ -0,0 +1,88 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkTileSource.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkTileSource - where a vtkOsmLayer gets its map tiles from
+// .SECTION Description
+// Abstract interface for reading encoded map-tile images, identified by
+// their OSM (zoom, x, y) indices. vtkOsmLayer downloads the tiles
+// missing from its cache through its tile source, which by default is
+// a vtkHttpTileSource for the layer's map-tile server.
+//
+// Tiles of remote sources are kept in the layer's on-disk cache,
+// revalidated, and requested with adaptive concurrency. Tiles of local
+// sources, such as vtkDirectoryTileSource, vtkPackedTileSource and
+// vtkProceduralTileSource, are read from the source every time.
+//
+// Implementations must be thread safe, as vtkMultiThreadedOsmLayer
+// reads tiles from its request threads.
+
+#ifndef __vtkTileSource_h
+#define __vtkTileSource_h
+
+#include "vtkmap_export.h"
+#include <vtkObject.h>
+
+#include <string>
+#include <vector>
+
+class vtkMapTileCacheInfo;
+
+class VTKMAP_EXPORT vtkTileSource : public vtkObject
+{
+public:
+  vtkTypeMacro(vtkTileSource, vtkObject)
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+
+  // Description:
+  // Read the encoded image of the tile into data. Returns false if the
+  // tile could not be read, with the same meaning of httpStatus,
+  // errorMessage and cacheInfo as in vtkMapTileFetcher::Fetch(). Local
+  // sources report a missing tile as status 404, and ignore cacheInfo.
+  virtual bool FetchTile(int zoom, int x, int y,
+                         std::vector<unsigned char>& data,
+                         long *httpStatus = NULL,
+                         std::string *errorMessage = NULL,
+                         vtkMapTileCacheInfo *cacheInfo = NULL) = 0;
+
+  // Description:
+  // Location of the tile, such as its URL, for messages and logs
+  virtual std::string GetTileUrl(int zoom, int x, int y) = 0;
+
+  // Description:
+  // Return true if tiles are read from this machine, so that there is
+  // no point in caching them on disk or limiting concurrent requests.
+  // Default is false.
+  virtual bool IsLocal();
+
+  // Description:
+  // Append the hosts tiles are requested from, which have their own
+  // limits on concurrent requests. Default is none.
+  virtual void GetHosts(std::vector<std::string>& hosts);
+
+protected:
+  vtkTileSource();
+  ~vtkTileSource();
+
+  // Description:
+  // Replace the {z}, {x} and {y} placeholders of a URL or path template
+  // by the tile indices
+  static std::string ExpandTemplate(const std::string& pattern,
+                                    int zoom, int x, int y);
+
+private:
+  vtkTileSource(const vtkTileSource&);  // Not implemented
+  void operator=(const vtkTileSource&); // Not implemented
+};
+
+#endif // __vtkTileSource_h